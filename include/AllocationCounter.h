@@ -0,0 +1,89 @@
+#ifndef ALLOCATIONCOUNTER_H
+#define ALLOCATIONCOUNTER_H
+
+#include <cstddef>
+
+/// @file AllocationCounter.h
+/// @brief Counts the heap allocations of the whole process by replacing the global operator new, so that the
+///        benchmarks can check that the simulation step doesn't allocate once it has warmed up
+/// @author Teemu Lindborg
+/// @version 1.0
+/// @date 18/10/2026 Initial version
+/// Revision History :
+///   Global operator new counting and allocation scopes 18/10/2026
+/// @todo Record the call stacks of the allocations inside a scope to find where they come from
+
+// ---------------------------------------------------------------------------------------
+/// @class AllocationCounter
+/// @brief Process wide allocation counts. Every operator new and new[] is counted, as are the NUMA placed buffers of
+///        Numa::allocate(), from all the threads. The counts are relaxed atomics, cheap enough to be always on.
+// ---------------------------------------------------------------------------------------
+class AllocationCounter
+{
+public:
+  // ---------------------------------------------------------------------------------------
+  /// @brief getAllocations
+  /// @return Amount of heap allocations since the start of the process
+  // ---------------------------------------------------------------------------------------
+  static unsigned long long getAllocations();
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief getBytes
+  /// @return Bytes requested by the heap allocations since the start of the process
+  // ---------------------------------------------------------------------------------------
+  static unsigned long long getBytes();
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief record     Counts an allocation that doesn't go through operator new
+  /// @param[in] _bytes Size of the allocation
+  // ---------------------------------------------------------------------------------------
+  static void record(const std::size_t &_bytes);
+}; // end of AllocationCounter
+
+// ---------------------------------------------------------------------------------------
+/// @class AllocationScope
+/// @brief Counts the allocations from its creation on, e.g. around the steps of a benchmark. The other threads of the
+///        process are counted as well, the background surface extraction included.
+// ---------------------------------------------------------------------------------------
+class AllocationScope
+{
+public:
+  // ---------------------------------------------------------------------------------------
+  /// @brief AllocationScope Default ctor, starts counting
+  // ---------------------------------------------------------------------------------------
+  AllocationScope() { reset(); }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief reset Starts counting again from zero
+  // ---------------------------------------------------------------------------------------
+  void reset()
+  {
+    m_allocations = AllocationCounter::getAllocations();
+    m_bytes = AllocationCounter::getBytes();
+  }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief getAllocations
+  /// @return Amount of heap allocations since the creation or reset
+  // ---------------------------------------------------------------------------------------
+  unsigned long long getAllocations() const { return AllocationCounter::getAllocations() - m_allocations; }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief getBytes
+  /// @return Bytes allocated since the creation or reset
+  // ---------------------------------------------------------------------------------------
+  unsigned long long getBytes() const { return AllocationCounter::getBytes() - m_bytes; }
+
+private:
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_allocations Allocation count at the start
+  // ---------------------------------------------------------------------------------------
+  unsigned long long m_allocations;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_bytes Allocated bytes at the start
+  // ---------------------------------------------------------------------------------------
+  unsigned long long m_bytes;
+}; // end of AllocationScope
+
+#endif
@@ -1,9 +1,7 @@
 #ifndef BOUNDINGBOX_H
 #define BOUNDINGBOX_H
 
-#include <memory>
-#include <ngl/VertexArrayObject.h>
-#include <ngl/Vec3.h>
+#include "VectorMath.h"
 
 /// @file BoundingBox.h
 /// @brief Implementation of a simple BoundingBox used as the boundaries of the simulation
@@ -12,17 +10,22 @@
 /// @date 17.03.2016 Commented
 /// Revision History :
 ///   Initial version 15.02.2016
+///   Moved the outline VAO to the renderer so the box is plain data 18/10/2026
+///   Kinematic walls moved in place with their velocities 18/10/2026
+///   Implicit copies, the walls are copied along with the extents 18/10/2026
 /// @todo Add the possibility to define each corner point for non axis-aligned boxes.
 
 // ---------------------------------------------------------------------------------------
 /// @struct Wall
-/// @brief Simple wall structure containing the center point, normal of the wall
+/// @brief Simple wall structure containing the center point, normal of the wall and the velocity
+///        the wall is moving at, zero for static walls
 // ---------------------------------------------------------------------------------------
 typedef struct Wall
 {
-  ngl::Vec3 centre;
-  ngl::Vec3 normal;
+  Vec3 centre;
+  Vec3 normal;
   float d;
+  Vec3 velocity;
 } Wall;
 
 // ---------------------------------------------------------------------------------------
@@ -32,6 +35,11 @@ typedef struct Wall
 class BoundingBox
 {
 public :
+  // ---------------------------------------------------------------------------------------
+  /// @brief Side Index of each wall in m_walls
+  // ---------------------------------------------------------------------------------------
+  enum Side {MIN_Y, MIN_X, MAX_Z, MAX_X, MIN_Z, MAX_Y};
+
   // ---------------------------------------------------------------------------------------
   /// @brief BoundingBox empty ctor
   // ---------------------------------------------------------------------------------------
@@ -46,9 +54,9 @@ public :
   /// @param[in] _minz Minimum z-coordinate
   /// @param[in] _maxz Maximum x-coordinate
   // ---------------------------------------------------------------------------------------
-  BoundingBox(const ngl::Real &_minx, const ngl::Real &_maxx,
-              const ngl::Real &_miny, const ngl::Real &_maxy,
-              const ngl::Real &_minz, const ngl::Real &_maxz)
+  BoundingBox(const float &_minx, const float &_maxx,
+              const float &_miny, const float &_maxy,
+              const float &_minz, const float &_maxz)
   {
     m_minx = _minx;
     m_maxx = _maxx;
@@ -58,63 +66,44 @@ public :
     m_maxz = _maxz;
   }
 
-  // ---------------------------------------------------------------------------------------
-  /// @brief operator =, overloaded = operator for copying the coordinates of another BoundingBox-type object
-  /// @param[in] _rhs BoundingBox to copy
-  // ---------------------------------------------------------------------------------------
-  void operator =(const BoundingBox &_rhs  ) noexcept
-  {
-    m_minx = _rhs.m_minx;
-    m_maxx = _rhs.m_maxx;
-    m_miny = _rhs.m_miny;
-    m_maxy = _rhs.m_maxy;
-    m_minz = _rhs.m_minz;
-    m_maxz = _rhs.m_maxz;
-  }
-
   // ---------------------------------------------------------------------------------------
   /// @brief m_minx Min x-coordinate
   // ---------------------------------------------------------------------------------------
-  ngl::Real m_minx;
+  float m_minx;
 
   // ---------------------------------------------------------------------------------------
   /// @brief m_maxx Max x-coordinate
   // ---------------------------------------------------------------------------------------
-  ngl::Real m_maxx;
+  float m_maxx;
 
   // ---------------------------------------------------------------------------------------
   /// @brief m_miny Min y-coordinate
   // ---------------------------------------------------------------------------------------
-  ngl::Real m_miny;
+  float m_miny;
 
   // ---------------------------------------------------------------------------------------
   /// @brief m_maxy Max y-coordinate
   // ---------------------------------------------------------------------------------------
-  ngl::Real m_maxy;
+  float m_maxy;
 
   // ---------------------------------------------------------------------------------------
   /// @brief m_minz Min z-coordinate
   // ---------------------------------------------------------------------------------------
-  ngl::Real m_minz;
+  float m_minz;
 
   // ---------------------------------------------------------------------------------------
   /// @brief m_maxz Max z-coordinate
   // ---------------------------------------------------------------------------------------
-  ngl::Real m_maxz;
+  float m_maxz;
 
   // ---------------------------------------------------------------------------------------
   /// @brief m_walls Array containing the 6 walls of the bounding box
   // ---------------------------------------------------------------------------------------
   Wall m_walls[6];
 
-  // ---------------------------------------------------------------------------------------
-  /// @brief m_vao Vertex Array Object for drawing the outline of the walls
-  // ---------------------------------------------------------------------------------------
-  std::unique_ptr<ngl::VertexArrayObject> m_vao;
-
   // ---------------------------------------------------------------------------------------
   /// @brief buildWalls Method to build the walls based on the given min and max
-  ///                   coordinates. Also calculates the normals and center points
+  ///                   coordinates. Calculates the normals and center points
   ///                   to be used in the collision detection/response calculations.
   // ---------------------------------------------------------------------------------------
   void buildWalls()
@@ -133,19 +122,9 @@ public :
      * 1              5
      */
 
-    // Define the indices for an indexed vao
-    const static GLubyte indices[] = {0, 1, 5, 4, 0, 2, 3, 1, 3, 7, 5, 7, 6, 4, 6, 2};
-
     // Defining each corner point
-    ngl::Vec3 p[8];
-    p[0] = ngl::Vec3(m_minx, m_miny, m_minz);
-    p[1] = ngl::Vec3(m_minx, m_miny, m_maxz);
-    p[2] = ngl::Vec3(m_minx, m_maxy, m_minz);
-    p[3] = ngl::Vec3(m_minx, m_maxy, m_maxz);
-    p[4] = ngl::Vec3(m_maxx, m_miny, m_minz);
-    p[5] = ngl::Vec3(m_maxx, m_miny, m_maxz);
-    p[6] = ngl::Vec3(m_maxx, m_maxy, m_minz);
-    p[7] = ngl::Vec3(m_maxx, m_maxy, m_maxz);
+    Vec3 p[8];
+    corners(p);
 
     // Calculating mid points for wall centre determination
     float halfX = (m_maxx + m_minx)/2.f;
@@ -155,59 +134,105 @@ public :
     // Calculating normals etc for each wall
     m_walls[0].normal = (p[5]-p[1]).cross(p[0]-p[1]);
     m_walls[0].normal.normalize();
-    m_walls[0].centre = ngl::Vec3(halfX, m_miny, halfZ);
+    m_walls[0].centre = Vec3(halfX, m_miny, halfZ);
     m_walls[0].d = -(m_walls[0].normal.m_x * m_walls[0].centre.m_x +
                      m_walls[0].normal.m_y * m_walls[0].centre.m_y +
                      m_walls[0].normal.m_z * m_walls[0].centre.m_z);
 
     m_walls[1].normal = (p[2]-p[0]).cross(p[1]-p[0]);
     m_walls[1].normal.normalize();
-    m_walls[1].centre = ngl::Vec3(m_minx, halfY, halfZ);
+    m_walls[1].centre = Vec3(m_minx, halfY, halfZ);
     m_walls[1].d = -(m_walls[1].normal.m_x * m_walls[1].centre.m_x +
                      m_walls[1].normal.m_y * m_walls[1].centre.m_y +
                      m_walls[1].normal.m_z * m_walls[1].centre.m_z);
 
     m_walls[2].normal = (p[3]-p[1]).cross(p[5]-p[1]);
     m_walls[2].normal.normalize();
-    m_walls[2].centre = ngl::Vec3(halfX, halfY, m_maxz);
+    m_walls[2].centre = Vec3(halfX, halfY, m_maxz);
     m_walls[2].d = -(m_walls[2].normal.m_x * m_walls[2].centre.m_x +
                      m_walls[2].normal.m_y * m_walls[2].centre.m_y +
                      m_walls[2].normal.m_z * m_walls[2].centre.m_z);
 
     m_walls[3].normal = (p[7]-p[5]).cross(p[4]-p[5]);
     m_walls[3].normal.normalize();
-    m_walls[3].centre = ngl::Vec3(m_maxx, halfY, halfZ);
+    m_walls[3].centre = Vec3(m_maxx, halfY, halfZ);
     m_walls[3].d = -(m_walls[3].normal.m_x * m_walls[3].centre.m_x +
                      m_walls[3].normal.m_y * m_walls[3].centre.m_y +
                      m_walls[3].normal.m_z * m_walls[3].centre.m_z);
 
     m_walls[4].normal = (p[6]-p[4]).cross(p[0]-p[4]);
     m_walls[4].normal.normalize();
-    m_walls[4].centre = ngl::Vec3(halfX, halfY, m_minz);
+    m_walls[4].centre = Vec3(halfX, halfY, m_minz);
     m_walls[4].d = -(m_walls[4].normal.m_x * m_walls[4].centre.m_x +
                      m_walls[4].normal.m_y * m_walls[4].centre.m_y +
                      m_walls[4].normal.m_z * m_walls[4].centre.m_z);
 
     m_walls[5].normal = (p[7]-p[6]).cross(p[2]-p[6]);
     m_walls[5].normal.normalize();
-    m_walls[5].centre = ngl::Vec3(halfX, m_maxy, halfZ);
+    m_walls[5].centre = Vec3(halfX, m_maxy, halfZ);
     m_walls[5].d = -(m_walls[5].normal.m_x * m_walls[5].centre.m_x +
                      m_walls[5].normal.m_y * m_walls[5].centre.m_y +
                      m_walls[5].normal.m_z * m_walls[5].centre.m_z);
 
-    // Setting up the VAO object to draw the outlines of the bounding box
-    m_vao.reset( ngl::VertexArrayObject::createVOA(GL_LINE_LOOP) );
-    m_vao->bind();
-    m_vao->setIndexedData(8*sizeof(ngl::Vec3),
-                               p[0].m_x,
-                               sizeof(indices),
-                               &indices[0],
-                               GL_UNSIGNED_BYTE, GL_STATIC_DRAW);
+    stopWalls();
+  }
 
-    m_vao->setVertexAttributePointer(0, 3, GL_FLOAT, sizeof(ngl::Vec3), 0);
+  // ---------------------------------------------------------------------------------------
+  /// @brief moveWall     Moves a wall along its normal to a new coordinate and sets its velocity from the
+  ///                     distance travelled. The walls are updated in place, the normals stay as they were
+  ///                     built as the box stays axis-aligned.
+  /// @param[in] _side      Wall to move
+  /// @param[in] _position  New coordinate of the wall on its axis
+  /// @param[in] _timeStep  Time the move takes
+  // ---------------------------------------------------------------------------------------
+  void moveWall(const Side &_side, const float &_position, const float &_timeStep)
+  {
+    float *coords[6] = {&m_miny, &m_minx, &m_maxz, &m_maxx, &m_minz, &m_maxy};
+    float &coord = *coords[_side];
+    const float speed = (_position - coord) / _timeStep;
+    coord = _position;
+
+    // The axis of the wall is the one its normal points along
+    Wall &wall = m_walls[_side];
+    wall.velocity = Vec3(wall.normal.m_x != 0.f ? speed : 0.f,
+                         wall.normal.m_y != 0.f ? speed : 0.f,
+                         wall.normal.m_z != 0.f ? speed : 0.f);
+
+    // The centres of the walls next to the moved one shift with it
+    const Vec3 half((m_maxx + m_minx)/2.f, (m_maxy + m_miny)/2.f, (m_maxz + m_minz)/2.f);
+    const Vec3 centres[6] = {Vec3(half.m_x, m_miny, half.m_z), Vec3(m_minx, half.m_y, half.m_z),
+                             Vec3(half.m_x, half.m_y, m_maxz), Vec3(m_maxx, half.m_y, half.m_z),
+                             Vec3(half.m_x, half.m_y, m_minz), Vec3(half.m_x, m_maxy, half.m_z)};
+    for(int i = 0; i < 6; ++i)
+    {
+      m_walls[i].centre = centres[i];
+      m_walls[i].d = -m_walls[i].normal.dot(centres[i]);
+    }
+  }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief stopWalls Sets the velocities of all the walls to zero
+  // ---------------------------------------------------------------------------------------
+  void stopWalls()
+  {
+    for(int i = 0; i < 6; ++i)
+      m_walls[i].velocity = Vec3(0.f, 0.f, 0.f);
+  }
 
-    m_vao->setNumIndices(sizeof(indices));
-    m_vao->unbind();
+  // ---------------------------------------------------------------------------------------
+  /// @brief corners    Method to get the corner points of the box, numbered as in buildWalls()
+  /// @param[out] o_p   Array of 8 points to write the corners to
+  // ---------------------------------------------------------------------------------------
+  void corners(Vec3 *o_p) const
+  {
+    o_p[0] = Vec3(m_minx, m_miny, m_minz);
+    o_p[1] = Vec3(m_minx, m_miny, m_maxz);
+    o_p[2] = Vec3(m_minx, m_maxy, m_minz);
+    o_p[3] = Vec3(m_minx, m_maxy, m_maxz);
+    o_p[4] = Vec3(m_maxx, m_miny, m_minz);
+    o_p[5] = Vec3(m_maxx, m_miny, m_maxz);
+    o_p[6] = Vec3(m_maxx, m_maxy, m_minz);
+    o_p[7] = Vec3(m_maxx, m_maxy, m_maxz);
   }
 }; // end of BoundingBox
 
@@ -0,0 +1,143 @@
+#ifndef COMPUTEBACKEND_H
+#define COMPUTEBACKEND_H
+
+#include <vector>
+#include "BoundingBox.h"
+#include "FrameFeed.h"
+#include "MultilevelSolver.h"
+#include "Particle.h"
+
+/// @file ComputeBackend.h
+/// @brief Interface for the stages of a simulation step, lets the same step run on the cpu or on an OpenCL device
+/// @author Teemu Lindborg
+/// @version 1.0
+/// @date 18/10/2026 Initial version
+/// Revision History :
+///   Step pipeline split into backend stages 18/10/2026
+///   Optional coloured Gauss-Seidel iteration 18/10/2026
+///   Warm start from the lambdas of the previous step 18/10/2026
+///   Optional coarse levels before the solver iterations 18/10/2026
+///   The grid can be refitted while the particle order doesn't change 18/10/2026
+///   The final positions can be written to the back buffer of a frame feed 18/10/2026
+///   A failed backend reports itself so the step can be run again elsewhere 18/10/2026
+/// @todo Keep the state on the device between the steps and share the position buffer with the renderer
+
+// ---------------------------------------------------------------------------------------
+/// @class ComputeBackend
+/// @brief Stages of a simulation step. FluidSystem calls them in the order of the pbf algorithm:
+///        beginStep, predict, buildGrid, buildNeighbors, optionally projectLevels and warmStart, then computeLambda, computePositionUpdate and
+///        applyPositionUpdate for each solver iteration, computeVorticity, finalize and endStep.
+///        Between beginStep and endStep the particle state is owned by the backend.
+// ---------------------------------------------------------------------------------------
+class ComputeBackend
+{
+public:
+  // ---------------------------------------------------------------------------------------
+  /// @brief ~ComputeBackend Default dtor
+  // ---------------------------------------------------------------------------------------
+  virtual ~ComputeBackend() {}
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief getName
+  /// @return Name of the backend shown to the user
+  // ---------------------------------------------------------------------------------------
+  virtual const char *getName() const = 0;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief isValid  Whether the stages have run, a backend that has failed skips the rest of its stages and
+  ///                 leaves the particles it was handed in beginStep() as they were
+  /// @return         False once the backend has failed
+  // ---------------------------------------------------------------------------------------
+  virtual bool isValid() const { return true; }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief beginStep        Hands the particles over to the backend for a step
+  /// @param[io] io_particles Particles of the system, the first _count of them are simulated
+  /// @param[in] _count       Amount of simulated particles, the rest are ghosts of a distributed run
+  /// @param[in] _bb          Bounding box the particles collide with
+  // ---------------------------------------------------------------------------------------
+  virtual void beginStep(std::vector<Particle *> &io_particles, const unsigned int &_count, const BoundingBox &_bb) = 0;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief predict        Applies the forces to the velocities and predicts the positions
+  /// @param[in] _timeStep  Time step
+  // ---------------------------------------------------------------------------------------
+  virtual void predict(const float &_timeStep) = 0;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief buildGrid    Sorts the particles to the grid cells
+  /// @param[in] _refit   The particles are in the order of the previous step, the search structure may be refitted
+  ///                     instead of built again
+  // ---------------------------------------------------------------------------------------
+  virtual void buildGrid(const bool &_refit) = 0;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief buildNeighbors Builds the neighbor lists from the grid
+  // ---------------------------------------------------------------------------------------
+  virtual void buildNeighbors() = 0;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief computeLambda    Computes the density and the scaling factor of each particle
+  /// @param[in] _iteration   Solver iteration, used to label the stage
+  // ---------------------------------------------------------------------------------------
+  virtual void computeLambda(const unsigned int &_iteration) = 0;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief warmStart Moves the particles by the position updates of the lambdas they carry from the last
+  ///                  iteration of the previous step and handles the collisions, before the first lambda pass
+  // ---------------------------------------------------------------------------------------
+  virtual void warmStart() = 0;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief projectLevels    Projects the coarse levels of a multilevel solver and moves the particles by the
+  ///                         corrections, before the first solver iteration
+  /// @param[in,out] io_levels Solver holding the hierarchy and its scratch buffers
+  /// @return                 False if the backend can't run the coarse levels, nothing is done then
+  // ---------------------------------------------------------------------------------------
+  virtual bool projectLevels(MultilevelSolver &) { return false; }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief computePositionUpdate  Computes the position update of each particle
+  /// @param[in] _iteration         Solver iteration, used to label the stage
+  // ---------------------------------------------------------------------------------------
+  virtual void computePositionUpdate(const unsigned int &_iteration) = 0;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief applyPositionUpdate  Applies the position updates and handles the collisions with the bounding box
+  /// @param[in] _iteration       Solver iteration, used to label the stage
+  /// @param[in] _lastIteration   Whether to also calculate the velocities from the new predicted positions
+  /// @param[in] _timeStep        Time step
+  // ---------------------------------------------------------------------------------------
+  virtual void applyPositionUpdate(const unsigned int &_iteration, const bool &_lastIteration, const float &_timeStep) = 0;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief solveColoured      Runs a solver iteration as a Gauss-Seidel sweep instead of the three Jacobi stages,
+  ///                           see CpuBackend::solveColoured()
+  /// @param[in] _iteration     Solver iteration, the particles are coloured on the first one
+  /// @param[in] _lastIteration Whether to also calculate the velocities from the new predicted positions
+  /// @param[in] _timeStep      Time step
+  /// @return                   False if the backend only has the Jacobi stages, nothing is done then
+  // ---------------------------------------------------------------------------------------
+  virtual bool solveColoured(const unsigned int &, const bool &, const float &) { return false; }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief computeVorticity Computes the vorticity confinement and the xsph viscosity
+  /// @param[in] _timeStep    Time step
+  // ---------------------------------------------------------------------------------------
+  virtual void computeVorticity(const float &_timeStep) = 0;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief finalize     Applies the viscosity and moves the particles to their predicted positions
+  /// @param[out] o_frame Back buffer of a frame feed that gets the vertex of each simulated particle once the
+  ///                     particle is final, at the latest by endStep(), nullptr when no frame is published
+  // ---------------------------------------------------------------------------------------
+  virtual void finalize(FrameVertex *o_frame) = 0;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief endStep          Hands the particles back after a step
+  /// @param[io] io_particles Particles of the system, updated with the state of the backend
+  // ---------------------------------------------------------------------------------------
+  virtual void endStep(std::vector<Particle *> &io_particles) = 0;
+}; // end of ComputeBackend
+
+#endif
@@ -0,0 +1,109 @@
+#ifndef CPUBACKEND_H
+#define CPUBACKEND_H
+
+#include "ComputeBackend.h"
+#include "FluidSolver.h"
+#include "NNS.h"
+
+/// @file CpuBackend.h
+/// @brief Runs the stages of a simulation step on the cpu with OpenMP
+/// @author Teemu Lindborg
+/// @version 1.0
+/// @date 18/10/2026 Initial version
+/// Revision History :
+///   Whole-array loops moved from FluidSystem 18/10/2026
+///   Gauss-Seidel iterations over coloured grid cells 18/10/2026
+///   Warm start pass 18/10/2026
+///   Coarse levels of the multilevel solver 18/10/2026
+/// @todo
+
+// ---------------------------------------------------------------------------------------
+/// @class CpuBackend
+/// @brief Backend running each stage as a parallel loop over the particles using the solver and the
+///        neighbor search of the fluid system, works on the particles in place
+// ---------------------------------------------------------------------------------------
+class CpuBackend : public ComputeBackend
+{
+public:
+  // ---------------------------------------------------------------------------------------
+  /// @brief CpuBackend   Default ctor
+  /// @param[in] _solver  Solver of the fluid system
+  /// @param[in] _nns     Grid and neighbor tables of the fluid system
+  // ---------------------------------------------------------------------------------------
+  CpuBackend(FluidSolver &_solver, NNS &_nns);
+
+  const char *getName() const { return "cpu"; }
+  void beginStep(std::vector<Particle *> &io_particles, const unsigned int &_count, const BoundingBox &_bb);
+  void predict(const float &_timeStep);
+  void buildGrid(const bool &_refit);
+  void buildNeighbors();
+  void computeLambda(const unsigned int &_iteration);
+  void warmStart();
+  bool projectLevels(MultilevelSolver &io_levels);
+  void computePositionUpdate(const unsigned int &_iteration);
+  void applyPositionUpdate(const unsigned int &_iteration, const bool &_lastIteration, const float &_timeStep);
+  bool solveColoured(const unsigned int &_iteration, const bool &_lastIteration, const float &_timeStep);
+  void computeVorticity(const float &_timeStep);
+  void finalize(FrameVertex *o_frame);
+  void endStep(std::vector<Particle *> &io_particles);
+
+private:
+  // ---------------------------------------------------------------------------------------
+  /// @brief colour Sorts the particles to their grid cells and the cells to colours by their coordinates modulo
+  ///               the search range + 1. The particles of two cells of the same colour are always more than the
+  ///               search range apart on some axis so they're never on each other's neighbor lists.
+  // ---------------------------------------------------------------------------------------
+  void colour();
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_solver Solver of the fluid system
+  // ---------------------------------------------------------------------------------------
+  FluidSolver &m_solver;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_nns Grid and neighbor tables of the fluid system
+  // ---------------------------------------------------------------------------------------
+  NNS &m_nns;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_particles Particles of the current step, ghost particles may be appended during the step
+  // ---------------------------------------------------------------------------------------
+  std::vector<Particle *> *m_particles;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_count Amount of simulated particles
+  // ---------------------------------------------------------------------------------------
+  unsigned int m_count;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_bb Bounding box of the current step
+  // ---------------------------------------------------------------------------------------
+  const BoundingBox *m_bb;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_particleCells Grid cell of each particle, clamped to the grid
+  // ---------------------------------------------------------------------------------------
+  std::vector<unsigned int> m_particleCells;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_cellParticles Particle indices sorted by cell
+  // ---------------------------------------------------------------------------------------
+  std::vector<unsigned int> m_cellParticles;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_cellOffsets Start of each cell in m_cellParticles followed by the particle count
+  // ---------------------------------------------------------------------------------------
+  std::vector<unsigned int> m_cellOffsets;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_colourCells Non-empty cells sorted by colour
+  // ---------------------------------------------------------------------------------------
+  std::vector<unsigned int> m_colourCells;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_colourOffsets Start of each colour in m_colourCells followed by the cell count
+  // ---------------------------------------------------------------------------------------
+  std::vector<unsigned int> m_colourOffsets;
+}; // end of CpuBackend
+
+#endif
@@ -0,0 +1,217 @@
+#ifndef DOMAIN_H
+#define DOMAIN_H
+
+#ifdef PBF_USE_MPI
+
+#include <mpi.h>
+#include <vector>
+#include "BoundingBox.h"
+#include "Particle.h"
+
+/// @file Domain.h
+/// @brief Domain decomposition of the simulation over MPI ranks. The bounding box is split into slabs
+///        along one axis, each rank owns the particles inside its slab and receives a halo of ghost
+///        particles from the neighboring slabs
+/// @author Teemu Lindborg
+/// @version 1.0
+/// @date 18/10/2026 Initial version
+/// Revision History :
+///   Slab decomposition, halo exchange, migration and load balancing 18/10/2026
+///   Global sums for the decisions all the ranks have to agree on 18/10/2026
+/// @todo k-d decomposition for domains that are large along more than one axis
+
+// ---------------------------------------------------------------------------------------
+/// @struct HaloState
+/// @brief Subset of the particle state that's refreshed on the ghost particles during a step
+// ---------------------------------------------------------------------------------------
+typedef struct HaloState
+{
+  Vec3 predPos;
+  Vec3 vel;
+  float density;
+  float lambda;
+} HaloState;
+
+// ---------------------------------------------------------------------------------------
+/// @class Domain
+/// @brief Slab decomposition of the bounding box, handles the particle migration, halo exchange
+///        and load balancing between the ranks. The particle vector of a rank is laid out so that
+///        the owned particles come first and the ghost particles after them
+// ---------------------------------------------------------------------------------------
+class Domain
+{
+public:
+  // ---------------------------------------------------------------------------------------
+  /// @brief Domain Default ctor
+  /// @param[in] _comm Communicator containing the ranks the domain is split over
+  // ---------------------------------------------------------------------------------------
+  Domain(MPI_Comm _comm = MPI_COMM_WORLD);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief ~Domain Default dtor
+  // ---------------------------------------------------------------------------------------
+  ~Domain();
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief init             Splits the bounding box into equally sized slabs
+  /// @param[in] _bb          Bounding box of the whole simulation
+  /// @param[in] _haloWidth   Width of the halo, should be at least the smoothing length
+  /// @param[in] _axis        Axis the slabs are cut along (0 = x, 1 = y, 2 = z)
+  // ---------------------------------------------------------------------------------------
+  void init(const BoundingBox &_bb, const float &_haloWidth, const int &_axis = 0);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief needsBalance     Checks whether the particle counts of the ranks have drifted apart
+  /// @param[in] _ownedCount  Amount of particles owned by this rank
+  /// @return                 True if the most loaded rank exceeds the average by more than the tolerance
+  // ---------------------------------------------------------------------------------------
+  bool needsBalance(const unsigned int &_ownedCount);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief balance          Moves the slab boundaries so that each rank gets roughly the same amount of particles,
+  ///                         the particles are not moved, call migrate() afterwards
+  /// @param[in] _particles   Particles of this rank
+  /// @param[in] _ownedCount  Amount of particles owned by this rank
+  // ---------------------------------------------------------------------------------------
+  void balance(const ParticleBuffer &_particles, const unsigned int &_ownedCount);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief migrate          Sends the particles that have left the slab to their new owners and receives the
+  ///                         particles that have entered it. The ghost particles are invalidated.
+  /// @param[io] io_particles Particles of this rank, the particles past the owned count are overwritten
+  /// @param[io] io_ownedCount Amount of particles owned by this rank
+  // ---------------------------------------------------------------------------------------
+  void migrate(ParticleBuffer &io_particles, unsigned int &io_ownedCount);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief exchangeHalo     Sends the owned particles within the halo width of other slabs to the corresponding
+  ///                         ranks and appends the received ghost particles after the owned ones
+  /// @param[io] io_particles Particles of this rank
+  /// @param[in] _ownedCount  Amount of particles owned by this rank
+  // ---------------------------------------------------------------------------------------
+  void exchangeHalo(ParticleBuffer &io_particles, const unsigned int &_ownedCount);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief refreshHalo      Updates the state of the ghost particles received in the last exchangeHalo()
+  /// @param[io] io_particles Particles of this rank
+  /// @param[in] _ownedCount  Amount of particles owned by this rank
+  // ---------------------------------------------------------------------------------------
+  void refreshHalo(ParticleBuffer &io_particles, const unsigned int &_ownedCount);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief localBounds      Bounding box of the slab including the halo, used for the local grid
+  /// @param[in] _bb          Bounding box of the whole simulation
+  /// @param[out] o_bb        Local bounding box
+  // ---------------------------------------------------------------------------------------
+  void localBounds(const BoundingBox &_bb, BoundingBox &o_bb) const;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief globalCount      Sums the owned particle counts over all the ranks
+  /// @param[in] _ownedCount  Amount of particles owned by this rank
+  /// @return                 Total particle count of the simulation
+  // ---------------------------------------------------------------------------------------
+  unsigned long globalCount(const unsigned int &_ownedCount);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief globalSum    Sums a value over all the ranks, every rank gets the same result
+  /// @param[in] _local   Value of this rank
+  /// @return             Sum over the ranks
+  // ---------------------------------------------------------------------------------------
+  double globalSum(const double &_local);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief getRank
+  /// @return Rank of this process
+  // ---------------------------------------------------------------------------------------
+  int getRank() const { return m_rank; }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief getSize
+  /// @return Amount of ranks
+  // ---------------------------------------------------------------------------------------
+  int getSize() const { return m_size; }
+
+private:
+  // ---------------------------------------------------------------------------------------
+  /// @brief coord    Coordinate of a position along the decomposition axis
+  /// @param[in] _p   Position
+  /// @return         Coordinate along the axis
+  // ---------------------------------------------------------------------------------------
+  float coord(const Vec3 &_p) const;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief owner    Rank owning a coordinate, coordinates outside of the box belong to the first or last rank
+  /// @param[in] _c   Coordinate along the decomposition axis
+  /// @return         Owning rank
+  // ---------------------------------------------------------------------------------------
+  int owner(const float &_c) const;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief exchange     Exchanges per rank send buffers with MPI_Alltoallv
+  /// @param[in] _send    Data to send to each rank
+  /// @param[in] _type    MPI datatype of a single element
+  /// @param[out] o_recv  Received data, in rank order
+  /// @param[out] o_recvCounts Amount of elements received from each rank
+  // ---------------------------------------------------------------------------------------
+  template <typename T>
+  void exchange(const std::vector<std::vector<T>> &_send, MPI_Datatype _type, std::vector<T> &o_recv, std::vector<int> &o_recvCounts);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_comm Communicator of the decomposition
+  // ---------------------------------------------------------------------------------------
+  MPI_Comm m_comm;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_rank Rank of this process
+  // ---------------------------------------------------------------------------------------
+  int m_rank;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_size Amount of ranks
+  // ---------------------------------------------------------------------------------------
+  int m_size;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_axis Axis the slabs are cut along
+  // ---------------------------------------------------------------------------------------
+  int m_axis;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_haloWidth Width of the halo region
+  // ---------------------------------------------------------------------------------------
+  float m_haloWidth;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_imbalanceTolerance Allowed ratio between the most loaded rank and the average
+  // ---------------------------------------------------------------------------------------
+  float m_imbalanceTolerance;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_cuts Slab boundaries, rank r owns the coordinates [m_cuts[r], m_cuts[r+1])
+  // ---------------------------------------------------------------------------------------
+  std::vector<float> m_cuts;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_haloSend Indices of the owned particles sent to each rank in the last halo exchange
+  // ---------------------------------------------------------------------------------------
+  std::vector<std::vector<unsigned int>> m_haloSend;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_haloStates Send buffers for the halo refresh, kept around to avoid reallocating them
+  // ---------------------------------------------------------------------------------------
+  std::vector<std::vector<HaloState>> m_haloStates;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_particleType MPI datatype for a whole particle
+  // ---------------------------------------------------------------------------------------
+  MPI_Datatype m_particleType;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_haloType MPI datatype for a HaloState
+  // ---------------------------------------------------------------------------------------
+  MPI_Datatype m_haloType;
+}; // end of Domain
+
+#endif // PBF_USE_MPI
+
+#endif
@@ -0,0 +1,143 @@
+#ifndef ENSEMBLE_H
+#define ENSEMBLE_H
+
+#include <ostream>
+#include <string>
+#include <vector>
+#include "FluidSolver.h"
+#include "Seeder.h"
+#include "TaskScheduler.h"
+
+/// @file Ensemble.h
+/// @brief Runs many independent small scenes concurrently for parameter sweeps, a scene of a few thousand
+///        particles doesn't have enough work per loop to use many cores but hundreds of them side by side do
+/// @author Teemu Lindborg
+/// @version 1.0
+/// @date 18/10/2026 Initial version
+/// Revision History :
+///   Scenes as tasks on a shared thread pool, per scene metrics 18/10/2026
+///   Relaxation, warm start and coarse levels of the solver per scene 18/10/2026
+/// @todo Split the scenes into chunks of steps so a long scene at the end of the queue doesn't idle the other workers
+
+// ---------------------------------------------------------------------------------------
+/// @struct EnsembleScene
+/// @brief Setup of a single scene of the ensemble
+// ---------------------------------------------------------------------------------------
+typedef struct EnsembleScene
+{
+  std::string name;
+  SolverParameters parameters;
+  unsigned int iterations;
+  float relaxation;
+  bool warmStart;
+  unsigned int levels;
+  unsigned int steps;
+  bool waves;
+  Seeder seeder;
+} EnsembleScene;
+
+// ---------------------------------------------------------------------------------------
+/// @struct SceneMetrics
+/// @brief Results of a scene. The densities are relative to the rest density and taken after the last step,
+///        a scene is stable if all the particles are finite and inside the bounding box at the end.
+// ---------------------------------------------------------------------------------------
+typedef struct SceneMetrics
+{
+  unsigned int particles;
+  unsigned int worker;
+  float meanStepTime;
+  float maxStepTime;
+  float meanDensity;
+  float maxDensity;
+  float kineticEnergy;
+  bool stable;
+} SceneMetrics;
+
+// ---------------------------------------------------------------------------------------
+/// @class Ensemble
+/// @brief Holds the scenes of a sweep and runs each of them as a task on a shared pool of workers. A scene is
+///        created, simulated and destroyed on a single worker with the OpenMP loops inside it limited to that
+///        thread, so the memory of the scene stays next to the core running it and the pool size bounds the
+///        amount of scenes alive at once.
+// ---------------------------------------------------------------------------------------
+class Ensemble
+{
+public:
+  // ---------------------------------------------------------------------------------------
+  /// @brief Ensemble     Default ctor, starts the workers
+  /// @param[in] _threads Amount of workers including the calling thread, 0 for the hardware concurrency
+  // ---------------------------------------------------------------------------------------
+  explicit Ensemble(const unsigned int &_threads = 0);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief defaultScene Scene with the default constants and the dam break
+  /// @param[in] _steps   Amount of steps to simulate
+  /// @return             Scene to modify and add
+  // ---------------------------------------------------------------------------------------
+  static EnsembleScene defaultScene(const unsigned int &_steps);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief addScene     Adds a scene to run
+  /// @param[in] _scene   Setup of the scene
+  /// @return             Index of the scene and its metrics
+  // ---------------------------------------------------------------------------------------
+  unsigned int addScene(const EnsembleScene &_scene);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief run  Runs all the scenes and returns once they have finished
+  // ---------------------------------------------------------------------------------------
+  void run();
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief getScenes
+  /// @return Setups of the scenes
+  // ---------------------------------------------------------------------------------------
+  const std::vector<EnsembleScene> &getScenes() const { return m_scenes; }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief getMetrics
+  /// @return Results of the scenes, valid after run()
+  // ---------------------------------------------------------------------------------------
+  const std::vector<SceneMetrics> &getMetrics() const { return m_metrics; }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief getThreadCount
+  /// @return Amount of workers
+  // ---------------------------------------------------------------------------------------
+  unsigned int getThreadCount() const { return m_scheduler.getThreadCount(); }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief writeCSV       Writes the parameters and metrics of each scene as a row of comma separated values
+  /// @param[out] o_stream  Stream to write to
+  // ---------------------------------------------------------------------------------------
+  void writeCSV(std::ostream &o_stream) const;
+
+private:
+  // ---------------------------------------------------------------------------------------
+  /// @brief runScene   Creates, simulates and measures a scene on the calling worker
+  /// @param[in] _index Index of the scene
+  // ---------------------------------------------------------------------------------------
+  void runScene(const unsigned int &_index);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_scheduler Pool of the workers
+  // ---------------------------------------------------------------------------------------
+  TaskScheduler m_scheduler;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_graph One task per scene without dependencies
+  // ---------------------------------------------------------------------------------------
+  TaskGraph m_graph;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_scenes Setups of the scenes
+  // ---------------------------------------------------------------------------------------
+  std::vector<EnsembleScene> m_scenes;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_metrics Results of the scenes
+  // ---------------------------------------------------------------------------------------
+  std::vector<SceneMetrics> m_metrics;
+}; // end of Ensemble
+
+#endif
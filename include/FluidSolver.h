@@ -1,9 +1,10 @@
 #ifndef FLUIDSOLVER_H
 #define FLUIDSOLVER_H
 
-#include <ngl/Vec3.h>
+#include "VectorMath.h"
 #include <vector>
 
+#include "BoundingBox.h"
 #include "Particle.h"
 
 /// @file FluidSolver.h
@@ -14,10 +15,39 @@
 /// Revision History :
 ///   Started blocking out 08.02.16
 ///   Implemented the solver and commented the code 17.03.16
+///   Fused the neighbor loops so each kernel walks the neighbors once 18/10/2026
+///   Kernels on the squared distance and optional lookup tables 18/10/2026
+///   Environment collisions and the parameters for the compute backends 18/10/2026
+///   Own vector types instead of NGL's, const vector parameters 18/10/2026
+///   Tunable constants can be set for parameter sweeps 18/10/2026
+///   Collisions relative to the velocity of the wall 18/10/2026
+///   Over-relaxation of the position updates 18/10/2026
+///   Density colouring moved to the renderer 18/10/2026
+///   Removed the distance based density kernels the fused loops replaced 18/10/2026
+///   Kernel tables of less than 2 intervals are raised to 2, the fixed radius weight follows the tables 18/10/2026
 /// @todo Make the code more robust
 
 constexpr float m_pi = 3.14159265359f;
 
+// ---------------------------------------------------------------------------------------
+/// @struct SolverParameters
+/// @brief Constants of the solver, used by the compute backends that run the solver outside of this class
+// ---------------------------------------------------------------------------------------
+typedef struct SolverParameters
+{
+  float smoothingLength;
+  float polyKernelConstant;
+  float spikyKernelConstant;
+  float inverseRestDensity;
+  float inverseFixedRadiusWeight;
+  float k;
+  int n;
+  float epsilon;
+  float xsph_c;
+  float vorticityScale;
+  Vec3 gravity;
+} SolverParameters;
+
 // ---------------------------------------------------------------------------------------
 /// @class FluidSolver
 /// @brief Solver implementing the algorithm defined in the original PBF paper by M. Macklin & M. Müller
@@ -44,7 +74,8 @@ public:
   void predictPos(Particle* &io_p, const float &_t);
 
   // ---------------------------------------------------------------------------------------
-  /// @brief computeLambda        Computes the scaling factor for a particle, used for the position update calculations (formula 11)
+  /// @brief computeLambda        Computes the density and the scaling factor for a particle, used for the position update
+  ///                             calculations (formulas 2 & 11). Both are accumulated in a single pass over the neighbors.
   /// @param[io] io_particles     Vector holding all the particles
   /// @param[in] _currentParticle Index of the particle currently being updated
   /// @param[in] _neighbors       Array of neighbor indices for the particle
@@ -53,56 +84,90 @@ public:
   void computeLambda(std::vector<Particle *> &io_particles, const unsigned int &_currentParticle, unsigned int *_neighbors, const unsigned int &_numNeighbors);
 
   // ---------------------------------------------------------------------------------------
-  /// @brief computeDensity       Computes the density of a particle based on the neighboring particles (formula 2)
-  /// @param[io] io_particles     Vector holding all the particles
-  /// @param[in] _currentParticle Index of the particle currently being updated
-  /// @param[in] _neighbors       Array of neighbor indices for the particle
-  /// @param[in] _numNeighbors    Amount of neighbors
-  // ---------------------------------------------------------------------------------------
-  void computeDensity(std::vector<Particle *> &io_particles, const unsigned int &_currentParticle, unsigned int *_neighbors, const unsigned int &_numNeighbors);
-
-  // ---------------------------------------------------------------------------------------
-  /// @brief computeVorticityAndXSPH  Computes and adds xsph viscosity and vorticity confiment to the particles velocity (formulas 16 & 17)
+  /// @brief computeVorticityAndXSPH  Computes xsph viscosity and adds vorticity confiment to the particles external forces (formulas 16 & 17)
   /// @param[io] io_particles         Vector holding all the particles
   /// @param[in] _currentParticle     Index of the particle currently being updated
   /// @param[in] _neighbors           Array of neighbor indices for the particle
   /// @param[in] _numNeighbors        Amount of neighbors
   /// @param[in] _t                   Time step
+  /// @return                         XSPH viscosity to add to the particle's velocity, left to the caller so
+  ///                                 that the neighbors can still read the unmodified velocity
   // ---------------------------------------------------------------------------------------
-  void computeVorticityAndXSPH(std::vector<Particle *> &io_particles, const unsigned int &_currentParticle, unsigned int *_neighbors, const unsigned int &_numNeighbors, float &_t);
+  Vec3 computeVorticityAndXSPH(std::vector<Particle *> &io_particles, const unsigned int &_currentParticle, unsigned int *_neighbors, const unsigned int &_numNeighbors, const float &_t);
 
   // ---------------------------------------------------------------------------------------
-  /// @brief computeArtificialPressure  Computes artificial pressure correction for particle position update
-  /// @param[in] _p                     Vector holding the predicted position of the current particle
-  /// @param[in] _n                     Vector holding the predicted position of a neighboring particle
+  /// @brief computeArtificialPressure  Computes artificial pressure correction for a known distance
+  /// @param[in] _r2                    Squared distance between the two particles
   /// @return                           Correction scalar
   // ---------------------------------------------------------------------------------------
-  float computeArtificialPressure(ngl::Vec3 &_p, ngl::Vec3 &_n);
+  float computeArtificialPressure(const float &_r2);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief computePoly6 Calculates the poly6 kernel directly from the squared distance, no square root needed
+  /// @param[in] _r2      Squared distance between two particles
+  /// @return             Weight of the neighboring particle
+  // ---------------------------------------------------------------------------------------
+  float computePoly6(const float &_r2);
 
   // ---------------------------------------------------------------------------------------
-  /// @brief computeDensityKernel Calculates the weight of a neighboring particle using a poly6 kernel
-  /// @param[in] _r               Distance between two particles
-  /// @return                     Weight of the neighboring particle
+  /// @brief computeSpikyGradient Calculates the spiky kernel gradient from the vector between the particles and its
+  ///                             squared length using a single inverse square root
+  /// @param[in] _v               Vector from the neighboring particle to the current particle
+  /// @param[in] _r2              Squared length of the vector
+  /// @return                     Gradient vector
   // ---------------------------------------------------------------------------------------
-  float computeDensityKernel(const float &_r);
+  Vec3 computeSpikyGradient(const Vec3 &_v, const float &_r2);
 
   // ---------------------------------------------------------------------------------------
-  /// @brief computeDensityKernelGradient Calculates the gradient of the density kernel using a spiky kernel
-  /// @param[in] _p                       Predicted position of the current particle
-  /// @param[in] _n                       Predicted position of a neighboring particle
-  /// @return                             Gradient vector
+  /// @brief setKernelTable Tabulates the kernels over r^2/h^2 and interpolates them linearly instead of evaluating
+  ///                       them, the error falls with the square of the table size
+  /// @param[in] _size      Amount of intervals in the tables, 0 evaluates the kernels directly, 1 is raised to 2
   // ---------------------------------------------------------------------------------------
-  ngl::Vec3 computeDensityKernelGradient(ngl::Vec3 &_p, ngl::Vec3 &_n);
+  void setKernelTable(const unsigned int &_size);
 
   // ---------------------------------------------------------------------------------------
-  /// @brief calcPositionUpdate     Calculates a position update for a particle
+  /// @brief calcPositionUpdate     Calculates a position update for a particle, the collisions are left to the caller
+  ///                               so that the neighbors can keep reading the predicted position
   /// @param[io] io_particles       Vector holding all the particles
   /// @param[in] _currentParticle   Index of the particle currently being updated
   /// @param[in] _neighbors         Array of neighbor indices for the particle
   /// @param[in] _numNeighbors      Amount of neighbors
-  /// @return                       The position update
+  /// @return                       The position update scaled by the relaxation factor
   // ---------------------------------------------------------------------------------------
-  ngl::Vec3 calcPositionUpdate(std::vector<Particle *> &io_particles, const unsigned int &_currentParticle, unsigned int *_neighbors, const unsigned int &_numNeighbors);
+  Vec3 calcPositionUpdate(std::vector<Particle *> &io_particles, const unsigned int &_currentParticle, unsigned int *_neighbors, const unsigned int &_numNeighbors);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief handleEnvCollisions  Handles the collision of a particle with the bounding box
+  /// @param[io] io_p             Particle that's checked for collisions
+  /// @param[in] _bb              Bounding box with its walls built
+  // ---------------------------------------------------------------------------------------
+  void handleEnvCollisions(Particle *io_p, const BoundingBox &_bb);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief getParameters
+  /// @return Constants of the solver
+  // ---------------------------------------------------------------------------------------
+  SolverParameters getParameters() const;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief setParameters    Sets the tunable constants: k, n, epsilon, xsph_c, the vorticity scale and gravity. The
+  ///                         kernel constants follow from the smoothing length and are ignored.
+  /// @param[in] _parameters  Constants, usually from getParameters() with some of them changed
+  // ---------------------------------------------------------------------------------------
+  void setParameters(const SolverParameters &_parameters);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief setRelaxation  Scales the position updates, over 1 over-relaxes the constraint projection. Not one of
+  ///                       the constants as it's changed while running when the solver diverges.
+  /// @param[in] _factor    Relaxation factor, 1 by default
+  // ---------------------------------------------------------------------------------------
+  void setRelaxation(const float &_factor) { m_relaxation = _factor; }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief getRelaxation
+  /// @return Relaxation factor of the position updates
+  // ---------------------------------------------------------------------------------------
+  float getRelaxation() const { return m_relaxation; }
 
 private:
   // ---------------------------------------------------------------------------------------
@@ -140,6 +205,16 @@ private:
   // ---------------------------------------------------------------------------------------
   float m_xsph_c;
 
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_vorticityScale Scale for the vorticity confinement force
+  // ---------------------------------------------------------------------------------------
+  float m_vorticityScale;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_relaxation Scale of the position updates
+  // ---------------------------------------------------------------------------------------
+  float m_relaxation;
+
   // ---------------------------------------------------------------------------------------
   /// @brief m_polyKernelConstant Precomputed poly6 kernel constant
   // ---------------------------------------------------------------------------------------
@@ -153,7 +228,38 @@ private:
   // ---------------------------------------------------------------------------------------
   /// @brief m_gravity Vector holding gravity force
   // ---------------------------------------------------------------------------------------
-  ngl::Vec3 m_gravity;
+  Vec3 m_gravity;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_smoothingLength2 Squared smoothing length
+  // ---------------------------------------------------------------------------------------
+  float m_smoothingLength2;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_inverseFixedRadiusWeight 1 / poly6 weight at the fixed radius, used by the artificial pressure
+  // ---------------------------------------------------------------------------------------
+  float m_inverseFixedRadiusWeight;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_tableSize Amount of intervals in the kernel tables, 0 if the tables aren't used
+  // ---------------------------------------------------------------------------------------
+  unsigned int m_tableSize;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_tableScale Maps a squared distance to a table position (size / h^2)
+  // ---------------------------------------------------------------------------------------
+  float m_tableScale;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_poly6Table Poly6 kernel sampled at r^2 = i * h^2 / size
+  // ---------------------------------------------------------------------------------------
+  std::vector<float> m_poly6Table;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_spikyTable Spiky gradient scale (constant * (h - r)^2 / r) at the same samples, the first
+  ///                     interval is singular at r = 0 so it's evaluated directly instead
+  // ---------------------------------------------------------------------------------------
+  std::vector<float> m_spikyTable;
 
 protected:
 
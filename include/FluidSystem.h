@@ -1,12 +1,26 @@
 #ifndef FLUIDSYSTEM_H
 #define FLUIDSYSTEM_H
 
+#include <algorithm>
+#include <chrono>
 #include <memory>
+#include <string>
 #include <vector>
 #include "BoundingBox.h"
+#include "ComputeBackend.h"
 #include "FluidSolver.h"
+#include "FrameFeed.h"
+#include "MetricsFeed.h"
+#include "MultilevelSolver.h"
 #include "NNS.h"
 #include "Particle.h"
+#include "ParticleOrder.h"
+#include "Seeder.h"
+#include "SurfaceMesher.h"
+#include "TaskScheduler.h"
+
+class Domain;
+class Workload;
 
 /// @file FluidSystem.h
 /// @brief Fluid system -class encapsulates and plugs together the whole system, handles the creation of the particles
@@ -17,6 +31,25 @@
 /// Revision History :
 ///   Started blocking out 08/02/16
 ///   Implemented the system and commented code -17/03/2016
+///   Step stages moved behind the compute backends 18/10/2026
+///   Surface extraction after the step 18/10/2026
+///   Bounding box drawing moved to the renderer 18/10/2026
+///   Particles created by the seeder 18/10/2026
+///   Space filling curve reordering of the particles and lookup by id 18/10/2026
+///   Solver constants and iterations settable for the ensemble runs 18/10/2026
+///   Wave machine moves the wall in place as a kinematic wall 18/10/2026
+///   Live metrics published to shared memory 18/10/2026
+///   Gauss-Seidel solver mode over coloured cells 18/10/2026
+///   Warm started lambdas and over-relaxation with divergence backoff 18/10/2026
+///   Coarse to fine multilevel projection 18/10/2026
+///   Frames published to shared memory for a separate viewer 18/10/2026
+///   Neighbor search selectable by name 18/10/2026
+///   Initial state restored from a captured workload 18/10/2026
+///   Tile lists and the task graph reuse their storage so a step doesn't allocate 18/10/2026
+///   init() fails on an empty scene 18/10/2026
+///   Neighbor search refitted while the particle order doesn't change 18/10/2026
+///   Frames written into the feed by the last pass of the step 18/10/2026
+///   A step that fails on the OpenCL backend runs again on the cpu backend 18/10/2026
 /// @todo Implement a GUI to run the variables in the system
 
 // ---------------------------------------------------------------------------------------
@@ -26,6 +59,13 @@
 class FluidSystem
 {
 public:
+  // ---------------------------------------------------------------------------------------
+  /// @brief SolverMode How the density constraints are iterated. Jacobi computes all the lambdas and updates from
+  ///                   the positions of the previous iteration, Gauss-Seidel projects the particles colour by colour
+  ///                   so later colours see the corrected positions and converge in fewer iterations.
+  // ---------------------------------------------------------------------------------------
+  enum SolverMode {JACOBI, GAUSS_SEIDEL};
+
   // ---------------------------------------------------------------------------------------
   /// @brief FluidSystem Default ctor
   // ---------------------------------------------------------------------------------------
@@ -38,14 +78,68 @@ public:
 
   // ---------------------------------------------------------------------------------------
   /// @brief init Initialises the system, creates particles and initialises the NNS class
+  /// @return     False if there are no particles to simulate, the system mustn't be run then
   // ---------------------------------------------------------------------------------------
-  void init();
+  bool init();
 
   // ---------------------------------------------------------------------------------------
   /// @brief execute Executes the simulation loop
   // ---------------------------------------------------------------------------------------
   void execute();
 
+  // ---------------------------------------------------------------------------------------
+  /// @brief getBoundingBox
+  /// @return Boundaries of the simulation, the wave machine moves the max x wall
+  // ---------------------------------------------------------------------------------------
+  const BoundingBox &getBoundingBox() const { return m_bb; }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief setDomain  Runs the system as a part of a distributed simulation, must be called before init()
+  /// @param[in] _domain Domain decomposition shared with the other ranks, nullptr for a single process
+  // ---------------------------------------------------------------------------------------
+  void setDomain(Domain *_domain) { m_domain = _domain; }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief setNumaMode      Configures the NUMA placement, must be called before init()
+  /// @param[in] _pinThreads  Pin the worker threads to cores so they stay next to the memory they first touched
+  /// @param[in] _hugePages   Back the particle and neighbor buffers with transparent huge pages
+  // ---------------------------------------------------------------------------------------
+  void setNumaMode(const bool &_pinThreads, const bool &_hugePages) { m_pinThreads = _pinThreads; m_hugePages = _hugePages; }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief setTaskScheduling  Runs the solver stages as a task graph over spatial tiles instead of whole-array loops,
+  ///                           not used in distributed runs
+  /// @param[in] _threads       Amount of worker threads, 0 for the hardware concurrency
+  /// @param[in] _tileSize      Edge length of a tile in grid cells, at least the neighbor search range
+  // ---------------------------------------------------------------------------------------
+  void setTaskScheduling(const unsigned int &_threads, const unsigned int &_tileSize = 4);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief setBackend   Selects where the simulation step runs, must be called before init()
+  /// @param[in] _name    "cpu" or "opencl", the OpenCL backend falls back to the cpu if it can't be used
+  // ---------------------------------------------------------------------------------------
+  void setBackend(const std::string &_name) { m_backendName = _name; }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief setNeighborSearch  Selects the structure the neighbors are searched with, must be called before init()
+  /// @param[in] _name          "grid", "hash", "octree" or "kdtree", see NNS::create()
+  // ---------------------------------------------------------------------------------------
+  void setNeighborSearch(const std::string &_name) { m_nnsName = _name; }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief getSeeder  Volumes and sampling of the initial particles, must be set up before init(). The default
+  ///                   dam break is seeded if no volumes are added.
+  /// @return           Seeder used by init()
+  // ---------------------------------------------------------------------------------------
+  Seeder &getSeeder() { return m_seeder; }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief setWorkload  Starts from a captured state instead of seeding, must be called before init(). The bounds,
+  ///                     particles and step count are taken from it, the wave machine isn't toggled.
+  /// @param[in] _workload Captured state, nullptr to seed, must stay alive until init() has run
+  // ---------------------------------------------------------------------------------------
+  void setWorkload(const Workload *_workload) { m_workload = _workload; }
+
   // ---------------------------------------------------------------------------------------
   /// @brief toggleSimulation Toggles on and off whether to run the simulation or not
   // ---------------------------------------------------------------------------------------
@@ -56,18 +150,218 @@ public:
   // ---------------------------------------------------------------------------------------
   void toggleWaves() { m_waves ^= true; }
 
+  // ---------------------------------------------------------------------------------------
+  /// @brief setDeterministic Makes the results bit-identical at any thread count and schedule. The per particle sums
+  ///                         are always accumulated serially over the neighbor list, this fixes the order of the lists.
+  /// @param[in] _deterministic Whether to run in the deterministic mode
+  // ---------------------------------------------------------------------------------------
+  void setDeterministic(const bool &_deterministic) { m_deterministic = _deterministic; m_nns->setSortedNeighbors(_deterministic); }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief isDeterministic
+  /// @return True if running in the deterministic mode
+  // ---------------------------------------------------------------------------------------
+  bool isDeterministic() const { return m_deterministic; }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief setKernelTable Interpolates the kernels from lookup tables instead of evaluating them
+  /// @param[in] _size      Amount of intervals in the tables, more is more accurate, 0 evaluates the kernels
+  // ---------------------------------------------------------------------------------------
+  void setKernelTable(const unsigned int &_size) { m_solver.setKernelTable(_size); }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief setSolverParameters  Sets the tunable constants of the solver, must be called before init() as the
+  ///                             OpenCL backend builds them into its kernels
+  /// @param[in] _parameters      Constants, see FluidSolver::setParameters()
+  // ---------------------------------------------------------------------------------------
+  void setSolverParameters(const SolverParameters &_parameters) { m_solver.setParameters(_parameters); }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief getSolverParameters
+  /// @return Constants of the solver
+  // ---------------------------------------------------------------------------------------
+  SolverParameters getSolverParameters() const { return m_solver.getParameters(); }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief setSolverIterations  Sets the amount of constraint iterations per step
+  /// @param[in] _iterations      Iteration count, at least 1
+  // ---------------------------------------------------------------------------------------
+  void setSolverIterations(const unsigned int &_iterations) { m_solverIterations = std::max(_iterations, 1u); }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief setSolverMode  Sets how the constraints are iterated. Gauss-Seidel needs a backend that supports it,
+  ///                       the OpenCL backend, the tiled steps and the distributed runs iterate Jacobi.
+  /// @param[in] _mode      Solver mode, Jacobi by default
+  // ---------------------------------------------------------------------------------------
+  void setSolverMode(const SolverMode &_mode) { m_solverMode = _mode; }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief setWarmStart   Starts each step with the position update of the lambdas the particles carry from the
+  ///                       previous step, so a coherent flow doesn't converge from zero again. Not used by the tiled
+  ///                       steps.
+  /// @param[in] _enabled   Whether to warm start, off by default
+  // ---------------------------------------------------------------------------------------
+  void setWarmStart(const bool &_enabled) { m_warmStart = _enabled; }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief setMultilevel    Projects coarse proxies of the particles before the solver iterations, see
+  ///                         MultilevelSolver. Only the cpu backend runs them and not in the tiled steps or the
+  ///                         distributed runs.
+  /// @param[in] _levels      Amount of coarse levels, 0 to disable
+  /// @param[in] _iterations  Iterations on each coarse level
+  // ---------------------------------------------------------------------------------------
+  void setMultilevel(const unsigned int &_levels, const unsigned int &_iterations = 2) { m_multilevel.configure(_levels, _iterations); }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief setRelaxation  Scales the position updates of the solver. Over 1 the density error left after a step is
+  ///                       watched, a jump in it halves the over-relaxation which then recovers over the next steps.
+  /// @param[in] _factor    Relaxation factor, 1 by default
+  // ---------------------------------------------------------------------------------------
+  void setRelaxation(const float &_factor);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief getRelaxation
+  /// @return Relaxation factor currently used, below the one set while backing off
+  // ---------------------------------------------------------------------------------------
+  float getRelaxation() const { return m_solver.getRelaxation(); }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief setVerbose   Prints the progress of init() and the cleanup, on by default
+  /// @param[in] _verbose Whether to print
+  // ---------------------------------------------------------------------------------------
+  void setVerbose(const bool &_verbose) { m_verbose = _verbose; }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief setMetricsFeed Publishes live counters of the run to a shared memory feed, see MetricsFeed. A step only
+  ///                       reads the clock, the statistics over the particles are gathered when a sample is published.
+  /// @param[in] _name      Name of the feed
+  /// @param[in] _interval  Publish every this many steps
+  /// @return               True if the feed could be created
+  // ---------------------------------------------------------------------------------------
+  bool setMetricsFeed(const std::string &_name, const unsigned int &_interval = 10);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief setFrameFeed   Publishes the particles to a shared memory feed a viewer process can draw, see FrameFeed.
+  ///                       The feed grows with the particle count, the viewers attach again when it does.
+  /// @param[in] _name      Name of the feed
+  /// @param[in] _interval  Publish every this many steps
+  /// @return               True if the feed could be created
+  // ---------------------------------------------------------------------------------------
+  bool setFrameFeed(const std::string &_name, const unsigned int &_interval = 1);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief setReordering  Sorts the particles along a space filling curve over the grid cells at the start of a step
+  ///                       so that neighbors are close in memory, the particles keep their ids
+  /// @param[in] _curve     Curve to order the cells along
+  /// @param[in] _interval  Reorder every this many steps, 0 to only use the threshold
+  /// @param[in] _threshold Also reorder once this fraction of the particles is out of order, 0 to only use the interval
+  // ---------------------------------------------------------------------------------------
+  void setReordering(const ParticleOrder::Curve &_curve, const unsigned int &_interval, const float &_threshold) { m_order.configure(_curve, _interval, _threshold); }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief setSurfaceExtraction Extracts the surface of the fluid after every step
+  /// @param[in] _enabled         Whether to extract the surface
+  /// @param[in] _background      Extract on a background thread while the next step runs, the surface
+  ///                             then lags behind the particles by a step or more
+  // ---------------------------------------------------------------------------------------
+  void setSurfaceExtraction(const bool &_enabled, const bool &_background) { m_extractSurface = _enabled; m_backgroundSurface = _background; }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief isExtractingSurface
+  /// @return True if the surface is extracted after the steps
+  // ---------------------------------------------------------------------------------------
+  bool isExtractingSurface() const { return m_extractSurface; }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief getSurface
+  /// @return Latest extracted surface
+  // ---------------------------------------------------------------------------------------
+  const SurfaceMesh &getSurface() const { return m_surface; }
+
   // ---------------------------------------------------------------------------------------
   /// @brief getParticles
-  /// @return Vector containing pointers to each particle
+  /// @return Vector containing pointers to each particle, valid until the next init()
   // ---------------------------------------------------------------------------------------
-  std::vector<Particle *> getParticles() { return m_particles; }
+  const std::vector<Particle *> &getParticles() const { return m_particles; }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief getOwnedCount
+  /// @return Amount of particles simulated by this process, the rest of the particles are ghosts of other ranks
+  // ---------------------------------------------------------------------------------------
+  unsigned int getOwnedCount() const { return m_ownedCount; }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief findParticle Finds an owned particle by its id, the index of a particle changes when the particles are
+  ///                     reordered or migrate to another rank but the id doesn't
+  /// @param[in] _id      Id given by the seeder
+  /// @return             The particle or nullptr if this process doesn't own it
+  // ---------------------------------------------------------------------------------------
+  Particle *findParticle(const unsigned int &_id);
 
 private:
   // ---------------------------------------------------------------------------------------
-  /// @brief handleEnvCollisions  Handles the collision of a particle with the bounding box
-  /// @param[io] io_p             Particle that's checked for collisions
+  /// @brief refreshHalo Updates the ghost particles from the other ranks in a distributed run, no-op otherwise
+  // ---------------------------------------------------------------------------------------
+  void refreshHalo();
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief extractSurface Extracts the surface of the owned particles or hands them to the background thread
   // ---------------------------------------------------------------------------------------
-  void handleEnvCollisions(Particle *io_p);
+  void extractSurface();
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief updateParticleViews Points m_particles to the particles in m_storage, called whenever the storage is resized
+  // ---------------------------------------------------------------------------------------
+  void updateParticleViews();
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief publishMetrics Counts a finished step and publishes a sample to the feed every m_metricsInterval steps
+  /// @param[in] _start     Time the step started
+  // ---------------------------------------------------------------------------------------
+  void publishMetrics(const std::chrono::steady_clock::time_point &_start);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief beginFrame Points m_frame to the back buffer of the frame feed every m_framesInterval steps, the last
+  ///                   pass of the step writes the owned particles into it
+  // ---------------------------------------------------------------------------------------
+  void beginFrame();
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief publishFrame Publishes the frame started by beginFrame()
+  // ---------------------------------------------------------------------------------------
+  void publishFrame();
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief adaptRelaxation Backs the relaxation factor off when the density error of the step jumped and moves it
+  ///                        back towards the one set otherwise
+  // ---------------------------------------------------------------------------------------
+  void adaptRelaxation();
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief executeBackend Runs the stages of the simulation step on m_backend
+  /// @param[in] _timeStep  Time step
+  // ---------------------------------------------------------------------------------------
+  void executeBackend(const float &_timeStep);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief executeTiles Runs the simulation step as a task graph, each (stage, tile) pair is a task
+  ///                     depending on the neighboring tiles of the previous stage
+  /// @param[in] _timeStep Time step
+  // ---------------------------------------------------------------------------------------
+  void executeTiles(const float &_timeStep);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief binTiles Sorts the particles to tiles based on their grid cells and finds the neighboring tiles
+  // ---------------------------------------------------------------------------------------
+  void binTiles();
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief runTileStage   Runs a single stage of the step for the particles of a tile
+  /// @param[in] _stage     Stage index, see executeTiles()
+  /// @param[in] _tile      Index of the tile in m_activeTiles
+  /// @param[in] _timeStep  Time step
+  // ---------------------------------------------------------------------------------------
+  void runTileStage(const unsigned int &_stage, const unsigned int &_tile, const float &_timeStep);
 
   // ---------------------------------------------------------------------------------------
   /// @brief m_solver Solver class
@@ -75,9 +369,9 @@ private:
   FluidSolver m_solver;
 
   // ---------------------------------------------------------------------------------------
-  /// @brief m_sHash Grid & nearest neighbor search class
+  /// @brief m_nns Grid & nearest neighbor search class, the uniform grid until init() creates the selected one
   // ---------------------------------------------------------------------------------------
-  NNS m_nns;
+  std::unique_ptr<NNS> m_nns;
 
   // ---------------------------------------------------------------------------------------
   /// @brief m_bb Bounding box of the simulation
@@ -85,25 +379,266 @@ private:
   BoundingBox m_bb;
 
   // ---------------------------------------------------------------------------------------
-  /// @brief m_particles Vector holding all the particles of the system
+  /// @brief m_storage Contiguous storage of all the particles of the system
+  // ---------------------------------------------------------------------------------------
+  ParticleBuffer m_storage;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_particles Vector holding pointers to the particles in m_storage
   // ---------------------------------------------------------------------------------------
   std::vector<Particle *> m_particles;
 
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_ownedCount Amount of particles owned by this process, ghost particles are stored after them
+  // ---------------------------------------------------------------------------------------
+  unsigned int m_ownedCount;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_domain Domain decomposition for distributed runs, nullptr when running in a single process
+  // ---------------------------------------------------------------------------------------
+  Domain *m_domain;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_step Amount of executed simulation steps
+  // ---------------------------------------------------------------------------------------
+  unsigned int m_step;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_balanceInterval How often (in steps) to check the load balance of a distributed run
+  // ---------------------------------------------------------------------------------------
+  unsigned int m_balanceInterval;
+
   // ---------------------------------------------------------------------------------------
   /// @brief m_solverIterations Solver iteration count
   // ---------------------------------------------------------------------------------------
   unsigned int m_solverIterations;
 
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_solverMode How the constraints are iterated
+  // ---------------------------------------------------------------------------------------
+  SolverMode m_solverMode;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_warmStart Whether the steps start from the lambdas of the previous step
+  // ---------------------------------------------------------------------------------------
+  bool m_warmStart;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_multilevel Coarse levels projected before the solver iterations
+  // ---------------------------------------------------------------------------------------
+  MultilevelSolver m_multilevel;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_relaxation Relaxation factor set by the user, the solver runs with a smaller one while backing off
+  // ---------------------------------------------------------------------------------------
+  float m_relaxation;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_lastDensityError Mean density error after the previous step, used to detect divergence
+  // ---------------------------------------------------------------------------------------
+  float m_lastDensityError;
+
   // ---------------------------------------------------------------------------------------
   /// @brief m_simulate Boolean value to determine whether to run the simulation or not
   // ---------------------------------------------------------------------------------------
   bool m_simulate;
 
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_seeder Creates the initial particles
+  // ---------------------------------------------------------------------------------------
+  Seeder m_seeder;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_workload Captured state init() starts from, nullptr to seed the particles
+  // ---------------------------------------------------------------------------------------
+  const Workload *m_workload;
+
   // ---------------------------------------------------------------------------------------
   /// @brief m_waves Boolean value to determine whether to move the bounding box wall to create waves
   // ---------------------------------------------------------------------------------------
   bool m_waves;
 
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_pinThreads Boolean value to determine whether to pin the worker threads to cores
+  // ---------------------------------------------------------------------------------------
+  bool m_pinThreads;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_hugePages Boolean value to determine whether to use transparent huge pages for the large buffers
+  // ---------------------------------------------------------------------------------------
+  bool m_hugePages;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_deterministic Whether the neighbor order is fixed
+  // ---------------------------------------------------------------------------------------
+  bool m_deterministic;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_wavePhase Phase of the wave machine, per system so that runs are repeatable
+  // ---------------------------------------------------------------------------------------
+  float m_wavePhase;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_backendName Requested compute backend
+  // ---------------------------------------------------------------------------------------
+  std::string m_backendName;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_nnsName Requested neighbor search
+  // ---------------------------------------------------------------------------------------
+  std::string m_nnsName;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_backend Backend running the whole-array step
+  // ---------------------------------------------------------------------------------------
+  std::unique_ptr<ComputeBackend> m_backend;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_mesher Surface extraction on the cells of the neighbor search
+  // ---------------------------------------------------------------------------------------
+  SurfaceMesher m_mesher;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_surface Latest extracted surface
+  // ---------------------------------------------------------------------------------------
+  SurfaceMesh m_surface;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_extractSurface Whether to extract the surface after the steps
+  // ---------------------------------------------------------------------------------------
+  bool m_extractSurface;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_backgroundSurface Whether the surface is extracted on a background thread
+  // ---------------------------------------------------------------------------------------
+  bool m_backgroundSurface;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_scheduler Task scheduler for the tiled step, nullptr when running the whole-array loops
+  // ---------------------------------------------------------------------------------------
+  std::unique_ptr<TaskScheduler> m_scheduler;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_graph Task graph of the tiled step, rebuilt every step
+  // ---------------------------------------------------------------------------------------
+  TaskGraph m_graph;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_graphTimeStep Time step the tasks of the graph run with, kept out of the tasks so they stay small
+  // ---------------------------------------------------------------------------------------
+  float m_graphTimeStep;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_tileSize Edge length of a tile in grid cells
+  // ---------------------------------------------------------------------------------------
+  unsigned int m_tileSize;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_tileCount Amount of tiles along each axis
+  // ---------------------------------------------------------------------------------------
+  int m_tileCount[3];
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_tileStart Start of the particles of each tile in m_tileParticles followed by their count
+  // ---------------------------------------------------------------------------------------
+  std::vector<unsigned int> m_tileStart;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_tileParticles Particle indices sorted by tile
+  // ---------------------------------------------------------------------------------------
+  std::vector<unsigned int> m_tileParticles;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_particleTiles Tile of each particle while sorting them
+  // ---------------------------------------------------------------------------------------
+  std::vector<unsigned int> m_particleTiles;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_activeTiles Ids of the tiles containing particles
+  // ---------------------------------------------------------------------------------------
+  std::vector<unsigned int> m_activeTiles;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_tileIndex Index of each tile in m_activeTiles, -1 for empty tiles
+  // ---------------------------------------------------------------------------------------
+  std::vector<int> m_tileIndex;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_tileNeighbors Active neighboring tiles of each active tile, including the tile itself
+  // ---------------------------------------------------------------------------------------
+  std::vector<std::vector<unsigned int>> m_tileNeighbors;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_order Space filling curve order of the particles
+  // ---------------------------------------------------------------------------------------
+  ParticleOrder m_order;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_idIndex Index of each particle id in m_storage, -1 for the ids not owned by this process
+  // ---------------------------------------------------------------------------------------
+  std::vector<int> m_idIndex;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_idIndexValid Whether m_idIndex matches the storage, cleared whenever the particles move in it
+  // ---------------------------------------------------------------------------------------
+  bool m_idIndexValid;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_searchOrdered Whether the particles are in the order the neighbor search was last built or refitted in,
+  ///                        cleared with m_idIndexValid
+  // ---------------------------------------------------------------------------------------
+  bool m_searchOrdered;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_verbose Whether to print the progress
+  // ---------------------------------------------------------------------------------------
+  bool m_verbose;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_metrics Live metrics feed, nullptr when not publishing
+  // ---------------------------------------------------------------------------------------
+  std::unique_ptr<MetricsFeed> m_metrics;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_metricsInterval Steps between the published samples
+  // ---------------------------------------------------------------------------------------
+  unsigned int m_metricsInterval;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_metricsSteps Steps since the last published sample
+  // ---------------------------------------------------------------------------------------
+  unsigned int m_metricsSteps;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_metricsSample Sample being gathered, the max step time accumulates between the samples
+  // ---------------------------------------------------------------------------------------
+  MetricsSample m_metricsSample;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_metricsStart/m_metricsLastPublish Times the feed was opened and the last sample published
+  // ---------------------------------------------------------------------------------------
+  std::chrono::steady_clock::time_point m_metricsStart, m_metricsLastPublish;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_frames Frame feed of a viewer, nullptr when not publishing
+  // ---------------------------------------------------------------------------------------
+  std::unique_ptr<FrameFeed> m_frames;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_framesName Name of the frame feed, kept to open it again with more room
+  // ---------------------------------------------------------------------------------------
+  std::string m_framesName;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_framesInterval Steps between the published frames
+  // ---------------------------------------------------------------------------------------
+  unsigned int m_framesInterval;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_frame Back buffer of the frame feed the step writes to, nullptr when no frame is published this step
+  // ---------------------------------------------------------------------------------------
+  FrameVertex *m_frame;
+
 protected:
 
 }; // end of FluidSystem
@@ -0,0 +1,250 @@
+#ifndef FRAMEFEED_H
+#define FRAMEFEED_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "Particle.h"
+
+/// @file FrameFeed.h
+/// @brief Particles of each frame published to a double buffered POSIX shared memory segment, so that a viewer in
+///        another process can draw a run without the run waiting on it or going down with it
+/// @author Teemu Lindborg
+/// @version 1.0
+/// @date 18/10/2026 Initial version
+/// Revision History :
+///   Double buffered frames with a generation counter, writer and reader 18/10/2026
+///   Density and speed instead of a colour, the viewer picks the channel 18/10/2026
+///   The solver writes the vertices into the back buffer as it finishes the particles 18/10/2026
+/// @todo Publish the extracted surface alongside the particles
+
+// ---------------------------------------------------------------------------------------
+/// @struct FrameVertex
+/// @brief A particle as the renderer draws it, also the sprite vertex of NGLScene so that a frame can be uploaded
+///        straight from the segment. The channels the sprites can be coloured by follow the radius, the density is
+///        relative to the rest density.
+// ---------------------------------------------------------------------------------------
+typedef struct FrameVertex
+{
+  float x, y, z;
+  float radius;
+  float density;
+  float speed;
+} FrameVertex;
+
+// ---------------------------------------------------------------------------------------
+/// @brief writeFrameVertex           Writes the sprite vertex of a particle, called by the last pass of the step over
+///                                   the particles so the frame is produced in the segment rather than copied to it
+/// @param[in] _particle              Particle with its final position and velocity of the step
+/// @param[in] _inverseRestDensity    Inverse of the rest density the density is relative to
+/// @param[out] o_vertex              Vertex in the back buffer of the frame
+// ---------------------------------------------------------------------------------------
+inline void writeFrameVertex(const Particle &_particle, const float &_inverseRestDensity, FrameVertex &o_vertex)
+{
+  o_vertex.x = _particle.m_pos.m_x;
+  o_vertex.y = _particle.m_pos.m_y;
+  o_vertex.z = _particle.m_pos.m_z;
+  o_vertex.radius = _particle.m_radius;
+  o_vertex.density = _particle.m_density * _inverseRestDensity;
+  o_vertex.speed = _particle.m_vel.length();
+}
+
+// ---------------------------------------------------------------------------------------
+/// @struct FrameHeader
+/// @brief Step, particle count and bounding box of the frame in a buffer
+// ---------------------------------------------------------------------------------------
+typedef struct FrameHeader
+{
+  uint64_t step;
+  uint32_t count;
+  float boxMin[3];
+  float boxMax[3];
+} FrameHeader;
+
+// ---------------------------------------------------------------------------------------
+/// @struct FrameSegment
+/// @brief Layout of the shared memory segment, the vertices of the two buffers follow the header. The writer sets
+///        writing to the generation it starts on, fills the buffer the readers aren't pointed to and then bumps
+///        the generation, the latest frame is always in buffer generation & 1. A buffer is only written again
+///        for the frame after the next one, so a reader's copy is whole as long as writing didn't get that far
+///        while it read, which leaves a reader a whole step.
+// ---------------------------------------------------------------------------------------
+typedef struct FrameSegment
+{
+  uint32_t magic;
+  uint32_t version;
+  int32_t pid;
+  uint32_t closed;
+  uint32_t capacity;
+  std::atomic<uint64_t> generation;
+  std::atomic<uint64_t> writing;
+  FrameHeader headers[2];
+} FrameSegment;
+
+// ---------------------------------------------------------------------------------------
+/// @class FrameFeed
+/// @brief Writer side of a frame feed. The step writes the particles straight into the back buffer of the segment
+///        as its last pass produces them, there is no copy of the particle storage, and publishing is a single
+///        store, a slow or crashed reader never holds the writer up.
+// ---------------------------------------------------------------------------------------
+class FrameFeed
+{
+public:
+  // ---------------------------------------------------------------------------------------
+  /// @brief FrameFeed Default ctor, the feed is closed
+  // ---------------------------------------------------------------------------------------
+  FrameFeed();
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief ~FrameFeed Default dtor, closes the feed
+  // ---------------------------------------------------------------------------------------
+  ~FrameFeed();
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief open         Creates the segment, replacing a stale one of the same name
+  /// @param[in] _name    Name of the feed, the segment is /pbf-frames.<name>
+  /// @param[in] _capacity Particles a buffer holds
+  /// @return             True if the segment could be created
+  // ---------------------------------------------------------------------------------------
+  bool open(const std::string &_name, const unsigned int &_capacity);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief close Marks the feed closed for the readers and removes the segment
+  // ---------------------------------------------------------------------------------------
+  void close();
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief isOpen
+  /// @return True if the segment exists
+  // ---------------------------------------------------------------------------------------
+  bool isOpen() const { return m_segment != nullptr; }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief getCapacity
+  /// @return Particles a buffer holds, 0 when closed
+  // ---------------------------------------------------------------------------------------
+  unsigned int getCapacity() const { return m_segment ? m_segment->capacity : 0; }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief beginFrame Starts the next frame, the readers don't look at its buffer until publish()
+  /// @return           getCapacity() vertices of the buffer to write, nullptr when closed
+  // ---------------------------------------------------------------------------------------
+  FrameVertex *beginFrame();
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief publish    Makes the frame started by beginFrame() the latest one
+  /// @param[in] _header Step, count and bounding box of the frame
+  // ---------------------------------------------------------------------------------------
+  void publish(const FrameHeader &_header);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief segmentName  Name of the shared memory segment of a feed
+  /// @param[in] _name    Name of the feed
+  /// @return             Segment name
+  // ---------------------------------------------------------------------------------------
+  static std::string segmentName(const std::string &_name) { return "/pbf-frames." + _name; }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief segmentSize   Bytes of a segment
+  /// @param[in] _capacity Particles a buffer holds
+  /// @return              Size of the header and both buffers
+  // ---------------------------------------------------------------------------------------
+  static std::size_t segmentSize(const unsigned int &_capacity) { return sizeof(FrameSegment) + 2 * (std::size_t)_capacity * sizeof(FrameVertex); }
+
+private:
+  // ---------------------------------------------------------------------------------------
+  /// @brief FrameFeed Copying would close the segment twice
+  // ---------------------------------------------------------------------------------------
+  FrameFeed(const FrameFeed &) = delete;
+  FrameFeed &operator =(const FrameFeed &) = delete;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_name Segment name
+  // ---------------------------------------------------------------------------------------
+  std::string m_name;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_segment Mapped segment, nullptr when closed
+  // ---------------------------------------------------------------------------------------
+  FrameSegment *m_segment;
+}; // end of FrameFeed
+
+// ---------------------------------------------------------------------------------------
+/// @class FrameReader
+/// @brief Reader side of a frame feed, maps the segment read only and hands out the latest buffer in place
+// ---------------------------------------------------------------------------------------
+class FrameReader
+{
+public:
+  // ---------------------------------------------------------------------------------------
+  /// @brief FrameReader Default ctor, not attached
+  // ---------------------------------------------------------------------------------------
+  FrameReader();
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief ~FrameReader Default dtor, detaches
+  // ---------------------------------------------------------------------------------------
+  ~FrameReader();
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief attach     Maps the segment of a feed
+  /// @param[in] _name  Name of the feed
+  /// @return           True if the feed exists and has the expected layout
+  // ---------------------------------------------------------------------------------------
+  bool attach(const std::string &_name);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief detach Unmaps the segment
+  // ---------------------------------------------------------------------------------------
+  void detach();
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief isAttached
+  /// @return True if a segment is mapped
+  // ---------------------------------------------------------------------------------------
+  bool isAttached() const { return m_segment != nullptr; }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief acquire        Points to the latest frame in the segment, use it and check it with release()
+  /// @param[out] o_header  Step, count and bounding box of the frame
+  /// @return               Vertices of the frame, nullptr if nothing was published since the last release()
+  // ---------------------------------------------------------------------------------------
+  const FrameVertex *acquire(FrameHeader &o_header);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief release  Finishes with the acquired frame
+  /// @return         True if the writer didn't start overwriting the frame while it was used
+  // ---------------------------------------------------------------------------------------
+  bool release();
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief isAlive
+  /// @return True while the writer hasn't closed the feed and its process is running
+  // ---------------------------------------------------------------------------------------
+  bool isAlive() const;
+
+private:
+  // ---------------------------------------------------------------------------------------
+  /// @brief FrameReader Copying would unmap the segment twice
+  // ---------------------------------------------------------------------------------------
+  FrameReader(const FrameReader &) = delete;
+  FrameReader &operator =(const FrameReader &) = delete;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_segment Mapped segment, nullptr when detached
+  // ---------------------------------------------------------------------------------------
+  const FrameSegment *m_segment;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_size Mapped bytes
+  // ---------------------------------------------------------------------------------------
+  std::size_t m_size;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_generation Generation of the acquired frame, of the last released one otherwise
+  // ---------------------------------------------------------------------------------------
+  uint64_t m_generation;
+}; // end of FrameReader
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef GOLDENSTATE_H
+#define GOLDENSTATE_H
+
+#include <ostream>
+#include <string>
+#include <vector>
+#include "Particle.h"
+
+/// @file GoldenState.h
+/// @brief Stores the full particle state of a reference scene after a number of steps and compares later runs
+///        against it, used to check that performance changes don't change the physics
+/// @author Teemu Lindborg
+/// @version 1.0
+/// @date 18/10/2026 Initial version
+/// Revision History :
+///   Golden state files and comparison 18/10/2026
+///   Particles stored in the order of their ids 18/10/2026
+/// @todo
+
+// ---------------------------------------------------------------------------------------
+/// @struct GoldenTolerance
+/// @brief Allowed differences to the golden state, all zeros requires bit-identical results. The scenes are
+///        chaotic so a different summation order moves the individual particles apart within tens of steps,
+///        the bulk tolerance accepts that as long as the centre of mass, kinetic energy and mean density still match.
+// ---------------------------------------------------------------------------------------
+typedef struct GoldenTolerance
+{
+  float position;
+  float velocity;
+  float density;
+  float bulk;
+} GoldenTolerance;
+
+// ---------------------------------------------------------------------------------------
+/// @class GoldenState
+/// @brief Reads and writes the golden state files. The file starts with a header (magic, version,
+///        particle count and step count) followed by the position, velocity, external forces, density
+///        and lambda of each particle as floats. The particles are stored in the order of their ids so
+///        the files don't depend on where the particles are in the storage.
+// ---------------------------------------------------------------------------------------
+class GoldenState
+{
+public:
+  // ---------------------------------------------------------------------------------------
+  /// @brief write          Writes the state of the particles to a file
+  /// @param[in] _fileName  Golden file
+  /// @param[in] _particles Particles to store
+  /// @param[in] _steps     Amount of steps simulated, stored to catch mismatching runs
+  /// @return               True if the file was written
+  // ---------------------------------------------------------------------------------------
+  static bool write(const std::string &_fileName, const std::vector<Particle *> &_particles, const unsigned int &_steps);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief compare        Compares the state of the particles against a file
+  /// @param[in] _fileName  Golden file
+  /// @param[in] _particles Particles to compare
+  /// @param[in] _steps     Amount of steps simulated
+  /// @param[in] _tolerance Allowed differences, the density difference is relative to the golden density. With a
+  ///                       non-zero bulk tolerance the comparison passes if either all the particles or the bulk
+  ///                       quantities are within the tolerances.
+  /// @param[out] o_report  Stream the largest differences and the result are written to
+  /// @return               True if all the particles are within the tolerances
+  // ---------------------------------------------------------------------------------------
+  static bool compare(const std::string &_fileName, const std::vector<Particle *> &_particles, const unsigned int &_steps,
+                      const GoldenTolerance &_tolerance, std::ostream &o_report);
+
+private:
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_version Version of the file format
+  // ---------------------------------------------------------------------------------------
+  static const unsigned int m_version = 1;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_recordSize Amount of floats stored per particle
+  // ---------------------------------------------------------------------------------------
+  static const unsigned int m_recordSize = 11;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief sortById       Orders the particles by their ids
+  /// @param[in] _particles Particles
+  /// @return               Particles sorted by id
+  // ---------------------------------------------------------------------------------------
+  static std::vector<const Particle *> sortById(const std::vector<Particle *> &_particles);
+}; // end of GoldenState
+
+#endif
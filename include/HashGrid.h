@@ -0,0 +1,128 @@
+#ifndef HASHGRID_H
+#define HASHGRID_H
+
+#include "NNS.h"
+
+/// @file HashGrid.h
+/// @brief Nearest neighbor searching using spatial hashing, the memory follows the particle count instead of the
+///        volume of the domain
+/// @author Teemu Lindborg
+/// @version 1.0
+/// @date 18/10/2026 Initial version
+/// Revision History :
+///   Hash table sorted by a counting sort, cells of the search radius 18/10/2026
+/// @todo Keep a list of the occupied cells so a query doesn't scan a bucket shared by other cells
+
+// ---------------------------------------------------------------------------------------
+/// @class HashGrid
+/// @brief Compact hash grid. The unbounded cells are as wide as the search radius and hashed to a table of at least
+///        twice as many buckets as there are particles, the particles are counting sorted by bucket so that a bucket
+///        is a range of one array. The positions and cells are copied in bucket order, a query looks at the 27 cells
+///        around the point and skips the particles of other cells sharing a bucket. Particles outside of the bounding
+///        box are found too.
+// ---------------------------------------------------------------------------------------
+class HashGrid : public NNS
+{
+public:
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief HashGrid Default ctor
+  //----------------------------------------------------------------------------------------------------------------------
+  HashGrid() : m_bucketMask(0) {}
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief getName
+  /// @return "hash"
+  //----------------------------------------------------------------------------------------------------------------------
+  const char *getName() const { return "hash"; }
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief buildGrid        Hashes the particles and sorts them by bucket
+  /// @param[in] _particles   Vector containing the particles
+  //----------------------------------------------------------------------------------------------------------------------
+  void buildGrid(const std::vector<Particle *> &_particles);
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief findNeighbors    Builds the neighbor table of a single particle, the grid must have been built
+  /// @param[in] _particles   Vector containing the particles
+  /// @param[in] _pid         Index of the particle
+  //----------------------------------------------------------------------------------------------------------------------
+  void findNeighbors(const std::vector<Particle *> &_particles, const unsigned int &_pid);
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief rangeQuery       Finds the particles within a radius of a point from the buckets of the cells it overlaps
+  /// @param[in] _particles   Vector containing the particles, the copied positions are used instead
+  /// @param[in] _p           Centre of the query
+  /// @param[in] _radius      Radius of the query
+  /// @param[out] o_indices   Indices of the particles closer than the radius
+  //----------------------------------------------------------------------------------------------------------------------
+  void rangeQuery(const std::vector<Particle *> &_particles, const Vec3 &_p, const float &_radius, std::vector<unsigned int> &o_indices) const;
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief cleanTable Nothing to clean, the buckets are counted again by buildGrid()
+  //----------------------------------------------------------------------------------------------------------------------
+  void cleanTable() {}
+
+protected:
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief initStructure Sizes the hash table for the particle count
+  //----------------------------------------------------------------------------------------------------------------------
+  void initStructure();
+
+private:
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief forEachInRange Calls a function for every particle closer than a radius to a point
+  /// @param[in] _p         Centre of the query
+  /// @param[in] _radius    Radius of the query
+  /// @param[in] _f         Function taking the particle index
+  //----------------------------------------------------------------------------------------------------------------------
+  template <typename F>
+  void forEachInRange(const Vec3 &_p, const float &_radius, F _f) const;
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief getHashCell  Unbounded cell of a position
+  /// @param[in] _p       Position
+  /// @return             Cell coordinates
+  //----------------------------------------------------------------------------------------------------------------------
+  Vec3i getHashCell(const Vec3 &_p) const;
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief getBucket  Bucket of a cell
+  /// @param[in] _x     x-coordinate of the cell
+  /// @param[in] _y     y-coordinate of the cell
+  /// @param[in] _z     z-coordinate of the cell
+  /// @return           Bucket index
+  //----------------------------------------------------------------------------------------------------------------------
+  unsigned int getBucket(const int &_x, const int &_y, const int &_z) const;
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief m_bucketMask Amount of buckets minus one, the amount is a power of two
+  //----------------------------------------------------------------------------------------------------------------------
+  unsigned int m_bucketMask;
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief m_bucketStart Start of each bucket in the sorted arrays followed by the particle count
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<unsigned int> m_bucketStart;
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief m_particleBuckets Bucket of each particle
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<unsigned int> m_particleBuckets;
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief m_sortedParticles Particle indices in bucket order
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<unsigned int> m_sortedParticles;
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief m_sortedPositions Positions in bucket order
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<Vec3> m_sortedPositions;
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief m_sortedCells Cells in bucket order, tells apart the cells sharing a bucket
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<Vec3i> m_sortedCells;
+}; // end of HashGrid
+
+#endif
@@ -0,0 +1,140 @@
+#ifndef KDTREE_H
+#define KDTREE_H
+
+#include <cstdint>
+#include "NNS.h"
+
+/// @file KdTree.h
+/// @brief Nearest neighbor searching using a balanced k-d tree over the particles
+/// @author Teemu Lindborg
+/// @version 1.0
+/// @date 18/10/2026 Initial version
+/// Revision History :
+///   Implicit median split tree built with tasks 18/10/2026
+///   Split planes refitted to the moved particles between the rebuilds 18/10/2026
+
+// ---------------------------------------------------------------------------------------
+/// @class KdTree
+/// @brief The particles are split at the median of the longest side of their bounds until a few are left, so the
+///        tree is balanced and implicit: node k covers half of the range of its parent and has the children 2k + 1
+///        and 2k + 2, only the split of each node is stored. The subtrees are built as OpenMP tasks and the positions
+///        copied in leaf order, a query descends into the sides of the splits the query sphere reaches. Refitting
+///        keeps the particles of each node and gives each side its own plane, the largest coordinate of the lower half
+///        and the smallest of the upper half along the split axis, so the halves may overlap until the next build.
+// ---------------------------------------------------------------------------------------
+class KdTree : public NNS
+{
+public:
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief KdTree Default ctor
+  //----------------------------------------------------------------------------------------------------------------------
+  KdTree() : m_refits(0) {}
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief getName
+  /// @return "kdtree"
+  //----------------------------------------------------------------------------------------------------------------------
+  const char *getName() const { return "kdtree"; }
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief buildGrid        Builds the tree over the particles
+  /// @param[in] _particles   Vector containing the particles
+  //----------------------------------------------------------------------------------------------------------------------
+  void buildGrid(const std::vector<Particle *> &_particles);
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief update           Keeps the nodes and the order of the particles and refits the planes of the halves to the
+  ///                         moved particles, the halves overlap more the further the particles move so the tree is
+  ///                         built again every few steps
+  /// @param[in] _particles   Vector containing the particles
+  //----------------------------------------------------------------------------------------------------------------------
+  void update(const std::vector<Particle *> &_particles);
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief findNeighbors    Builds the neighbor table of a single particle, the tree must have been built
+  /// @param[in] _particles   Vector containing the particles
+  /// @param[in] _pid         Index of the particle
+  //----------------------------------------------------------------------------------------------------------------------
+  void findNeighbors(const std::vector<Particle *> &_particles, const unsigned int &_pid);
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief rangeQuery       Finds the particles within a radius of a point from the leaves it reaches
+  /// @param[in] _particles   Vector containing the particles, the copied positions are used instead
+  /// @param[in] _p           Centre of the query
+  /// @param[in] _radius      Radius of the query
+  /// @param[out] o_indices   Indices of the particles closer than the radius
+  //----------------------------------------------------------------------------------------------------------------------
+  void rangeQuery(const std::vector<Particle *> &_particles, const Vec3 &_p, const float &_radius, std::vector<unsigned int> &o_indices) const;
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief cleanTable Nothing to clean, the tree is rebuilt by buildGrid()
+  //----------------------------------------------------------------------------------------------------------------------
+  void cleanTable() {}
+
+protected:
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief initStructure Nothing to allocate up front, the arrays follow the particle count
+  //----------------------------------------------------------------------------------------------------------------------
+  void initStructure() {}
+
+private:
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief buildNode        Splits the particles of a node between its children and builds them
+  /// @param[in] _particles   Vector containing the particles
+  /// @param[in] _node        Index of the node
+  /// @param[in] _begin       First particle of the node in m_sortedParticles
+  /// @param[in] _end         End of the particles of the node
+  //----------------------------------------------------------------------------------------------------------------------
+  void buildNode(const std::vector<Particle *> &_particles, const unsigned int &_node, const unsigned int &_begin, const unsigned int &_end);
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief refitNode        Refits the planes of a node and its children to the copied positions
+  /// @param[in] _node        Index of the node
+  /// @param[in] _begin       First particle of the node in m_sortedParticles
+  /// @param[in] _end         End of the particles of the node
+  /// @param[out] o_low       Smallest coordinates of the particles of the node
+  /// @param[out] o_high      Largest coordinates of the particles of the node
+  //----------------------------------------------------------------------------------------------------------------------
+  void refitNode(const unsigned int &_node, const unsigned int &_begin, const unsigned int &_end, Vec3 &o_low, Vec3 &o_high);
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief forEachInRange Calls a function for every particle closer than a radius to a point
+  /// @param[in] _p         Centre of the query
+  /// @param[in] _radius    Radius of the query
+  /// @param[in] _f         Function taking the particle index
+  //----------------------------------------------------------------------------------------------------------------------
+  template <typename F>
+  void forEachInRange(const Vec3 &_p, const float &_radius, F _f) const;
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief m_sortedParticles Particle indices in leaf order
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<unsigned int> m_sortedParticles;
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief m_sortedPositions Positions in leaf order
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<Vec3> m_sortedPositions;
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief m_lowerMax Largest coordinate of the lower half of each inner node along its axis, the split once built
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<float> m_lowerMax;
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief m_upperMin Smallest coordinate of the upper half of each inner node along its axis, the split once built
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<float> m_upperMin;
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief m_axes Split axis of each inner node
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<uint8_t> m_axes;
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief m_refits Refits since the tree was last built
+  //----------------------------------------------------------------------------------------------------------------------
+  unsigned int m_refits;
+}; // end of KdTree
+
+#endif
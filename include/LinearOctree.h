@@ -0,0 +1,136 @@
+#ifndef LINEAROCTREE_H
+#define LINEAROCTREE_H
+
+#include <cstdint>
+#include "NNS.h"
+
+/// @file LinearOctree.h
+/// @brief Nearest neighbor searching using an octree over the particles sorted along a Morton curve
+/// @author Teemu Lindborg
+/// @version 1.0
+/// @date 18/10/2026 Initial version
+/// Revision History :
+///   Morton sorted particles, octants as ranges of the sorted array 18/10/2026
+///   Octant bounds refitted to the moved particles between the rebuilds 18/10/2026
+/// @todo Radix sort the codes instead of a comparison sort
+
+// ---------------------------------------------------------------------------------------
+/// @struct OctreeNode
+/// @brief Octant of a linear octree, its particles are a range of the Morton sorted arrays. The bounds are the cube
+///        of the octant when the tree is built and the box around its particles once it has been refitted.
+// ---------------------------------------------------------------------------------------
+typedef struct OctreeNode
+{
+  Vec3 min, max;
+  uint32_t code;
+  unsigned int begin, end;
+  int firstChild;
+  unsigned int childCount;
+} OctreeNode;
+
+// ---------------------------------------------------------------------------------------
+/// @class LinearOctree
+/// @brief The cube around the particles is quantised to 1024 steps per axis and the particles are sorted by the Morton
+///        code of their step, the particles of any octant are then consecutive. The octants are split down to a few
+///        particles, keeping only the non-empty children, and the queries descend into the octants the query sphere
+///        touches. The tree adapts to the particles so sparse or unbounded domains cost nothing extra.
+// ---------------------------------------------------------------------------------------
+class LinearOctree : public NNS
+{
+public:
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief LinearOctree Default ctor
+  //----------------------------------------------------------------------------------------------------------------------
+  LinearOctree() : m_refits(0) {}
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief getName
+  /// @return "octree"
+  //----------------------------------------------------------------------------------------------------------------------
+  const char *getName() const { return "octree"; }
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief buildGrid        Sorts the particles by their Morton codes and builds the octants
+  /// @param[in] _particles   Vector containing the particles
+  //----------------------------------------------------------------------------------------------------------------------
+  void buildGrid(const std::vector<Particle *> &_particles);
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief update           Keeps the octants and the order of the particles and refits the bounds of the octants to
+  ///                         the moved particles, the boxes overlap more the further the particles move so the tree
+  ///                         is built again every few steps
+  /// @param[in] _particles   Vector containing the particles
+  //----------------------------------------------------------------------------------------------------------------------
+  void update(const std::vector<Particle *> &_particles);
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief findNeighbors    Builds the neighbor table of a single particle, the tree must have been built
+  /// @param[in] _particles   Vector containing the particles
+  /// @param[in] _pid         Index of the particle
+  //----------------------------------------------------------------------------------------------------------------------
+  void findNeighbors(const std::vector<Particle *> &_particles, const unsigned int &_pid);
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief rangeQuery       Finds the particles within a radius of a point from the octants it overlaps
+  /// @param[in] _particles   Vector containing the particles, the copied positions are used instead
+  /// @param[in] _p           Centre of the query
+  /// @param[in] _radius      Radius of the query
+  /// @param[out] o_indices   Indices of the particles closer than the radius
+  //----------------------------------------------------------------------------------------------------------------------
+  void rangeQuery(const std::vector<Particle *> &_particles, const Vec3 &_p, const float &_radius, std::vector<unsigned int> &o_indices) const;
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief cleanTable Nothing to clean, the tree is rebuilt by buildGrid()
+  //----------------------------------------------------------------------------------------------------------------------
+  void cleanTable() {}
+
+protected:
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief initStructure Nothing to allocate up front, the arrays follow the particle count
+  //----------------------------------------------------------------------------------------------------------------------
+  void initStructure() {}
+
+private:
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief buildNode  Splits an octant to its non-empty children and those recursively
+  /// @param[in] _node  Index of the octant
+  /// @param[in] _level Depth of the octant, the root is 0
+  //----------------------------------------------------------------------------------------------------------------------
+  void buildNode(const unsigned int &_node, const unsigned int &_level);
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief forEachInRange Calls a function for every particle closer than a radius to a point
+  /// @param[in] _p         Centre of the query
+  /// @param[in] _radius    Radius of the query
+  /// @param[in] _f         Function taking the particle index
+  //----------------------------------------------------------------------------------------------------------------------
+  template <typename F>
+  void forEachInRange(const Vec3 &_p, const float &_radius, F _f) const;
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief m_keys Morton code and index of each particle, sorted
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<std::pair<uint32_t, unsigned int>> m_keys;
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief m_sortedParticles Particle indices in Morton order
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<unsigned int> m_sortedParticles;
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief m_sortedPositions Positions in Morton order
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<Vec3> m_sortedPositions;
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief m_nodes Octants, the root first and the children of an octant next to each other
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<OctreeNode> m_nodes;
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief m_refits Refits since the tree was last built
+  //----------------------------------------------------------------------------------------------------------------------
+  unsigned int m_refits;
+}; // end of LinearOctree
+
+#endif
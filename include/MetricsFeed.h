@@ -0,0 +1,232 @@
+#ifndef METRICSFEED_H
+#define METRICSFEED_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/// @file MetricsFeed.h
+/// @brief Live counters of a running simulation published to a POSIX shared memory segment, so that a batch run
+///        can be watched from another process on the same node without any network service
+/// @author Teemu Lindborg
+/// @version 1.0
+/// @date 18/10/2026 Initial version
+/// Revision History :
+///   Seqlock protected sample in shared memory, writer and reader 18/10/2026
+///   Resident memory read from a statm kept open by the feed 18/10/2026
+/// @todo Keep a short ring of the samples so a slow reader can log every one of them
+
+// ---------------------------------------------------------------------------------------
+/// @struct MetricsStage
+/// @brief Timing of a profiled stage, only filled when the profiler is compiled in (PBF_PROFILE)
+// ---------------------------------------------------------------------------------------
+typedef struct MetricsStage
+{
+  char name[24];
+  int32_t index;
+  float meanTime;
+  float p95Time;
+} MetricsStage;
+
+// ---------------------------------------------------------------------------------------
+/// @struct MetricsSample
+/// @brief Counters published by a simulation. Plain data so that it can be copied in and out of the segment as a
+///        whole. The times are in milliseconds, the rates per second of wall time since the previous sample.
+///        The density errors are the residual of the density constraint in the last solver iteration, the positive
+///        part of rho / rho0 - 1 as the solver only corrects compression. The tree doesn't put particles to sleep,
+///        resting particles are the ones slower than a sleep pass would allow. The neighbor counts come from the
+///        cpu neighbor search and are 0 with the OpenCL backend.
+// ---------------------------------------------------------------------------------------
+typedef struct MetricsSample
+{
+  uint64_t step;
+  double elapsed;
+  float stepRate;
+  float particleStepRate;
+  float stepTime;
+  float maxStepTime;
+  uint32_t particles;
+  uint32_t ghosts;
+  uint32_t iterations;
+  float meanDensityError;
+  float maxDensityError;
+  uint32_t movingParticles;
+  uint32_t restingParticles;
+  uint32_t minNeighbors;
+  uint32_t maxNeighbors;
+  float meanNeighbors;
+  uint64_t particleBytes;
+  uint64_t neighborBytes;
+  uint64_t residentBytes;
+  uint32_t stageCount;
+  MetricsStage stages[32];
+} MetricsSample;
+
+// ---------------------------------------------------------------------------------------
+/// @struct MetricsSegment
+/// @brief Layout of the shared memory segment. The writer makes the sequence odd while it copies a sample in and
+///        even again once done, a reader retries its copy until it got the same even sequence before and after.
+// ---------------------------------------------------------------------------------------
+typedef struct MetricsSegment
+{
+  uint32_t magic;
+  uint32_t version;
+  int32_t pid;
+  uint32_t closed;
+  std::atomic<uint64_t> sequence;
+  MetricsSample sample;
+} MetricsSegment;
+
+// ---------------------------------------------------------------------------------------
+/// @class MetricsFeed
+/// @brief Writer side of a feed. Publishing is a copy of the sample between two stores to the sequence, it never
+///        blocks on a reader and readers never write to the segment.
+// ---------------------------------------------------------------------------------------
+class MetricsFeed
+{
+public:
+  // ---------------------------------------------------------------------------------------
+  /// @brief MetricsFeed Default ctor, the feed is closed
+  // ---------------------------------------------------------------------------------------
+  MetricsFeed();
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief ~MetricsFeed Default dtor, closes the feed
+  // ---------------------------------------------------------------------------------------
+  ~MetricsFeed();
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief open       Creates the segment, replacing a stale one of the same name
+  /// @param[in] _name  Name of the feed, the segment is /pbf.<name>
+  /// @return           True if the segment could be created
+  // ---------------------------------------------------------------------------------------
+  bool open(const std::string &_name);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief close Marks the feed closed for the readers and removes the segment
+  // ---------------------------------------------------------------------------------------
+  void close();
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief isOpen
+  /// @return True if the segment exists
+  // ---------------------------------------------------------------------------------------
+  bool isOpen() const { return m_segment != nullptr; }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief publish    Replaces the sample in the segment
+  /// @param[in] _sample Counters to publish
+  // ---------------------------------------------------------------------------------------
+  void publish(const MetricsSample &_sample);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief segmentName  Name of the shared memory segment of a feed
+  /// @param[in] _name    Name of the feed
+  /// @return             Segment name
+  // ---------------------------------------------------------------------------------------
+  static std::string segmentName(const std::string &_name) { return "/pbf." + _name; }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief list Finds the feeds on this node
+  /// @return     Names of the feeds, empty where the segments can't be listed
+  // ---------------------------------------------------------------------------------------
+  static std::vector<std::string> list();
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief residentBytes Resident memory of the calling process, read from the statm the feed opened so a
+  ///                      sample costs one read and no allocation
+  /// @return              Bytes, 0 where it can't be read
+  // ---------------------------------------------------------------------------------------
+  uint64_t residentBytes() const;
+
+private:
+  // ---------------------------------------------------------------------------------------
+  /// @brief MetricsFeed Copying would close the segment twice
+  // ---------------------------------------------------------------------------------------
+  MetricsFeed(const MetricsFeed &) = delete;
+  MetricsFeed &operator =(const MetricsFeed &) = delete;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_name Segment name
+  // ---------------------------------------------------------------------------------------
+  std::string m_name;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_segment Mapped segment, nullptr when closed
+  // ---------------------------------------------------------------------------------------
+  MetricsSegment *m_segment;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_statm Descriptor of /proc/self/statm, -1 when closed or not on Linux
+  // ---------------------------------------------------------------------------------------
+  int m_statm;
+}; // end of MetricsFeed
+
+// ---------------------------------------------------------------------------------------
+/// @class MetricsReader
+/// @brief Reader side of a feed, maps the segment read only
+// ---------------------------------------------------------------------------------------
+class MetricsReader
+{
+public:
+  // ---------------------------------------------------------------------------------------
+  /// @brief MetricsReader Default ctor, not attached
+  // ---------------------------------------------------------------------------------------
+  MetricsReader();
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief ~MetricsReader Default dtor, detaches
+  // ---------------------------------------------------------------------------------------
+  ~MetricsReader();
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief attach     Maps the segment of a feed
+  /// @param[in] _name  Name of the feed
+  /// @return           True if the feed exists and has the expected layout
+  // ---------------------------------------------------------------------------------------
+  bool attach(const std::string &_name);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief detach Unmaps the segment
+  // ---------------------------------------------------------------------------------------
+  void detach();
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief read           Copies a consistent sample out of the segment
+  /// @param[out] o_sample  Latest sample
+  /// @return               True if a sample was published since the last read
+  // ---------------------------------------------------------------------------------------
+  bool read(MetricsSample &o_sample);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief isAlive
+  /// @return True while the writer hasn't closed the feed and its process is running
+  // ---------------------------------------------------------------------------------------
+  bool isAlive() const;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief getPid
+  /// @return Process id of the writer
+  // ---------------------------------------------------------------------------------------
+  int getPid() const;
+
+private:
+  // ---------------------------------------------------------------------------------------
+  /// @brief MetricsReader Copying would unmap the segment twice
+  // ---------------------------------------------------------------------------------------
+  MetricsReader(const MetricsReader &) = delete;
+  MetricsReader &operator =(const MetricsReader &) = delete;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_segment Mapped segment, nullptr when detached
+  // ---------------------------------------------------------------------------------------
+  const MetricsSegment *m_segment;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_lastSequence Sequence of the last sample read
+  // ---------------------------------------------------------------------------------------
+  uint64_t m_lastSequence;
+}; // end of MetricsReader
+
+#endif
@@ -0,0 +1,142 @@
+#ifndef MULTILEVELSOLVER_H
+#define MULTILEVELSOLVER_H
+
+#include <vector>
+#include "BoundingBox.h"
+#include "FluidSolver.h"
+#include "NNS.h"
+#include "Particle.h"
+
+/// @file MultilevelSolver.h
+/// @brief Projects the density constraint on coarse proxies of the particles before the fine iterations, so that
+///        errors spanning many particles, e.g. the pressure of a deep tank, don't have to travel a particle per
+///        iteration
+/// @author Teemu Lindborg
+/// @version 1.0
+/// @date 18/10/2026 Initial version
+/// Revision History :
+///   Proxies clustered through the neighbor search grid, coarse to fine projection 18/10/2026
+/// @todo Restrict the fine residual to the proxies instead of estimating the density again on each level
+
+// ---------------------------------------------------------------------------------------
+/// @class MultilevelSolver
+/// @brief Level l merges blocks of 2^l x 2^l x 2^l neighbor search cells to a proxy particle at the centre of mass
+///        of its particles. The proxies are projected with the smoothing length scaled by 2^l, starting from the
+///        coarsest level, and each particle is moved by the displacement of its proxy before the next level is
+///        built from the moved particles. The coarse constraint reduces to the one of FluidSolver for proxies of a
+///        single particle, the artificial pressure is left to the fine iterations. FluidSolver leaves the particle
+///        itself out of its density, a proxy counts its own mass instead and takes off the self contribution of a
+///        fine particle so both levels see the same density at rest.
+// ---------------------------------------------------------------------------------------
+class MultilevelSolver
+{
+public:
+  // ---------------------------------------------------------------------------------------
+  /// @brief MultilevelSolver Default ctor, no coarse levels
+  // ---------------------------------------------------------------------------------------
+  MultilevelSolver();
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief configure        Sets the hierarchy
+  /// @param[in] _levels      Amount of coarse levels, 0 disables the solver
+  /// @param[in] _iterations  Jacobi iterations on each coarse level
+  // ---------------------------------------------------------------------------------------
+  void configure(const unsigned int &_levels, const unsigned int &_iterations);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief isEnabled
+  /// @return True if there are coarse levels to project
+  // ---------------------------------------------------------------------------------------
+  bool isEnabled() const { return m_levels != 0; }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief project              Projects the coarse levels and moves the particles by the corrections
+  /// @param[in,out] io_particles Particles, the predicted positions are moved and the collisions handled
+  /// @param[in] _count           Amount of particles to project
+  /// @param[in] _nns             Neighbor search with the grid built
+  /// @param[in] _solver          Solver the constants and collisions are taken from
+  /// @param[in] _bb              Bounding box with its walls built
+  // ---------------------------------------------------------------------------------------
+  void project(std::vector<Particle *> &io_particles, const unsigned int &_count, NNS &_nns, FluidSolver &_solver, const BoundingBox &_bb);
+
+private:
+  // ---------------------------------------------------------------------------------------
+  /// @brief buildLevel         Clusters the particles to the proxies of a level and finds the candidate neighbors
+  /// @param[in] _particles     Particles
+  /// @param[in] _count         Amount of particles
+  /// @param[in] _nns           Neighbor search the cells are taken from
+  /// @param[in] _level         Level, the blocks are 2^level cells wide
+  // ---------------------------------------------------------------------------------------
+  void buildLevel(const std::vector<Particle *> &_particles, const unsigned int &_count, NNS &_nns, const unsigned int &_level);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief projectLevel   Runs the Jacobi iterations of the proxies and accumulates their displacements
+  /// @param[in] _h           Smoothing length of the level
+  /// @param[in] _mass        Mass of a fine particle, the inverse masses of the proxies are relative to it
+  /// @param[in] _selfDensity Density a fine particle would add to itself
+  /// @param[in] _solver      Solver the rest density and relaxation factor are taken from
+  // ---------------------------------------------------------------------------------------
+  void projectLevel(const float &_h, const float &_mass, const float &_selfDensity, const FluidSolver &_solver);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_levels Amount of coarse levels
+  // ---------------------------------------------------------------------------------------
+  unsigned int m_levels;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_iterations Jacobi iterations per coarse level
+  // ---------------------------------------------------------------------------------------
+  unsigned int m_iterations;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_particleBlocks Block of each particle on the current level
+  // ---------------------------------------------------------------------------------------
+  std::vector<unsigned int> m_particleBlocks;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_blockProxies Proxy of each block, -1 for the empty blocks
+  // ---------------------------------------------------------------------------------------
+  std::vector<int> m_blockProxies;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_proxyBlocks Block of each proxy
+  // ---------------------------------------------------------------------------------------
+  std::vector<unsigned int> m_proxyBlocks;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_positions Positions of the proxies
+  // ---------------------------------------------------------------------------------------
+  std::vector<Vec3> m_positions;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_masses Masses of the proxies
+  // ---------------------------------------------------------------------------------------
+  std::vector<float> m_masses;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_lambdas Scaling factors of the proxies
+  // ---------------------------------------------------------------------------------------
+  std::vector<float> m_lambdas;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_updates Position updates of the proxies in the current iteration
+  // ---------------------------------------------------------------------------------------
+  std::vector<Vec3> m_updates;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_displacements Total displacement of the proxies on the current level
+  // ---------------------------------------------------------------------------------------
+  std::vector<Vec3> m_displacements;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_neighbors Proxies of the surrounding blocks of each proxy, the distances are checked when used
+  // ---------------------------------------------------------------------------------------
+  std::vector<unsigned int> m_neighbors;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_neighborOffsets Start of the neighbors of each proxy in m_neighbors followed by their count
+  // ---------------------------------------------------------------------------------------
+  std::vector<unsigned int> m_neighborOffsets;
+}; // end of MultilevelSolver
+
+#endif
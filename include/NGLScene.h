@@ -7,7 +7,11 @@
 #include <ngl/Text.h>
 #include <QOpenGLWindow>
 #include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
 #include "FluidSystem.h"
+#include "FrameFeed.h"
 //----------------------------------------------------------------------------------------------------------------------
 /// @file NGLScene.h
 /// @brief this class inherits from the Qt OpenGLWindow and allows us to use NGL to draw OpenGL
@@ -24,6 +28,11 @@
 class NGLScene : public QOpenGLWindow
 {
   public:
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief ColourChannel Attribute the particles are coloured by, the shader maps it through the colour ramp of the
+    /// channel so the simulation never writes colours
+    //----------------------------------------------------------------------------------------------------------------------
+    enum ColourChannel {FLAT, DENSITY, SPEED};
     //----------------------------------------------------------------------------------------------------------------------
     /// @brief ctor for our NGL drawing class
     /// @param [in] parent the parent window to the class
@@ -42,6 +51,33 @@ class NGLScene : public QOpenGLWindow
     /// @brief this is called everytime we want to draw the scene
     //----------------------------------------------------------------------------------------------------------------------
     void paintGL();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief getFluidSystem used to configure the simulation before the window is shown
+    /// @return the fluid system drawn by the scene
+    //----------------------------------------------------------------------------------------------------------------------
+    FluidSystem &getFluidSystem() { return m_pbf; }
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief setImpostors Selects how the particles are drawn, key 4 switches between the modes
+    /// @param [in] _impostors draw the particles as ray cast sprites instead of sphere meshes
+    /// @param [in] _lodDistance eye distance beyond which the sprites are flat discs
+    //----------------------------------------------------------------------------------------------------------------------
+    void setImpostors(const bool &_impostors, const float &_lodDistance) { m_impostors = _impostors; m_lodDistance = _lodDistance; }
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief setDrawSurface Draws the extracted surface instead of the particles, key 5 switches between them
+    /// @param [in] _draw whether to draw the surface
+    //----------------------------------------------------------------------------------------------------------------------
+    void setDrawSurface(const bool &_draw) { m_drawSurface = _draw; }
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief setColourChannel Selects what the particles are coloured by, key 6 cycles through the channels
+    /// @param [in] _channel attribute mapped to the colour
+    //----------------------------------------------------------------------------------------------------------------------
+    void setColourChannel(const ColourChannel &_channel) { m_colourChannel = _channel; }
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief setViewer Draws the frames another process publishes to a frame feed instead of simulating, the feed
+    /// is attached to whenever it appears and the particles are drawn as sprites
+    /// @param [in] _name name of the frame feed
+    //----------------------------------------------------------------------------------------------------------------------
+    void setViewer(const std::string &_name) { m_viewer.reset(new FrameReader); m_viewerName = _name; }
 
 private:
     //----------------------------------------------------------------------------------------------------------------------
@@ -82,6 +118,60 @@ private:
     //----------------------------------------------------------------------------------------------------------------------
     void wheelEvent( QWheelEvent *_event);
     //----------------------------------------------------------------------------------------------------------------------
+    /// @brief drawProfile Renders the stage and thread timings of the profiler, does nothing unless PBF_PROFILE is defined
+    //----------------------------------------------------------------------------------------------------------------------
+    void drawProfile();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief createShader compiles and links a shader program from a vertex and a fragment shader
+    /// @param [in] _name name of the program, the shaders are named after it
+    /// @param [in] _vertex path of the vertex shader
+    /// @param [in] _fragment path of the fragment shader
+    //----------------------------------------------------------------------------------------------------------------------
+    void createShader(const std::string &_name, const std::string &_vertex, const std::string &_fragment);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief drawSpheres draws each particle as a sphere mesh
+    /// @param [in] _particles particles to draw
+    /// @param [in] _mouseGlobalTX rotation of the scene
+    //----------------------------------------------------------------------------------------------------------------------
+    void drawSpheres(const std::vector<Particle *> &_particles, const ngl::Mat4 &_mouseGlobalTX);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief drawSprites draws all the particles as points in one call, the fragment shader ray casts a sphere
+    /// in each sprite and writes its depth, sprites further than m_lodDistance are drawn as flat discs
+    /// @param [in] _particles particles to draw
+    /// @param [in] _mouseGlobalTX rotation of the scene
+    //----------------------------------------------------------------------------------------------------------------------
+    void drawSprites(const std::vector<Particle *> &_particles, const ngl::Mat4 &_mouseGlobalTX);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief drawSpriteBuffer draws the sprites already uploaded to the sprite buffer
+    /// @param [in] _count number of sprites in the buffer
+    /// @param [in] _mouseGlobalTX rotation of the scene
+    //----------------------------------------------------------------------------------------------------------------------
+    void drawSpriteBuffer(const unsigned int &_count, const ngl::Mat4 &_mouseGlobalTX);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief mapColour maps a particle through the colour ramp of the channel like the sprite shader does, for the
+    /// sphere meshes that are drawn one by one
+    /// @param [in] _particle particle to colour
+    /// @return colour of the particle
+    //----------------------------------------------------------------------------------------------------------------------
+    ngl::Vec4 mapColour(const Particle &_particle) const;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief drawFrame uploads the latest frame of the viewed feed and draws it with its bounding box, the previous
+    /// frame is drawn again until there's a new one
+    /// @param [in] _mouseGlobalTX rotation of the scene
+    //----------------------------------------------------------------------------------------------------------------------
+    void drawFrame(const ngl::Mat4 &_mouseGlobalTX);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief drawSurface draws the extracted surface mesh
+    /// @param [in] _surface surface of the fluid
+    /// @param [in] _mouseGlobalTX rotation of the scene
+    //----------------------------------------------------------------------------------------------------------------------
+    void drawSurface(const SurfaceMesh &_surface, const ngl::Mat4 &_mouseGlobalTX);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief drawBoundingBox draws the outlines of the simulation boundaries, the corner buffer is rewritten when the box has moved
+    /// @param [in] _bb boundaries of the simulation
+    //----------------------------------------------------------------------------------------------------------------------
+    void drawBoundingBox(const BoundingBox &_bb);
+    //----------------------------------------------------------------------------------------------------------------------
     /// @brief window width
     //----------------------------------------------------------------------------------------------------------------------
     int m_width;
@@ -140,6 +230,66 @@ private:
     /// @brief m_start/m_end Start and end times of a frame
     //----------------------------------------------------------------------------------------------------------------------
     std::chrono::time_point<std::chrono::system_clock> m_start, m_end;
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief m_impostors Draw the particles as sprite impostors instead of sphere meshes
+    //----------------------------------------------------------------------------------------------------------------------
+    bool m_impostors;
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief m_lodDistance Eye distance beyond which the sprites are drawn as flat discs
+    //----------------------------------------------------------------------------------------------------------------------
+    float m_lodDistance;
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief m_spriteVAO/m_spriteVBO Vertex array and buffer of the sprites
+    //----------------------------------------------------------------------------------------------------------------------
+    GLuint m_spriteVAO, m_spriteVBO;
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief m_spriteData Staging of the sprite vertices, centre and radius followed by the colour channels
+    //----------------------------------------------------------------------------------------------------------------------
+    std::vector<FrameVertex> m_spriteData;
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief m_colourChannel Attribute the particles are coloured by
+    //----------------------------------------------------------------------------------------------------------------------
+    ColourChannel m_colourChannel;
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief m_drawSurface Draw the extracted surface instead of the particles
+    //----------------------------------------------------------------------------------------------------------------------
+    bool m_drawSurface;
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief m_surfaceVAO/m_surfaceBuffers Vertex array of the surface and its position, normal and index buffers
+    //----------------------------------------------------------------------------------------------------------------------
+    GLuint m_surfaceVAO, m_surfaceBuffers[3];
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief m_boxVAO/m_boxBuffers Vertex array of the bounding box outlines and its corner and index buffers
+    //----------------------------------------------------------------------------------------------------------------------
+    GLuint m_boxVAO, m_boxBuffers[2];
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief m_boxCorners Corners currently in the corner buffer
+    //----------------------------------------------------------------------------------------------------------------------
+    Vec3 m_boxCorners[8];
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief m_viewer Reader of the viewed frame feed, nullptr when the scene simulates itself
+    //----------------------------------------------------------------------------------------------------------------------
+    std::unique_ptr<FrameReader> m_viewer;
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief m_viewerName Name of the viewed frame feed
+    //----------------------------------------------------------------------------------------------------------------------
+    std::string m_viewerName;
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief m_viewerFrame Header of the frame in the sprite buffer, a count of 0 until a whole frame was uploaded
+    //----------------------------------------------------------------------------------------------------------------------
+    FrameHeader m_viewerFrame;
 }; // end of NGLScnee
 
 #endif
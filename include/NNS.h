@@ -1,24 +1,31 @@
 #ifndef NNS_H
 #define NNS_H
 
-#include <unordered_map>
+#include <memory>
+#include <string>
+#include <vector>
 #include "BoundingBox.h"
 #include "Particle.h"
 
 /// @file NNS.h
-/// @brief Nearest neighbor searching class using a uniform grid where the grid size is based on the particle diameter
+/// @brief Nearest neighbor search interface, the implementations share the cell layout of the bounding box and the
+///        neighbor tables and differ in how they store and search the particles
 /// @author Teemu Lindborg
 /// @version 1.0
 /// @date 17/03/2016 Commenting and tidying up
 /// Revision History :
 ///   Started blocking out 08/02/2016
 ///   Implemented the grid and nearest neighbor searching ...-17/03/2016
-/// @todo Research and implement a more efficient way
+///   Integer cell counts 18/10/2026
+///   Split to an interface and the uniform grid, hash grid, linear octree and k-d tree 18/10/2026
+///   Refitting update of the search structure while the particle order doesn't change 18/10/2026
 
 // ---------------------------------------------------------------------------------------
 /// @class NNS
-/// @brief Uniform grid implementation that creates the grid map and builds neighbor tables
-///        for each particle, neighbor table parallelised
+/// @brief Base of the neighbor searches. The cells of the bounding box are based on the particle diameter and are
+///        what the rest of the system partitions the space with (tiles, colouring, particle order, coarse levels,
+///        surface lattice), an implementation only decides how the particles are found. The neighbor tables are
+///        flat with a fixed amount of slots per particle and built in parallel with findNeighbors().
 // ---------------------------------------------------------------------------------------
 class NNS
 {
@@ -26,12 +33,25 @@ public:
   //----------------------------------------------------------------------------------------------------------------------
   /// @brief NNS Default ctor
   //----------------------------------------------------------------------------------------------------------------------
-  NNS() {}
+  NNS() : m_particleCount(0), m_sortNeighbors(false), m_maxNeighbors(0), m_fixedRadius(0.f) {}
 
   //----------------------------------------------------------------------------------------------------------------------
   /// @brief ~NNS Default dtor
   //----------------------------------------------------------------------------------------------------------------------
-  ~NNS();
+  virtual ~NNS() {}
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief create     Creates a neighbor search by name
+  /// @param[in] _name  "grid", "hash", "octree" or "kdtree"
+  /// @return           The neighbor search, nullptr for an unknown name
+  //----------------------------------------------------------------------------------------------------------------------
+  static std::unique_ptr<NNS> create(const std::string &_name);
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief getName
+  /// @return Name the neighbor search is created with
+  //----------------------------------------------------------------------------------------------------------------------
+  virtual const char *getName() const = 0;
 
   //----------------------------------------------------------------------------------------------------------------------
   /// @brief init                 Method to initialise the grid and prepare it for the nns
@@ -41,16 +61,84 @@ public:
   //----------------------------------------------------------------------------------------------------------------------
   void init(const BoundingBox &_bb, const unsigned int &_particleCount, const unsigned int &_maxNeighbors = 60);
 
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief resize               Changes the amount of particles the tables are built for, the neighbor table
+  ///                             is only ever grown so a fluctuating particle count doesn't reallocate it
+  /// @param[in] _particleCount   Particle count
+  //----------------------------------------------------------------------------------------------------------------------
+  void resize(const unsigned int &_particleCount);
+
   //----------------------------------------------------------------------------------------------------------------------
   /// @brief buildTable       Builds the grid and constructs the neighbor table for each particle
   /// @param[in] _particles   Vector containing the particles
   //----------------------------------------------------------------------------------------------------------------------
   void buildTable(const std::vector<Particle *> &_particles);
 
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief buildGrid        Builds the search structure from the particle positions without building the neighbor
+  ///                         tables, needed whenever the particles have been reordered or migrated
+  /// @param[in] _particles   Vector containing the particles
+  //----------------------------------------------------------------------------------------------------------------------
+  virtual void buildGrid(const std::vector<Particle *> &_particles) = 0;
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief update           Brings the search structure up to date with the moved particles while they are in the
+  ///                         order of the last buildGrid() or update(), the table has to be cleaned first as for a
+  ///                         build. The trees refit their bounds in place, the grids have nothing to refit and are
+  ///                         built again.
+  /// @param[in] _particles   Vector containing the particles
+  //----------------------------------------------------------------------------------------------------------------------
+  virtual void update(const std::vector<Particle *> &_particles) { buildGrid(_particles); }
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief findNeighbors    Builds the neighbor table of a single particle, the grid must have been built. Safe to
+  ///                         call for different particles in parallel.
+  /// @param[in] _particles   Vector containing the particles
+  /// @param[in] _pid         Index of the particle
+  //----------------------------------------------------------------------------------------------------------------------
+  virtual void findNeighbors(const std::vector<Particle *> &_particles, const unsigned int &_pid) = 0;
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief rangeQuery       Finds the particles within a radius of any point, the grid must have been built
+  /// @param[in] _particles   Vector containing the particles
+  /// @param[in] _p           Centre of the query
+  /// @param[in] _radius      Radius of the query
+  /// @param[out] o_indices   Indices of the particles closer than the radius, in no particular order
+  //----------------------------------------------------------------------------------------------------------------------
+  virtual void rangeQuery(const std::vector<Particle *> &_particles, const Vec3 &_p, const float &_radius, std::vector<unsigned int> &o_indices) const = 0;
+
   //----------------------------------------------------------------------------------------------------------------------
   /// @brief cleanTable Cleans the grid and neighbor tables
   //----------------------------------------------------------------------------------------------------------------------
-  void cleanTable();
+  virtual void cleanTable() = 0;
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief getCellCoords  Method to get the cell coordinates of a position, may be outside of the grid
+  /// @param[in] _p         Position
+  /// @param[out] o_x       x-coordinate of the cell
+  /// @param[out] o_y       y-coordinate of the cell
+  /// @param[out] o_z       z-coordinate of the cell
+  //----------------------------------------------------------------------------------------------------------------------
+  void getCellCoords(const Vec3 &_p, int &o_x, int &o_y, int &o_z) const { o_x = getCellX(_p.m_x); o_y = getCellY(_p.m_y); o_z = getCellZ(_p.m_z); }
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief getGridSize
+  /// @return Cell-count for each axis
+  //----------------------------------------------------------------------------------------------------------------------
+  const Vec3i &getGridSize() const { return m_cells; }
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief getSearchRange
+  /// @return How many cells away from a particle's own cell the neighbors are searched from
+  //----------------------------------------------------------------------------------------------------------------------
+  int getSearchRange() const { return 2; }
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief setSortedNeighbors Sorts each neighbor list by particle index so the neighbor order doesn't depend on the
+  ///                           order the particles were inserted to the grid, used by the deterministic mode
+  /// @param[in] _sort          Whether to sort the lists
+  //----------------------------------------------------------------------------------------------------------------------
+  void setSortedNeighbors(const bool &_sort) { m_sortNeighbors = _sort; }
 
   //----------------------------------------------------------------------------------------------------------------------
   /// @brief getNeighbors Method to get the neighbors of a particle
@@ -59,33 +147,68 @@ public:
   //----------------------------------------------------------------------------------------------------------------------
   std::pair<unsigned int *, unsigned int> getNeighbors(const int &_pid);
 
-private:
   //----------------------------------------------------------------------------------------------------------------------
-  /// @brief buildNeighborTable Builds the neighbor table
+  /// @brief buildNeighborTable Builds the neighbor table from the grid built by buildGrid()
   /// @param[in] _particles     Vector containing the particles
   //----------------------------------------------------------------------------------------------------------------------
   void buildNeighborTable(const std::vector<Particle *> &_particles);
 
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief getBounds
+  /// @return Bounding box the grid covers
+  //----------------------------------------------------------------------------------------------------------------------
+  const BoundingBox &getBounds() const { return m_bb; }
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief getCellSize
+  /// @return Size of a cell along each axis
+  //----------------------------------------------------------------------------------------------------------------------
+  const Vec3 &getCellSize() const { return m_cellSize; }
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief getMaxNeighbors
+  /// @return Maximum amount of neighbors per particle
+  //----------------------------------------------------------------------------------------------------------------------
+  unsigned int getMaxNeighbors() const { return m_maxNeighbors; }
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief getFixedRadius
+  /// @return Radius the neighbors are accepted from
+  //----------------------------------------------------------------------------------------------------------------------
+  float getFixedRadius() const { return m_fixedRadius; }
+
+protected:
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief initStructure Allocates the search structure, called by init() once the cells and the tables are set up
+  //----------------------------------------------------------------------------------------------------------------------
+  virtual void initStructure() = 0;
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief finishNeighbors  Sorts the neighbor list of a particle in the deterministic mode
+  /// @param[in] _pid         Index of the particle
+  //----------------------------------------------------------------------------------------------------------------------
+  void finishNeighbors(const unsigned int &_pid);
+
   //----------------------------------------------------------------------------------------------------------------------
   /// @brief getCellX Method to get the cell's X-coordinate
   /// @param[in] _x   x-coordinate of the particle
   /// @return         x-coordinate of the cell based on the particle's postion
   //----------------------------------------------------------------------------------------------------------------------
-  int getCellX(const float &_x);
+  int getCellX(const float &_x) const;
 
   //----------------------------------------------------------------------------------------------------------------------
   /// @brief getCellY Method to get the cell's Y-coordinate
   /// @param[in] _y   y-coordinate of the particle
   /// @return         y-coordinate of the cell based on the particle's postion
   //----------------------------------------------------------------------------------------------------------------------
-  int getCellY(const float &_y);
+  int getCellY(const float &_y) const;
 
   //----------------------------------------------------------------------------------------------------------------------
   /// @brief getCellZ Method to get the cell's Z-coordinate
   /// @param[in] _z   z-coordinate of the particle
   /// @return         z-coordinate of the cell based on the particle's postion
   //----------------------------------------------------------------------------------------------------------------------
-  int getCellZ(const float &_z);
+  int getCellZ(const float &_z) const;
 
   //----------------------------------------------------------------------------------------------------------------------
   /// @brief getCell  Method to get the 1D cell id
@@ -94,7 +217,7 @@ private:
   /// @param[in] _z   z-coordinate of the cell
   /// @return         Cell id or -1 if it's outside of the bounding box
   //----------------------------------------------------------------------------------------------------------------------
-  int getCell(const int &_x, const int &_y, const int &_z);
+  int getCell(const int &_x, const int &_y, const int &_z) const;
 
   //----------------------------------------------------------------------------------------------------------------------
   /// @brief m_particleCount Amount of particles in the system
@@ -102,34 +225,24 @@ private:
   unsigned int m_particleCount;
 
   //----------------------------------------------------------------------------------------------------------------------
-  /// @brief m_maxNeighbors Maximum amount of neighbors per particle
+  /// @brief m_sortNeighbors Whether the neighbor lists are sorted by particle index
   //----------------------------------------------------------------------------------------------------------------------
-  unsigned int m_maxNeighbors;
+  bool m_sortNeighbors;
 
   //----------------------------------------------------------------------------------------------------------------------
-  /// @brief m_maxParticlesPerCell Maximum amount of particles per cell
+  /// @brief m_maxNeighbors Maximum amount of neighbors per particle
   //----------------------------------------------------------------------------------------------------------------------
-  unsigned int m_maxParticlesPerCell;
+  unsigned int m_maxNeighbors;
 
   //----------------------------------------------------------------------------------------------------------------------
-  /// @brief m_neighbors Vector containing the neighbors of each particle
+  /// @brief m_neighbors Flat neighbor table, the neighbors of particle i start at i * m_maxNeighbors
   //----------------------------------------------------------------------------------------------------------------------
-  std::vector<unsigned int*> m_neighbors;
+  std::vector<unsigned int, NumaAllocator<unsigned int>> m_neighbors;
 
   //----------------------------------------------------------------------------------------------------------------------
   /// @brief m_numNeighbors Vector containing the number of particles for each particle
   //----------------------------------------------------------------------------------------------------------------------
-  std::vector<unsigned int> m_numNeighbors;
-
-  //----------------------------------------------------------------------------------------------------------------------
-  /// @brief m_gridCellNumParticles Vector containing the amount of particles in each cell
-  //----------------------------------------------------------------------------------------------------------------------
-  std::vector<unsigned int> m_gridCellNumParticles;
-
-  //----------------------------------------------------------------------------------------------------------------------
-  /// @brief m_grid Map of the cell id to particle indices
-  //----------------------------------------------------------------------------------------------------------------------
-  std::unordered_map<unsigned int, std::vector<int>> m_grid;
+  std::vector<unsigned int, NumaAllocator<unsigned int>> m_numNeighbors;
 
   //----------------------------------------------------------------------------------------------------------------------
   /// @brief m_fixedRadius Fixed radius to search/accept neighbors from
@@ -139,17 +252,24 @@ private:
   //----------------------------------------------------------------------------------------------------------------------
   /// @brief m_cells Cell-count for each axis
   //----------------------------------------------------------------------------------------------------------------------
-  ngl::Vec3 m_cells;
+  Vec3i m_cells;
 
   //----------------------------------------------------------------------------------------------------------------------
   /// @brief m_cellSize Cell-size for each axis
   //----------------------------------------------------------------------------------------------------------------------
-  ngl::Vec3 m_cellSize;
+  Vec3 m_cellSize;
 
   //----------------------------------------------------------------------------------------------------------------------
   /// @brief m_bb Bounding box of the simulation
   //----------------------------------------------------------------------------------------------------------------------
   BoundingBox m_bb;
+
+private:
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief NNS Copying would share the tables of the structure
+  //----------------------------------------------------------------------------------------------------------------------
+  NNS(const NNS &) = delete;
+  NNS &operator =(const NNS &) = delete;
 }; // end of NNS
 
 #endif
@@ -0,0 +1,83 @@
+#ifndef NUMA_H
+#define NUMA_H
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+/// @file Numa.h
+/// @brief NUMA helpers for the solver, places the memory of large buffers with a parallel first touch
+///        that's partitioned the same way as the solver loops (static schedule over the particle index)
+///        and pins the worker threads so they stay next to the memory they touched
+/// @author Teemu Lindborg
+/// @version 1.0
+/// @date 18/10/2026 Initial version
+/// Revision History :
+///   First touch allocation, thread pinning and transparent huge pages 18/10/2026
+///   Small buffers skip the first touch pass 18/10/2026
+/// @todo Read the node layout with libnuma instead of relying on the OS cpu numbering
+
+// ---------------------------------------------------------------------------------------
+/// @class Numa
+/// @brief Static helpers for the NUMA aware memory placement and thread affinity
+// ---------------------------------------------------------------------------------------
+class Numa
+{
+public:
+  // ---------------------------------------------------------------------------------------
+  /// @brief pinThreads Pins each OpenMP worker thread to its own core, thread n goes to the n:th
+  ///                   cpu the process is allowed to run on. No-op without OpenMP or on other platforms
+  // ---------------------------------------------------------------------------------------
+  static void pinThreads();
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief setHugePages Enables backing the large buffers with transparent huge pages
+  /// @param[in] _enable  Whether to advise the kernel to use huge pages for new allocations
+  // ---------------------------------------------------------------------------------------
+  static void setHugePages(const bool &_enable) { hugePages() = _enable; }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief allocate         Allocates a buffer and touches it in parallel so that the pages of element i
+  ///                         land on the node of the thread that processes particle i in the solver loops.
+  ///                         Buffers of a page or less aren't touched, the contents are left uninitialised.
+  /// @param[in] _count       Amount of elements
+  /// @param[in] _elementSize Size of an element in bytes
+  /// @return                 Pointer to the buffer, throws std::bad_alloc on failure
+  // ---------------------------------------------------------------------------------------
+  static void *allocate(const std::size_t &_count, const std::size_t &_elementSize);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief release  Releases a buffer allocated with allocate()
+  /// @param[in] _ptr Buffer to release
+  // ---------------------------------------------------------------------------------------
+  static void release(void *_ptr);
+
+private:
+  // ---------------------------------------------------------------------------------------
+  /// @brief hugePages Accessor for the huge page setting
+  /// @return          Reference to the setting
+  // ---------------------------------------------------------------------------------------
+  static bool &hugePages() { static bool enabled = false; return enabled; }
+}; // end of Numa
+
+// ---------------------------------------------------------------------------------------
+/// @class NumaAllocator
+/// @brief Standard allocator using Numa::allocate(), lets std::vector based buffers use the first touch placement
+// ---------------------------------------------------------------------------------------
+template <typename T>
+class NumaAllocator
+{
+public:
+  typedef T value_type;
+
+  NumaAllocator() {}
+  template <typename U> NumaAllocator(const NumaAllocator<U> &) {}
+
+  T *allocate(std::size_t _n) { return static_cast<T *>(Numa::allocate(_n, sizeof(T))); }
+  void deallocate(T *_p, std::size_t) { Numa::release(_p); }
+
+  template <typename U> bool operator ==(const NumaAllocator<U> &) const { return true; }
+  template <typename U> bool operator !=(const NumaAllocator<U> &) const { return false; }
+}; // end of NumaAllocator
+
+#endif
@@ -0,0 +1,305 @@
+#ifndef OPENCLBACKEND_H
+#define OPENCLBACKEND_H
+
+#ifdef PBF_USE_OPENCL
+
+#define CL_TARGET_OPENCL_VERSION 120
+#ifdef __APPLE__
+#include <OpenCL/opencl.h>
+#else
+#include <CL/cl.h>
+#endif
+#include <string>
+#include <vector>
+#include "ComputeBackend.h"
+#include "FluidSolver.h"
+#include "NNS.h"
+
+/// @file OpenCLBackend.h
+/// @brief Runs the stages of a simulation step as OpenCL kernels, works on any OpenCL 1.2 device including
+///        cpu runtimes such as POCL
+/// @author Teemu Lindborg
+/// @version 1.0
+/// @date 18/10/2026 Initial version
+/// Revision History :
+///   Structure of arrays buffers, bitonic sort of the grid keys and the solver kernels 18/10/2026
+///   Wall velocities next to the planes 18/10/2026
+///   Relaxation factor of the position updates and the warm start pass 18/10/2026
+///   Frame vertices written while the particles are read back 18/10/2026
+///   Reports a failed OpenCL call through isValid() instead of skipping the steps silently 18/10/2026
+/// @todo Keep the particles on the device between the steps instead of copying them every step
+
+// ---------------------------------------------------------------------------------------
+/// @class OpenCLBackend
+/// @brief Backend copying the particles to flat structure of arrays buffers on the device at the start of a step
+///        and back at the end. The grid is built by sorting (cell, particle) keys on the device and finding the
+///        range of each cell in the sorted keys, the neighbor lists and the solver stages then follow the cpu path.
+// ---------------------------------------------------------------------------------------
+class OpenCLBackend : public ComputeBackend
+{
+public:
+  // ---------------------------------------------------------------------------------------
+  /// @brief OpenCLBackend  Default ctor
+  /// @param[in] _solver    Solver the constants are taken from
+  /// @param[in] _nns       Neighbor search the grid layout and search radius are taken from
+  // ---------------------------------------------------------------------------------------
+  OpenCLBackend(const FluidSolver &_solver, const NNS &_nns);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief ~OpenCLBackend Default dtor, releases the OpenCL objects
+  // ---------------------------------------------------------------------------------------
+  ~OpenCLBackend();
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief init             Picks the first available OpenCL device and builds the kernels
+  /// @param[in] _kernelFile  Path of the kernel source
+  /// @return                 True if the backend can be used
+  // ---------------------------------------------------------------------------------------
+  bool init(const std::string &_kernelFile);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief getDeviceName
+  /// @return Name of the device the kernels run on
+  // ---------------------------------------------------------------------------------------
+  const std::string &getDeviceName() const { return m_deviceName; }
+
+  const char *getName() const { return "opencl"; }
+  bool isValid() const { return m_ok; }
+  void beginStep(std::vector<Particle *> &io_particles, const unsigned int &_count, const BoundingBox &_bb);
+  void predict(const float &_timeStep);
+  void buildGrid(const bool &_refit);
+  void buildNeighbors();
+  void computeLambda(const unsigned int &_iteration);
+  void warmStart();
+  void computePositionUpdate(const unsigned int &_iteration);
+  void applyPositionUpdate(const unsigned int &_iteration, const bool &_lastIteration, const float &_timeStep);
+  void computeVorticity(const float &_timeStep);
+  void finalize(FrameVertex *o_frame);
+  void endStep(std::vector<Particle *> &io_particles);
+
+private:
+  // ---------------------------------------------------------------------------------------
+  /// @brief Kernel Kernels of kernels/pbf.cl, KERNEL_COUNT is the amount of them
+  // ---------------------------------------------------------------------------------------
+  enum Kernel
+  {
+    PREDICT,
+    CELL_KEYS,
+    BITONIC_SORT,
+    CLEAR_CELLS,
+    CELL_RANGES,
+    NEIGHBORS,
+    LAMBDA,
+    POSITION_UPDATE,
+    APPLY_UPDATE,
+    VORTICITY,
+    FINALIZE,
+    KERNEL_COUNT
+  };
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief Buffer Device buffers, BUFFER_COUNT is the amount of them
+  // ---------------------------------------------------------------------------------------
+  enum Buffer
+  {
+    POS,
+    PRED_POS,
+    VEL,
+    EXT_FORCES,
+    POS_UPDATE,
+    MASS,
+    RADIUS,
+    DENSITY,
+    LAMBDA_VALUES,
+    KEYS,
+    CELL_START,
+    CELL_END,
+    NEIGHBOR_LIST,
+    NUM_NEIGHBORS,
+    WALLS,
+    BUFFER_COUNT
+  };
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief OpenCLBackend Non-copyable as the object owns the OpenCL objects
+  // ---------------------------------------------------------------------------------------
+  OpenCLBackend(const OpenCLBackend &);
+  OpenCLBackend &operator=(const OpenCLBackend &);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief check        Reports a failed OpenCL call, the backend stops running the kernels after the first failure
+  /// @param[in] _error   Return value of the call
+  /// @param[in] _what    Description of the call
+  /// @return             True if the call succeeded
+  // ---------------------------------------------------------------------------------------
+  bool check(const cl_int &_error, const char *_what);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief allocate     (Re)creates the buffers for a particle count and grid size
+  /// @param[in] _count   Amount of particles
+  /// @param[in] _cells   Amount of grid cells
+  /// @return             True if all the buffers were created
+  // ---------------------------------------------------------------------------------------
+  bool allocate(const unsigned int &_count, const unsigned int &_cells);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief setArgs    Sets the arguments of a kernel starting from _index
+  /// @param[in] _kernel Kernel
+  /// @param[in] _index Index of the first argument
+  /// @param[in] _arg   Value of the argument, buffers are passed as cl_mem
+  // ---------------------------------------------------------------------------------------
+  template <typename T, typename... Args>
+  void setArgs(const Kernel &_kernel, const cl_uint &_index, const T &_arg, const Args &... _args)
+  {
+    check(clSetKernelArg(m_kernels[_kernel], _index, sizeof(T), &_arg), "clSetKernelArg");
+    setArgs(_kernel, _index + 1, _args...);
+  }
+  void setArgs(const Kernel &, const cl_uint &) {}
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief run            Enqueues a kernel over a range of work items
+  /// @param[in] _kernel    Kernel
+  /// @param[in] _workItems Amount of work items
+  // ---------------------------------------------------------------------------------------
+  void run(const Kernel &_kernel, const size_t &_workItems);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief sync Waits for the queued kernels when profiling so the stage timings cover the device work
+  // ---------------------------------------------------------------------------------------
+  void sync();
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_parameters Solver constants
+  // ---------------------------------------------------------------------------------------
+  SolverParameters m_parameters;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_solver Solver the relaxation factor is read from, it changes while running
+  // ---------------------------------------------------------------------------------------
+  const FluidSolver &m_solver;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_nns Neighbor search of the fluid system, only its grid layout is used
+  // ---------------------------------------------------------------------------------------
+  const NNS &m_nns;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_ok False after an OpenCL call has failed
+  // ---------------------------------------------------------------------------------------
+  bool m_ok;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_deviceName Name of the device
+  // ---------------------------------------------------------------------------------------
+  std::string m_deviceName;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_context Context of the device
+  // ---------------------------------------------------------------------------------------
+  cl_context m_context;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_device Device the kernels run on
+  // ---------------------------------------------------------------------------------------
+  cl_device_id m_device;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_queue In-order queue all the work is enqueued to
+  // ---------------------------------------------------------------------------------------
+  cl_command_queue m_queue;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_program Program built from the kernel source
+  // ---------------------------------------------------------------------------------------
+  cl_program m_program;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_kernels Kernels of the program indexed by Kernel
+  // ---------------------------------------------------------------------------------------
+  cl_kernel m_kernels[KERNEL_COUNT];
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_buffers Device buffers indexed by Buffer
+  // ---------------------------------------------------------------------------------------
+  cl_mem m_buffers[BUFFER_COUNT];
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_count Amount of particles simulated this step
+  // ---------------------------------------------------------------------------------------
+  cl_uint m_count;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_capacity Amount of particles the buffers have space for
+  // ---------------------------------------------------------------------------------------
+  cl_uint m_capacity;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_paddedCount Size of the sort, the next power of two from the capacity
+  // ---------------------------------------------------------------------------------------
+  cl_uint m_paddedCount;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_cellCount Amount of grid cells plus one for the particles outside of the grid
+  // ---------------------------------------------------------------------------------------
+  cl_uint m_cellCount;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_frame Back buffer of the frame feed handed to finalize(), written in endStep()
+  // ---------------------------------------------------------------------------------------
+  FrameVertex *m_frame;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_gridMin Minimum corner of the grid
+  // ---------------------------------------------------------------------------------------
+  cl_float4 m_gridMin;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_cellSize Size of a grid cell along each axis
+  // ---------------------------------------------------------------------------------------
+  cl_float4 m_cellSize;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_cells Amount of grid cells along each axis
+  // ---------------------------------------------------------------------------------------
+  cl_int m_cells[3];
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_hostPos Host side staging of the positions, the staging vectors are kept between the steps
+  ///                  so they don't reallocate
+  // ---------------------------------------------------------------------------------------
+  std::vector<cl_float4> m_hostPos;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_hostVel Host side staging of the velocities
+  // ---------------------------------------------------------------------------------------
+  std::vector<cl_float4> m_hostVel;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_hostExtForces Host side staging of the external forces
+  // ---------------------------------------------------------------------------------------
+  std::vector<cl_float4> m_hostExtForces;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_hostMass Host side staging of the masses
+  // ---------------------------------------------------------------------------------------
+  std::vector<cl_float> m_hostMass;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_hostRadius Host side staging of the radii
+  // ---------------------------------------------------------------------------------------
+  std::vector<cl_float> m_hostRadius;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_hostDensity Host side staging of the densities
+  // ---------------------------------------------------------------------------------------
+  std::vector<cl_float> m_hostDensity;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_hostLambda Host side staging of the scaling factors
+  // ---------------------------------------------------------------------------------------
+  std::vector<cl_float> m_hostLambda;
+}; // end of OpenCLBackend
+
+#endif // PBF_USE_OPENCL
+
+#endif
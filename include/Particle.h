@@ -2,7 +2,8 @@
 #define PARTICLE_H
 
 #include <vector>
-#include <ngl/Vec4.h>
+#include "VectorMath.h"
+#include "Numa.h"
 
 /// @file Particle.h
 /// @brief Simple particle struct
@@ -11,6 +12,9 @@
 /// @date 08/02/16 Initial blocking
 /// Revision History :
 /// Started blocking out 08/02/16
+/// Vectors from VectorMath.h instead of NGL 18/10/2026
+/// Stable ids so the storage can be reordered 18/10/2026
+/// Colour left to the renderer 18/10/2026
 /// @todo Refining
 
 // ---------------------------------------------------------------------------------------
@@ -22,32 +26,27 @@ typedef struct Particle
   //----------------------------------------------------------------------------------------------------------------------
   /// @brief m_pos Position of a particle
   //----------------------------------------------------------------------------------------------------------------------
-  ngl::Vec3 m_pos;
+  Vec3 m_pos;
 
   //----------------------------------------------------------------------------------------------------------------------
   /// @brief m_predPos Predicted position of a particle
   //----------------------------------------------------------------------------------------------------------------------
-  ngl::Vec3 m_predPos;
+  Vec3 m_predPos;
 
   //----------------------------------------------------------------------------------------------------------------------
   /// @brief m_posUpdate Calculated position update of a particle
   //----------------------------------------------------------------------------------------------------------------------
-  ngl::Vec3 m_posUpdate;
+  Vec3 m_posUpdate;
 
   //----------------------------------------------------------------------------------------------------------------------
   /// @brief m_vel Velocity of a particle
   //----------------------------------------------------------------------------------------------------------------------
-  ngl::Vec3 m_vel;
+  Vec3 m_vel;
 
   //----------------------------------------------------------------------------------------------------------------------
   /// @brief m_extForces External forces to a particle
   //----------------------------------------------------------------------------------------------------------------------
-  ngl::Vec3 m_extForces;
-
-  //----------------------------------------------------------------------------------------------------------------------
-  /// @brief m_colour Colour of a particle
-  //----------------------------------------------------------------------------------------------------------------------
-  ngl::Vec4 m_colour;
+  Vec3 m_extForces;
 
   //----------------------------------------------------------------------------------------------------------------------
   /// @brief m_mass Mass of a particle
@@ -69,6 +68,11 @@ typedef struct Particle
   //----------------------------------------------------------------------------------------------------------------------
   float m_lambda;
 
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief m_id Id of a particle, stays the same when the particles are reordered or move between ranks
+  //----------------------------------------------------------------------------------------------------------------------
+  unsigned int m_id;
+
   //----------------------------------------------------------------------------------------------------------------------
   /// @brief Particle Default ctor
   /// @param[in] _x Initial x-position
@@ -80,12 +84,17 @@ typedef struct Particle
     m_pos(_x, _y, _z),
     m_radius(_r),
     m_density(0.f),
-    m_lambda(0.f)
+    m_lambda(0.f),
+    m_id(0)
   {
     float d = _r*2;
     m_mass = d*d*d*1000.f;
-    m_colour = ngl::Vec4(1.0f, 1.0f, 1.0f, 1.0f);
   }
 } Particle; // end of struct
 
+// ---------------------------------------------------------------------------------------
+/// @brief ParticleBuffer Contiguous particle storage, placed with a parallel first touch
+// ---------------------------------------------------------------------------------------
+typedef std::vector<Particle, NumaAllocator<Particle>> ParticleBuffer;
+
 #endif
@@ -0,0 +1,169 @@
+#ifndef PARTICLEORDER_H
+#define PARTICLEORDER_H
+
+#include <cstdint>
+#include <vector>
+#include "NNS.h"
+#include "Particle.h"
+
+/// @file ParticleOrder.h
+/// @brief Reorders the particle storage along a space filling curve over the grid cells so that the neighbors of a
+///        particle are mostly next to it in memory
+/// @author Teemu Lindborg
+/// @version 1.0
+/// @date 18/10/2026 Initial version
+/// Revision History :
+///   Morton and Hilbert ordering, periodic and disorder triggered 18/10/2026
+/// @todo Sort the ghost particles of a distributed run as well
+
+// ---------------------------------------------------------------------------------------
+/// @class ParticleOrder
+/// @brief Sorts the owned particles by the curve key of their neighbor search cell. The sort is stable so the
+///        order only depends on the positions and the previous order, the particles keep their ids.
+// ---------------------------------------------------------------------------------------
+class ParticleOrder
+{
+public:
+  // ---------------------------------------------------------------------------------------
+  /// @brief Curve Space filling curve the cells are ordered along, Hilbert never jumps between
+  ///              distant cells but its keys are more expensive to compute
+  // ---------------------------------------------------------------------------------------
+  enum Curve {MORTON, HILBERT};
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief ParticleOrder Default ctor, reordering is disabled
+  // ---------------------------------------------------------------------------------------
+  ParticleOrder();
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief configure      Sets when the particles are reordered
+  /// @param[in] _curve     Curve to order the cells along
+  /// @param[in] _interval  Reorder every this many steps, 0 to only use the threshold
+  /// @param[in] _threshold Also reorder when the disorder of the particles goes over this, 0 to only use the interval
+  // ---------------------------------------------------------------------------------------
+  void configure(const Curve &_curve, const unsigned int &_interval, const float &_threshold);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief isEnabled
+  /// @return True if the particles are reordered at all
+  // ---------------------------------------------------------------------------------------
+  bool isEnabled() const { return m_interval != 0 || m_threshold > 0.f; }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief update             Reorders the particles if the interval has passed or they're too disordered
+  /// @param[in,out] io_storage Particles, the first _count of them are reordered and the rest are left in place
+  /// @param[in] _count         Amount of particles to reorder
+  /// @param[in] _nns           Neighbor search the cells are taken from
+  /// @param[in] _step          Current simulation step
+  /// @return                   True if the particles moved in the storage
+  // ---------------------------------------------------------------------------------------
+  bool update(ParticleBuffer &io_storage, const unsigned int &_count, const NNS &_nns, const unsigned int &_step);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief reorder            Sorts the particles along the curve
+  /// @param[in,out] io_storage Particles, the first _count of them are reordered and the rest are left in place
+  /// @param[in] _count         Amount of particles to reorder
+  /// @param[in] _nns           Neighbor search the cells are taken from
+  // ---------------------------------------------------------------------------------------
+  void reorder(ParticleBuffer &io_storage, const unsigned int &_count, const NNS &_nns);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief getDisorder
+  /// @return Fraction of the particles whose key is smaller than the key of the previous particle when last
+  ///         measured, 0 right after a reorder and about 0.5 for a random order
+  // ---------------------------------------------------------------------------------------
+  float getDisorder() const { return m_disorder; }
+
+private:
+  // ---------------------------------------------------------------------------------------
+  /// @brief computeKeys    Computes the curve keys of the particle cells to m_keys and measures the disorder
+  /// @param[in] _storage   Particles
+  /// @param[in] _count     Amount of particles
+  /// @param[in] _nns       Neighbor search the cells are taken from
+  // ---------------------------------------------------------------------------------------
+  void computeKeys(const ParticleBuffer &_storage, const unsigned int &_count, const NNS &_nns);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief sortKeys Stable radix sort of the particle indices by m_keys to m_order
+  /// @param[in] _count Amount of particles
+  // ---------------------------------------------------------------------------------------
+  void sortKeys(const unsigned int &_count);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief gather             Moves the particles to the order in m_order
+  /// @param[in,out] io_storage Particles
+  /// @param[in] _count         Amount of sorted particles, the rest stay in place
+  // ---------------------------------------------------------------------------------------
+  void gather(ParticleBuffer &io_storage, const unsigned int &_count);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief mortonKey  Interleaves the bits of the cell coordinates
+  /// @param[in] _x     x-coordinate of the cell
+  /// @param[in] _y     y-coordinate of the cell
+  /// @param[in] _z     z-coordinate of the cell
+  /// @return           Key with bit b of x at 3b + 2
+  // ---------------------------------------------------------------------------------------
+  static uint64_t mortonKey(const uint32_t &_x, const uint32_t &_y, const uint32_t &_z);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief hilbertKey Index of the cell along the Hilbert curve
+  /// @param[in] _x     x-coordinate of the cell
+  /// @param[in] _y     y-coordinate of the cell
+  /// @param[in] _z     z-coordinate of the cell
+  /// @param[in] _bits  Bits per coordinate
+  /// @return           Key
+  // ---------------------------------------------------------------------------------------
+  static uint64_t hilbertKey(const uint32_t &_x, const uint32_t &_y, const uint32_t &_z, const int &_bits);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_curve Curve the cells are ordered along
+  // ---------------------------------------------------------------------------------------
+  Curve m_curve;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_interval Steps between the periodic reorders, 0 for none
+  // ---------------------------------------------------------------------------------------
+  unsigned int m_interval;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_threshold Disorder that triggers a reorder, 0 for none
+  // ---------------------------------------------------------------------------------------
+  float m_threshold;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_disorder Last measured disorder
+  // ---------------------------------------------------------------------------------------
+  float m_disorder;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_keyBits Amount of significant bits in the keys of the current grid
+  // ---------------------------------------------------------------------------------------
+  int m_keyBits;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_keys Curve key of each particle
+  // ---------------------------------------------------------------------------------------
+  std::vector<uint64_t> m_keys;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_keyScratch Scratch keys of the radix sort passes
+  // ---------------------------------------------------------------------------------------
+  std::vector<uint64_t> m_keyScratch;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_order Particle indices sorted by key, m_order[i] is moved to i
+  // ---------------------------------------------------------------------------------------
+  std::vector<unsigned int> m_order;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_sortScratch Scratch indices of the radix sort passes
+  // ---------------------------------------------------------------------------------------
+  std::vector<unsigned int> m_sortScratch;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_scratch Storage the particles are gathered to, swapped with the particle storage
+  // ---------------------------------------------------------------------------------------
+  ParticleBuffer m_scratch;
+}; // end of ParticleOrder
+
+#endif
@@ -0,0 +1,95 @@
+#ifndef PERFCOUNTERS_H
+#define PERFCOUNTERS_H
+
+/// @file PerfCounters.h
+/// @brief Hardware performance counters of the calling thread through perf_event_open, used by the
+///        profiler to record the counters of each scope
+/// @author Teemu Lindborg
+/// @version 1.0
+/// @date 18/10/2026 Initial version
+/// Revision History :
+///   Cycles, instructions, cache and branch misses 18/10/2026
+/// @todo Scale the values when the kernel multiplexes the counters
+
+// ---------------------------------------------------------------------------------------
+/// @class PerfCounters
+/// @brief Group of counters measuring the thread that created it. Counters the kernel or the cpu
+///        don't support are left out and read as 0, if none of them can be opened (non-Linux, perf_event_paranoid,
+///        containers) the object is unavailable and every read returns zeros.
+// ---------------------------------------------------------------------------------------
+class PerfCounters
+{
+public:
+  // ---------------------------------------------------------------------------------------
+  /// @brief Counter Counters recorded, COUNT is the amount of them
+  // ---------------------------------------------------------------------------------------
+  enum Counter
+  {
+    CYCLES,
+    INSTRUCTIONS,
+    L1_MISSES,
+    LLC_MISSES,
+    BRANCH_MISSES,
+    COUNT
+  };
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief PerfCounters Default ctor, opens and starts the counters for the calling thread
+  // ---------------------------------------------------------------------------------------
+  PerfCounters();
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief ~PerfCounters Default dtor, closes the counters
+  // ---------------------------------------------------------------------------------------
+  ~PerfCounters();
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief read           Reads the current values of the counters, only valid on the thread that created the object
+  /// @param[out] o_values  Counter values, 0 for the counters that aren't available
+  // ---------------------------------------------------------------------------------------
+  void read(long long o_values[COUNT]) const;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief isAvailable
+  /// @return True if at least one of the counters could be opened
+  // ---------------------------------------------------------------------------------------
+  bool isAvailable() const { return m_leader != -1; }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief isAvailable
+  /// @param[in] _counter Counter to check
+  /// @return True if the counter could be opened
+  // ---------------------------------------------------------------------------------------
+  bool isAvailable(const Counter &_counter) const { return m_fds[_counter] != -1; }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief getName
+  /// @param[in] _counter Counter
+  /// @return Short name of the counter
+  // ---------------------------------------------------------------------------------------
+  static const char *getName(const Counter &_counter);
+
+private:
+  // ---------------------------------------------------------------------------------------
+  /// @brief PerfCounters Non-copyable as the object owns the file descriptors
+  // ---------------------------------------------------------------------------------------
+  PerfCounters(const PerfCounters &);
+  PerfCounters &operator=(const PerfCounters &);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_leader File descriptor of the group leader, -1 if no counter could be opened
+  // ---------------------------------------------------------------------------------------
+  int m_leader;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_fds File descriptors of the counters, -1 for the ones that couldn't be opened
+  // ---------------------------------------------------------------------------------------
+  int m_fds[COUNT];
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_ids Kernel ids of the counters, used to match the values of a group read
+  // ---------------------------------------------------------------------------------------
+  unsigned long long m_ids[COUNT];
+}; // end of PerfCounters
+
+#endif
@@ -0,0 +1,405 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+/// @file Profiler.h
+/// @brief Scoped timers for the simulation stages. The timings are recorded per thread, aggregated into
+///        rolling histograms every frame and can be captured into a Chrome trace (chrome://tracing).
+///        Everything compiles to nothing unless PBF_PROFILE is defined.
+/// @author Teemu Lindborg
+/// @version 1.0
+/// @date 18/10/2026 Initial version
+/// Revision History :
+///   Profiling scopes, rolling histograms and trace export 18/10/2026
+///   Hardware counters per scope with PBF_PERF_COUNTERS 18/10/2026
+///   Recording can be disabled per thread 18/10/2026
+///   Event buffers sized from the largest frame so that recording doesn't allocate 18/10/2026
+///   Percentiles select from a scratch copy kept by the histogram 18/10/2026
+/// @todo Export the histograms to a file for offline comparison
+
+#ifdef PBF_PROFILE
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+#ifdef PBF_PERF_COUNTERS
+#include "PerfCounters.h"
+#endif
+
+// ---------------------------------------------------------------------------------------
+/// @class RollingHistogram
+/// @brief Keeps the last samples of a value in a ring buffer and computes statistics over them
+// ---------------------------------------------------------------------------------------
+class RollingHistogram
+{
+public:
+  // ---------------------------------------------------------------------------------------
+  /// @brief RollingHistogram Default ctor
+  /// @param[in] _capacity    Amount of samples kept
+  // ---------------------------------------------------------------------------------------
+  explicit RollingHistogram(const unsigned int &_capacity = 120);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief add        Adds a sample, overwrites the oldest one once the buffer is full
+  /// @param[in] _value Sample value
+  // ---------------------------------------------------------------------------------------
+  void add(const float &_value);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief mean
+  /// @return Mean of the samples, 0 if there are none
+  // ---------------------------------------------------------------------------------------
+  float mean() const;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief percentile   Nearest rank percentile of the samples, partially sorts a scratch copy kept by the
+  ///                     histogram so it doesn't allocate, not to be called from several threads at once
+  /// @param[in] _p       Percentile between 0 and 1
+  /// @return             Sample at the percentile, 0 if there are none
+  // ---------------------------------------------------------------------------------------
+  float percentile(const float &_p) const;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief histogram    Bins the samples between 0 and the largest sample
+  /// @param[in] _bins    Amount of bins
+  /// @param[out] o_counts Amount of samples in each bin
+  /// @return             Width of a bin
+  // ---------------------------------------------------------------------------------------
+  float histogram(const unsigned int &_bins, std::vector<unsigned int> &o_counts) const;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief getCount
+  /// @return Amount of samples currently kept
+  // ---------------------------------------------------------------------------------------
+  unsigned int getCount() const { return m_count; }
+
+private:
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_samples Ring buffer of the samples
+  // ---------------------------------------------------------------------------------------
+  std::vector<float> m_samples;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_next Index the next sample is written to
+  // ---------------------------------------------------------------------------------------
+  unsigned int m_next;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_count Amount of valid samples
+  // ---------------------------------------------------------------------------------------
+  unsigned int m_count;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_sorted Scratch copy of the samples percentile() selects from, sized with the ring buffer
+  // ---------------------------------------------------------------------------------------
+  mutable std::vector<float> m_sorted;
+}; // end of RollingHistogram
+
+// ---------------------------------------------------------------------------------------
+/// @struct ProfileStage
+/// @brief Timings of a named stage, the same name can be split by an index (eg. the solver iteration)
+// ---------------------------------------------------------------------------------------
+typedef struct ProfileStage
+{
+  const char *name;
+  int index;
+  RollingHistogram wallTime;
+#ifdef PBF_PERF_COUNTERS
+  // Counter totals per frame summed over the threads
+  RollingHistogram counters[PerfCounters::COUNT];
+#endif
+} ProfileStage;
+
+// ---------------------------------------------------------------------------------------
+/// @class Profiler
+/// @brief Singleton collecting the scope timings of all the threads. The scopes only append to a buffer
+///        owned by their thread, the buffers are processed in endFrame() which has to be called when no
+///        other thread is inside a scope (ie. after the step has finished)
+// ---------------------------------------------------------------------------------------
+class Profiler
+{
+public:
+  // ---------------------------------------------------------------------------------------
+  /// @brief instance Gets the profiler instance
+  /// @return The profiler
+  // ---------------------------------------------------------------------------------------
+  static Profiler *instance();
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief now  Time since the profiler was created
+  /// @return     Nanoseconds
+  // ---------------------------------------------------------------------------------------
+  long long now() const;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief begin  Opens a scope on the calling thread
+  /// @return       Start time of the scope in nanoseconds
+  // ---------------------------------------------------------------------------------------
+  long long begin();
+
+#ifdef PBF_PERF_COUNTERS
+  // ---------------------------------------------------------------------------------------
+  /// @brief readCounters   Reads the hardware counters of the calling thread
+  /// @param[out] o_values  Counter values, zeros if the counters aren't available
+  // ---------------------------------------------------------------------------------------
+  void readCounters(long long o_values[PerfCounters::COUNT]);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief end          Closes the innermost scope of the calling thread along with its counter values
+  /// @param[in] _name    Name of the stage
+  /// @param[in] _index   Index of the stage, -1 if not used
+  /// @param[in] _start   Start time returned by begin()
+  /// @param[in] _counters Counter values at the start of the scope
+  // ---------------------------------------------------------------------------------------
+  void end(const char *_name, const int &_index, const long long &_start, const long long _counters[PerfCounters::COUNT]);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief hasCounters
+  /// @return True if the hardware counters could be opened on any of the threads
+  // ---------------------------------------------------------------------------------------
+  bool hasCounters() const { return m_hasCounters; }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief getThreadCounters
+  /// @return Counter totals of the outermost scopes of each thread per frame
+  // ---------------------------------------------------------------------------------------
+  const std::vector<std::vector<RollingHistogram>> &getThreadCounters() const { return m_threadCounters; }
+#endif
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief end        Closes the innermost scope of the calling thread and stores it to the thread's buffer
+  /// @param[in] _name  Name of the stage, has to be a string literal
+  /// @param[in] _index Index of the stage, -1 if not used
+  /// @param[in] _start Start time returned by begin()
+  // ---------------------------------------------------------------------------------------
+  void end(const char *_name, const int &_index, const long long &_start);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief endFrame Aggregates the scopes recorded during the frame into the histograms and the trace,
+  ///                 ignored on a disabled thread
+  // ---------------------------------------------------------------------------------------
+  void endFrame();
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief reserveEvents  Makes room for the scopes of a frame in the buffer of every thread, so that recording
+  ///                       them doesn't allocate. Has to be called between the frames as the other threads'
+  ///                       buffers are reallocated.
+  /// @param[in] _events    Most scopes a single thread may record during a frame
+  // ---------------------------------------------------------------------------------------
+  void reserveEvents(const std::size_t &_events);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief setThreadEnabled Enables or disables the recording on the calling thread. The scopes and frame ends
+  ///                         of a disabled thread are ignored, used by the ensemble workers that each run a whole
+  ///                         scene concurrently with the others.
+  /// @param[in] _enabled     Whether the thread records, must not be changed inside a scope
+  // ---------------------------------------------------------------------------------------
+  void setThreadEnabled(const bool &_enabled) { threadBuffer()->enabled = _enabled; }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief captureTrace   Records the scopes of the following frames and writes them as a Chrome trace
+  /// @param[in] _frames    Amount of frames to capture
+  /// @param[in] _fileName  File the trace is written to once the frames have been captured
+  // ---------------------------------------------------------------------------------------
+  void captureTrace(const unsigned int &_frames, const std::string &_fileName);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief isCapturing
+  /// @return True while a trace is being captured
+  // ---------------------------------------------------------------------------------------
+  bool isCapturing() const { return m_captureFrames > 0; }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief getStages
+  /// @return Wall times of the stages in the order they were first seen, in milliseconds
+  // ---------------------------------------------------------------------------------------
+  const std::vector<ProfileStage> &getStages() const { return m_stages; }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief getThreadTimes
+  /// @return Time each thread spent inside the top level scopes per frame, in milliseconds
+  // ---------------------------------------------------------------------------------------
+  const std::vector<RollingHistogram> &getThreadTimes() const { return m_threadTimes; }
+
+private:
+  // ---------------------------------------------------------------------------------------
+  /// @struct Event
+  /// @brief A finished scope
+  // ---------------------------------------------------------------------------------------
+  struct Event
+  {
+    const char *name;
+    int index;
+    int depth;
+    long long start;
+    long long end;
+#ifdef PBF_PERF_COUNTERS
+    long long counters[PerfCounters::COUNT];
+#endif
+  };
+
+  // ---------------------------------------------------------------------------------------
+  /// @struct ThreadBuffer
+  /// @brief Scopes recorded by a single thread
+  // ---------------------------------------------------------------------------------------
+  struct ThreadBuffer
+  {
+    unsigned int id;
+    int depth;
+    bool enabled;
+    std::vector<Event> events;
+#ifdef PBF_PERF_COUNTERS
+    PerfCounters *counters;
+#endif
+  };
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief Profiler Default ctor, private as the class is a singleton
+  // ---------------------------------------------------------------------------------------
+  Profiler();
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief threadBuffer Gets the calling thread's buffer, registers it on first use
+  /// @return             Buffer of the thread
+  // ---------------------------------------------------------------------------------------
+  ThreadBuffer *threadBuffer();
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief findStage  Finds or adds a stage
+  /// @param[in] _name  Name of the stage
+  /// @param[in] _index Index of the stage
+  /// @return           Index to m_stages
+  // ---------------------------------------------------------------------------------------
+  unsigned int findStage(const char *_name, const int &_index);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief writeTrace Writes the captured events in the Chrome trace event format
+  // ---------------------------------------------------------------------------------------
+  void writeTrace();
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_epoch Creation time of the profiler, the timings are relative to it
+  // ---------------------------------------------------------------------------------------
+  std::chrono::steady_clock::time_point m_epoch;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_lock Guards the registration of the thread buffers
+  // ---------------------------------------------------------------------------------------
+  std::mutex m_lock;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_buffers Buffers of all the threads that have recorded a scope
+  // ---------------------------------------------------------------------------------------
+  std::vector<ThreadBuffer *> m_buffers;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_stages Histograms of the stage wall times
+  // ---------------------------------------------------------------------------------------
+  std::vector<ProfileStage> m_stages;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_stageStart/m_stageEnd Earliest start and latest end of each stage during the frame
+  // ---------------------------------------------------------------------------------------
+  std::vector<long long> m_stageStart, m_stageEnd;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_threadTimes Histograms of the busy time of each thread
+  // ---------------------------------------------------------------------------------------
+  std::vector<RollingHistogram> m_threadTimes;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_eventCapacity Events each thread buffer has room for, twice the most scopes of a frame so far
+  // ---------------------------------------------------------------------------------------
+  std::size_t m_eventCapacity;
+
+#ifdef PBF_PERF_COUNTERS
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_threadCounters Histograms of the counters of each thread, indexed by thread and counter
+  // ---------------------------------------------------------------------------------------
+  std::vector<std::vector<RollingHistogram>> m_threadCounters;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_stageCounters Counter totals of each stage during the frame, indexed by stage and counter
+  // ---------------------------------------------------------------------------------------
+  std::vector<long long> m_stageCounters;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_hasCounters Whether any thread managed to open the counters
+  // ---------------------------------------------------------------------------------------
+  bool m_hasCounters;
+#endif
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_trace Events captured for the trace along with the id of their thread
+  // ---------------------------------------------------------------------------------------
+  std::vector<std::pair<unsigned int, Event>> m_trace;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_captureFrames Frames left to capture
+  // ---------------------------------------------------------------------------------------
+  unsigned int m_captureFrames;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_traceFile File the trace is written to
+  // ---------------------------------------------------------------------------------------
+  std::string m_traceFile;
+}; // end of Profiler
+
+// ---------------------------------------------------------------------------------------
+/// @class ProfileScope
+/// @brief Times the enclosing scope, use through the PBF_PROFILE_SCOPE macros
+// ---------------------------------------------------------------------------------------
+class ProfileScope
+{
+public:
+#ifdef PBF_PERF_COUNTERS
+  // The counters are read after the clock on entry and before it on exit so the timing overhead
+  // stays out of them
+  ProfileScope(const char *_name, const int &_index = -1) :
+    m_name(_name),
+    m_index(_index),
+    m_start(Profiler::instance()->begin())
+  {
+    Profiler::instance()->readCounters(m_counters);
+  }
+
+  ~ProfileScope() { Profiler::instance()->end(m_name, m_index, m_start, m_counters); }
+#else
+  ProfileScope(const char *_name, const int &_index = -1) :
+    m_name(_name),
+    m_index(_index),
+    m_start(Profiler::instance()->begin())
+  {}
+
+  ~ProfileScope() { Profiler::instance()->end(m_name, m_index, m_start); }
+#endif
+
+private:
+  const char *m_name;
+  int m_index;
+  long long m_start;
+#ifdef PBF_PERF_COUNTERS
+  long long m_counters[PerfCounters::COUNT];
+#endif
+}; // end of ProfileScope
+
+#define PBF_PROFILE_CONCAT_IMPL(_a, _b) _a##_b
+#define PBF_PROFILE_CONCAT(_a, _b) PBF_PROFILE_CONCAT_IMPL(_a, _b)
+#define PBF_PROFILE_SCOPE(_name) ProfileScope PBF_PROFILE_CONCAT(profileScope, __LINE__)(_name)
+#define PBF_PROFILE_SCOPE_INDEX(_name, _index) ProfileScope PBF_PROFILE_CONCAT(profileScope, __LINE__)(_name, _index)
+#define PBF_PROFILE_FRAME() Profiler::instance()->endFrame()
+#define PBF_PROFILE_THREAD(_enabled) Profiler::instance()->setThreadEnabled(_enabled)
+#define PBF_PROFILE_RESERVE(_events) Profiler::instance()->reserveEvents(_events)
+
+#else
+
+// The index is still evaluated so that a parameter only used as one doesn't become unused
+#define PBF_PROFILE_SCOPE(_name)
+#define PBF_PROFILE_SCOPE_INDEX(_name, _index) (void)(_index)
+#define PBF_PROFILE_FRAME()
+#define PBF_PROFILE_THREAD(_enabled)
+#define PBF_PROFILE_RESERVE(_events)
+
+#endif // PBF_PROFILE
+
+#endif
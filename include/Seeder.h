@@ -0,0 +1,368 @@
+#ifndef SEEDER_H
+#define SEEDER_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "BoundingBox.h"
+#include "Particle.h"
+#include "VectorMath.h"
+
+/// @file Seeder.h
+/// @brief Fills volumes with particles in parallel, the shapes are boxes, spheres and closed triangle meshes
+/// @author Teemu Lindborg
+/// @version 1.0
+/// @date 18/10/2026 Initial version
+/// Revision History :
+///   Lattice and jittered sampling, target count or spacing, mesh voxelization 18/10/2026
+///   Open meshes are rejected 18/10/2026
+/// @todo Poisson disk sampling for less regular initial states
+
+// ---------------------------------------------------------------------------------------
+/// @class SeedVolume
+/// @brief Shape to fill with particles
+// ---------------------------------------------------------------------------------------
+class SeedVolume
+{
+public:
+  // ---------------------------------------------------------------------------------------
+  /// @brief ~SeedVolume Default dtor
+  // ---------------------------------------------------------------------------------------
+  virtual ~SeedVolume() {}
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief contains Whether a point is inside the shape
+  /// @param[in] _p   Point
+  // ---------------------------------------------------------------------------------------
+  virtual bool contains(const Vec3 &_p) const = 0;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief getBounds  Axis aligned bounds of the shape
+  /// @param[out] o_min Minimum corner
+  /// @param[out] o_max Maximum corner
+  // ---------------------------------------------------------------------------------------
+  virtual void getBounds(Vec3 &o_min, Vec3 &o_max) const = 0;
+};
+
+// ---------------------------------------------------------------------------------------
+/// @class SeedBox
+/// @brief Axis aligned box
+// ---------------------------------------------------------------------------------------
+class SeedBox : public SeedVolume
+{
+public:
+  // ---------------------------------------------------------------------------------------
+  /// @brief SeedBox    Default ctor
+  /// @param[in] _min   Minimum corner
+  /// @param[in] _max   Maximum corner
+  // ---------------------------------------------------------------------------------------
+  SeedBox(const Vec3 &_min, const Vec3 &_max) : m_min(_min), m_max(_max) {}
+
+  bool contains(const Vec3 &_p) const
+  {
+    return _p.m_x >= m_min.m_x && _p.m_y >= m_min.m_y && _p.m_z >= m_min.m_z &&
+           _p.m_x <= m_max.m_x && _p.m_y <= m_max.m_y && _p.m_z <= m_max.m_z;
+  }
+  void getBounds(Vec3 &o_min, Vec3 &o_max) const { o_min = m_min; o_max = m_max; }
+
+private:
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_min, m_max Corners of the box
+  // ---------------------------------------------------------------------------------------
+  Vec3 m_min, m_max;
+};
+
+// ---------------------------------------------------------------------------------------
+/// @class SeedSphere
+/// @brief Sphere
+// ---------------------------------------------------------------------------------------
+class SeedSphere : public SeedVolume
+{
+public:
+  // ---------------------------------------------------------------------------------------
+  /// @brief SeedSphere   Default ctor
+  /// @param[in] _centre  Centre of the sphere
+  /// @param[in] _radius  Radius of the sphere
+  // ---------------------------------------------------------------------------------------
+  SeedSphere(const Vec3 &_centre, const float &_radius) : m_centre(_centre), m_radius(_radius) {}
+
+  bool contains(const Vec3 &_p) const { return distanceSquared(_p, m_centre) <= m_radius*m_radius; }
+  void getBounds(Vec3 &o_min, Vec3 &o_max) const
+  {
+    const Vec3 r(m_radius, m_radius, m_radius);
+    o_min = m_centre - r;
+    o_max = m_centre + r;
+  }
+
+private:
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_centre Centre of the sphere
+  // ---------------------------------------------------------------------------------------
+  Vec3 m_centre;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_radius Radius of the sphere
+  // ---------------------------------------------------------------------------------------
+  float m_radius;
+};
+
+// ---------------------------------------------------------------------------------------
+/// @class SeedMesh
+/// @brief Closed triangle mesh, voxelized to an inside/outside grid when constructed. Each column of voxels along
+///        z is classified by the parity of the triangle crossings of a ray through the column centres.
+// ---------------------------------------------------------------------------------------
+class SeedMesh : public SeedVolume
+{
+public:
+  // ---------------------------------------------------------------------------------------
+  /// @brief SeedMesh         Default ctor, voxelizes the mesh
+  /// @param[in] _vertices    Vertex positions
+  /// @param[in] _indices     Three vertex indices per triangle, the winding doesn't matter
+  /// @param[in] _resolution  Amount of voxels along the longest axis of the mesh
+  // ---------------------------------------------------------------------------------------
+  SeedMesh(const std::vector<Vec3> &_vertices, const std::vector<unsigned int> &_indices, const unsigned int &_resolution = 128);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief readOBJ          Reads the vertices and faces of a Wavefront OBJ file, polygons are split into triangles
+  /// @param[in] _fileName    Path of the file
+  /// @param[out] o_vertices  Vertex positions
+  /// @param[out] o_indices   Three vertex indices per triangle
+  /// @return                 True if the file could be read and had triangles
+  // ---------------------------------------------------------------------------------------
+  static bool readOBJ(const std::string &_fileName, std::vector<Vec3> &o_vertices, std::vector<unsigned int> &o_indices);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief isClosed       Checks that a mesh has no holes, the inside of an open mesh is undefined
+  /// @param[in] _indices   Three vertex indices per triangle
+  /// @return               True if every edge is shared by exactly two triangles
+  // ---------------------------------------------------------------------------------------
+  static bool isClosed(const std::vector<unsigned int> &_indices);
+
+  bool contains(const Vec3 &_p) const;
+  void getBounds(Vec3 &o_min, Vec3 &o_max) const { o_min = m_min; o_max = m_max; }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief getInsideCount
+  /// @return Amount of voxels inside the mesh
+  // ---------------------------------------------------------------------------------------
+  unsigned int getInsideCount() const { return m_insideCount; }
+
+private:
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_min, m_max Bounds of the mesh
+  // ---------------------------------------------------------------------------------------
+  Vec3 m_min, m_max;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_voxelSize Size of a voxel along each axis
+  // ---------------------------------------------------------------------------------------
+  Vec3 m_voxelSize;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_voxels Amount of voxels along each axis
+  // ---------------------------------------------------------------------------------------
+  int m_voxels[3];
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_inside One per voxel, x fastest, non-zero inside the mesh
+  // ---------------------------------------------------------------------------------------
+  std::vector<unsigned char> m_inside;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_insideCount Amount of voxels inside the mesh
+  // ---------------------------------------------------------------------------------------
+  unsigned int m_insideCount;
+};
+
+// ---------------------------------------------------------------------------------------
+/// @class Seeder
+/// @brief Places particles on a lattice inside the union of the volumes. The lattice points are counted per x-slab
+///        in parallel, a prefix sum over the slabs gives every point its index and a second parallel pass writes
+///        the particles straight to their place in the preallocated storage, so the result doesn't depend on the
+///        thread count. With a target count the spacing is searched so that the lattice has at least that many
+///        points and the surplus is thinned out evenly over the lattice order.
+// ---------------------------------------------------------------------------------------
+class Seeder
+{
+public:
+  // ---------------------------------------------------------------------------------------
+  /// @brief Sampling Placement of the particles, the jitter offsets each lattice point by a hash of its index
+  // ---------------------------------------------------------------------------------------
+  enum Sampling
+  {
+    LATTICE,
+    JITTERED
+  };
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief Seeder Default ctor
+  // ---------------------------------------------------------------------------------------
+  Seeder();
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief addBox   Adds an axis aligned box to fill
+  /// @param[in] _min Minimum corner
+  /// @param[in] _max Maximum corner
+  // ---------------------------------------------------------------------------------------
+  void addBox(const Vec3 &_min, const Vec3 &_max) { m_volumes.push_back(std::make_shared<SeedBox>(_min, _max)); }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief addSphere    Adds a sphere to fill
+  /// @param[in] _centre  Centre of the sphere
+  /// @param[in] _radius  Radius of the sphere
+  // ---------------------------------------------------------------------------------------
+  void addSphere(const Vec3 &_centre, const float &_radius) { m_volumes.push_back(std::make_shared<SeedSphere>(_centre, _radius)); }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief addMesh          Adds a closed triangle mesh read from an OBJ file to fill
+  /// @param[in] _fileName    Path of the file
+  /// @param[in] _resolution  Amount of voxels along the longest axis of the mesh
+  /// @return                 True if the file could be read and the mesh is closed
+  // ---------------------------------------------------------------------------------------
+  bool addMesh(const std::string &_fileName, const unsigned int &_resolution = 128);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief addVolume  Adds any shape to fill, the volumes are shared between copies of the seeder
+  /// @param[in] _volume Shape
+  // ---------------------------------------------------------------------------------------
+  void addVolume(const std::shared_ptr<const SeedVolume> &_volume) { m_volumes.push_back(_volume); }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief clear Removes all the volumes
+  // ---------------------------------------------------------------------------------------
+  void clear() { m_volumes.clear(); }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief empty
+  /// @return True if there are no volumes to fill
+  // ---------------------------------------------------------------------------------------
+  bool empty() const { return m_volumes.empty(); }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief setSpacing     Distance between the lattice points, used when there's no target count
+  /// @param[in] _spacing   Spacing
+  // ---------------------------------------------------------------------------------------
+  void setSpacing(const float &_spacing) { m_spacing = _spacing; }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief getSpacing
+  /// @return Spacing of the lattice, after seed() the one that was used
+  // ---------------------------------------------------------------------------------------
+  float getSpacing() const { return m_spacing; }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief setTargetCount Seeds exactly this many particles, the spacing is searched for. 0 uses the spacing instead.
+  /// @param[in] _count     Amount of particles
+  // ---------------------------------------------------------------------------------------
+  void setTargetCount(const unsigned int &_count) { m_targetCount = _count; }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief setOrigin  Anchors the lattice to a point, by default a lattice point is half a spacing in from the
+  ///                   minimum corner of the volumes
+  /// @param[in] _origin A lattice point
+  // ---------------------------------------------------------------------------------------
+  void setOrigin(const Vec3 &_origin) { m_origin = _origin; m_hasOrigin = true; }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief setSampling  Selects the placement of the particles
+  /// @param[in] _sampling Lattice or jittered
+  /// @param[in] _jitter  Largest offset along each axis as a fraction of the spacing
+  /// @param[in] _seed    Seed of the jitter, the same seed gives the same particles
+  // ---------------------------------------------------------------------------------------
+  void setSampling(const Sampling &_sampling, const float &_jitter = 0.25f, const unsigned int &_seed = 1);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief seed         Fills the volumes, replacing the particles of the storage. Points closer than the particle
+  ///                     radius to the walls of the bounding box are left out. The particles are numbered over all
+  ///                     the processes, the number is the id of the particle.
+  /// @param[out] o_storage Particle storage, resized to the particles of this process
+  /// @param[in] _bb      Boundaries of the simulation
+  /// @param[in] _first   Index of the first particle of this process
+  /// @param[in] _stride  Every _stride:th particle from _first belongs to this process
+  /// @return             Amount of particles seeded by all the processes
+  // ---------------------------------------------------------------------------------------
+  unsigned int seed(ParticleBuffer &o_storage, const BoundingBox &_bb, const unsigned int &_first = 0, const unsigned int &_stride = 1);
+
+private:
+  // ---------------------------------------------------------------------------------------
+  /// @brief Lattice Lattice over the bounds of the volumes
+  // ---------------------------------------------------------------------------------------
+  typedef struct Lattice
+  {
+    float spacing;
+    Vec3 origin;
+    int begin[3];
+    int end[3];
+    std::vector<unsigned int> slabStart;
+  } Lattice;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief getBounds  Union of the bounds of the volumes limited to the clip region
+  /// @param[out] o_min Minimum corner
+  /// @param[out] o_max Maximum corner
+  // ---------------------------------------------------------------------------------------
+  void getBounds(Vec3 &o_min, Vec3 &o_max) const;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief buildLattice   Sets up the lattice for a spacing and counts its points inside the volumes per x-slab
+  /// @param[in] _spacing   Spacing
+  /// @param[out] o_lattice Lattice, slabStart holds the index of the first point of each slab and the total last
+  // ---------------------------------------------------------------------------------------
+  void buildLattice(const float &_spacing, Lattice &o_lattice) const;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief samplePoint    Position of a lattice point and whether a particle is placed there
+  /// @param[in] _lattice   Lattice
+  /// @param[in] _x, _y, _z Lattice index
+  /// @param[out] o_p       Position including the jitter
+  /// @return               True if the point is inside a volume and inside the simulation boundaries
+  // ---------------------------------------------------------------------------------------
+  bool samplePoint(const Lattice &_lattice, const int &_x, const int &_y, const int &_z, Vec3 &o_p) const;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_volumes Shapes to fill
+  // ---------------------------------------------------------------------------------------
+  std::vector<std::shared_ptr<const SeedVolume>> m_volumes;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_spacing Distance between the lattice points
+  // ---------------------------------------------------------------------------------------
+  float m_spacing;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_targetCount Amount of particles to seed, 0 to use the spacing
+  // ---------------------------------------------------------------------------------------
+  unsigned int m_targetCount;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_origin A lattice point, only used when m_hasOrigin is set
+  // ---------------------------------------------------------------------------------------
+  Vec3 m_origin;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_hasOrigin Whether the lattice is anchored to m_origin
+  // ---------------------------------------------------------------------------------------
+  bool m_hasOrigin;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_sampling Placement of the particles
+  // ---------------------------------------------------------------------------------------
+  Sampling m_sampling;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_jitter Largest offset as a fraction of the spacing
+  // ---------------------------------------------------------------------------------------
+  float m_jitter;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_seed Seed of the jitter
+  // ---------------------------------------------------------------------------------------
+  unsigned int m_seed;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_clipMin, m_clipMax Region the particles have to be in, the bounding box shrunk by the particle radius
+  // ---------------------------------------------------------------------------------------
+  Vec3 m_clipMin, m_clipMax;
+}; // end of Seeder
+
+#endif
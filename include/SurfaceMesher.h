@@ -0,0 +1,361 @@
+#ifndef SURFACEMESHER_H
+#define SURFACEMESHER_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "FluidSolver.h"
+#include "NNS.h"
+#include "Particle.h"
+
+/// @file SurfaceMesher.h
+/// @brief Extracts the fluid surface as a triangle mesh with marching cubes over a smoothed density field
+/// @author Teemu Lindborg
+/// @version 1.0
+/// @date 18/10/2026 Initial version
+/// Revision History :
+///   Sparse field on the neighbor search cells, tiled marching cubes and background extraction 18/10/2026
+///   Tiles reserve room for a plane on first use 18/10/2026
+///   Every tile reserves room for a two sided sheet in init() 18/10/2026
+/// @todo Anisotropic kernels for flatter surfaces
+
+// ---------------------------------------------------------------------------------------
+/// @struct SurfaceMesh
+/// @brief Indexed triangle mesh, the vertices are shared between the triangles
+// ---------------------------------------------------------------------------------------
+typedef struct SurfaceMesh
+{
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief m_vertices Vertex positions
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<Vec3> m_vertices;
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief m_normals Unit normals of the vertices pointing out of the fluid
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<Vec3> m_normals;
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief m_indices Three vertex indices per triangle, counter clockwise seen from outside the fluid
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<unsigned int> m_indices;
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief writeOBJ       Writes the mesh to a Wavefront OBJ file
+  /// @param[in] _fileName  Path of the file
+  /// @return               True if the file was written
+  //----------------------------------------------------------------------------------------------------------------------
+  bool writeOBJ(const std::string &_fileName) const;
+} SurfaceMesh; // end of struct
+
+// ---------------------------------------------------------------------------------------
+/// @class SurfaceMesher
+/// @brief Surface reconstruction using the cell layout of the neighbor search. The particles are binned to the
+///        cells, the cells within the kernel radius of an occupied cell are active and only the lattice points
+///        touching them are evaluated. The lattice is split into tiles of cells which are processed in parallel:
+///        each tile splats the particles around it to the lattice points it owns, creates the vertices of the
+///        edges starting from its points and triangulates its voxels, looking the shared vertices up from the
+///        tiles owning them. The extraction can run on a background thread while the next step is simulated.
+// ---------------------------------------------------------------------------------------
+class SurfaceMesher
+{
+public:
+  // ---------------------------------------------------------------------------------------
+  /// @brief SurfaceMesher Default ctor
+  // ---------------------------------------------------------------------------------------
+  SurfaceMesher();
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief ~SurfaceMesher Default dtor, stops the background thread
+  // ---------------------------------------------------------------------------------------
+  ~SurfaceMesher();
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief init             Sets up the lattice on the cells of the neighbor search and reserves the output of every
+  ///                         tile so the extractions after it don't allocate, waits for a running extraction
+  /// @param[in] _nns         Neighbor search the cell layout is taken from
+  /// @param[in] _parameters  Solver constants, the field is the density over the rest density
+  /// @param[in] _subdivisions Lattice intervals per cell along each axis
+  // ---------------------------------------------------------------------------------------
+  void init(const NNS &_nns, const SolverParameters &_parameters, const unsigned int &_subdivisions = 2);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief setIsoValue  Sets the field value of the surface
+  /// @param[in] _iso     Fraction of the rest density, smaller values include sparser particles
+  // ---------------------------------------------------------------------------------------
+  void setIsoValue(const float &_iso) { m_iso = _iso; }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief extract        Extracts the surface of the particles on the calling thread
+  /// @param[in] _particles Particles
+  /// @param[in] _count     Amount of particles to use from the start of the vector
+  /// @param[out] o_mesh    Extracted mesh, its storage is reused
+  // ---------------------------------------------------------------------------------------
+  void extract(const std::vector<Particle *> &_particles, const unsigned int &_count, SurfaceMesh &o_mesh);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief submit         Copies the particles and extracts their surface on the background thread,
+  ///                       ignored if the previous extraction is still running
+  /// @param[in] _particles Particles
+  /// @param[in] _count     Amount of particles to use from the start of the vector
+  /// @return               True if the particles were taken
+  // ---------------------------------------------------------------------------------------
+  bool submit(const std::vector<Particle *> &_particles, const unsigned int &_count);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief fetch        Takes the latest mesh finished by the background thread
+  /// @param[out] o_mesh  Swapped with the finished mesh
+  /// @return             True if a new mesh was available
+  // ---------------------------------------------------------------------------------------
+  bool fetch(SurfaceMesh &o_mesh);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief wait Blocks until the background thread has finished its extraction
+  // ---------------------------------------------------------------------------------------
+  void wait();
+
+private:
+  // ---------------------------------------------------------------------------------------
+  /// @struct Tile
+  /// @brief Output of a tile, the vectors keep their storage between the extractions
+  // ---------------------------------------------------------------------------------------
+  struct Tile
+  {
+    std::vector<uint64_t> edges;
+    std::vector<Vec3> vertices;
+    std::vector<Vec3> normals;
+    std::vector<unsigned int> indices;
+    unsigned int vertexOffset;
+    unsigned int indexOffset;
+  };
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief SurfaceMesher Non-copyable as the object owns a thread
+  // ---------------------------------------------------------------------------------------
+  SurfaceMesher(const SurfaceMesher &);
+  SurfaceMesher &operator=(const SurfaceMesher &);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief run            Runs all the passes of an extraction over the copied particles
+  /// @param[out] o_mesh    Extracted mesh
+  // ---------------------------------------------------------------------------------------
+  void run(SurfaceMesh &o_mesh);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief binParticles Sorts the copied particles to the cells and marks the active cells and tiles
+  // ---------------------------------------------------------------------------------------
+  void binParticles();
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief splatTile  Evaluates the field at the lattice points owned by a tile
+  /// @param[in] _tile  Tile id
+  // ---------------------------------------------------------------------------------------
+  void splatTile(const unsigned int &_tile);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief createVertices Creates the vertices of the surface crossing edges starting from the points of a tile
+  /// @param[in] _tile      Tile id
+  // ---------------------------------------------------------------------------------------
+  void createVertices(const unsigned int &_tile);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief triangulate    Runs marching cubes over the voxels of the active cells of a tile
+  /// @param[in] _tile      Tile id
+  // ---------------------------------------------------------------------------------------
+  void triangulate(const unsigned int &_tile);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief findVertex     Looks up the global index of the vertex of an edge from the tile owning the edge
+  /// @param[in] _x         x-coordinate of the lattice point the edge starts from
+  /// @param[in] _y         y-coordinate of the lattice point
+  /// @param[in] _z         z-coordinate of the lattice point
+  /// @param[in] _axis      Axis the edge runs along
+  /// @return               Index of the vertex in the mesh
+  // ---------------------------------------------------------------------------------------
+  unsigned int findVertex(const int &_x, const int &_y, const int &_z, const int &_axis) const;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief isCellActive Checks a cell, the cells outside of the grid are inactive
+  /// @param[in] _x       x-coordinate of the cell
+  /// @param[in] _y       y-coordinate of the cell
+  /// @param[in] _z       z-coordinate of the cell
+  /// @return             True if the field may be non-zero in the cell
+  // ---------------------------------------------------------------------------------------
+  bool isCellActive(const int &_x, const int &_y, const int &_z) const;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief pointIndex Index of a lattice point in m_field
+  // ---------------------------------------------------------------------------------------
+  std::size_t pointIndex(const int &_x, const int &_y, const int &_z) const { return _x + m_points[0] * ((std::size_t)_y + (std::size_t)m_points[1] * _z); }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief tileRange  Range of lattice points owned by a tile along an axis, the last tile also owns the last point
+  /// @param[in] _t     Tile coordinate
+  /// @param[in] _axis  Axis
+  /// @param[out] o_begin First point
+  /// @param[out] o_end One past the last point
+  // ---------------------------------------------------------------------------------------
+  void tileRange(const int &_t, const int &_axis, int &o_begin, int &o_end) const;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief workerLoop Main loop of the background thread
+  // ---------------------------------------------------------------------------------------
+  void workerLoop();
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_min Minimum corner of the lattice
+  // ---------------------------------------------------------------------------------------
+  Vec3 m_min;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_cellSize Size of a cell along each axis
+  // ---------------------------------------------------------------------------------------
+  Vec3 m_cellSize;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_spacing Distance between the lattice points along each axis
+  // ---------------------------------------------------------------------------------------
+  Vec3 m_spacing;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_cells Amount of cells along each axis
+  // ---------------------------------------------------------------------------------------
+  int m_cells[3];
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_points Amount of lattice points along each axis
+  // ---------------------------------------------------------------------------------------
+  int m_points[3];
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_tiles Amount of tiles along each axis
+  // ---------------------------------------------------------------------------------------
+  int m_tiles[3];
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_tileSize Edge length of a tile in cells
+  // ---------------------------------------------------------------------------------------
+  int m_tileSize;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_subdivisions Lattice intervals per cell
+  // ---------------------------------------------------------------------------------------
+  int m_subdivisions;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_range Kernel radius in cells
+  // ---------------------------------------------------------------------------------------
+  int m_range;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_h2 Squared kernel radius
+  // ---------------------------------------------------------------------------------------
+  float m_h2;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_weight Poly6 constant over the rest density
+  // ---------------------------------------------------------------------------------------
+  float m_weight;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_iso Field value of the surface
+  // ---------------------------------------------------------------------------------------
+  float m_iso;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_positions/m_masses Copy of the particles being meshed
+  // ---------------------------------------------------------------------------------------
+  std::vector<Vec3> m_positions;
+  std::vector<float> m_masses;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_cellStart Start of each cell in m_cellParticles, the cells are counting sorted
+  // ---------------------------------------------------------------------------------------
+  std::vector<unsigned int> m_cellStart;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_cellParticles Particle indices sorted by cell
+  // ---------------------------------------------------------------------------------------
+  std::vector<unsigned int> m_cellParticles;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_particleCells Cell of each particle, -1 outside of the grid
+  // ---------------------------------------------------------------------------------------
+  std::vector<int> m_particleCells;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_active Whether each cell is within the kernel radius of an occupied cell
+  // ---------------------------------------------------------------------------------------
+  std::vector<unsigned char> m_active;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_scratch Temporary cell flags of the dilation
+  // ---------------------------------------------------------------------------------------
+  std::vector<unsigned char> m_scratch;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_activeTiles Tiles owning lattice points that touch an active cell
+  // ---------------------------------------------------------------------------------------
+  std::vector<unsigned int> m_activeTiles;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_tileActive Whether each tile is in m_activeTiles
+  // ---------------------------------------------------------------------------------------
+  std::vector<unsigned char> m_tileActive;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_field Field values of the lattice points, zero outside of the active tiles
+  // ---------------------------------------------------------------------------------------
+  std::vector<float> m_field;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_fieldTiles Tiles whose points were written by the previous extraction
+  // ---------------------------------------------------------------------------------------
+  std::vector<unsigned int> m_fieldTiles;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_tileData Output of each tile, indexed by tile id
+  // ---------------------------------------------------------------------------------------
+  std::vector<Tile> m_tileData;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_thread Background thread, started on the first submit()
+  // ---------------------------------------------------------------------------------------
+  std::thread m_thread;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_lock/m_wake Guard the hand-over between the threads
+  // ---------------------------------------------------------------------------------------
+  std::mutex m_lock;
+  std::condition_variable m_wake;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_busy The background thread owns the copied particles and the lattice
+  // ---------------------------------------------------------------------------------------
+  bool m_busy;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_ready m_result holds a mesh that hasn't been fetched
+  // ---------------------------------------------------------------------------------------
+  bool m_ready;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_quit Tells the background thread to exit
+  // ---------------------------------------------------------------------------------------
+  bool m_quit;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_result Latest mesh of the background thread
+  // ---------------------------------------------------------------------------------------
+  SurfaceMesh m_result;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_working Mesh the background thread is writing
+  // ---------------------------------------------------------------------------------------
+  SurfaceMesh m_working;
+}; // end of SurfaceMesher
+
+#endif
@@ -0,0 +1,254 @@
+#ifndef TASKSCHEDULER_H
+#define TASKSCHEDULER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// @file TaskScheduler.h
+/// @brief Work stealing scheduler running a graph of tasks with dependencies, used to run the solver
+///        stages per spatial tile instead of in whole-array passes separated by barriers
+/// @author Teemu Lindborg
+/// @version 1.0
+/// @date 18/10/2026 Initial version
+/// Revision History :
+///   Task graph and work stealing scheduler 18/10/2026
+///   Worker id of the running task 18/10/2026
+///   Flat successor lists and ring buffer deques so a graph of the same size doesn't allocate 18/10/2026
+/// @todo Lock-free deques if the locking ever shows up in the profiles
+
+// ---------------------------------------------------------------------------------------
+/// @class TaskGraph
+/// @brief Directed acyclic graph of tasks, the storage is reused between clear() calls
+// ---------------------------------------------------------------------------------------
+class TaskGraph
+{
+public:
+  // ---------------------------------------------------------------------------------------
+  /// @brief TaskGraph Default ctor
+  // ---------------------------------------------------------------------------------------
+  TaskGraph() : m_size(0) {}
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief addTask      Adds a task to the graph
+  /// @param[in] _task    Function to run
+  /// @return             Id of the task used for the dependencies
+  // ---------------------------------------------------------------------------------------
+  unsigned int addTask(const std::function<void()> &_task);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief addDependency  Makes a task wait for another one to finish
+  /// @param[in] _before    Task that has to finish first
+  /// @param[in] _after     Task that depends on it
+  // ---------------------------------------------------------------------------------------
+  void addDependency(const unsigned int &_before, const unsigned int &_after);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief clear Removes all the tasks, keeps the allocated storage
+  // ---------------------------------------------------------------------------------------
+  void clear() { m_size = 0; m_dependencies.clear(); }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief size
+  /// @return Amount of tasks in the graph
+  // ---------------------------------------------------------------------------------------
+  unsigned int size() const { return m_size; }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief reserve          Allocates the storage of a graph up front, so that building and running graphs up to
+  ///                         the size doesn't allocate. The scheduler sizes its buffers to the reserved tasks.
+  /// @param[in] _tasks       Amount of tasks
+  /// @param[in] _dependencies Amount of dependencies
+  // ---------------------------------------------------------------------------------------
+  void reserve(const unsigned int &_tasks, const unsigned int &_dependencies);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief capacity
+  /// @return Amount of tasks the graph has storage for
+  // ---------------------------------------------------------------------------------------
+  unsigned int capacity() const { return m_tasks.capacity(); }
+
+private:
+  friend class TaskScheduler;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_size Amount of tasks in use, the vectors may hold more from earlier graphs
+  // ---------------------------------------------------------------------------------------
+  unsigned int m_size;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_tasks Functions of the tasks
+  // ---------------------------------------------------------------------------------------
+  std::vector<std::function<void()>> m_tasks;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief buildSuccessors Sorts the dependencies into the successor lists of the tasks, called before running
+  // ---------------------------------------------------------------------------------------
+  void buildSuccessors();
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_dependencies Dependencies in the order they were added, the task that has to finish first and
+  ///                       the task waiting for it
+  // ---------------------------------------------------------------------------------------
+  std::vector<std::pair<unsigned int, unsigned int>> m_dependencies;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_successorStart Start of the successors of each task in m_successors followed by their count
+  // ---------------------------------------------------------------------------------------
+  std::vector<unsigned int> m_successorStart;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_successors Tasks waiting for each task
+  // ---------------------------------------------------------------------------------------
+  std::vector<unsigned int> m_successors;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_predecessorCount Amount of tasks each task waits for
+  // ---------------------------------------------------------------------------------------
+  std::vector<unsigned int> m_predecessorCount;
+}; // end of TaskGraph
+
+// ---------------------------------------------------------------------------------------
+/// @class TaskScheduler
+/// @brief Pool of worker threads with a task deque each. A worker pushes the tasks it makes ready
+///        to its own deque and pops the newest one, so dependent work runs while its data is still
+///        in cache. Idle workers steal the oldest tasks from the other deques.
+// ---------------------------------------------------------------------------------------
+class TaskScheduler
+{
+public:
+  // ---------------------------------------------------------------------------------------
+  /// @brief TaskScheduler  Default ctor, starts the worker threads
+  /// @param[in] _threads   Amount of workers including the calling thread, 0 for the hardware concurrency
+  // ---------------------------------------------------------------------------------------
+  explicit TaskScheduler(const unsigned int &_threads = 0);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief ~TaskScheduler Default dtor, stops the worker threads
+  // ---------------------------------------------------------------------------------------
+  ~TaskScheduler();
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief run        Runs all the tasks of a graph, the calling thread works as one of the workers
+  ///                   and the call returns once every task has finished
+  /// @param[in] _graph Graph to run
+  // ---------------------------------------------------------------------------------------
+  void run(TaskGraph &_graph);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief getThreadCount
+  /// @return Amount of workers including the calling thread
+  // ---------------------------------------------------------------------------------------
+  unsigned int getThreadCount() const { return m_workers.size(); }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief getCurrentWorker
+  /// @return Id of the worker running the calling task, 0 outside of the tasks
+  // ---------------------------------------------------------------------------------------
+  static unsigned int getCurrentWorker();
+
+private:
+  // ---------------------------------------------------------------------------------------
+  /// @struct Worker
+  /// @brief Task deque of a single worker, a ring buffer that can hold every task of the graph
+  // ---------------------------------------------------------------------------------------
+  struct Worker
+  {
+    std::mutex lock;
+    std::vector<unsigned int> tasks;
+    unsigned int first;
+    unsigned int count;
+  };
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief workerLoop Main loop of the worker threads, waits for a graph and processes it
+  /// @param[in] _id    Id of the worker
+  // ---------------------------------------------------------------------------------------
+  void workerLoop(const unsigned int _id);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief process  Runs tasks until the whole graph has finished
+  /// @param[in] _id  Id of the worker
+  // ---------------------------------------------------------------------------------------
+  void process(const unsigned int &_id);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief pop          Takes the newest task of the worker's own deque
+  /// @param[in] _id      Id of the worker
+  /// @param[out] o_task  Task id
+  /// @return             True if a task was found
+  // ---------------------------------------------------------------------------------------
+  bool pop(const unsigned int &_id, unsigned int &o_task);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief steal        Takes the oldest task of another worker's deque
+  /// @param[in] _id      Id of the stealing worker
+  /// @param[out] o_task  Task id
+  /// @return             True if a task was found
+  // ---------------------------------------------------------------------------------------
+  bool steal(const unsigned int &_id, unsigned int &o_task);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief push     Adds a ready task to a worker's deque
+  /// @param[in] _id  Id of the worker
+  /// @param[in] _task Task id
+  // ---------------------------------------------------------------------------------------
+  void push(const unsigned int &_id, const unsigned int &_task);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_workers Deques of the workers, worker 0 is the thread calling run()
+  // ---------------------------------------------------------------------------------------
+  std::vector<std::unique_ptr<Worker>> m_workers;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_threads Worker threads 1..n
+  // ---------------------------------------------------------------------------------------
+  std::vector<std::thread> m_threads;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_graph Graph currently being run
+  // ---------------------------------------------------------------------------------------
+  TaskGraph *m_graph;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_pending Amount of unfinished predecessors of each task
+  // ---------------------------------------------------------------------------------------
+  std::unique_ptr<std::atomic<unsigned int>[]> m_pending;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_pendingCapacity Size of m_pending
+  // ---------------------------------------------------------------------------------------
+  unsigned int m_pendingCapacity;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_remaining Amount of unfinished tasks in the graph
+  // ---------------------------------------------------------------------------------------
+  std::atomic<unsigned int> m_remaining;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_active Amount of worker threads currently processing the graph
+  // ---------------------------------------------------------------------------------------
+  std::atomic<unsigned int> m_active;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_lock/m_wake Used to put the idle workers to sleep between graphs
+  // ---------------------------------------------------------------------------------------
+  std::mutex m_lock;
+  std::condition_variable m_wake;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_generation Incremented for every run() so the workers know there's a new graph
+  // ---------------------------------------------------------------------------------------
+  unsigned long m_generation;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_quit Tells the workers to exit
+  // ---------------------------------------------------------------------------------------
+  bool m_quit;
+}; // end of TaskScheduler
+
+#endif
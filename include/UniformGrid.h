@@ -0,0 +1,93 @@
+#ifndef UNIFORMGRID_H
+#define UNIFORMGRID_H
+
+#include <unordered_map>
+#include "NNS.h"
+
+/// @file UniformGrid.h
+/// @brief Nearest neighbor searching using a uniform grid where the grid size is based on the particle diameter
+/// @author Teemu Lindborg
+/// @version 1.0
+/// @date 17/03/2016 Commenting and tidying up
+/// Revision History :
+///   Started blocking out 08/02/2016
+///   Implemented the grid and nearest neighbor searching ...-17/03/2016
+///   Moved from NNS behind the neighbor search interface 18/10/2026
+///   Cells read in place by the neighbor search instead of copied 18/10/2026
+/// @todo Store the cells as one sorted array instead of a vector per cell
+
+// ---------------------------------------------------------------------------------------
+/// @class UniformGrid
+/// @brief Uniform grid implementation that stores the particle indices of every cell of the bounding box, the
+///        neighbors are searched from the cells up to two away. Particles outside of the bounding box aren't found.
+// ---------------------------------------------------------------------------------------
+class UniformGrid : public NNS
+{
+public:
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief UniformGrid Default ctor
+  //----------------------------------------------------------------------------------------------------------------------
+  UniformGrid() : m_maxParticlesPerCell(0) {}
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief ~UniformGrid Default dtor
+  //----------------------------------------------------------------------------------------------------------------------
+  ~UniformGrid();
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief getName
+  /// @return "grid"
+  //----------------------------------------------------------------------------------------------------------------------
+  const char *getName() const { return "grid"; }
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief buildGrid        Inserts the particles to the grid cells without building the neighbor tables
+  /// @param[in] _particles   Vector containing the particles
+  //----------------------------------------------------------------------------------------------------------------------
+  void buildGrid(const std::vector<Particle *> &_particles);
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief findNeighbors    Builds the neighbor table of a single particle, the grid must have been built
+  /// @param[in] _particles   Vector containing the particles
+  /// @param[in] _pid         Index of the particle
+  //----------------------------------------------------------------------------------------------------------------------
+  void findNeighbors(const std::vector<Particle *> &_particles, const unsigned int &_pid);
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief rangeQuery       Finds the particles within a radius of a point from the cells the radius overlaps
+  /// @param[in] _particles   Vector containing the particles
+  /// @param[in] _p           Centre of the query
+  /// @param[in] _radius      Radius of the query
+  /// @param[out] o_indices   Indices of the particles closer than the radius
+  //----------------------------------------------------------------------------------------------------------------------
+  void rangeQuery(const std::vector<Particle *> &_particles, const Vec3 &_p, const float &_radius, std::vector<unsigned int> &o_indices) const;
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief cleanTable Cleans the grid and neighbor tables
+  //----------------------------------------------------------------------------------------------------------------------
+  void cleanTable();
+
+protected:
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief initStructure Allocates the particle indices of every cell
+  //----------------------------------------------------------------------------------------------------------------------
+  void initStructure();
+
+private:
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief m_maxParticlesPerCell Maximum amount of particles per cell
+  //----------------------------------------------------------------------------------------------------------------------
+  unsigned int m_maxParticlesPerCell;
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief m_gridCellNumParticles Vector containing the amount of particles in each cell
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<unsigned int> m_gridCellNumParticles;
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief m_grid Map of the cell id to particle indices
+  //----------------------------------------------------------------------------------------------------------------------
+  std::unordered_map<unsigned int, std::vector<int>> m_grid;
+}; // end of UniformGrid
+
+#endif
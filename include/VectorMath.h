@@ -0,0 +1,255 @@
+#ifndef VECTORMATH_H
+#define VECTORMATH_H
+
+#include <cmath>
+
+/// @file VectorMath.h
+/// @brief Header-only vector types of the simulation core, templated on the scalar type so the core doesn't depend on
+///        a graphics library. The renderer converts them to its own types when uploading.
+/// @author Teemu Lindborg
+/// @version 1.0
+/// @date 18/10/2026 Initial version
+/// Revision History :
+///   Aligned vec3/vec4, fused operations and a structure of arrays batch 18/10/2026
+/// @todo Explicit intrinsics for the batch operations if the compiler doesn't vectorise them
+
+// ---------------------------------------------------------------------------------------
+/// @struct TVec3
+/// @brief 3D vector padded to four lanes and aligned to 16 bytes so that a vector is a single SIMD load. The
+///        componentwise operations run over all four lanes which lets the compiler emit one packed instruction,
+///        the padding lane is zero on construction and never read by the reductions (dot, length etc).
+///        The component order and rounding of every operation is the plain scalar one, results don't change
+///        with the vectorisation.
+// ---------------------------------------------------------------------------------------
+template <typename T>
+struct alignas(16) TVec3
+{
+  // ---------------------------------------------------------------------------------------
+  /// @brief TVec3  Default ctor
+  /// @param[in] _x x-component
+  /// @param[in] _y y-component
+  /// @param[in] _z z-component
+  // ---------------------------------------------------------------------------------------
+  TVec3(const T &_x = T(0), const T &_y = T(0), const T &_z = T(0)) : m_x(_x), m_y(_y), m_z(_z), m_pad(T(0)) {}
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief set    Sets the components
+  /// @param[in] _x x-component
+  /// @param[in] _y y-component
+  /// @param[in] _z z-component
+  // ---------------------------------------------------------------------------------------
+  void set(const T &_x, const T &_y, const T &_z) { m_x = _x; m_y = _y; m_z = _z; }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief dot      Dot product
+  /// @param[in] _rhs Other vector
+  // ---------------------------------------------------------------------------------------
+  T dot(const TVec3 &_rhs) const { return m_x*_rhs.m_x + m_y*_rhs.m_y + m_z*_rhs.m_z; }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief lengthSquared Squared length, no square root needed
+  // ---------------------------------------------------------------------------------------
+  T lengthSquared() const { return dot(*this); }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief length Length of the vector
+  // ---------------------------------------------------------------------------------------
+  T length() const { return std::sqrt(lengthSquared()); }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief normalize Scales the vector to unit length, a zero vector is left as it is
+  // ---------------------------------------------------------------------------------------
+  void normalize()
+  {
+    const T l = length();
+    if(l != T(0))
+    {
+      m_x /= l;
+      m_y /= l;
+      m_z /= l;
+    }
+  }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief cross    Cross product
+  /// @param[in] _rhs Right hand side of the product
+  // ---------------------------------------------------------------------------------------
+  TVec3 cross(const TVec3 &_rhs) const
+  {
+    return TVec3(m_y*_rhs.m_z - m_z*_rhs.m_y, m_z*_rhs.m_x - m_x*_rhs.m_z, m_x*_rhs.m_y - m_y*_rhs.m_x);
+  }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief cross  Sets the vector to the cross product of two vectors
+  /// @param[in] _a Left hand side of the product
+  /// @param[in] _b Right hand side of the product
+  // ---------------------------------------------------------------------------------------
+  void cross(const TVec3 &_a, const TVec3 &_b) { *this = _a.cross(_b); }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief addScaled  Fused this += _v * _s without a temporary vector
+  /// @param[in] _v     Vector to add
+  /// @param[in] _s     Scale of the vector
+  // ---------------------------------------------------------------------------------------
+  void addScaled(const TVec3 &_v, const T &_s)
+  {
+    m_x += _v.m_x*_s;
+    m_y += _v.m_y*_s;
+    m_z += _v.m_z*_s;
+    m_pad += _v.m_pad*_s;
+  }
+
+  TVec3 operator+(const TVec3 &_rhs) const { TVec3 r; r.m_x = m_x + _rhs.m_x; r.m_y = m_y + _rhs.m_y; r.m_z = m_z + _rhs.m_z; r.m_pad = m_pad + _rhs.m_pad; return r; }
+  TVec3 operator-(const TVec3 &_rhs) const { TVec3 r; r.m_x = m_x - _rhs.m_x; r.m_y = m_y - _rhs.m_y; r.m_z = m_z - _rhs.m_z; r.m_pad = m_pad - _rhs.m_pad; return r; }
+  TVec3 operator*(const TVec3 &_rhs) const { TVec3 r; r.m_x = m_x * _rhs.m_x; r.m_y = m_y * _rhs.m_y; r.m_z = m_z * _rhs.m_z; r.m_pad = m_pad * _rhs.m_pad; return r; }
+  TVec3 operator*(const T &_s) const { TVec3 r; r.m_x = m_x * _s; r.m_y = m_y * _s; r.m_z = m_z * _s; r.m_pad = m_pad * _s; return r; }
+  TVec3 operator/(const T &_s) const { return TVec3(m_x / _s, m_y / _s, m_z / _s); }
+  TVec3 operator-() const { TVec3 r; r.m_x = -m_x; r.m_y = -m_y; r.m_z = -m_z; r.m_pad = -m_pad; return r; }
+  void operator+=(const TVec3 &_rhs) { m_x += _rhs.m_x; m_y += _rhs.m_y; m_z += _rhs.m_z; m_pad += _rhs.m_pad; }
+  void operator-=(const TVec3 &_rhs) { m_x -= _rhs.m_x; m_y -= _rhs.m_y; m_z -= _rhs.m_z; m_pad -= _rhs.m_pad; }
+  void operator*=(const T &_s) { m_x *= _s; m_y *= _s; m_z *= _s; m_pad *= _s; }
+  bool operator==(const TVec3 &_rhs) const { return m_x == _rhs.m_x && m_y == _rhs.m_y && m_z == _rhs.m_z; }
+  bool operator!=(const TVec3 &_rhs) const { return !(*this == _rhs); }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_x, m_y, m_z Components of the vector
+  // ---------------------------------------------------------------------------------------
+  T m_x, m_y, m_z;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_pad Padding lane, only written by the componentwise operations
+  // ---------------------------------------------------------------------------------------
+  T m_pad;
+}; // end of TVec3
+
+template <typename T>
+inline TVec3<T> operator*(const T &_s, const TVec3<T> &_v) { return _v * _s; }
+
+// ---------------------------------------------------------------------------------------
+/// @brief madd Fused _a + _b * _s
+// ---------------------------------------------------------------------------------------
+template <typename T>
+inline TVec3<T> madd(const TVec3<T> &_a, const TVec3<T> &_b, const T &_s)
+{
+  TVec3<T> r = _a;
+  r.addScaled(_b, _s);
+  return r;
+}
+
+// ---------------------------------------------------------------------------------------
+/// @brief distanceSquared Squared distance between two points without the intermediate difference vector
+// ---------------------------------------------------------------------------------------
+template <typename T>
+inline T distanceSquared(const TVec3<T> &_a, const TVec3<T> &_b)
+{
+  const T x = _a.m_x - _b.m_x;
+  const T y = _a.m_y - _b.m_y;
+  const T z = _a.m_z - _b.m_z;
+  return x*x + y*y + z*z;
+}
+
+// ---------------------------------------------------------------------------------------
+/// @struct TVec4
+/// @brief 4D vector aligned to 16 bytes, used for the colours and homogeneous points
+// ---------------------------------------------------------------------------------------
+template <typename T>
+struct alignas(16) TVec4
+{
+  // ---------------------------------------------------------------------------------------
+  /// @brief TVec4  Default ctor
+  /// @param[in] _x x-component
+  /// @param[in] _y y-component
+  /// @param[in] _z z-component
+  /// @param[in] _w w-component
+  // ---------------------------------------------------------------------------------------
+  TVec4(const T &_x = T(0), const T &_y = T(0), const T &_z = T(0), const T &_w = T(1)) : m_x(_x), m_y(_y), m_z(_z), m_w(_w) {}
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief TVec4  Ctor from a 3D vector
+  /// @param[in] _v xyz-components
+  /// @param[in] _w w-component
+  // ---------------------------------------------------------------------------------------
+  TVec4(const TVec3<T> &_v, const T &_w = T(1)) : m_x(_v.m_x), m_y(_v.m_y), m_z(_v.m_z), m_w(_w) {}
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief set    Sets the components
+  /// @param[in] _x x-component
+  /// @param[in] _y y-component
+  /// @param[in] _z z-component
+  /// @param[in] _w w-component
+  // ---------------------------------------------------------------------------------------
+  void set(const T &_x, const T &_y, const T &_z, const T &_w = T(1)) { m_x = _x; m_y = _y; m_z = _z; m_w = _w; }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief toVec3 The xyz-components
+  // ---------------------------------------------------------------------------------------
+  TVec3<T> toVec3() const { return TVec3<T>(m_x, m_y, m_z); }
+
+  TVec4 operator+(const TVec4 &_rhs) const { return TVec4(m_x + _rhs.m_x, m_y + _rhs.m_y, m_z + _rhs.m_z, m_w + _rhs.m_w); }
+  TVec4 operator-(const TVec4 &_rhs) const { return TVec4(m_x - _rhs.m_x, m_y - _rhs.m_y, m_z - _rhs.m_z, m_w - _rhs.m_w); }
+  TVec4 operator*(const T &_s) const { return TVec4(m_x * _s, m_y * _s, m_z * _s, m_w * _s); }
+  bool operator==(const TVec4 &_rhs) const { return m_x == _rhs.m_x && m_y == _rhs.m_y && m_z == _rhs.m_z && m_w == _rhs.m_w; }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_x, m_y, m_z, m_w Components of the vector
+  // ---------------------------------------------------------------------------------------
+  T m_x, m_y, m_z, m_w;
+}; // end of TVec4
+
+template <typename T>
+inline TVec4<T> operator*(const T &_s, const TVec4<T> &_v) { return _v * _s; }
+
+// ---------------------------------------------------------------------------------------
+/// @struct TVec3Batch
+/// @brief Structure of arrays of N 3D vectors. The lanes of each component are contiguous and cache line aligned
+///        so the loops over a batch vectorise across the vectors instead of within one.
+// ---------------------------------------------------------------------------------------
+template <typename T, unsigned int N>
+struct TVec3Batch
+{
+  // ---------------------------------------------------------------------------------------
+  /// @brief size Amount of vectors in a batch
+  // ---------------------------------------------------------------------------------------
+  static constexpr unsigned int size = N;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief set    Writes a vector to a lane
+  /// @param[in] _i Lane
+  /// @param[in] _v Vector
+  // ---------------------------------------------------------------------------------------
+  void set(const unsigned int &_i, const TVec3<T> &_v) { m_x[_i] = _v.m_x; m_y[_i] = _v.m_y; m_z[_i] = _v.m_z; }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief get    Reads the vector of a lane
+  /// @param[in] _i Lane
+  // ---------------------------------------------------------------------------------------
+  TVec3<T> get(const unsigned int &_i) const { return TVec3<T>(m_x[_i], m_y[_i], m_z[_i]); }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief lengthSquared  Squared lengths of the first _count lanes
+  /// @param[in] _count     Amount of lanes
+  /// @param[out] o_r2      Squared length of each lane
+  // ---------------------------------------------------------------------------------------
+  void lengthSquared(const unsigned int &_count, T *o_r2) const
+  {
+    for(unsigned int i = 0; i < _count; ++i)
+      o_r2[i] = m_x[i]*m_x[i] + m_y[i]*m_y[i] + m_z[i]*m_z[i];
+  }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_x, m_y, m_z Components of the vectors
+  // ---------------------------------------------------------------------------------------
+  alignas(64) T m_x[N];
+  alignas(64) T m_y[N];
+  alignas(64) T m_z[N];
+}; // end of TVec3Batch
+
+// ---------------------------------------------------------------------------------------
+/// @brief Scalar types of the simulation core
+// ---------------------------------------------------------------------------------------
+typedef TVec3<float> Vec3;
+typedef TVec4<float> Vec4;
+typedef TVec3<int> Vec3i;
+typedef TVec3<double> Vec3d;
+
+#endif
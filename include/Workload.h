@@ -0,0 +1,187 @@
+#ifndef WORKLOAD_H
+#define WORKLOAD_H
+
+#include <ostream>
+#include <string>
+#include <vector>
+#include "BoundingBox.h"
+#include "Particle.h"
+
+/// @file Workload.h
+/// @brief Particle states of reference scenes captured at chosen steps, so that the benchmarks of the neighbor
+///        search and the solver run on the same mid-splash inputs on every machine and code version
+/// @author Teemu Lindborg
+/// @version 1.0
+/// @date 18/10/2026 Initial version
+/// Revision History :
+///   Versioned workload files with optional neighbor lists 18/10/2026
+/// @todo Compress the files, the positions of a splash are far from random
+
+// ---------------------------------------------------------------------------------------
+/// @class Workload
+/// @brief A captured step of a scene. The file starts with a header (magic, version, flags, particle count, step,
+///        scene name and bounding box) followed by the id, position, velocity, external forces, mass, radius,
+///        density and lambda of each particle in the order of the storage, so that a replay also has the memory
+///        layout of the capture. The flags tell whether the wave machine was running and whether the neighbors were
+///        recorded, in which case the neighbor count of each particle follows and then the neighbor lists, sorted
+///        by particle index, as they were found for the stored positions.
+// ---------------------------------------------------------------------------------------
+class Workload
+{
+public:
+  // ---------------------------------------------------------------------------------------
+  /// @brief Workload Default ctor, an empty workload
+  // ---------------------------------------------------------------------------------------
+  Workload();
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief capture        Copies the state of a running system
+  /// @param[in] _scene     Name of the scene, at most 31 characters are stored
+  /// @param[in] _step      Step the state is after
+  /// @param[in] _bb        Bounding box of the scene
+  /// @param[in] _waves     Whether the wave machine is running
+  /// @param[in] _particles Particles of the system
+  /// @param[in] _count     Amount of particles to copy, the ghosts of a distributed run are left out
+  // ---------------------------------------------------------------------------------------
+  void capture(const std::string &_scene, const unsigned int &_step, const BoundingBox &_bb, const bool &_waves,
+               const std::vector<Particle *> &_particles, const unsigned int &_count);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief computeNeighbors   Records the neighbors of the particles at their current positions
+  /// @param[in] _nns           Name of the neighbor search to find them with, see NNS::create()
+  /// @param[in] _maxNeighbors  Maximum amount of neighbors per particle
+  /// @return                   False if the neighbor search doesn't exist
+  // ---------------------------------------------------------------------------------------
+  bool computeNeighbors(const std::string &_nns = "grid", const unsigned int &_maxNeighbors = 150);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief write          Writes the workload to a file
+  /// @param[in] _fileName  Workload file
+  /// @return               True if the file was written
+  // ---------------------------------------------------------------------------------------
+  bool write(const std::string &_fileName) const;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief read           Reads a workload file
+  /// @param[in] _fileName  Workload file
+  /// @param[out] o_report  Stream the reason is written to if the file can't be read
+  /// @return               True if the file was read, the workload is left empty otherwise
+  // ---------------------------------------------------------------------------------------
+  bool read(const std::string &_fileName, std::ostream &o_report);
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief restore        Creates the particles of the workload like Seeder::seed() does
+  /// @param[out] o_storage Storage of the particles, replaced
+  /// @param[in] _first     Index of the first particle to create, the rank of a distributed run
+  /// @param[in] _stride    Every stride-th particle from the first is created, the amount of ranks
+  /// @return               Total amount of particles over all the ranks
+  // ---------------------------------------------------------------------------------------
+  unsigned int restore(ParticleBuffer &o_storage, const unsigned int &_first = 0, const unsigned int &_stride = 1) const;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief getScene
+  /// @return Name of the scene
+  // ---------------------------------------------------------------------------------------
+  const std::string &getScene() const { return m_scene; }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief getStep
+  /// @return Step the state is after
+  // ---------------------------------------------------------------------------------------
+  unsigned int getStep() const { return m_step; }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief getBounds
+  /// @return Bounding box of the scene
+  // ---------------------------------------------------------------------------------------
+  const BoundingBox &getBounds() const { return m_bb; }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief getWaves
+  /// @return True if the wave machine was running, the max x wall of the bounds is where it had moved
+  // ---------------------------------------------------------------------------------------
+  bool getWaves() const { return m_waves; }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief setBounds  Changes the bounding box, e.g. after moving the particles
+  /// @param[in] _bb    Bounding box
+  // ---------------------------------------------------------------------------------------
+  void setBounds(const BoundingBox &_bb) { m_bb = _bb; }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief getParticles
+  /// @return Particles in the order of the capture, changing them leaves the recorded neighbors stale
+  // ---------------------------------------------------------------------------------------
+  std::vector<Particle> &getParticles() { return m_particles; }
+  const std::vector<Particle> &getParticles() const { return m_particles; }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief hasNeighbors
+  /// @return True if the neighbor lists were recorded
+  // ---------------------------------------------------------------------------------------
+  bool hasNeighbors() const { return !m_neighborOffsets.empty(); }
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief getNeighbors Recorded neighbors of a particle
+  /// @param[in] _i       Index of the particle
+  /// @return             Pointer to the sorted neighbor list and the amount of neighbors
+  // ---------------------------------------------------------------------------------------
+  std::pair<const unsigned int *, unsigned int> getNeighbors(const unsigned int &_i) const
+  {
+    return std::make_pair(m_neighbors.data() + m_neighborOffsets[_i], m_neighborOffsets[_i + 1] - m_neighborOffsets[_i]);
+  }
+
+private:
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_version Version of the file format
+  // ---------------------------------------------------------------------------------------
+  static const unsigned int m_version = 1;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_recordSize Amount of floats stored per particle after its id
+  // ---------------------------------------------------------------------------------------
+  static const unsigned int m_recordSize = 13;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_nameSize Bytes of the scene name in the header
+  // ---------------------------------------------------------------------------------------
+  static const unsigned int m_nameSize = 32;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_scene Name of the scene
+  // ---------------------------------------------------------------------------------------
+  std::string m_scene;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_step Step the state is after
+  // ---------------------------------------------------------------------------------------
+  unsigned int m_step;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_bb Bounding box of the scene
+  // ---------------------------------------------------------------------------------------
+  BoundingBox m_bb;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_waves Whether the wave machine was running
+  // ---------------------------------------------------------------------------------------
+  bool m_waves;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_particles Particles in the order of the capture
+  // ---------------------------------------------------------------------------------------
+  std::vector<Particle> m_particles;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_neighborOffsets Start of the neighbors of each particle in m_neighbors followed by their count, empty
+  ///                          if the neighbors weren't recorded
+  // ---------------------------------------------------------------------------------------
+  std::vector<unsigned int> m_neighborOffsets;
+
+  // ---------------------------------------------------------------------------------------
+  /// @brief m_neighbors Neighbor lists of all the particles
+  // ---------------------------------------------------------------------------------------
+  std::vector<unsigned int> m_neighbors;
+}; // end of Workload
+
+#endif
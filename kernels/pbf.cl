@@ -0,0 +1,324 @@
+// Position based fluids step for the OpenCL backend, the kernels mirror FluidSolver and NNS.
+// The particle state is kept in flat structure of arrays buffers, vectors are float4 with w = 0.
+// The solver constants are given as build options by OpenCLBackend:
+//   H, H2, POLY6, SPIKY, INV_REST_DENSITY, INV_FIXED_WEIGHT, K, N, EPSILON, XSPH_C, VORTICITY_SCALE,
+//   FIXED_RADIUS2, MAX_NEIGHBORS
+
+// Keep the rounding of the cpu path, no fused multiply-adds
+#pragma OPENCL FP_CONTRACT OFF
+
+//----------------------------------------------------------------------------------------------------------------------
+float poly6(const float r2)
+{
+  const float tmp = H2 - r2;
+  return r2 > H2 ? 0.f : POLY6 * tmp*tmp*tmp;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+float4 spikyGradient(const float4 v, const float r2)
+{
+  // constant * (h - r)^2 * v / r, coincident particles have no direction to push each other in
+  if(r2 > H2 || r2 == 0.f)
+    return (float4)(0.f);
+  const float invR = rsqrt(r2);
+  const float tmp = H - r2 * invR;
+  return (SPIKY * tmp*tmp * invR) * v;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+float artificialPressure(const float r2)
+{
+  const float tmp = poly6(r2) * INV_FIXED_WEIGHT;
+  float scorr = tmp;
+  for(int i = 1; i < N; ++i)
+    scorr *= tmp;
+  return -K * scorr;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+int getCell(const int x, const int y, const int z, const int cellsX, const int cellsY, const int cellsZ)
+{
+  if(x < 0 || x >= cellsX || y < 0 || y >= cellsY || z < 0 || z >= cellsZ)
+    return -1;
+  return x + y*cellsX + z*cellsX*cellsY;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+__kernel void predict(__global const float4 *pos, __global float4 *predPos, __global float4 *vel,
+                      __global float4 *extForces, __global float4 *posUpdate,
+                      const float4 gravity, const float timeStep, const uint count)
+{
+  const uint i = get_global_id(0);
+  if(i >= count)
+    return;
+
+  // Add the gravity and external forces to the velocity and predict the new position
+  const float4 v = vel[i] + (gravity*timeStep + extForces[i]*timeStep);
+  vel[i] = v;
+  predPos[i] = pos[i] + timeStep*v;
+  extForces[i] = (float4)(0.f);
+  posUpdate[i] = (float4)(0.f);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+__kernel void computeCellKeys(__global const float4 *pos, __global ulong *keys,
+                              const float4 gridMin, const float4 cellSize,
+                              const int cellsX, const int cellsY, const int cellsZ,
+                              const uint count, const uint paddedCount)
+{
+  const uint i = get_global_id(0);
+  if(i >= paddedCount)
+    return;
+
+  // Sort key is the cell in the high and the particle index in the low bits, so the particles of a cell stay in
+  // index order like in the cpu grid. Particles outside of the grid go to an extra cell that's never searched
+  // and the padding of the sort goes after everything
+  if(i >= count)
+  {
+    keys[i] = ULONG_MAX;
+    return;
+  }
+  const float4 p = pos[i];
+  int cell = getCell((int)((p.x - gridMin.x) / cellSize.x), (int)((p.y - gridMin.y) / cellSize.y),
+                     (int)((p.z - gridMin.z) / cellSize.z), cellsX, cellsY, cellsZ);
+  if(cell == -1)
+    cell = cellsX * cellsY * cellsZ;
+  keys[i] = ((ulong)cell << 32) | i;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+__kernel void bitonicSort(__global ulong *keys, const uint j, const uint k)
+{
+  // One compare-exchange pass of a bitonic sort over a power of two sized array
+  const uint i = get_global_id(0);
+  const uint ixj = i ^ j;
+  if(ixj <= i)
+    return;
+
+  const ulong a = keys[i];
+  const ulong b = keys[ixj];
+  const bool ascending = (i & k) == 0;
+  if((a > b) == ascending)
+  {
+    keys[i] = b;
+    keys[ixj] = a;
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+__kernel void clearCellRanges(__global uint *cellStart, __global uint *cellEnd, const uint cellCount)
+{
+  const uint i = get_global_id(0);
+  if(i >= cellCount)
+    return;
+  cellStart[i] = 0;
+  cellEnd[i] = 0;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+__kernel void findCellRanges(__global const ulong *keys, __global uint *cellStart, __global uint *cellEnd, const uint count)
+{
+  // The particles of a cell are consecutive in the sorted keys, the first and last of each cell write the range
+  const uint i = get_global_id(0);
+  if(i >= count)
+    return;
+
+  const uint cell = (uint)(keys[i] >> 32);
+  if(i == 0 || cell != (uint)(keys[i - 1] >> 32))
+    cellStart[cell] = i;
+  if(i == count - 1 || cell != (uint)(keys[i + 1] >> 32))
+    cellEnd[cell] = i + 1;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+__kernel void findNeighbors(__global const float4 *pos, __global const ulong *keys,
+                            __global const uint *cellStart, __global const uint *cellEnd,
+                            __global uint *neighbors, __global uint *numNeighbors,
+                            const float4 gridMin, const float4 cellSize,
+                            const int cellsX, const int cellsY, const int cellsZ, const uint count)
+{
+  const uint i = get_global_id(0);
+  if(i >= count)
+    return;
+
+  // Same search order and radius as NNS::findNeighbors using the positions from the start of the step
+  const int offsets[5] = {0, 1, -1, 2, -2};
+  const float4 p = pos[i];
+  const int x = (int)((p.x - gridMin.x) / cellSize.x);
+  const int y = (int)((p.y - gridMin.y) / cellSize.y);
+  const int z = (int)((p.z - gridMin.z) / cellSize.z);
+  __global uint *list = neighbors + (size_t)i * MAX_NEIGHBORS;
+  uint found = 0;
+
+  for(int a = 0; a < 5; ++a)
+  {
+    for(int b = 0; b < 5; ++b)
+    {
+      for(int c = 0; c < 5; ++c)
+      {
+        const int cell = getCell(x + offsets[a], y + offsets[b], z + offsets[c], cellsX, cellsY, cellsZ);
+        if(cell == -1)
+          continue;
+        for(uint s = cellStart[cell]; s < cellEnd[cell] && found < MAX_NEIGHBORS; ++s)
+        {
+          const uint n = (uint)keys[s];
+          if(n == i)
+            continue;
+          const float4 d = p - pos[n];
+          if(dot(d, d) < FIXED_RADIUS2)
+            list[found++] = n;
+        }
+      }
+    }
+  }
+  numNeighbors[i] = found;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+__kernel void computeLambda(__global const float4 *predPos, __global const float *mass,
+                            __global const uint *neighbors, __global const uint *numNeighbors,
+                            __global float *density, __global float *lambda, const uint count)
+{
+  const uint i = get_global_id(0);
+  if(i >= count)
+    return;
+
+  // Formulas 2, 8 & 11, the density and the constraint gradient terms in the same pass
+  const float4 p = predPos[i];
+  __global const uint *list = neighbors + (size_t)i * MAX_NEIGHBORS;
+  float rho = 0.f;
+  float sumGradientLengthSquared = 0.f;
+  float4 grad_pi_Ci = (float4)(0.f);
+  for(uint n = 0; n < numNeighbors[i]; ++n)
+  {
+    const uint j = list[n];
+    const float4 v = p - predPos[j];
+    const float r2 = dot(v, v);
+    if(r2 > H2)
+      continue;
+
+    rho += mass[j] * poly6(r2);
+    float4 gradient = mass[j] * spikyGradient(v, r2);
+    gradient *= INV_REST_DENSITY;
+    sumGradientLengthSquared += dot(gradient, gradient);
+    grad_pi_Ci += gradient;
+  }
+  density[i] = rho;
+
+  const float c = rho*INV_REST_DENSITY - 1.f;
+  if(c > 0.f)
+  {
+    sumGradientLengthSquared += dot(grad_pi_Ci, grad_pi_Ci);
+    lambda[i] = -c / (sumGradientLengthSquared + EPSILON);
+  }
+  else
+  {
+    lambda[i] = 0.f;
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+__kernel void computePositionUpdate(__global const float4 *predPos, __global const float *lambda,
+                                    __global const uint *neighbors, __global const uint *numNeighbors,
+                                    __global float4 *posUpdate, const float relaxation, const uint count)
+{
+  const uint i = get_global_id(0);
+  if(i >= count)
+    return;
+
+  // Formula 14 with the artificial pressure
+  const float4 p = predPos[i];
+  const float lambdaI = lambda[i];
+  __global const uint *list = neighbors + (size_t)i * MAX_NEIGHBORS;
+  float4 update = (float4)(0.f);
+  for(uint n = 0; n < numNeighbors[i]; ++n)
+  {
+    const uint j = list[n];
+    const float4 v = p - predPos[j];
+    const float r2 = dot(v, v);
+    if(r2 > H2)
+      continue;
+    update += (lambdaI + lambda[j] + artificialPressure(r2)) * spikyGradient(v, r2);
+  }
+  posUpdate[i] = (relaxation * INV_REST_DENSITY) * update;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+__kernel void applyPositionUpdate(__global const float4 *pos, __global float4 *predPos, __global const float4 *posUpdate,
+                                  __global float4 *vel, __global const float *radius, __constant float4 *walls,
+                                  const int lastIteration, const float invTimeStep, const uint count)
+{
+  const uint i = get_global_id(0);
+  if(i >= count)
+    return;
+
+  // Walls are the plane normal in xyz and the distance term in w followed by the velocity of the wall,
+  // particles penetrating a wall are pushed back out and lose half of their velocity relative to the wall
+  float4 p = predPos[i] + posUpdate[i];
+  float4 v = vel[i];
+  for(int w = 0; w < 6; ++w)
+  {
+    const float4 normal = (float4)(walls[2*w].x, walls[2*w].y, walls[2*w].z, 0.f);
+    const float dist = p.x * normal.x + p.y * normal.y + p.z * normal.z + walls[2*w].w - radius[i];
+    if(dist < 0.f)
+    {
+      const float4 wallVel = walls[2*w + 1];
+      const float4 rel = v - wallVel;
+      const float vn = dot(rel, normal);
+      p = p - 2.f*dist*normal;
+      v = wallVel - 0.5f*(vn * normal + (rel - vn * normal));
+    }
+  }
+  predPos[i] = p;
+  vel[i] = lastIteration ? invTimeStep * (p - pos[i]) : v;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+__kernel void computeVorticity(__global const float4 *predPos, __global const float4 *vel, __global const float *density,
+                               __global const uint *neighbors, __global const uint *numNeighbors,
+                               __global float4 *extForces, __global float4 *posUpdate, const uint count)
+{
+  const uint i = get_global_id(0);
+  if(i >= count)
+    return;
+
+  // Formulas 15, 16 and 17, the viscosity goes to the position update until the neighbors have read the velocity
+  const float4 p = predPos[i];
+  const float4 velI = vel[i];
+  __global const uint *list = neighbors + (size_t)i * MAX_NEIGHBORS;
+  float4 vorticity = (float4)(0.f);
+  float4 gradVorticity = (float4)(0.f);
+  float4 xsphV = (float4)(0.f);
+  for(uint n = 0; n < numNeighbors[i]; ++n)
+  {
+    const uint j = list[n];
+    const float4 p_ij = p - predPos[j];
+    const float r2 = dot(p_ij, p_ij);
+    if(r2 > H2)
+      continue;
+    const float4 v_ij = vel[j] - velI;
+    const float4 gradient = spikyGradient(p_ij, r2);
+    vorticity += cross(v_ij, gradient);
+    gradVorticity += gradient;
+    if(density[j] != 0.f)
+      xsphV += v_ij * poly6(r2);
+  }
+  gradVorticity *= length(vorticity);
+
+  if(dot(gradVorticity, gradVorticity) != 0.f)
+    extForces[i] += cross(normalize(gradVorticity), vorticity) * VORTICITY_SCALE;
+  posUpdate[i] = XSPH_C * xsphV;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+__kernel void finalize(__global float4 *pos, __global const float4 *predPos, __global float4 *vel,
+                       __global const float4 *posUpdate, const uint count)
+{
+  const uint i = get_global_id(0);
+  if(i >= count)
+    return;
+
+  // Apply the viscosity and move the particle to the predicted position
+  vel[i] += posUpdate[i];
+  pos[i] = predPos[i];
+}
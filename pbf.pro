@@ -20,18 +20,75 @@ SOURCES +=  $$PWD/src/main.cpp \
             $$PWD/src/NGLScene.cpp \
             $$PWD/src/FluidSystem.cpp \
             $$PWD/src/FluidSolver.cpp \
-            $$PWD/src/NNS.cpp
+            $$PWD/src/NNS.cpp \
+            $$PWD/src/UniformGrid.cpp \
+            $$PWD/src/HashGrid.cpp \
+            $$PWD/src/LinearOctree.cpp \
+            $$PWD/src/KdTree.cpp \
+            $$PWD/src/Domain.cpp \
+            $$PWD/src/Numa.cpp \
+            $$PWD/src/TaskScheduler.cpp \
+            $$PWD/src/Profiler.cpp \
+            $$PWD/src/PerfCounters.cpp \
+            $$PWD/src/GoldenState.cpp \
+            $$PWD/src/Workload.cpp \
+            $$PWD/src/AllocationCounter.cpp \
+            $$PWD/src/CpuBackend.cpp \
+            $$PWD/src/OpenCLBackend.cpp \
+            $$PWD/src/SurfaceMesher.cpp \
+            $$PWD/src/Seeder.cpp \
+            $$PWD/src/ParticleOrder.cpp \
+            $$PWD/src/Ensemble.cpp \
+            $$PWD/src/MetricsFeed.cpp \
+            $$PWD/src/FrameFeed.cpp \
+            $$PWD/src/MultilevelSolver.cpp
 # same for the .h files
 HEADERS +=  $$PWD/include/NGLScene.h \
             $$PWD/include/Particle.h \
             $$PWD/include/FluidSystem.h \
             $$PWD/include/FluidSolver.h \
             $$PWD/include/NNS.h \
-            $$PWD/include/BoundingBox.h
+            $$PWD/include/UniformGrid.h \
+            $$PWD/include/HashGrid.h \
+            $$PWD/include/LinearOctree.h \
+            $$PWD/include/KdTree.h \
+            $$PWD/include/BoundingBox.h \
+            $$PWD/include/Domain.h \
+            $$PWD/include/Numa.h \
+            $$PWD/include/TaskScheduler.h \
+            $$PWD/include/Profiler.h \
+            $$PWD/include/PerfCounters.h \
+            $$PWD/include/GoldenState.h \
+            $$PWD/include/Workload.h \
+            $$PWD/include/AllocationCounter.h \
+            $$PWD/include/ComputeBackend.h \
+            $$PWD/include/CpuBackend.h \
+            $$PWD/include/OpenCLBackend.h \
+            $$PWD/include/SurfaceMesher.h \
+            $$PWD/include/VectorMath.h \
+            $$PWD/include/Seeder.h \
+            $$PWD/include/ParticleOrder.h \
+            $$PWD/include/Ensemble.h \
+            $$PWD/include/MetricsFeed.h \
+            $$PWD/include/FrameFeed.h \
+            $$PWD/include/MultilevelSolver.h
 # and add the include dir into the search path for Qt and make
 INCLUDEPATH += ./include
-#QMAKE_CXXFLAGS += -fopenmp
-#QMAKE_LFLAGS += -fopenmp
+QMAKE_CXXFLAGS += -fopenmp
+QMAKE_LFLAGS += -fopenmp
+# POSIX shared memory of the metrics feed
+unix:!macx:LIBS += -lrt
+# stage timings in the HUD and trace capture, comment out to compile the profiling scopes out
+DEFINES += PBF_PROFILE
+# uncomment to record hardware counters (perf_event_open, Linux) in the profiling scopes
+#DEFINES += PBF_PERF_COUNTERS
+# uncomment to build the distributed mode (mpirun -np 4 ./pbf --distributed 500)
+#DEFINES += PBF_USE_MPI
+#QMAKE_CXX = mpicxx
+#QMAKE_LINK = mpicxx
+# uncomment to build the OpenCL backend (./pbf --backend opencl), POCL runs it on the cpu
+#DEFINES += PBF_USE_OPENCL
+#LIBS += -lOpenCL
 
 # where our exe is going to live (root of project)
 DESTDIR=./
@@ -39,7 +96,8 @@ DESTDIR=./
 OTHER_FILES += README.md \
                shaders/*.glsl \
                shaders/*.vert \
-               shaders/*.frag
+               shaders/*.frag \
+               kernels/*.cl
 # were are going to default to a console app
 CONFIG += console
 # note each command you add needs a ; as it will be run as a single line
@@ -48,9 +106,11 @@ CONFIG += console
 	copydata.commands = echo "creating destination dirs" ;
 	# now make a dir
 	copydata.commands += mkdir -p $$OUT_PWD/shaders ;
+	copydata.commands += mkdir -p $$OUT_PWD/kernels ;
 	copydata.commands += echo "copying files" ;
 	# then copy the files
 	copydata.commands += $(COPY_DIR) $$PWD/shaders/* $$OUT_PWD/shaders/ ;
+	copydata.commands += $(COPY_DIR) $$PWD/kernels/* $$OUT_PWD/kernels/ ;
 	# now make sure the first target is built before copy
 	first.depends = $(first) copydata
 	export(first.depends)
@@ -0,0 +1,85 @@
+#version 410 core
+
+// Attributes passed on from the vertex shader
+flat in vec3 o_Centre;
+flat in float o_Radius;
+flat in vec4 o_Color;
+flat in int o_Impostor;
+
+// Structure for holding light parameters
+struct LightInfo {
+    vec4 Position; // Light position in eye coords.
+    vec3 La; // Ambient light intensity
+    vec3 Ld; // Diffuse light intensity
+    vec3 Ls; // Specular light intensity
+};
+
+uniform LightInfo u_Light;
+uniform LightInfo u_BackLight;
+
+// The material properties of our object
+struct MaterialInfo {
+    vec3 Ka; // Ambient reflectivity
+    vec3 Kd; // Diffuse reflectivity
+    vec3 Ks; // Specular reflectivity
+    float Shininess; // Specular shininess factor
+};
+uniform MaterialInfo u_Material;
+
+uniform mat4 u_Projection;
+// Size of the viewport in pixels
+uniform vec2 u_Viewport;
+
+out vec4 o_FragColor;
+
+// Phong shading from both of the lights, same as shaders/simple.frag
+vec3 shade(vec3 _position, vec3 _n)
+{
+    vec3 s = normalize( vec3(u_Light.Position) - _position );
+    vec3 s2 = normalize( vec3(u_BackLight.Position) - _position );
+    vec3 v = normalize( -_position );
+    vec3 r = reflect( -s, _n );
+    vec3 r2 = reflect( -s2, _n );
+
+    vec3 lightColor = (
+            u_Light.La * u_Material.Ka +
+            u_Light.Ld * o_Color.rgb * max( dot(s, _n), 0.0 ) +
+            u_Light.Ls * u_Material.Ks * pow( max( dot(r,v), 0.0 ), u_Material.Shininess ));
+
+    lightColor += (
+            u_BackLight.La * u_Material.Ka +
+            u_BackLight.Ld * o_Color.rgb * max( dot(s2, _n), 0.0 ) +
+            u_BackLight.Ls * u_Material.Ks * pow( max( dot(r2,v), 0.0 ), u_Material.Shininess ));
+    return lightColor;
+}
+
+void main() {
+    if(o_Impostor == 0)
+    {
+        // Far away particles are flat discs facing the camera at the depth of the sprite
+        vec2 d = gl_PointCoord * 2.0 - 1.0;
+        if(dot(d, d) > 1.0)
+            discard;
+        gl_FragDepth = gl_FragCoord.z;
+        o_FragColor = vec4(shade(o_Centre, vec3(0.0, 0.0, 1.0)), 1.0);
+        return;
+    }
+
+    // Eye space direction of the view ray through the pixel, the projection is a symmetric perspective
+    vec2 ndc = gl_FragCoord.xy / u_Viewport * 2.0 - 1.0;
+    vec3 dir = normalize(vec3(ndc.x / u_Projection[0][0], ndc.y / u_Projection[1][1], -1.0));
+
+    // Intersect the ray from the eye with the sphere, the pixels the sphere doesn't cover are discarded
+    float b = dot(dir, o_Centre);
+    float discriminant = b * b - dot(o_Centre, o_Centre) + o_Radius * o_Radius;
+    if(discriminant < 0.0)
+        discard;
+    vec3 position = (b - sqrt(discriminant)) * dir;
+    vec3 n = (position - o_Centre) / o_Radius;
+
+    // Write the depth of the hit point so the spheres intersect each other and the walls correctly
+    vec4 clip = u_Projection * vec4(position, 1.0);
+    gl_FragDepth = (clip.z / clip.w) * 0.5 * (gl_DepthRange.far - gl_DepthRange.near) + 0.5 * (gl_DepthRange.far + gl_DepthRange.near);
+
+    o_FragColor = vec4(shade(position, n), 1.0);
+}
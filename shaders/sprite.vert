@@ -0,0 +1,44 @@
+#version 410 core
+
+uniform mat4 u_MV;
+uniform mat4 u_Projection;
+// Height of the viewport in pixels
+uniform float u_ViewportHeight;
+// Particles further away from the camera than this are drawn as flat discs
+uniform float u_LodDistance;
+
+// Transfer function of the colour channel, the value is mapped linearly from the low to the high colour over the
+// range and clamped outside of it
+uniform vec2 u_ColourRange;
+uniform vec3 u_ColourLow;
+uniform vec3 u_ColourHigh;
+
+// Centre and radius of the particle, and the value of the colour channel
+layout(location = 0) in vec4 a_PosRadius;
+layout(location = 1) in float a_Value;
+
+flat out vec3 o_Centre;
+flat out float o_Radius;
+flat out vec4 o_Color;
+flat out int o_Impostor;
+
+void main()
+{
+    // Centre of the sphere in eye coordinates
+    vec4 centre = u_MV * vec4(a_PosRadius.xyz, 1.0);
+    o_Centre = centre.xyz;
+    o_Radius = a_PosRadius.w;
+    float t = clamp((a_Value - u_ColourRange.x) / (u_ColourRange.y - u_ColourRange.x), 0.0, 1.0);
+    o_Color = vec4(mix(u_ColourLow, u_ColourHigh, t), 1.0);
+
+    float distance2 = dot(centre.xyz, centre.xyz);
+    o_Impostor = distance2 < u_LodDistance * u_LodDistance ? 1 : 0;
+
+    // The sprite covers the silhouette of the sphere, the tangent of the silhouette cone
+    // is r / sqrt(d^2 - r^2) which is slightly more than r / d for close particles
+    float tangent = o_Radius * inversesqrt(max(distance2 - o_Radius * o_Radius, 1e-6));
+    float eyeDistance = sqrt(distance2);
+    gl_PointSize = max(u_Projection[1][1] * tangent * eyeDistance / -centre.z * u_ViewportHeight, 1.0);
+
+    gl_Position = u_Projection * centre;
+}
@@ -0,0 +1,122 @@
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include "AllocationCounter.h"
+
+namespace
+{
+  // Plain globals so that they're initialised before any allocation of a static constructor
+  std::atomic<unsigned long long> g_allocations(0);
+  std::atomic<unsigned long long> g_bytes(0);
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief countedAlloc Allocates with malloc and counts the allocation
+  /// @param[in] _bytes   Size of the allocation
+  /// @return             Pointer to the memory, nullptr if it couldn't be allocated
+  //----------------------------------------------------------------------------------------------------------------------
+  inline void *countedAlloc(std::size_t _bytes)
+  {
+    AllocationCounter::record(_bytes);
+    return std::malloc(_bytes ? _bytes : 1);
+  }
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief throwingAlloc  Allocates like countedAlloc(), calls the new handler until it succeeds or there's none
+  /// @param[in] _bytes     Size of the allocation
+  /// @return               Pointer to the memory, throws std::bad_alloc on failure
+  //----------------------------------------------------------------------------------------------------------------------
+  inline void *throwingAlloc(std::size_t _bytes)
+  {
+    void *p = countedAlloc(_bytes);
+    while(!p)
+    {
+      std::new_handler handler = std::get_new_handler();
+      if(!handler)
+        throw std::bad_alloc();
+      handler();
+      p = std::malloc(_bytes ? _bytes : 1);
+    }
+    return p;
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+unsigned long long AllocationCounter::getAllocations()
+{
+  return g_allocations.load(std::memory_order_relaxed);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+unsigned long long AllocationCounter::getBytes()
+{
+  return g_bytes.load(std::memory_order_relaxed);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void AllocationCounter::record(const std::size_t &_bytes)
+{
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  g_bytes.fetch_add(_bytes, std::memory_order_relaxed);
+}
+
+// Replacements of the global allocation functions, the deallocation functions have to be replaced as a pair
+//----------------------------------------------------------------------------------------------------------------------
+void *operator new(std::size_t _bytes)
+{
+  return throwingAlloc(_bytes);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void *operator new[](std::size_t _bytes)
+{
+  return throwingAlloc(_bytes);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void *operator new(std::size_t _bytes, const std::nothrow_t &) noexcept
+{
+  return countedAlloc(_bytes);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void *operator new[](std::size_t _bytes, const std::nothrow_t &) noexcept
+{
+  return countedAlloc(_bytes);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void operator delete(void *_ptr) noexcept
+{
+  std::free(_ptr);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void operator delete[](void *_ptr) noexcept
+{
+  std::free(_ptr);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void operator delete(void *_ptr, const std::nothrow_t &) noexcept
+{
+  std::free(_ptr);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void operator delete[](void *_ptr, const std::nothrow_t &) noexcept
+{
+  std::free(_ptr);
+}
+
+// The sized forms are called instead of the unsized ones from C++14 on
+//----------------------------------------------------------------------------------------------------------------------
+void operator delete(void *_ptr, std::size_t) noexcept
+{
+  std::free(_ptr);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void operator delete[](void *_ptr, std::size_t) noexcept
+{
+  std::free(_ptr);
+}
@@ -0,0 +1,295 @@
+#include <algorithm>
+#include "CpuBackend.h"
+#include "Profiler.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+CpuBackend::CpuBackend(FluidSolver &_solver, NNS &_nns) :
+  m_solver(_solver),
+  m_nns(_nns),
+  m_particles(nullptr),
+  m_count(0),
+  m_bb(nullptr)
+{
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void CpuBackend::beginStep(std::vector<Particle *> &io_particles, const unsigned int &_count, const BoundingBox &_bb)
+{
+  // The particles are simulated in place so there's nothing to upload
+  m_particles = &io_particles;
+  m_count = _count;
+  m_bb = &_bb;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void CpuBackend::predict(const float &_timeStep)
+{
+  std::vector<Particle *> &particles = *m_particles;
+
+  // Parallelising the predicted position and velocity calculations
+#pragma omp parallel
+  {
+    PBF_PROFILE_SCOPE("predict");
+#pragma omp for schedule(static) nowait
+    for(unsigned int i = 0; i < m_count; ++i)
+    {
+      m_solver.predictPos(particles[i], _timeStep);
+      particles[i]->m_posUpdate.set(0.f, 0.f, 0.f);
+    }
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void CpuBackend::buildGrid(const bool &_refit)
+{
+  if(_refit)
+    m_nns.update(*m_particles);
+  else
+    m_nns.buildGrid(*m_particles);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void CpuBackend::buildNeighbors()
+{
+  m_nns.buildNeighborTable(*m_particles);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void CpuBackend::computeLambda(const unsigned int &_iteration)
+{
+  std::vector<Particle *> &particles = *m_particles;
+
+  // Parallelise the lambda calculation
+#pragma omp parallel
+  {
+    PBF_PROFILE_SCOPE_INDEX("lambda", _iteration);
+#pragma omp for schedule(static) nowait
+    for(unsigned int i = 0; i < m_count; ++i)
+    {
+      // Get the neighbors for a particle from the computed table
+      std::pair<unsigned int *, unsigned int> neighbors = m_nns.getNeighbors(i);
+
+      // Calculate the density constraint
+      m_solver.computeLambda(particles, i, neighbors.first, neighbors.second);
+    }
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void CpuBackend::warmStart()
+{
+  std::vector<Particle *> &particles = *m_particles;
+
+  // The updates are computed from the lambdas of the previous step before any particle moves, the lambdas are
+  // part of the particles so they followed them through reordering and migration
+#pragma omp parallel
+  {
+    PBF_PROFILE_SCOPE("warm-start");
+#pragma omp for schedule(static)
+    for(unsigned int i = 0; i < m_count; ++i)
+    {
+      std::pair<unsigned int *, unsigned int> neighbors = m_nns.getNeighbors(i);
+      particles[i]->m_posUpdate = m_solver.calcPositionUpdate(particles, i, neighbors.first, neighbors.second);
+    }
+#pragma omp for schedule(static) nowait
+    for(unsigned int i = 0; i < m_count; ++i)
+    {
+      particles[i]->m_predPos += particles[i]->m_posUpdate;
+      m_solver.handleEnvCollisions(particles[i], *m_bb);
+    }
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool CpuBackend::projectLevels(MultilevelSolver &io_levels)
+{
+  io_levels.project(*m_particles, m_count, m_nns, m_solver, *m_bb);
+  return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void CpuBackend::computePositionUpdate(const unsigned int &_iteration)
+{
+  std::vector<Particle *> &particles = *m_particles;
+
+  // Parallelise the position update calculation, the collisions are handled when the update is
+  // applied so the predicted positions the neighbors read don't change during this loop
+#pragma omp parallel
+  {
+    PBF_PROFILE_SCOPE_INDEX("update", _iteration);
+#pragma omp for schedule(static) nowait
+    for(unsigned int i = 0; i < m_count; ++i)
+    {
+      // Get the neighbors for a particle from the computed table
+      std::pair<unsigned int *, unsigned int> neighbors = m_nns.getNeighbors(i);
+      particles[i]->m_posUpdate = m_solver.calcPositionUpdate(particles, i, neighbors.first, neighbors.second);
+    }
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void CpuBackend::applyPositionUpdate(const unsigned int &_iteration, const bool &_lastIteration, const float &_timeStep)
+{
+  std::vector<Particle *> &particles = *m_particles;
+  const float invTimeStep = 1.f/_timeStep;
+
+  // Add the position updates to the predicted positions and handle the environment collisions,
+  // the last iteration also calculates the new velocity based on the old position and the newly
+  // predicted position as the vorticity and viscosity need the velocities of the neighbors
+#pragma omp parallel
+  {
+    PBF_PROFILE_SCOPE_INDEX("collisions", _iteration);
+#pragma omp for schedule(static) nowait
+    for(unsigned int i = 0; i < m_count; ++i)
+    {
+      particles[i]->m_predPos += particles[i]->m_posUpdate;
+      m_solver.handleEnvCollisions(particles[i], *m_bb);
+      if(_lastIteration)
+        particles[i]->m_vel = invTimeStep * (particles[i]->m_predPos - particles[i]->m_pos);
+    }
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool CpuBackend::solveColoured(const unsigned int &_iteration, const bool &_lastIteration, const float &_timeStep)
+{
+  std::vector<Particle *> &particles = *m_particles;
+  const float invTimeStep = 1.f/_timeStep;
+  if(_iteration == 0)
+    colour();
+
+  // The colours are projected one after another, each particle computes its lambda from the current positions
+  // and moves right away so the particles after it already see the corrected position. The cells of a colour
+  // never read each other's particles so they're projected in parallel, the particles of a cell in order.
+  const unsigned int colours = m_colourOffsets.size() - 1;
+#pragma omp parallel
+  {
+    PBF_PROFILE_SCOPE_INDEX("gauss-seidel", _iteration);
+    for(unsigned int c = 0; c < colours; ++c)
+    {
+#pragma omp for schedule(static)
+      for(unsigned int n = m_colourOffsets[c]; n < m_colourOffsets[c + 1]; ++n)
+      {
+        const unsigned int cell = m_colourCells[n];
+        for(unsigned int k = m_cellOffsets[cell]; k < m_cellOffsets[cell + 1]; ++k)
+        {
+          const unsigned int i = m_cellParticles[k];
+          std::pair<unsigned int *, unsigned int> neighbors = m_nns.getNeighbors(i);
+          m_solver.computeLambda(particles, i, neighbors.first, neighbors.second);
+          particles[i]->m_posUpdate = m_solver.calcPositionUpdate(particles, i, neighbors.first, neighbors.second);
+          particles[i]->m_predPos += particles[i]->m_posUpdate;
+          m_solver.handleEnvCollisions(particles[i], *m_bb);
+          if(_lastIteration)
+            particles[i]->m_vel = invTimeStep * (particles[i]->m_predPos - particles[i]->m_pos);
+        }
+      }
+    }
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void CpuBackend::colour()
+{
+  std::vector<Particle *> &particles = *m_particles;
+  PBF_PROFILE_SCOPE("colour");
+
+  // Sort to the cells the neighbor lists were built from. A particle outside of the grid only finds neighbors
+  // on the border cells so it's projected with the closest of them. The lambdas of the particles that haven't
+  // been projected yet are read by the earlier ones, they start from zero.
+  const Vec3i &cells = m_nns.getGridSize();
+  const unsigned int cellCount = cells.m_x * cells.m_y * cells.m_z;
+  m_particleCells.resize(m_count);
+#pragma omp parallel for schedule(static)
+  for(unsigned int i = 0; i < m_count; ++i)
+  {
+    int x, y, z;
+    m_nns.getCellCoords(particles[i]->m_pos, x, y, z);
+    x = std::min(std::max(x, 0), cells.m_x - 1);
+    y = std::min(std::max(y, 0), cells.m_y - 1);
+    z = std::min(std::max(z, 0), cells.m_z - 1);
+    m_particleCells[i] = x + (y + z * cells.m_y) * cells.m_x;
+    particles[i]->m_lambda = 0.f;
+  }
+
+  // Counting sort, scattering backwards from the ends of the cells keeps the particles of a cell in index order
+  // and leaves the offsets at the starts. The colour lists hold at most every cell, so reserving them for the grid
+  // keeps cells the fluid hasn't reached before from growing them mid-run
+  m_cellOffsets.assign(cellCount + 1, 0);
+  m_colourCells.reserve(cellCount);
+  for(unsigned int i = 0; i < m_count; ++i)
+    ++m_cellOffsets[m_particleCells[i]];
+  for(unsigned int c = 1; c <= cellCount; ++c)
+    m_cellOffsets[c] += m_cellOffsets[c - 1];
+  m_cellParticles.resize(m_count);
+  for(unsigned int i = m_count; i-- > 0;)
+    m_cellParticles[--m_cellOffsets[m_particleCells[i]]] = i;
+
+  // Gather the non-empty cells of each colour
+  const int period = m_nns.getSearchRange() + 1;
+  m_colourCells.clear();
+  m_colourOffsets.resize(period * period * period + 1);
+  for(int c = 0; c < period * period * period; ++c)
+  {
+    m_colourOffsets[c] = m_colourCells.size();
+    for(int z = c / (period * period); z < cells.m_z; z += period)
+      for(int y = c / period % period; y < cells.m_y; y += period)
+        for(int x = c % period; x < cells.m_x; x += period)
+        {
+          const unsigned int cell = x + (y + z * cells.m_y) * cells.m_x;
+          if(m_cellOffsets[cell] != m_cellOffsets[cell + 1])
+            m_colourCells.push_back(cell);
+        }
+  }
+  m_colourOffsets.back() = m_colourCells.size();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void CpuBackend::computeVorticity(const float &_timeStep)
+{
+  std::vector<Particle *> &particles = *m_particles;
+  float timeStep = _timeStep;
+
+  // Compute the vorticity and xsph viscosity, the viscosity is stored in the unused position
+  // update until all the neighbors have read the velocities
+#pragma omp parallel
+  {
+    PBF_PROFILE_SCOPE("vorticity");
+#pragma omp for schedule(static) nowait
+    for(unsigned int i = 0; i < m_count; ++i)
+    {
+      std::pair<unsigned int *, unsigned int> neighbors = m_nns.getNeighbors(i);
+      particles[i]->m_posUpdate = m_solver.computeVorticityAndXSPH(particles, i, neighbors.first, neighbors.second, timeStep);
+    }
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void CpuBackend::finalize(FrameVertex *o_frame)
+{
+  std::vector<Particle *> &particles = *m_particles;
+  const float inverseRestDensity = m_solver.getParameters().inverseRestDensity;
+
+  // Apply the viscosity and update the position to be the predicted position, the particle is final so
+  // its vertex goes straight to the frame
+#pragma omp parallel
+  {
+    PBF_PROFILE_SCOPE("finalize");
+#pragma omp for schedule(static) nowait
+    for(unsigned int i = 0; i < m_count; ++i)
+    {
+      particles[i]->m_vel += particles[i]->m_posUpdate;
+      particles[i]->m_pos = particles[i]->m_predPos;
+      if(o_frame)
+        writeFrameVertex(*particles[i], inverseRestDensity, o_frame[i]);
+    }
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void CpuBackend::endStep(std::vector<Particle *> &)
+{
+  // Clean the grid and the neighbor tables for the next step
+  m_nns.cleanTable();
+  m_particles = nullptr;
+}
@@ -0,0 +1,280 @@
+#ifdef PBF_USE_MPI
+
+#include <algorithm>
+#include <cmath>
+#include "Domain.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+Domain::Domain(MPI_Comm _comm) :
+  m_comm(_comm),
+  m_axis(0),
+  m_haloWidth(0.f),
+  m_imbalanceTolerance(1.1f)
+{
+  MPI_Comm_rank(m_comm, &m_rank);
+  MPI_Comm_size(m_comm, &m_size);
+
+  // Particles are sent as raw bytes, they don't own any heap memory
+  MPI_Type_contiguous(sizeof(Particle), MPI_BYTE, &m_particleType);
+  MPI_Type_commit(&m_particleType);
+  MPI_Type_contiguous(sizeof(HaloState), MPI_BYTE, &m_haloType);
+  MPI_Type_commit(&m_haloType);
+
+  m_haloSend.resize(m_size);
+  m_haloStates.resize(m_size);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+Domain::~Domain()
+{
+  MPI_Type_free(&m_particleType);
+  MPI_Type_free(&m_haloType);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void Domain::init(const BoundingBox &_bb, const float &_haloWidth, const int &_axis)
+{
+  m_axis = _axis;
+  m_haloWidth = _haloWidth;
+
+  // Start with equally sized slabs, balance() moves the cuts once the particles exist
+  float min = coord(Vec3(_bb.m_minx, _bb.m_miny, _bb.m_minz));
+  float max = coord(Vec3(_bb.m_maxx, _bb.m_maxy, _bb.m_maxz));
+  m_cuts.resize(m_size + 1);
+  for(int r = 0; r <= m_size; ++r)
+    m_cuts[r] = min + (max - min) * r / m_size;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool Domain::needsBalance(const unsigned int &_ownedCount)
+{
+  unsigned long local = _ownedCount, max = 0, sum = 0;
+  MPI_Allreduce(&local, &max, 1, MPI_UNSIGNED_LONG, MPI_MAX, m_comm);
+  MPI_Allreduce(&local, &sum, 1, MPI_UNSIGNED_LONG, MPI_SUM, m_comm);
+  if(sum == 0)
+    return false;
+  return max > m_imbalanceTolerance * sum / m_size;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void Domain::balance(const ParticleBuffer &_particles, const unsigned int &_ownedCount)
+{
+  // Build a global histogram of the particle coordinates along the axis and place the cuts
+  // so that each slab contains an equal share of the particles
+  const int bins = 1024;
+  const float min = m_cuts.front();
+  const float max = m_cuts.back();
+  const float binSize = (max - min) / bins;
+
+  std::vector<unsigned long> local(bins, 0), global(bins, 0);
+  for(unsigned int i = 0; i < _ownedCount; ++i)
+  {
+    int b = (int)((coord(_particles[i].m_pos) - min) / binSize);
+    local[std::min(std::max(b, 0), bins - 1)]++;
+  }
+  MPI_Allreduce(&local[0], &global[0], bins, MPI_UNSIGNED_LONG, MPI_SUM, m_comm);
+
+  unsigned long total = 0;
+  for(int b = 0; b < bins; ++b)
+    total += global[b];
+  if(total == 0)
+    return;
+
+  // Walk the cumulative histogram and interpolate the cut position inside the bin where
+  // the running count crosses the target of each rank
+  unsigned long running = 0;
+  int b = 0;
+  for(int r = 1; r < m_size; ++r)
+  {
+    const double target = (double)total * r / m_size;
+    while(b < bins && running + global[b] < target)
+      running += global[b++];
+    float fraction = 0.f;
+    if(b < bins && global[b] > 0)
+      fraction = (float)((target - running) / global[b]);
+    m_cuts[r] = min + (b + fraction) * binSize;
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void Domain::migrate(ParticleBuffer &io_particles, unsigned int &io_ownedCount)
+{
+  // Pack the particles that are now owned by another rank and fill their slots
+  // with the last owned particle
+  std::vector<std::vector<Particle>> send(m_size);
+  unsigned int i = 0;
+  while(i < io_ownedCount)
+  {
+    int r = owner(coord(io_particles[i].m_pos));
+    if(r != m_rank)
+    {
+      send[r].push_back(io_particles[i]);
+      io_particles[i] = io_particles[--io_ownedCount];
+    }
+    else
+    {
+      ++i;
+    }
+  }
+
+  std::vector<Particle> recv;
+  std::vector<int> recvCounts;
+  exchange(send, m_particleType, recv, recvCounts);
+
+  // Append the received particles to the owned range, the old ghosts are overwritten
+  // and the rest of them are rebuilt by the next halo exchange
+  if(io_ownedCount + recv.size() > io_particles.size())
+    io_particles.resize(io_ownedCount + recv.size());
+  std::copy(recv.begin(), recv.end(), io_particles.begin() + io_ownedCount);
+  io_ownedCount += recv.size();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void Domain::exchangeHalo(ParticleBuffer &io_particles, const unsigned int &_ownedCount)
+{
+  // Find the owned particles within the halo width of the other slabs, the slabs are ordered
+  // so we only have to walk outwards from our own rank until a slab is too far away
+  std::vector<std::vector<Particle>> send(m_size);
+  for(int r = 0; r < m_size; ++r)
+    m_haloSend[r].clear();
+
+  for(unsigned int i = 0; i < _ownedCount; ++i)
+  {
+    const float c = coord(io_particles[i].m_pos);
+    for(int r = m_rank - 1; r >= 0 && c < m_cuts[r + 1] + m_haloWidth; --r)
+    {
+      m_haloSend[r].push_back(i);
+      send[r].push_back(io_particles[i]);
+    }
+    for(int r = m_rank + 1; r < m_size && c >= m_cuts[r] - m_haloWidth; ++r)
+    {
+      m_haloSend[r].push_back(i);
+      send[r].push_back(io_particles[i]);
+    }
+  }
+
+  std::vector<Particle> recv;
+  std::vector<int> recvCounts;
+  exchange(send, m_particleType, recv, recvCounts);
+
+  // Store the ghosts after the owned particles
+  io_particles.resize(_ownedCount + recv.size());
+  std::copy(recv.begin(), recv.end(), io_particles.begin() + _ownedCount);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void Domain::refreshHalo(ParticleBuffer &io_particles, const unsigned int &_ownedCount)
+{
+  // Send the current state of the same particles as in the last halo exchange, the receiving
+  // ranks get them in the same order so the ghosts can be updated in place
+  for(int r = 0; r < m_size; ++r)
+  {
+    std::vector<HaloState> &states = m_haloStates[r];
+    states.resize(m_haloSend[r].size());
+    for(unsigned int n = 0; n < m_haloSend[r].size(); ++n)
+    {
+      const Particle &p = io_particles[m_haloSend[r][n]];
+      states[n].predPos = p.m_predPos;
+      states[n].vel = p.m_vel;
+      states[n].density = p.m_density;
+      states[n].lambda = p.m_lambda;
+    }
+  }
+
+  std::vector<HaloState> recv;
+  std::vector<int> recvCounts;
+  exchange(m_haloStates, m_haloType, recv, recvCounts);
+
+  for(unsigned int n = 0; n < recv.size(); ++n)
+  {
+    Particle &p = io_particles[_ownedCount + n];
+    p.m_predPos = recv[n].predPos;
+    p.m_vel = recv[n].vel;
+    p.m_density = recv[n].density;
+    p.m_lambda = recv[n].lambda;
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void Domain::localBounds(const BoundingBox &_bb, BoundingBox &o_bb) const
+{
+  o_bb = _bb;
+  const float min = m_rank == 0 ? m_cuts.front() : m_cuts[m_rank] - m_haloWidth;
+  const float max = m_rank == m_size - 1 ? m_cuts.back() : m_cuts[m_rank + 1] + m_haloWidth;
+  switch(m_axis)
+  {
+    case 0 : o_bb.m_minx = std::max(min, _bb.m_minx); o_bb.m_maxx = std::min(max, _bb.m_maxx); break;
+    case 1 : o_bb.m_miny = std::max(min, _bb.m_miny); o_bb.m_maxy = std::min(max, _bb.m_maxy); break;
+    default : o_bb.m_minz = std::max(min, _bb.m_minz); o_bb.m_maxz = std::min(max, _bb.m_maxz); break;
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+unsigned long Domain::globalCount(const unsigned int &_ownedCount)
+{
+  unsigned long local = _ownedCount, sum = 0;
+  MPI_Allreduce(&local, &sum, 1, MPI_UNSIGNED_LONG, MPI_SUM, m_comm);
+  return sum;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+double Domain::globalSum(const double &_local)
+{
+  double local = _local, sum = 0.0;
+  MPI_Allreduce(&local, &sum, 1, MPI_DOUBLE, MPI_SUM, m_comm);
+  return sum;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+float Domain::coord(const Vec3 &_p) const
+{
+  switch(m_axis)
+  {
+    case 0 : return _p.m_x;
+    case 1 : return _p.m_y;
+    default : return _p.m_z;
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+int Domain::owner(const float &_c) const
+{
+  // The first and last slabs extend to infinity so escaped particles always have an owner
+  int r = (int)(std::upper_bound(m_cuts.begin() + 1, m_cuts.end() - 1, _c) - (m_cuts.begin() + 1));
+  return r;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+template <typename T>
+void Domain::exchange(const std::vector<std::vector<T>> &_send, MPI_Datatype _type, std::vector<T> &o_recv, std::vector<int> &o_recvCounts)
+{
+  // Flatten the per rank buffers, exchange the counts and then the data
+  std::vector<int> sendCounts(m_size), sendDispl(m_size), recvDispl(m_size);
+  o_recvCounts.assign(m_size, 0);
+
+  int sendTotal = 0;
+  for(int r = 0; r < m_size; ++r)
+  {
+    sendCounts[r] = _send[r].size();
+    sendDispl[r] = sendTotal;
+    sendTotal += sendCounts[r];
+  }
+  MPI_Alltoall(&sendCounts[0], 1, MPI_INT, &o_recvCounts[0], 1, MPI_INT, m_comm);
+
+  int recvTotal = 0;
+  for(int r = 0; r < m_size; ++r)
+  {
+    recvDispl[r] = recvTotal;
+    recvTotal += o_recvCounts[r];
+  }
+
+  std::vector<T> sendBuffer(sendTotal);
+  for(int r = 0; r < m_size; ++r)
+    std::copy(_send[r].begin(), _send[r].end(), sendBuffer.begin() + sendDispl[r]);
+  o_recv.resize(recvTotal);
+
+  MPI_Alltoallv(sendBuffer.data(), &sendCounts[0], &sendDispl[0], _type,
+                o_recv.data(), &o_recvCounts[0], &recvDispl[0], _type, m_comm);
+}
+
+#endif // PBF_USE_MPI
@@ -0,0 +1,145 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "Ensemble.h"
+#include "FluidSystem.h"
+#include "Profiler.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+Ensemble::Ensemble(const unsigned int &_threads) :
+  m_scheduler(_threads)
+{
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+EnsembleScene Ensemble::defaultScene(const unsigned int &_steps)
+{
+  FluidSolver solver;
+  EnsembleScene scene;
+  scene.name = "dam";
+  scene.parameters = solver.getParameters();
+  scene.iterations = 3;
+  scene.relaxation = 1.f;
+  scene.warmStart = false;
+  scene.levels = 0;
+  scene.steps = _steps;
+  scene.waves = false;
+  return scene;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+unsigned int Ensemble::addScene(const EnsembleScene &_scene)
+{
+  m_scenes.push_back(_scene);
+  return m_scenes.size() - 1;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void Ensemble::run()
+{
+  // The scenes are independent so the graph has no dependencies, the workers steal scenes from each
+  // other once their own share has run out
+  m_metrics.assign(m_scenes.size(), SceneMetrics());
+  m_graph.clear();
+  for(unsigned int s = 0; s < m_scenes.size(); ++s)
+    m_graph.addTask([this, s]() { runScene(s); });
+  m_scheduler.run(m_graph);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void Ensemble::runScene(const unsigned int &_index)
+{
+  // Keep the parallel loops of the scene on this worker, the other workers are busy with their own scenes.
+  // The profiler aggregates a single scene per frame so the workers don't record.
+#ifdef _OPENMP
+  const int threads = omp_get_max_threads();
+  omp_set_num_threads(1);
+#endif
+  PBF_PROFILE_THREAD(false);
+
+  const EnsembleScene &scene = m_scenes[_index];
+  SceneMetrics &metrics = m_metrics[_index];
+  metrics.worker = TaskScheduler::getCurrentWorker();
+  {
+    // The scene lives only as long as the task so its memory is first touched by this worker
+    FluidSystem pbf;
+    pbf.setVerbose(false);
+    pbf.setSolverParameters(scene.parameters);
+    pbf.setSolverIterations(scene.iterations);
+    pbf.setRelaxation(scene.relaxation);
+    pbf.setWarmStart(scene.warmStart);
+    pbf.setMultilevel(scene.levels);
+    pbf.getSeeder() = scene.seeder;
+    // A scene without particles isn't run and counts as unstable
+    const bool seeded = pbf.init();
+    if(seeded)
+      pbf.toggleSimulation();
+    if(scene.waves)
+      pbf.toggleWaves();
+
+    double total = 0.0, longest = 0.0;
+    for(unsigned int i = 0; seeded && i < scene.steps; ++i)
+    {
+      std::chrono::time_point<std::chrono::steady_clock> start = std::chrono::steady_clock::now();
+      pbf.execute();
+      const double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+      total += elapsed;
+      longest = std::max(longest, elapsed);
+    }
+
+    // Final state of the particles, NaNs fail the bounds test
+    const std::vector<Particle *> &particles = pbf.getParticles();
+    const BoundingBox &bb = pbf.getBoundingBox();
+    const float inverseRestDensity = scene.parameters.inverseRestDensity;
+    double density = 0.0, energy = 0.0;
+    float maxDensity = 0.f;
+    bool stable = seeded;
+    for(unsigned int i = 0; i < particles.size(); ++i)
+    {
+      const Particle *p = particles[i];
+      const float margin = p->m_radius;
+      stable = stable && p->m_pos.m_x >= bb.m_minx - margin && p->m_pos.m_x <= bb.m_maxx + margin &&
+                         p->m_pos.m_y >= bb.m_miny - margin && p->m_pos.m_y <= bb.m_maxy + margin &&
+                         p->m_pos.m_z >= bb.m_minz - margin && p->m_pos.m_z <= bb.m_maxz + margin &&
+                         std::isfinite(p->m_vel.lengthSquared());
+      density += p->m_density * inverseRestDensity;
+      maxDensity = std::max(maxDensity, p->m_density * inverseRestDensity);
+      energy += 0.5 * p->m_mass * p->m_vel.lengthSquared();
+    }
+
+    const double count = std::max<double>(particles.size(), 1.0);
+    metrics.particles = particles.size();
+    metrics.meanStepTime = scene.steps ? total / scene.steps : 0.0;
+    metrics.maxStepTime = longest;
+    metrics.meanDensity = density / count;
+    metrics.maxDensity = maxDensity;
+    metrics.kineticEnergy = energy / count;
+    metrics.stable = stable;
+  }
+
+  PBF_PROFILE_THREAD(true);
+#ifdef _OPENMP
+  omp_set_num_threads(threads);
+#endif
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void Ensemble::writeCSV(std::ostream &o_stream) const
+{
+  o_stream << "name,k,n,epsilon,xsph_c,vorticity,iterations,relaxation,warm_start,levels,steps,waves,particles,worker,"
+              "mean_step_ms,max_step_ms,mean_density,max_density,kinetic_energy,stable\n";
+  for(unsigned int s = 0; s < m_scenes.size() && s < m_metrics.size(); ++s)
+  {
+    const EnsembleScene &scene = m_scenes[s];
+    const SceneMetrics &metrics = m_metrics[s];
+    o_stream << scene.name << "," << scene.parameters.k << "," << scene.parameters.n << "," << scene.parameters.epsilon << ","
+             << scene.parameters.xsph_c << "," << scene.parameters.vorticityScale << "," << scene.iterations << ","
+             << scene.relaxation << "," << (scene.warmStart ? 1 : 0) << "," << scene.levels << ","
+             << scene.steps << "," << (scene.waves ? 1 : 0) << "," << metrics.particles << "," << metrics.worker << ","
+             << metrics.meanStepTime << "," << metrics.maxStepTime << "," << metrics.meanDensity << "," << metrics.maxDensity << ","
+             << metrics.kineticEnergy << "," << (metrics.stable ? 1 : 0) << "\n";
+  }
+}
@@ -1,9 +1,40 @@
 #include <iostream>
 #include <cmath>
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
 //#include <omp.h>
 #include "FluidSolver.h"
 #include "Particle.h"
 
+namespace
+{
+//----------------------------------------------------------------------------------------------------------------------
+inline float invSqrt(const float &_x)
+{
+#ifdef __SSE__
+  // Hardware estimate refined with one Newton-Raphson step, close to full float precision
+  // and much cheaper than a square root followed by a divide
+  const float y = _mm_cvtss_f32(_mm_rsqrt_ss(_mm_set_ss(_x)));
+  return y * (1.5f - 0.5f * _x * y * y);
+#else
+  return 1.f / std::sqrt(_x);
+#endif
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+inline float lookup(const std::vector<float> &_table, const float &_position)
+{
+  // Linear interpolation between the samples, the position is within [0, size]
+  const unsigned int last = _table.size() - 2;
+  unsigned int i = (unsigned int)_position;
+  if(i > last)
+    i = last;
+  const float t = _position - i;
+  return _table[i] + t * (_table[i + 1] - _table[i]);
+}
+}
+
 //----------------------------------------------------------------------------------------------------------------------
 FluidSolver::FluidSolver()
 {
@@ -19,10 +50,55 @@ FluidSolver::FluidSolver()
   m_fixedRadius = 0.3f * m_smoothingLength;
   m_epsilon = 0.0005f;
   m_xsph_c = 0.002f;
+  m_vorticityScale = 0.01f;
+  m_relaxation = 1.f;
 
   m_polyKernelConstant = 315.f/( 64.f * m_pi * h*h*h*h*h*h*h*h*h);
   m_spikyKernelConstant = -45.f/( m_pi * h*h*h*h*h*h);
   m_gravity.set(0.f, -9.81f, 0.f);
+
+  m_smoothingLength2 = h*h;
+  m_tableSize = 0;
+  m_tableScale = 0.f;
+  m_inverseFixedRadiusWeight = 1.f / computePoly6(m_fixedRadius*m_fixedRadius);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void FluidSolver::setKernelTable(const unsigned int &_size)
+{
+  // Evaluate the kernels directly while building the tables
+  m_tableSize = 0;
+  m_poly6Table.clear();
+  m_spikyTable.clear();
+  m_inverseFixedRadiusWeight = 1.f / computePoly6(m_fixedRadius*m_fixedRadius);
+  if(_size == 0)
+    return;
+
+  // The first interval is never looked up for the gradient, a table needs a second one
+  unsigned int size = _size;
+  if(size < 2)
+  {
+    std::cerr << "A kernel table needs at least 2 intervals, using 2 instead of " << _size << "\n";
+    size = 2;
+  }
+
+  m_poly6Table.resize(size + 1);
+  m_spikyTable.resize(size + 1);
+  for(unsigned int i = 0; i <= size; ++i)
+  {
+    const float r2 = m_smoothingLength2 * i / size;
+    m_poly6Table[i] = computePoly6(r2);
+    // The gradient scale is singular at r = 0, the first interval is never looked up
+    const float r = std::sqrt(r2);
+    const float tmp = m_smoothingLength - r;
+    m_spikyTable[i] = i == 0 ? 0.f : m_spikyKernelConstant * tmp*tmp / r;
+  }
+  m_spikyTable[0] = m_spikyTable[1];
+  m_tableScale = size / m_smoothingLength2;
+  m_tableSize = size;
+
+  // The artificial pressure divides by the kernel the tables give at the fixed radius, so it's exactly 1 there
+  m_inverseFixedRadiusWeight = 1.f / computePoly6(m_fixedRadius*m_fixedRadius);
 }
 
 //----------------------------------------------------------------------------------------------------------------------
@@ -31,81 +107,66 @@ void FluidSolver::predictPos(Particle* &io_p, const float &_t)
   // Add the gravity and external forces to the velocity and predict the new position
   // Also reset the external forces
   io_p->m_vel += m_gravity*_t + io_p->m_extForces*_t;
-  io_p->m_predPos = io_p->m_pos + _t*io_p->m_vel;
+  io_p->m_predPos = madd(io_p->m_pos, io_p->m_vel, _t);
   io_p->m_extForces.set(0.f, 0.f, 0.f);
 }
 
 //----------------------------------------------------------------------------------------------------------------------
 void FluidSolver::computeLambda(std::vector<Particle *> &io_particles, const unsigned int &_currentParticle, unsigned int *_neighbors, const unsigned int &_numNeighbors)
 {
-  // Formulas 8 & 11
+  // Formulas 2, 8 & 11
+  float density = 0.f;
   float sumGradientLengthSquared = 0;
   float c = 0.f;
-  ngl::Vec3 grad_pi_Ci = ngl::Vec3(0, 0, 0);
+  Vec3 grad_pi_Ci = Vec3(0, 0, 0);
+  Particle *p = io_particles[_currentParticle];
 
-  // Calculate the density of the particle based on its neighboring particles
-  computeDensity(io_particles, _currentParticle, _neighbors, _numNeighbors);
+  // Accumulate the density and the constraint gradient terms in the same pass over the neighbors,
+  // the gradient terms are only used when the particle is compressed
+  for(unsigned int i = 0; i < _numNeighbors; ++i)
+  {
+    if(_currentParticle == _neighbors[i])
+      continue;
 
-  // Change the colour of the particle based on the density
-  float d = io_particles[_currentParticle]->m_density*m_inverseRestDensity;
-  ngl::Vec4 color = d * ngl::Vec4(1.f, 1.f - 0.62745f, 1.f - 0.690196f, 1.f);
-  color.set( 0.75f - color.m_x, 1.0f - color.m_y, 1.0f - color.m_z, 1.0f);
-  io_particles[_currentParticle]->m_colour.set(color);
+    Particle *n = io_particles[_neighbors[i]];
+    Vec3 v = p->m_predPos - n->m_predPos;
+    float r2 = v.lengthSquared();
+    if(r2 > m_smoothingLength2)
+      continue;
 
-  // Solve density constraint
-  c = io_particles[_currentParticle]->m_density*m_inverseRestDensity - 1.f;
-  if(c > 0.f)
-  {
-    // Parallelise the calculations here
-    // #pragma omp parallel for num_threads(omp_get_max_threads())
-    for(unsigned int i = 0; i < _numNeighbors; ++i)
-    {
-      if(_currentParticle == _neighbors[i])
-        continue;
+    density += n->m_mass * computePoly6(r2);
 
-      // Implements the formula 8 of the pbf-paper, accumulates the density kernel gradient
-      // to be used to determine density constraint
-      ngl::Vec3 accumulatedGradient;
-      accumulatedGradient = io_particles[_neighbors[i]]->m_mass * computeDensityKernelGradient(io_particles[_currentParticle]->m_predPos, io_particles[_neighbors[i]]->m_predPos);
-      accumulatedGradient *= m_inverseRestDensity;
+    // Implements the formula 8 of the pbf-paper, accumulates the density kernel gradient
+    // to be used to determine density constraint
+    Vec3 accumulatedGradient = n->m_mass * computeSpikyGradient(v, r2);
+    accumulatedGradient *= m_inverseRestDensity;
 
-      sumGradientLengthSquared = sumGradientLengthSquared + accumulatedGradient.dot(accumulatedGradient);
-      grad_pi_Ci = grad_pi_Ci + accumulatedGradient;
-    }
+    sumGradientLengthSquared = sumGradientLengthSquared + accumulatedGradient.dot(accumulatedGradient);
+    grad_pi_Ci = grad_pi_Ci + accumulatedGradient;
+  }
+  p->m_density = density;
 
+  // Solve density constraint
+  c = p->m_density*m_inverseRestDensity - 1.f;
+  if(c > 0.f)
+  {
     // u.u = ||u|| * ||u|| * cos 0 = ||u||^2
     sumGradientLengthSquared += grad_pi_Ci.dot(grad_pi_Ci);
-    io_particles[_currentParticle]->m_lambda = -c / (sumGradientLengthSquared + m_epsilon);
+    p->m_lambda = -c / (sumGradientLengthSquared + m_epsilon);
   }
   else
   {
-    io_particles[_currentParticle]->m_lambda = 0.f;
+    p->m_lambda = 0.f;
   }
 }
 
 //----------------------------------------------------------------------------------------------------------------------
-void FluidSolver::computeDensity(std::vector<Particle *> &io_particles, const unsigned int &_currentParticle, unsigned int *_neighbors, const unsigned int &_numNeighbors)
+Vec3 FluidSolver::computeVorticityAndXSPH(std::vector<Particle *> &io_particles, const unsigned int &_currentParticle, unsigned int *_neighbors, const unsigned int &_numNeighbors, const float &_t)
 {
-  // Initialise density to 0 and calculate the density using
-  // the masses and weights of the neighboring particles (formula 2)
-  io_particles[_currentParticle]->m_density = 0.f;
-  // #pragma omp parallel for num_threads(omp_get_max_threads())
-  for(unsigned int i = 0; i < _numNeighbors; ++i)
-  {
-    if(_currentParticle == _neighbors[i])
-      continue;
-    io_particles[_currentParticle]->m_density += io_particles[_neighbors[i]]->m_mass * computeDensityKernel((io_particles[_currentParticle]->m_predPos - io_particles[_neighbors[i]]->m_predPos).length());
-  }
-}
-
-//----------------------------------------------------------------------------------------------------------------------
-void FluidSolver::computeVorticityAndXSPH(std::vector<Particle *> &io_particles, const unsigned int &_currentParticle, unsigned int *_neighbors, const unsigned int &_numNeighbors, float &_t)
-{
-  ngl::Vec3 vorticity, gradVorticity, tmp, xsphV;
+  Vec3 vorticity, gradVorticity, tmp, xsphV;
+  Particle *p = io_particles[_currentParticle];
 
   // Implements functions 15, 16 and 17
-  // Parallelise the calculations here
-  // #pragma omp parallel for num_threads(omp_get_max_threads())
   for(unsigned int i = 0; i < _numNeighbors; ++i)
   {
     // Skip the particle if it's the current particle
@@ -113,95 +174,163 @@ void FluidSolver::computeVorticityAndXSPH(std::vector<Particle *> &io_particles,
       continue;
 
     // Calculate the relative velocity and the vector between the two particles
-    ngl::Vec3 v_ij = io_particles[_neighbors[i]]->m_vel - io_particles[_currentParticle]->m_vel;
-    ngl::Vec3 p_ij = io_particles[_currentParticle]->m_predPos - io_particles[_neighbors[i]]->m_predPos;
-    tmp.cross(v_ij, computeDensityKernelGradient(io_particles[_currentParticle]->m_predPos, io_particles[_neighbors[i]]->m_predPos));
+    Particle *n = io_particles[_neighbors[i]];
+    Vec3 p_ij = p->m_predPos - n->m_predPos;
+    float r2 = p_ij.lengthSquared();
+    if(r2 > m_smoothingLength2)
+      continue;
+    Vec3 v_ij = n->m_vel - p->m_vel;
+    Vec3 gradient = computeSpikyGradient(p_ij, r2);
 
     // Accumulate the cross product of the relative velocity and density kernel gradient
     // to the vorticity force
+    tmp.cross(v_ij, gradient);
     vorticity += tmp;
 
+    // The gradient of the vorticity length is the sum of the kernel gradients scaled by it,
+    // so the sum can be accumulated here and scaled afterwards
+    gradVorticity += gradient;
+
     // Add a viscocity force
-    if(io_particles[_neighbors[i]]->m_density != 0.f)
-      xsphV += v_ij * computeDensityKernel(p_ij.length());
+    if(n->m_density != 0.f)
+      xsphV.addScaled(v_ij, computePoly6(r2));
   }
-  // Add the accumulated viscosity to the particle's velocity
-  io_particles[_currentParticle]->m_vel += m_xsph_c * xsphV;
-
   // Calculate a gradient vorticity using the spiky kernel and the accumulated vorticity
   float l = vorticity.length();
-  if(l != 0.f)
-  {
-    // #pragma omp parallel for num_threads(omp_get_max_threads())
-    for(unsigned int i = 0; i < _numNeighbors; ++i)
-    {
-      if(_currentParticle == _neighbors[i])
-        continue;
-      gradVorticity += computeDensityKernelGradient(io_particles[_currentParticle]->m_predPos, io_particles[_neighbors[i]]->m_predPos) * l;
-    }
-  }
+  gradVorticity *= l;
 
   if(gradVorticity.lengthSquared() != 0.f)
   {
     // If the gradient vorticity "exists", add it to the external forces
     // This is used for higher splashes
     gradVorticity.normalize();
-    io_particles[_currentParticle]->m_extForces += gradVorticity.cross(vorticity) * 0.01f;
+    p->m_extForces += gradVorticity.cross(vorticity) * m_vorticityScale;
   }
+
+  // Return the accumulated viscosity to be added to the particle's velocity
+  return m_xsph_c * xsphV;
 }
 
 //----------------------------------------------------------------------------------------------------------------------
-float FluidSolver::computeArtificialPressure(ngl::Vec3 &_p, ngl::Vec3 &_n)
+float FluidSolver::computeArtificialPressure(const float &_r2)
 {
-  // Compute the artificial pressure correction factor
   float scorr, tmp;
-  scorr = tmp = computeDensityKernel((_p - _n).length()) / computeDensityKernel(m_fixedRadius);
+  scorr = tmp = computePoly6(_r2) * m_inverseFixedRadiusWeight;
   for(int i = 1; i < m_n; ++i)
     scorr *= tmp;
   return -m_k * scorr;
 }
 
 //----------------------------------------------------------------------------------------------------------------------
-float FluidSolver::computeDensityKernel(const float &_r)
+float FluidSolver::computePoly6(const float &_r2)
 {
-  // Compute the weight of a particle based on the distance using a poly6 kernel
-  if( _r < 0.f || _r > m_smoothingLength )
+  // The poly6 kernel only depends on r^2 so there's no need for the distance itself
+  if( _r2 > m_smoothingLength2 )
     return 0.f;
+  if(m_tableSize)
+    return lookup(m_poly6Table, _r2 * m_tableScale);
 
-  float tmp = m_smoothingLength*m_smoothingLength - _r*_r;
+  float tmp = m_smoothingLength2 - _r2;
   return m_polyKernelConstant * tmp*tmp*tmp;
 }
 
 //----------------------------------------------------------------------------------------------------------------------
-ngl::Vec3 FluidSolver::computeDensityKernelGradient(ngl::Vec3 &_p, ngl::Vec3 &_n)
+Vec3 FluidSolver::computeSpikyGradient(const Vec3 &_v, const float &_r2)
 {
-  // Compute the kernel gradient and return the vector between the particles multiplied by this weight
-  ngl::Vec3 v = (_p - _n);
-  float r = v.length();
-
-  if( r > m_smoothingLength )
-    return ngl::Vec3(0.f, 0.f, 0.f);
+  // Coincident particles have no direction to push each other in
+  if( _r2 > m_smoothingLength2 || _r2 == 0.f )
+    return Vec3(0.f, 0.f, 0.f);
 
-  v.normalize();
-  float tmp = m_smoothingLength - r;
-  return m_spikyKernelConstant * tmp*tmp * v;
+  // constant * (h - r)^2 * v / r, both r and 1 / r come from the same inverse square root
+  float scale;
+  if(m_tableSize && _r2 * m_tableScale >= 1.f)
+  {
+    scale = lookup(m_spikyTable, _r2 * m_tableScale);
+  }
+  else
+  {
+    float invR = invSqrt(_r2);
+    float tmp = m_smoothingLength - _r2 * invR;
+    scale = m_spikyKernelConstant * tmp*tmp * invR;
+  }
+  return scale * _v;
 }
 
 //----------------------------------------------------------------------------------------------------------------------
-ngl::Vec3 FluidSolver::calcPositionUpdate(std::vector<Particle *> &io_particles, const unsigned int &_currentParticle, unsigned int *_neighbors, const unsigned int &_numNeighbors)
+Vec3 FluidSolver::calcPositionUpdate(std::vector<Particle *> &io_particles, const unsigned int &_currentParticle, unsigned int *_neighbors, const unsigned int &_numNeighbors)
 {
-  ngl::Vec3 positionUpdate;
+  Vec3 positionUpdate;
+  Particle *p = io_particles[_currentParticle];
 
-  // Looping through the neighboring particles
-  // Parallelising this part
-  // #pragma omp parallel for num_threads(omp_get_max_threads())
+  // Looping through the neighboring particles, the squared distance is shared by the
+  // artificial pressure and the kernel gradient
   for(unsigned int i = 0; i < _numNeighbors; ++i)
   {
     if(_currentParticle == _neighbors[i])
       continue;
+    Particle *n = io_particles[_neighbors[i]];
+    Vec3 v = p->m_predPos - n->m_predPos;
+    float r2 = v.lengthSquared();
+    if(r2 > m_smoothingLength2)
+      continue;
     // Implements formula 14
-    positionUpdate += (io_particles[_currentParticle]->m_lambda + io_particles[_neighbors[i]]->m_lambda + computeArtificialPressure( io_particles[_currentParticle]->m_predPos, io_particles[_neighbors[i]]->m_predPos )) * computeDensityKernelGradient(io_particles[_currentParticle]->m_predPos, io_particles[_neighbors[i]]->m_predPos);
+    positionUpdate.addScaled(computeSpikyGradient(v, r2), p->m_lambda + n->m_lambda + computeArtificialPressure(r2));
   }
 
-  return m_inverseRestDensity*positionUpdate;
+  return (m_relaxation*m_inverseRestDensity)*positionUpdate;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void FluidSolver::handleEnvCollisions(Particle *io_p, const BoundingBox &_bb)
+{
+  Vec3 newPos, newVel;
+  float dist;
+
+  // Loop through the walls
+  for(int i = 0; i < 6; ++i)
+  {
+    // Calculate the distance of the particle from the wall
+    dist = io_p->m_predPos.m_x * _bb.m_walls[i].normal.m_x + io_p->m_predPos.m_y * _bb.m_walls[i].normal.m_y + io_p->m_predPos.m_z * _bb.m_walls[i].normal.m_z + _bb.m_walls[i].d - io_p->m_radius;
+    if(dist < 0.0) // Penetrates the wall
+    {
+      // If the particle penetrated the wall, push it out using the distance of penetration and wall normal
+      // and update the predicted position accordingly. The velocity is reflected relative to the wall so
+      // a moving wall carries the particles with it.
+      float restcoef = 0.5f;
+      const Vec3 relVel = io_p->m_vel - _bb.m_walls[i].velocity;
+      newPos = io_p->m_predPos - 2.f*dist*_bb.m_walls[i].normal;
+      newVel = _bb.m_walls[i].velocity - restcoef*(relVel.dot(_bb.m_walls[i].normal) * _bb.m_walls[i].normal + (relVel - relVel.dot(_bb.m_walls[i].normal) * _bb.m_walls[i].normal));
+      io_p->m_predPos = newPos;
+      io_p->m_vel = newVel;
+    }
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+SolverParameters FluidSolver::getParameters() const
+{
+  SolverParameters parameters;
+  parameters.smoothingLength = m_smoothingLength;
+  parameters.polyKernelConstant = m_polyKernelConstant;
+  parameters.spikyKernelConstant = m_spikyKernelConstant;
+  parameters.inverseRestDensity = m_inverseRestDensity;
+  parameters.inverseFixedRadiusWeight = m_inverseFixedRadiusWeight;
+  parameters.k = m_k;
+  parameters.n = m_n;
+  parameters.epsilon = m_epsilon;
+  parameters.xsph_c = m_xsph_c;
+  parameters.vorticityScale = m_vorticityScale;
+  parameters.gravity = m_gravity;
+  return parameters;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void FluidSolver::setParameters(const SolverParameters &_parameters)
+{
+  m_k = _parameters.k;
+  m_n = _parameters.n;
+  m_epsilon = _parameters.epsilon;
+  m_xsph_c = _parameters.xsph_c;
+  m_vorticityScale = _parameters.vorticityScale;
+  m_gravity = _parameters.gravity;
 }
@@ -1,8 +1,16 @@
 #include <iostream>
 #include <cmath>
 #include <chrono>
+#include <algorithm>
+#include <cstring>
+#include <limits>
 //#include <omp.h>
 #include "FluidSystem.h"
+#include "CpuBackend.h"
+#include "OpenCLBackend.h"
+#include "Profiler.h"
+#include "Domain.h"
+#include "Workload.h"
 
 //----------------------------------------------------------------------------------------------------------------------
 FluidSystem::FluidSystem() :
@@ -10,157 +18,774 @@ FluidSystem::FluidSystem() :
 {
   // Initialise some of the member variables
   m_solverIterations = 3;
+  m_solverMode = JACOBI;
+  m_warmStart = false;
+  m_relaxation = 1.f;
+  m_lastDensityError = std::numeric_limits<float>::max();
   m_waves = false;
   m_simulate = false;
+  m_ownedCount = 0;
+  m_domain = nullptr;
+  m_workload = nullptr;
+  m_step = 0;
+  m_balanceInterval = 50;
+  m_pinThreads = false;
+  m_hugePages = false;
+  m_tileSize = 4;
+  m_graphTimeStep = 0.f;
+  m_deterministic = false;
+  m_wavePhase = 0.f;
+  m_backendName = "cpu";
+  m_nnsName = "grid";
+  m_nns = NNS::create(m_nnsName);
+  m_extractSurface = false;
+  m_backgroundSurface = false;
+  m_idIndexValid = false;
+  m_searchOrdered = false;
+  m_verbose = true;
+  m_metricsInterval = 10;
+  m_metricsSteps = 0;
+  m_framesInterval = 1;
+  m_frame = nullptr;
 }
 
 //----------------------------------------------------------------------------------------------------------------------
 FluidSystem::~FluidSystem()
 {
   // Clean up the particles after finishing
-  std::cout << "Cleaning up " << m_particles.size() << " particles\n";
-  for(unsigned int i = 0; i < m_particles.size(); ++i)
-    delete m_particles[i];
+  if(m_verbose)
+    std::cout << "Cleaning up " << m_storage.size() << " particles\n";
 }
 
 //----------------------------------------------------------------------------------------------------------------------
-void FluidSystem::init()
+bool FluidSystem::init()
 {
-  // Spawn particles and add the to a vector
-  std::cout << "Building the fluid system\n";
-  float scale = 0.24f;
-  for (int x = 0; x < 8; x++)
+  // Pin the threads before anything is allocated so the first touch happens on the final cores
+  Numa::setHugePages(m_hugePages);
+  if(m_pinThreads)
+    Numa::pinThreads();
+
+  // Seed the particles in parallel straight into the contiguous storage, its pages are first touched by the
+  // threads when it's allocated. Without any volumes the default dam break is seeded, a workload replaces both.
+  if(m_verbose)
+    std::cout << "Building the fluid system\n";
+  if(m_seeder.empty() && !m_workload)
   {
-    for (int z = 0; z < 8; z++)
-    {
-      for (int y = 0; y < 16; y++)
-      {
-        Particle *p = new Particle();
-        p->m_pos = ngl::Vec3(-7.5f, -7.f, -6.f) + scale * ngl::Vec3(x, y, z);
-        p->m_colour.set(0.f, 0.62745f, 0.690196f);
-        m_particles.push_back(p);
-      }
-    }
+    const float scale = 0.24f;
+    const Vec3 origin(-7.5f, -7.f, -6.f);
+    const Vec3 half(0.5f * scale, 0.5f * scale, 0.5f * scale);
+    m_seeder.setOrigin(origin);
+    m_seeder.setSpacing(scale);
+    m_seeder.setTargetCount(0);
+    m_seeder.addBox(origin - half, origin + scale * Vec3(8.f, 16.f, 8.f) - half);
+  }
+
+  // In a distributed run the particles are spread over the ranks and moved
+  // to the ranks owning their slabs once every rank has created its share
+  unsigned int first = 0, stride = 1;
+#ifdef PBF_USE_MPI
+  if(m_domain)
+  {
+    first = m_domain->getRank();
+    stride = m_domain->getSize();
+  }
+#endif
+  std::chrono::time_point<std::chrono::system_clock> seedStart = std::chrono::system_clock::now();
+  unsigned int total = 0;
+  if(m_workload)
+  {
+    // The wave machine continues from the phase it had at the captured step if it's toggled on
+    m_bb = m_workload->getBounds();
+    m_step = m_workload->getStep();
+    m_wavePhase = 0.035f * m_step;
+    total = m_workload->restore(m_storage, first, stride);
+  }
+  else
+  {
+    total = m_seeder.seed(m_storage, m_bb, first, stride);
   }
+  std::chrono::duration<float> seedTime = std::chrono::system_clock::now() - seedStart;
+  m_ownedCount = m_storage.size();
 
-  std::cout << m_particles.size() << " particles spawned\n";
+  if(m_verbose && m_workload)
+    std::cout << total << " particles of " << m_workload->getScene() << " at step " << m_step << " restored in " << seedTime.count() << "s\n";
+  else if(m_verbose)
+    std::cout << total << " particles spawned in " << seedTime.count() << "s, spacing " << m_seeder.getSpacing() << "\n";
+
+  // An empty scene is a mistake in the seed volumes or the workload, not something to simulate
+  if(total == 0)
+  {
+    std::cerr << "No particles to simulate, the seed volumes are empty or outside the clip box\n";
+    return false;
+  }
 
   // Call the grid initialisation function passing it the bounding box, amount of particles
   // and how many neighbors each particle can have (user defined)
-  m_nns.init(m_bb, m_particles.size(), 150);
+  BoundingBox gridBB;
+  gridBB = m_bb;
+#ifdef PBF_USE_MPI
+  if(m_domain)
+  {
+    // Split the box so that each rank gets the same amount of particles and only build the grid
+    // for the local slab and its halo
+    Particle tmp;
+    m_domain->init(m_bb, tmp.m_radius * 5.f);
+    m_domain->balance(m_storage, m_ownedCount);
+    m_domain->migrate(m_storage, m_ownedCount);
+    m_domain->localBounds(m_bb, gridBB);
+  }
+#endif
+  if(m_nnsName != m_nns->getName())
+  {
+    std::unique_ptr<NNS> nns = NNS::create(m_nnsName);
+    if(nns)
+      m_nns = std::move(nns);
+    else
+      std::cout << "The " << m_nnsName << " neighbor search doesn't exist, using the " << m_nns->getName() << "\n";
+  }
+  m_nns->setSortedNeighbors(m_deterministic);
+  m_nns->init(gridBB, m_ownedCount, 150);
+  m_mesher.init(*m_nns, m_solver.getParameters());
+  updateParticleViews();
+  m_idIndexValid = false;
+  m_searchOrdered = false;
+
+  // Create the backend for the whole-array step, the OpenCL backend takes the grid layout from the
+  // neighbor search so it's created after it. The task graph and the halo exchanges need the cpu backend.
+  m_backend.reset();
+#ifdef PBF_USE_OPENCL
+  if(m_backendName == "opencl" && !m_domain)
+  {
+    std::unique_ptr<OpenCLBackend> backend(new OpenCLBackend(m_solver, *m_nns));
+    if(backend->init("kernels/pbf.cl"))
+    {
+      m_backend = std::move(backend);
+      if(m_scheduler)
+      {
+        std::cout << "The task graph runs on the cpu backend only, disabling it\n";
+        m_scheduler.reset();
+      }
+    }
+  }
+#endif
+  if(!m_backend)
+  {
+    if(m_backendName != "cpu")
+      std::cout << "The " << m_backendName << " backend isn't available, running on the cpu\n";
+    m_backend.reset(new CpuBackend(m_solver, *m_nns));
+  }
 
-  // Build the walls of the bounding box (VAO, normals etc)
+  // Build the walls of the bounding box (normals etc)
   m_bb.buildWalls();
+  return true;
 }
 
 //----------------------------------------------------------------------------------------------------------------------
 void FluidSystem::execute()
 {
-  // Draw the bounding box at the beginning
-  m_bb.m_vao->bind();
-  m_bb.m_vao->draw();
-  m_bb.m_vao->unbind();
-
   if(m_simulate)
   {
-    // If the user wants to "simulate waves", move the bounding box max X wall using a sine function and build the vao, normals etc again
+    // The clock is only read for the metrics feed
+    const std::chrono::steady_clock::time_point stepStart = m_metrics ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+
+    // Time step used for velocity and position calculations
+    float timeStep = 0.016f;
+
+    // If the user wants to "simulate waves", move the bounding box max X wall using a sine function,
+    // the wall is updated in place and gets the velocity it moved at
     if(m_waves)
     {
-      static float sinWave = 0.f;
-      sinWave += 0.035f;
-      m_bb.m_maxx = 6.f - fabs(std::sin(sinWave)*5.f);
-      m_bb.buildWalls();
+      m_wavePhase += 0.035f;
+      m_bb.moveWall(BoundingBox::MAX_X, 6.f - fabs(std::sin(m_wavePhase)*5.f), timeStep);
+    }
+    else
+    {
+      m_bb.stopWalls();
     }
 
-    // Time step and inverse timestep used for velocity and position calculations
-    float timeStep = 0.016f;
-    float invTimeStep = 1.f/timeStep;
+#ifdef PBF_USE_MPI
+    // Rebalance the slabs every now and then if the particle counts have drifted apart
+    // and hand the particles that have left the slab over to their new owners
+    if(m_domain)
+    {
+      PBF_PROFILE_SCOPE("migrate");
+      if(m_step % m_balanceInterval == 0 && m_domain->needsBalance(m_ownedCount))
+      {
+        m_domain->balance(m_storage, m_ownedCount);
+        BoundingBox localBB;
+        m_domain->localBounds(m_bb, localBB);
+        m_nns->init(localBB, m_ownedCount, 150);
+        m_mesher.init(*m_nns, m_solver.getParameters());
+      }
+      m_domain->migrate(m_storage, m_ownedCount);
+      updateParticleViews();
+      m_idIndexValid = false;
+      m_searchOrdered = false;
+    }
+#endif
 
-    // Parallelising the predicted position and velocity calculations
-    // #pragma omp parallel for num_threads(omp_get_max_threads())
-    for(unsigned int i = 0; i < m_particles.size(); ++i)
+    // Sort the particles along the curve once they have scattered in memory, the grid and the neighbor
+    // tables are built from the new order below
+    if(m_order.update(m_storage, m_ownedCount, *m_nns, m_step))
     {
-      m_solver.predictPos(m_particles[i], timeStep);
-      m_particles[i]->m_posUpdate.set(0.f, 0.f, 0.f);
+      updateParticleViews();
+      m_idIndexValid = false;
+      m_searchOrdered = false;
     }
+    ++m_step;
+    beginFrame();
 
-    // Build the grid and neighbor tables based on the predicted positions
-    m_nns.buildTable(m_particles);
+    // Run the step as a task graph over spatial tiles if enabled, the halo exchanges
+    // of a distributed run need the whole-array passes though
+    if(m_scheduler && !m_domain)
+    {
+      executeTiles(timeStep);
+      m_nns->cleanTable();
+      extractSurface();
+      adaptRelaxation();
+      PBF_PROFILE_FRAME();
+      publishMetrics(stepStart);
+      publishFrame();
+      return;
+    }
 
-    // Iterate the solver
-    for(unsigned int iter = 0; iter < m_solverIterations; ++iter)
+    // Run the stages of the step on the backend. A backend that has failed leaves the particles as they were at
+    // the start of the step, the step runs again on the cpu backend which is kept from then on.
+    executeBackend(timeStep);
+    if(!m_backend->isValid())
     {
-      // Parallelise the lambda calculation
-      // #pragma omp parallel for num_threads(omp_get_max_threads())
-      for(unsigned int i = 0; i < m_particles.size(); ++i)
-      {
-        // Get the neighbors for a particle from the computed table
-        std::pair<unsigned int *, unsigned int> neighbors = m_nns.getNeighbors(i);
+      std::cerr << "The " << m_backend->getName() << " backend has failed, running on the cpu\n";
+      m_backend.reset(new CpuBackend(m_solver, *m_nns));
+      m_searchOrdered = false;
+      executeBackend(timeStep);
+    }
+    extractSurface();
+    adaptRelaxation();
+    PBF_PROFILE_FRAME();
+    publishMetrics(stepStart);
+    publishFrame();
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void FluidSystem::executeBackend(const float &_timeStep)
+{
+  // The ghost particles of a distributed run are refreshed between the stages that read the neighbors
+  m_backend->beginStep(m_particles, m_ownedCount, m_bb);
+  m_backend->predict(_timeStep);
+
+#ifdef PBF_USE_MPI
+  // Receive the ghost particles of the neighboring slabs before building the neighbor tables
+  if(m_domain)
+  {
+    PBF_PROFILE_SCOPE("halo");
+    m_domain->exchangeHalo(m_storage, m_ownedCount);
+    updateParticleViews();
+    m_nns->resize(m_particles.size());
+  }
+#endif
+
+  // Build the grid and neighbor tables based on the positions, the search structure is refitted while the
+  // particles keep their order. The ghosts of a distributed run are received again every step.
+  m_backend->buildGrid(m_searchOrdered && !m_domain);
+  m_searchOrdered = true;
+  m_backend->buildNeighbors();
+
+  // Remove the errors spanning many particles on the coarse levels first, the ghosts of a distributed
+  // run don't take part in the proxies so it only runs locally
+  if(m_multilevel.isEnabled() && !m_domain)
+    m_backend->projectLevels(m_multilevel);
+
+  // Start from the lambdas the particles carry from the previous step
+  if(m_warmStart)
+  {
+    m_backend->warmStart();
+    refreshHalo();
+  }
+
+  // Iterate the solver, the last iteration also calculates the new velocity based on the old
+  // position and the newly predicted position as the vorticity and viscosity need the velocities.
+  // A Gauss-Seidel sweep reads the ghosts in the middle of an iteration so it's only used locally.
+  for(unsigned int iter = 0; iter < m_solverIterations; ++iter)
+  {
+    PBF_PROFILE_SCOPE_INDEX("iteration", iter);
+    if(m_solverMode == GAUSS_SEIDEL && !m_domain &&
+       m_backend->solveColoured(iter, iter + 1 == m_solverIterations, _timeStep))
+      continue;
+    m_backend->computeLambda(iter);
+    refreshHalo();
+    m_backend->computePositionUpdate(iter);
+    m_backend->applyPositionUpdate(iter, iter + 1 == m_solverIterations, _timeStep);
+    refreshHalo();
+  }
+
+  // Compute the vorticity and xsph viscosity, then apply the viscosity and move the particles
+  m_backend->computeVorticity(_timeStep);
+  m_backend->finalize(m_frame);
+
+  // Hand the particles back and aggregate the stage timings of the step
+  m_backend->endStep(m_particles);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool FluidSystem::setMetricsFeed(const std::string &_name, const unsigned int &_interval)
+{
+  m_metrics.reset(new MetricsFeed);
+  if(!m_metrics->open(_name))
+  {
+    m_metrics.reset();
+    return false;
+  }
+  m_metricsInterval = std::max(_interval, 1u);
+  m_metricsSteps = 0;
+  m_metricsSample = MetricsSample();
+  m_metricsStart = m_metricsLastPublish = std::chrono::steady_clock::now();
+  return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool FluidSystem::setFrameFeed(const std::string &_name, const unsigned int &_interval)
+{
+  // Sized for the particles there are now, before init() that's none and the first frame grows it
+  m_frames.reset(new FrameFeed);
+  if(!m_frames->open(_name, m_ownedCount))
+  {
+    m_frames.reset();
+    return false;
+  }
+  m_framesName = _name;
+  m_framesInterval = std::max(_interval, 1u);
+  return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void FluidSystem::beginFrame()
+{
+  m_frame = nullptr;
+  if(!m_frames || m_step % m_framesInterval)
+    return;
+
+  // A bigger run gets a new segment with some room to spare, the viewers see the old one closed
+  if(m_ownedCount > m_frames->getCapacity() && !m_frames->open(m_framesName, m_ownedCount + m_ownedCount / 4))
+  {
+    std::cerr << "Could not grow the frame feed " << m_framesName << "\n";
+    m_frames.reset();
+    return;
+  }
+  m_frame = m_frames->beginFrame();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void FluidSystem::publishFrame()
+{
+  if(!m_frame)
+    return;
+
+  // The last pass of the step wrote the particles into the back buffer, publishing only points the readers to it
+  FrameHeader header;
+  header.step = m_step;
+  header.count = m_ownedCount;
+  header.boxMin[0] = m_bb.m_minx; header.boxMin[1] = m_bb.m_miny; header.boxMin[2] = m_bb.m_minz;
+  header.boxMax[0] = m_bb.m_maxx; header.boxMax[1] = m_bb.m_maxy; header.boxMax[2] = m_bb.m_maxz;
+  m_frames->publish(header);
+  m_frame = nullptr;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void FluidSystem::publishMetrics(const std::chrono::steady_clock::time_point &_start)
+{
+  if(!m_metrics)
+    return;
+
+  const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  const float stepTime = std::chrono::duration<float, std::milli>(now - _start).count();
+  MetricsSample &sample = m_metricsSample;
+  sample.maxStepTime = std::max(sample.maxStepTime, stepTime);
+  if(++m_metricsSteps < m_metricsInterval)
+    return;
+
+  PBF_PROFILE_SCOPE("metrics");
+  const float seconds = std::chrono::duration<float>(now - m_metricsLastPublish).count();
+  sample.step = m_step;
+  sample.elapsed = std::chrono::duration<double>(now - m_metricsStart).count();
+  sample.stepRate = seconds > 0.f ? m_metricsSteps / seconds : 0.f;
+  sample.particleStepRate = sample.stepRate * m_ownedCount;
+  sample.stepTime = stepTime;
+  sample.particles = m_ownedCount;
+  sample.ghosts = m_particles.size() - m_ownedCount;
+  sample.iterations = m_solverIterations;
+
+  // Residual of the density constraint, resting particles and neighbor counts over the owned particles
+  const float inverseRestDensity = m_solver.getParameters().inverseRestDensity;
+  const float restingSpeed2 = 0.05f * 0.05f;
+  double errorSum = 0.0;
+  float maxError = 0.f;
+  unsigned int resting = 0;
+  unsigned long neighborSum = 0;
+  unsigned int minNeighbors = m_ownedCount ? ~0u : 0;
+  unsigned int maxNeighbors = 0;
+#pragma omp parallel for schedule(static) reduction(+:errorSum, resting, neighborSum) reduction(max:maxError, maxNeighbors) reduction(min:minNeighbors)
+  for(int i = 0; i < (int)m_ownedCount; ++i)
+  {
+    const float error = std::max(m_storage[i].m_density * inverseRestDensity - 1.f, 0.f);
+    errorSum += error;
+    maxError = std::max(maxError, error);
+    resting += m_storage[i].m_vel.lengthSquared() < restingSpeed2 ? 1 : 0;
+    const unsigned int neighbors = m_nns->getNeighbors(i).second;
+    neighborSum += neighbors;
+    minNeighbors = std::min(minNeighbors, neighbors);
+    maxNeighbors = std::max(maxNeighbors, neighbors);
+  }
+  sample.meanDensityError = m_ownedCount ? errorSum / m_ownedCount : 0.f;
+  sample.maxDensityError = maxError;
+  sample.restingParticles = resting;
+  sample.movingParticles = m_ownedCount - resting;
+  sample.minNeighbors = minNeighbors;
+  sample.maxNeighbors = maxNeighbors;
+  sample.meanNeighbors = m_ownedCount ? (float)neighborSum / m_ownedCount : 0.f;
+  sample.particleBytes = m_storage.capacity() * sizeof(Particle);
+  sample.neighborBytes = (uint64_t)m_particles.size() * m_nns->getMaxNeighbors() * sizeof(unsigned int);
+  sample.residentBytes = m_metrics->residentBytes();
+
+#ifdef PBF_PROFILE
+  // Stage timings aggregated by the profiler over the last frames
+  const std::vector<ProfileStage> &stages = Profiler::instance()->getStages();
+  sample.stageCount = std::min<std::size_t>(stages.size(), sizeof(sample.stages) / sizeof(sample.stages[0]));
+  for(unsigned int s = 0; s < sample.stageCount; ++s)
+  {
+    std::strncpy(sample.stages[s].name, stages[s].name, sizeof(sample.stages[s].name) - 1);
+    sample.stages[s].index = stages[s].index;
+    sample.stages[s].meanTime = stages[s].wallTime.mean();
+    sample.stages[s].p95Time = stages[s].wallTime.percentile(0.95f);
+  }
+#endif
 
-        // Calculate the density constraint
+  m_metrics->publish(sample);
+  sample.maxStepTime = 0.f;
+  m_metricsSteps = 0;
+  m_metricsLastPublish = now;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void FluidSystem::extractSurface()
+{
+  if(!m_extractSurface)
+    return;
+
+  // The background thread meshes a copy of the particles, pick up the mesh of an earlier step
+  // and hand this step over if the thread is free
+  if(m_backgroundSurface)
+  {
+    m_mesher.fetch(m_surface);
+    m_mesher.submit(m_particles, m_ownedCount);
+  }
+  else
+  {
+    PBF_PROFILE_SCOPE("surface");
+    m_mesher.extract(m_particles, m_ownedCount, m_surface);
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+Particle *FluidSystem::findParticle(const unsigned int &_id)
+{
+  // Rebuild the table on the first lookup after the particles have moved in the storage
+  if(!m_idIndexValid)
+  {
+    unsigned int maxId = 0;
+    for(unsigned int i = 0; i < m_ownedCount; ++i)
+      maxId = std::max(maxId, m_storage[i].m_id);
+    m_idIndex.assign(m_ownedCount ? maxId + 1 : 0, -1);
+    for(unsigned int i = 0; i < m_ownedCount; ++i)
+      m_idIndex[m_storage[i].m_id] = i;
+    m_idIndexValid = true;
+  }
+
+  if(_id >= m_idIndex.size() || m_idIndex[_id] == -1)
+    return nullptr;
+  return m_particles[m_idIndex[_id]];
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void FluidSystem::setTaskScheduling(const unsigned int &_threads, const unsigned int &_tileSize)
+{
+  // The tiles have to be at least as wide as the neighbor search range so that
+  // all the neighbors of a particle are within the adjacent tiles
+  m_scheduler.reset(new TaskScheduler(_threads));
+  m_tileSize = std::max(_tileSize, (unsigned int)m_nns->getSearchRange());
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void FluidSystem::executeTiles(const float &_timeStep)
+{
+  // Insert the particles to the grid and sort them to tiles, the search structure is refitted while the particles
+  // keep their order
+  if(m_searchOrdered)
+    m_nns->update(m_particles);
+  else
+    m_nns->buildGrid(m_particles);
+  m_searchOrdered = true;
+  binTiles();
+  PBF_PROFILE_SCOPE("task graph");
+
+  // Stages of the step, each of them is run per tile:
+  //   0                  predict the positions and build the neighbor tables
+  //   1 + 3k, 2 + 3k     lambda and position update of solver iteration k
+  //   3 + 3k             apply the position update and handle the collisions, the last
+  //                      iteration also calculates the velocity
+  //   last 2             vorticity & xsph, apply the xsph and move the particles
+  const unsigned int tiles = m_activeTiles.size();
+  const unsigned int stages = 1 + 3 * m_solverIterations + 2;
+
+  // The graph is reserved for every tile of the grid with a dependency on each of the 27 tiles around it, and
+  // the captures of the tasks stay within the 16 bytes std::function of libstdc++ stores without allocating.
+  // Rebuilding the graph only allocates when the grid grows.
+  const unsigned int tileCount = m_tileCount[0] * m_tileCount[1] * m_tileCount[2];
+  m_graph.reserve(stages * tileCount, 27 * (stages - 1) * tileCount);
+
+  // Any worker may steal every tile, so each of them gets room for a scope per stage of every tile of the grid and
+  // the scopes around the graph
+  PBF_PROFILE_RESERVE(stages * tileCount + 64);
+  m_graph.clear();
+  m_graphTimeStep = _timeStep;
+  for(unsigned int stage = 0; stage < stages; ++stage)
+  {
+    for(unsigned int tile = 0; tile < tiles; ++tile)
+    {
+      const auto task = [this, stage, tile]() { runTileStage(stage, tile, m_graphTimeStep); };
+      static_assert(sizeof(task) <= 16, "The task has to fit in the local storage of std::function");
+      m_graph.addTask(task);
+    }
+  }
+
+  // A stage of a tile reads the particles of the neighboring tiles so it has to wait for the previous
+  // stage of all of them
+  for(unsigned int stage = 1; stage < stages; ++stage)
+  {
+    for(unsigned int tile = 0; tile < tiles; ++tile)
+    {
+      const std::vector<unsigned int> &neighbors = m_tileNeighbors[tile];
+      for(unsigned int n = 0; n < neighbors.size(); ++n)
+        m_graph.addDependency((stage - 1) * tiles + neighbors[n], stage * tiles + tile);
+    }
+  }
+
+  m_scheduler->run(m_graph);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void FluidSystem::binTiles()
+{
+  PBF_PROFILE_SCOPE("tiles");
+  const Vec3i &cells = m_nns->getGridSize();
+  m_tileCount[0] = (cells.m_x + m_tileSize - 1) / m_tileSize;
+  m_tileCount[1] = (cells.m_y + m_tileSize - 1) / m_tileSize;
+  m_tileCount[2] = (cells.m_z + m_tileSize - 1) / m_tileSize;
+  const unsigned int tileCount = m_tileCount[0] * m_tileCount[1] * m_tileCount[2];
+
+  // Counting sort of the particles to the tiles, the arrays keep their capacity between steps so they only
+  // reallocate when the grid or the particle count grows. Particles outside of the grid go to the closest tile,
+  // their neighbors are still within the adjacent tiles.
+  m_tileStart.assign(tileCount + 1, 0);
+  m_particleTiles.resize(m_particles.size());
+  m_tileParticles.resize(m_particles.size());
+  for(unsigned int i = 0; i < m_particles.size(); ++i)
+  {
+    int c[3];
+    m_nns->getCellCoords(m_particles[i]->m_pos, c[0], c[1], c[2]);
+    for(int a = 0; a < 3; ++a)
+      c[a] = std::min(std::max(c[a] / (int)m_tileSize, 0), m_tileCount[a] - 1);
+    m_particleTiles[i] = c[0] + c[1]*m_tileCount[0] + c[2]*m_tileCount[0]*m_tileCount[1];
+    ++m_tileStart[m_particleTiles[i] + 1];
+  }
+  for(unsigned int t = 0; t < tileCount; ++t)
+    m_tileStart[t + 1] += m_tileStart[t];
+  for(unsigned int i = 0; i < m_particles.size(); ++i)
+    m_tileParticles[m_tileStart[m_particleTiles[i]]++] = i;
+  for(unsigned int t = tileCount; t > 0; --t)
+    m_tileStart[t] = m_tileStart[t - 1];
+  m_tileStart[0] = 0;
+
+  m_activeTiles.clear();
+  m_activeTiles.reserve(tileCount);
+  m_tileIndex.assign(tileCount, -1);
+  for(unsigned int t = 0; t < tileCount; ++t)
+  {
+    if(m_tileStart[t + 1] != m_tileStart[t])
+    {
+      m_tileIndex[t] = m_activeTiles.size();
+      m_activeTiles.push_back(t);
+    }
+  }
+
+  // Find the non-empty tiles around each active tile, at most 27 of them. The lists are made for all the tiles
+  // so they're only allocated again when the grid grows.
+  if(m_tileNeighbors.size() < tileCount)
+  {
+    m_tileNeighbors.resize(tileCount);
+    for(std::vector<unsigned int> &neighbors : m_tileNeighbors)
+      neighbors.reserve(27);
+  }
+  for(unsigned int a = 0; a < m_activeTiles.size(); ++a)
+  {
+    const int t = m_activeTiles[a];
+    const int x = t % m_tileCount[0];
+    const int y = (t / m_tileCount[0]) % m_tileCount[1];
+    const int z = t / (m_tileCount[0] * m_tileCount[1]);
+    m_tileNeighbors[a].clear();
+    for(int k = std::max(z - 1, 0); k <= std::min(z + 1, m_tileCount[2] - 1); ++k)
+      for(int j = std::max(y - 1, 0); j <= std::min(y + 1, m_tileCount[1] - 1); ++j)
+        for(int i = std::max(x - 1, 0); i <= std::min(x + 1, m_tileCount[0] - 1); ++i)
+        {
+          const int index = m_tileIndex[i + j*m_tileCount[0] + k*m_tileCount[0]*m_tileCount[1]];
+          if(index != -1)
+            m_tileNeighbors[a].push_back(index);
+        }
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void FluidSystem::runTileStage(const unsigned int &_stage, const unsigned int &_tile, const float &_timeStep)
+{
+  const unsigned int tile = m_activeTiles[_tile];
+  const unsigned int *particles = m_tileParticles.data() + m_tileStart[tile];
+  const unsigned int count = m_tileStart[tile + 1] - m_tileStart[tile];
+  const unsigned int vorticityStage = 1 + 3 * m_solverIterations;
+
+  if(_stage == 0)
+  {
+    PBF_PROFILE_SCOPE("predict");
+    // Predict the positions and build the neighbor tables, the neighbor search uses the
+    // positions from the start of the step so it doesn't conflict with the prediction
+    for(unsigned int n = 0; n < count; ++n)
+    {
+      const unsigned int i = particles[n];
+      m_solver.predictPos(m_particles[i], _timeStep);
+      m_particles[i]->m_posUpdate.set(0.f, 0.f, 0.f);
+      m_nns->findNeighbors(m_particles, i);
+    }
+  }
+  else if(_stage < vorticityStage)
+  {
+    const unsigned int pass = (_stage - 1) % 3;
+    const bool lastIteration = _stage + 1 == vorticityStage;
+    const float invTimeStep = 1.f/_timeStep;
+    PBF_PROFILE_SCOPE_INDEX(pass == 0 ? "lambda" : (pass == 1 ? "update" : "collisions"), (_stage - 1) / 3);
+    for(unsigned int n = 0; n < count; ++n)
+    {
+      const unsigned int i = particles[n];
+      std::pair<unsigned int *, unsigned int> neighbors = m_nns->getNeighbors(i);
+      if(pass == 0)
+      {
         m_solver.computeLambda(m_particles, i, neighbors.first, neighbors.second);
       }
-      // Parallelise the position update calculation
-      // #pragma omp parallel for num_threads(omp_get_max_threads())
-      for(unsigned int i = 0; i < m_particles.size(); ++i)
+      else if(pass == 1)
       {
-        // Get the neighbors for a particle from the computed table
-        std::pair<unsigned int *, unsigned int> neighbors = m_nns.getNeighbors(i);
-
-        // Calculate the position update and handle the environment collisions
         m_particles[i]->m_posUpdate = m_solver.calcPositionUpdate(m_particles, i, neighbors.first, neighbors.second);
-        handleEnvCollisions(m_particles[i]);
       }
-      // Parallelising
-      // Add the position updates to the predicted positions
-      // #pragma omp parallel for num_threads(omp_get_max_threads())
-      for(unsigned int i = 0; i < m_particles.size(); ++i)
+      else
       {
+        // The collisions are handled after the update is applied as the neighboring tiles
+        // may still be reading the predicted position during the update pass
         m_particles[i]->m_predPos += m_particles[i]->m_posUpdate;
+        m_solver.handleEnvCollisions(m_particles[i], m_bb);
+        if(lastIteration)
+          m_particles[i]->m_vel = invTimeStep * (m_particles[i]->m_predPos - m_particles[i]->m_pos);
       }
     }
-
-    // Parallelising
-    // #pragma omp parallel for num_threads(omp_get_max_threads())
-    for(unsigned int i = 0; i < m_particles.size(); ++i)
+  }
+  else
+  {
+    const unsigned int pass = _stage - vorticityStage;
+    const float inverseRestDensity = m_solver.getParameters().inverseRestDensity;
+    PBF_PROFILE_SCOPE(pass == 0 ? "vorticity" : "finalize");
+    for(unsigned int n = 0; n < count; ++n)
     {
-      // Calculate the new velocity for each particle based on the old position and the newly predicted position
-      m_particles[i]->m_vel = invTimeStep * (m_particles[i]->m_predPos - m_particles[i]->m_pos);
-
-      // Get the neighbors for a particle from the computed table
-      // And compute the vorticity and xsph viscosity
-      std::pair<unsigned int *, unsigned int> neighbors = m_nns.getNeighbors(i);
-      m_solver.computeVorticityAndXSPH(m_particles, i, neighbors.first, neighbors.second, timeStep);
-
-      // Update the position to be the predicted position
-      m_particles[i]->m_pos = m_particles[i]->m_predPos;
+      const unsigned int i = particles[n];
+      if(pass == 0)
+      {
+        // Store the viscosity in the unused position update until the neighbors have read the velocity
+        std::pair<unsigned int *, unsigned int> neighbors = m_nns->getNeighbors(i);
+        float timeStep = _timeStep;
+        m_particles[i]->m_posUpdate = m_solver.computeVorticityAndXSPH(m_particles, i, neighbors.first, neighbors.second, timeStep);
+      }
+      else
+      {
+        m_particles[i]->m_vel += m_particles[i]->m_posUpdate;
+        m_particles[i]->m_pos = m_particles[i]->m_predPos;
+        if(m_frame)
+          writeFrameVertex(*m_particles[i], inverseRestDensity, m_frame[i]);
+      }
     }
-
-    // Clean the grid and the neighbor tables
-    m_nns.cleanTable();
   }
 }
 
 //----------------------------------------------------------------------------------------------------------------------
-void FluidSystem::handleEnvCollisions(Particle *io_p)
+void FluidSystem::setRelaxation(const float &_factor)
+{
+  m_relaxation = _factor;
+  m_solver.setRelaxation(_factor);
+  m_lastDensityError = std::numeric_limits<float>::max();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void FluidSystem::adaptRelaxation()
 {
-  ngl::Vec3 newPos, newVel;
-  float dist;
+  // Under-relaxation only damps the updates, there's nothing to back off from
+  if(m_relaxation <= 1.f)
+    return;
 
-  // Loop through the walls
-  for(int i = 0; i < 6; ++i)
+  // Positive part of rho / rho0 - 1 from the densities of the last iteration, the residual the metrics report. The
+  // rounding of a parallel sum depends on the thread count, so the deterministic mode sums in index order.
+  const float inverseRestDensity = m_solver.getParameters().inverseRestDensity;
+  float errorSum = 0.f;
+  if(m_deterministic)
   {
-    // Calculate the distance of the particle from the wall
-    dist = io_p->m_predPos.m_x * m_bb.m_walls[i].normal.m_x + io_p->m_predPos.m_y * m_bb.m_walls[i].normal.m_y + io_p->m_predPos.m_z * m_bb.m_walls[i].normal.m_z + m_bb.m_walls[i].d - io_p->m_radius;
-    if(dist < 0.0) // Penetrates the wall
-    {
-      // If the particle penetrated the wall, push it out using the distance of penetration and wall normal
-      // and update the predicted position accordingly
-      float restcoef = 0.5f;
-      newPos = io_p->m_predPos - 2.0*dist*m_bb.m_walls[i].normal;
-      newVel = -restcoef*(io_p->m_vel.dot(m_bb.m_walls[i].normal) * m_bb.m_walls[i].normal + (io_p->m_vel - io_p->m_vel.dot(m_bb.m_walls[i].normal) * m_bb.m_walls[i].normal));
-      io_p->m_predPos = newPos;
-      io_p->m_vel = newVel;
-    }
+    for(unsigned int i = 0; i < m_ownedCount; ++i)
+      errorSum += std::max(m_storage[i].m_density * inverseRestDensity - 1.f, 0.f);
+  }
+  else
+  {
+#pragma omp parallel for schedule(static) reduction(+:errorSum)
+    for(unsigned int i = 0; i < m_ownedCount; ++i)
+      errorSum += std::max(m_storage[i].m_density * inverseRestDensity - 1.f, 0.f);
+  }
+  float error = m_ownedCount ? errorSum / m_ownedCount : 0.f;
+#ifdef PBF_USE_MPI
+  // The ranks have to agree on the factor or the slabs would relax differently on either side of a boundary
+  if(m_domain)
+  {
+    const unsigned long count = m_domain->globalCount(m_ownedCount);
+    error = count ? (float)(m_domain->globalSum(errorSum) / count) : 0.f;
   }
+#endif
+
+  // Growing by half within a step is taken as divergence, small errors are noise. The comparison is written so
+  // that a NaN error counts as divergence too. Half of the over-relaxation is dropped at once and a twentieth of
+  // it is recovered per step after that.
+  float factor = m_solver.getRelaxation();
+  if(!(error <= std::max(1.5f * m_lastDensityError, 0.01f)))
+    factor = 1.f + 0.5f * (factor - 1.f);
+  else
+    factor = std::min(factor + 0.05f * (m_relaxation - 1.f), m_relaxation);
+  m_solver.setRelaxation(factor);
+  m_lastDensityError = error;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void FluidSystem::refreshHalo()
+{
+#ifdef PBF_USE_MPI
+  // Update the ghost particles with the latest state from their owners
+  if(m_domain)
+    m_domain->refreshHalo(m_storage, m_ownedCount);
+#endif
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void FluidSystem::updateParticleViews()
+{
+  m_particles.resize(m_storage.size());
+  for(unsigned int i = 0; i < m_storage.size(); ++i)
+    m_particles[i] = &m_storage[i];
 }
@@ -0,0 +1,224 @@
+#include <cerrno>
+#include <new>
+#if defined(__linux__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define PBF_SHARED_MEMORY
+#endif
+#include "FrameFeed.h"
+
+namespace
+{
+  // Identifies the segment and its layout, bumped whenever FrameSegment or FrameVertex change
+  const uint32_t c_magic = 0x70626632;
+  const uint32_t c_version = 2;
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief vertices     Vertices of a buffer of a segment
+  /// @param[in] _segment Segment
+  /// @param[in] _buffer  Buffer, 0 or 1
+  /// @return             First vertex of the buffer
+  //----------------------------------------------------------------------------------------------------------------------
+  inline const FrameVertex *vertices(const FrameSegment *_segment, const uint64_t &_buffer)
+  {
+    return reinterpret_cast<const FrameVertex *>(_segment + 1) + _buffer * _segment->capacity;
+  }
+}
+
+// The readers of other processes only see the generation as a plain 64-bit word
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "The generation of the frame feed has to be lock-free");
+static_assert(sizeof(FrameSegment) % alignof(FrameVertex) == 0, "The vertices have to be aligned after the header");
+
+//----------------------------------------------------------------------------------------------------------------------
+FrameFeed::FrameFeed() :
+  m_segment(nullptr)
+{
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+FrameFeed::~FrameFeed()
+{
+  close();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool FrameFeed::open(const std::string &_name, const unsigned int &_capacity)
+{
+  close();
+#ifdef PBF_SHARED_MEMORY
+  // Unlink first so that a viewer of a crashed run doesn't keep drawing the old segment
+  m_name = segmentName(_name);
+  shm_unlink(m_name.c_str());
+  const int fd = shm_open(m_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+  if(fd < 0)
+    return false;
+  const std::size_t size = segmentSize(_capacity);
+  void *memory = MAP_FAILED;
+  if(ftruncate(fd, size) == 0)
+    memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if(memory == MAP_FAILED)
+  {
+    shm_unlink(m_name.c_str());
+    return false;
+  }
+
+  // The new segment is zero filled, the header is written last so readers never see a half initialised feed
+  m_segment = new (memory) FrameSegment;
+  m_segment->pid = getpid();
+  m_segment->closed = 0;
+  m_segment->capacity = _capacity;
+  m_segment->version = c_version;
+  m_segment->generation.store(0, std::memory_order_relaxed);
+  m_segment->writing.store(0, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  m_segment->magic = c_magic;
+  return true;
+#else
+  (void)_name;
+  (void)_capacity;
+  return false;
+#endif
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void FrameFeed::close()
+{
+#ifdef PBF_SHARED_MEMORY
+  if(!m_segment)
+    return;
+  // Viewers that still have the segment mapped see the flag and attach again, e.g. after the feed has grown
+  m_segment->closed = 1;
+  munmap(m_segment, segmentSize(m_segment->capacity));
+  shm_unlink(m_name.c_str());
+  m_segment = nullptr;
+#endif
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+FrameVertex *FrameFeed::beginFrame()
+{
+  if(!m_segment)
+    return nullptr;
+  // Announce the generation before touching its buffer, a reader still on the frame two back sees it
+  const uint64_t generation = m_segment->generation.load(std::memory_order_relaxed) + 1;
+  m_segment->writing.store(generation, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  return const_cast<FrameVertex *>(vertices(m_segment, generation & 1));
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void FrameFeed::publish(const FrameHeader &_header)
+{
+  if(!m_segment)
+    return;
+
+  // The vertices and the header of the back buffer are visible before the generation that points to them
+  const uint64_t generation = m_segment->generation.load(std::memory_order_relaxed) + 1;
+  m_segment->headers[generation & 1] = _header;
+  m_segment->generation.store(generation, std::memory_order_release);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+FrameReader::FrameReader() :
+  m_segment(nullptr),
+  m_size(0),
+  m_generation(0)
+{
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+FrameReader::~FrameReader()
+{
+  detach();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool FrameReader::attach(const std::string &_name)
+{
+  detach();
+#ifdef PBF_SHARED_MEMORY
+  const int fd = shm_open(FrameFeed::segmentName(_name).c_str(), O_RDONLY, 0);
+  if(fd < 0)
+    return false;
+
+  // A segment that is still being created may not have its size yet, reading past the end would fault. Map the
+  // header to find the capacity, then the whole segment.
+  struct stat status;
+  void *memory = MAP_FAILED;
+  if(fstat(fd, &status) == 0 && (std::size_t)status.st_size >= sizeof(FrameSegment))
+    memory = mmap(nullptr, sizeof(FrameSegment), PROT_READ, MAP_SHARED, fd, 0);
+  if(memory == MAP_FAILED)
+  {
+    ::close(fd);
+    return false;
+  }
+  const FrameSegment *header = static_cast<const FrameSegment *>(memory);
+  std::atomic_thread_fence(std::memory_order_acquire);
+  const std::size_t size = FrameFeed::segmentSize(header->capacity);
+  const bool valid = header->magic == c_magic && header->version == c_version && (std::size_t)status.st_size >= size;
+  munmap(memory, sizeof(FrameSegment));
+  memory = valid ? mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+  ::close(fd);
+  if(memory == MAP_FAILED)
+    return false;
+
+  m_segment = static_cast<const FrameSegment *>(memory);
+  m_size = size;
+  m_generation = 0;
+  return true;
+#else
+  (void)_name;
+  return false;
+#endif
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void FrameReader::detach()
+{
+#ifdef PBF_SHARED_MEMORY
+  if(m_segment)
+    munmap(const_cast<FrameSegment *>(m_segment), m_size);
+#endif
+  m_segment = nullptr;
+  m_size = 0;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+const FrameVertex *FrameReader::acquire(FrameHeader &o_header)
+{
+  if(!m_segment)
+    return nullptr;
+  const uint64_t generation = m_segment->generation.load(std::memory_order_acquire);
+  if(generation == m_generation)
+    return nullptr;
+  m_generation = generation;
+  o_header = m_segment->headers[generation & 1];
+  return vertices(m_segment, generation & 1);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool FrameReader::release()
+{
+  if(!m_segment)
+    return false;
+  // The writer starts on the acquired buffer again with the frame after the next one
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return m_segment->writing.load(std::memory_order_relaxed) <= m_generation + 1;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool FrameReader::isAlive() const
+{
+  if(!m_segment || m_segment->closed)
+    return false;
+#ifdef PBF_SHARED_MEMORY
+  // A run that was killed never closes its feed
+  return kill(m_segment->pid, 0) == 0 || errno == EPERM;
+#else
+  return true;
+#endif
+}
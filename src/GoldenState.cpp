@@ -0,0 +1,129 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include "GoldenState.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+bool GoldenState::write(const std::string &_fileName, const std::vector<Particle *> &_particles, const unsigned int &_steps)
+{
+  std::ofstream file(_fileName.c_str(), std::ios::binary);
+  if(!file)
+    return false;
+
+  const unsigned int header[4] = {0x47464250u /* "PBFG" */, m_version, (unsigned int)_particles.size(), _steps};
+  file.write(reinterpret_cast<const char *>(header), sizeof(header));
+
+  const std::vector<const Particle *> particles = sortById(_particles);
+  for(unsigned int i = 0; i < particles.size(); ++i)
+  {
+    const Particle *p = particles[i];
+    const float values[m_recordSize] = {p->m_pos.m_x, p->m_pos.m_y, p->m_pos.m_z,
+                                        p->m_vel.m_x, p->m_vel.m_y, p->m_vel.m_z,
+                                        p->m_extForces.m_x, p->m_extForces.m_y, p->m_extForces.m_z,
+                                        p->m_density, p->m_lambda};
+    file.write(reinterpret_cast<const char *>(values), sizeof(values));
+  }
+  return (bool)file;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool GoldenState::compare(const std::string &_fileName, const std::vector<Particle *> &_particles, const unsigned int &_steps,
+                          const GoldenTolerance &_tolerance, std::ostream &o_report)
+{
+  std::ifstream file(_fileName.c_str(), std::ios::binary);
+  if(!file)
+  {
+    o_report << _fileName << ": could not open the golden file\n";
+    return false;
+  }
+
+  unsigned int header[4];
+  file.read(reinterpret_cast<char *>(header), sizeof(header));
+  if(!file || header[0] != 0x47464250u || header[1] != m_version)
+  {
+    o_report << _fileName << ": not a golden file of version " << m_version << "\n";
+    return false;
+  }
+  if(header[2] != _particles.size() || header[3] != _steps)
+  {
+    o_report << _fileName << ": golden file has " << header[2] << " particles after " << header[3] << " steps, run has "
+             << _particles.size() << " after " << _steps << "\n";
+    return false;
+  }
+
+  // Track the largest difference of each quantity and the id of the particle it happened at, along with
+  // the bulk quantities of both states
+  const std::vector<const Particle *> particles = sortById(_particles);
+  float maxPosition = 0.f, maxVelocity = 0.f, maxDensity = 0.f;
+  unsigned int worstPosition = 0, worstVelocity = 0, worstDensity = 0, failed = 0, bitDifferent = 0;
+  double centre[2][3] = {{0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}}, energy[2] = {0.0, 0.0}, meanDensity[2] = {0.0, 0.0};
+  for(unsigned int i = 0; i < _particles.size(); ++i)
+  {
+    float golden[m_recordSize];
+    file.read(reinterpret_cast<char *>(golden), sizeof(golden));
+    if(!file)
+    {
+      o_report << _fileName << ": golden file is truncated\n";
+      return false;
+    }
+
+    const Particle *p = particles[i];
+    const float current[m_recordSize] = {p->m_pos.m_x, p->m_pos.m_y, p->m_pos.m_z,
+                                         p->m_vel.m_x, p->m_vel.m_y, p->m_vel.m_z,
+                                         p->m_extForces.m_x, p->m_extForces.m_y, p->m_extForces.m_z,
+                                         p->m_density, p->m_lambda};
+    if(std::memcmp(golden, current, sizeof(golden)) != 0)
+      ++bitDifferent;
+
+    const float *states[2] = {golden, current};
+    for(int g = 0; g < 2; ++g)
+    {
+      for(int a = 0; a < 3; ++a)
+        centre[g][a] += states[g][a];
+      energy[g] += 0.5 * (states[g][3]*states[g][3] + states[g][4]*states[g][4] + states[g][5]*states[g][5]);
+      meanDensity[g] += states[g][9];
+    }
+
+    const float position = (Vec3(current[0], current[1], current[2]) - Vec3(golden[0], golden[1], golden[2])).length();
+    const float velocity = (Vec3(current[3], current[4], current[5]) - Vec3(golden[3], golden[4], golden[5])).length();
+    const float density = std::fabs(current[9] - golden[9]) / std::max(std::fabs(golden[9]), 1.f);
+
+    // NaNs never pass
+    if(!(position <= _tolerance.position) || !(velocity <= _tolerance.velocity) || !(density <= _tolerance.density))
+      ++failed;
+    if(!(position <= maxPosition)) { maxPosition = position; worstPosition = p->m_id; }
+    if(!(velocity <= maxVelocity)) { maxVelocity = velocity; worstVelocity = p->m_id; }
+    if(!(density <= maxDensity)) { maxDensity = density; worstDensity = p->m_id; }
+  }
+
+  // Bulk errors: centre of mass distance relative to the box scale of 1 unit, kinetic energy and
+  // mean density relative to the golden values
+  const double count = std::max((double)_particles.size(), 1.0);
+  double centreError = 0.0;
+  for(int a = 0; a < 3; ++a)
+    centreError += (centre[1][a] - centre[0][a]) * (centre[1][a] - centre[0][a]) / (count * count);
+  centreError = std::sqrt(centreError);
+  const double energyError = std::fabs(energy[1] - energy[0]) / std::max(std::fabs(energy[0]), 1e-6);
+  const double densityError = std::fabs(meanDensity[1] - meanDensity[0]) / std::max(std::fabs(meanDensity[0]), 1e-6);
+  const bool bulkPassed = _tolerance.bulk > 0.f && centreError <= _tolerance.bulk &&
+                          energyError <= _tolerance.bulk && densityError <= _tolerance.bulk;
+  const bool passed = failed == 0 || bulkPassed;
+
+  o_report << _fileName << ": " << bitDifferent << " of " << _particles.size() << " particles differ from the golden state\n"
+           << "  max position error " << maxPosition << " (particle id " << worstPosition << ")\n"
+           << "  max velocity error " << maxVelocity << " (particle id " << worstVelocity << ")\n"
+           << "  max relative density error " << maxDensity << " (particle id " << worstDensity << ")\n"
+           << "  bulk errors: centre of mass " << centreError << ", kinetic energy " << energyError << ", mean density " << densityError << "\n"
+           << "  " << (passed ? "PASS" : "FAIL") << " (" << failed << " particles outside the tolerances"
+           << (failed != 0 && bulkPassed ? ", bulk within tolerance)\n" : ")\n");
+  return passed;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+std::vector<const Particle *> GoldenState::sortById(const std::vector<Particle *> &_particles)
+{
+  std::vector<const Particle *> sorted(_particles.begin(), _particles.end());
+  std::sort(sorted.begin(), sorted.end(), [](const Particle *_a, const Particle *_b) { return _a->m_id < _b->m_id; });
+  return sorted;
+}
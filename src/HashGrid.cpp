@@ -0,0 +1,112 @@
+#include <algorithm>
+#include <cmath>
+#include "HashGrid.h"
+#include "Profiler.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+void HashGrid::initStructure()
+{
+  // At least twice as many buckets as particles keeps the shared buckets rare, grown by buildGrid() if needed
+  unsigned int buckets = 64;
+  while(buckets < 2 * m_particleCount)
+    buckets *= 2;
+  m_bucketMask = buckets - 1;
+  m_bucketStart.assign(buckets + 1, 0);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+Vec3i HashGrid::getHashCell(const Vec3 &_p) const
+{
+  // The cells continue past the bounding box in every direction
+  const float inverseSize = 1.f / m_fixedRadius;
+  return Vec3i((int)std::floor((_p.m_x - m_bb.m_minx) * inverseSize),
+               (int)std::floor((_p.m_y - m_bb.m_miny) * inverseSize),
+               (int)std::floor((_p.m_z - m_bb.m_minz) * inverseSize));
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+unsigned int HashGrid::getBucket(const int &_x, const int &_y, const int &_z) const
+{
+  return ((unsigned int)_x * 73856093u ^ (unsigned int)_y * 19349663u ^ (unsigned int)_z * 83492791u) & m_bucketMask;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void HashGrid::buildGrid(const std::vector<Particle *> &_particles)
+{
+  PBF_PROFILE_SCOPE("grid");
+  if(m_bucketMask + 1 < 2 * m_particleCount)
+    initStructure();
+  m_particleBuckets.resize(m_particleCount);
+  m_sortedParticles.resize(m_particleCount);
+  m_sortedPositions.resize(m_particleCount);
+  m_sortedCells.resize(m_particleCount);
+
+  // Hash the particles in parallel, the counting sort is serial so a bucket keeps its particles in index order
+#pragma omp parallel for schedule(static)
+  for(unsigned int i = 0; i < m_particleCount; ++i)
+  {
+    const Vec3i cell = getHashCell(_particles[i]->m_pos);
+    m_particleBuckets[i] = getBucket(cell.m_x, cell.m_y, cell.m_z);
+  }
+
+  // Count the particles of each bucket, sum to the bucket ends and scatter backwards so the ends become the starts
+  const unsigned int buckets = m_bucketMask + 1;
+  std::fill(m_bucketStart.begin(), m_bucketStart.end(), 0u);
+  for(unsigned int i = 0; i < m_particleCount; ++i)
+    ++m_bucketStart[m_particleBuckets[i]];
+  for(unsigned int b = 1; b < buckets; ++b)
+    m_bucketStart[b] += m_bucketStart[b - 1];
+  m_bucketStart[buckets] = m_particleCount;
+  for(unsigned int i = m_particleCount; i-- > 0; )
+    m_sortedParticles[--m_bucketStart[m_particleBuckets[i]]] = i;
+
+#pragma omp parallel for schedule(static)
+  for(unsigned int s = 0; s < m_particleCount; ++s)
+  {
+    m_sortedPositions[s] = _particles[m_sortedParticles[s]]->m_pos;
+    m_sortedCells[s] = getHashCell(m_sortedPositions[s]);
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+template <typename F>
+void HashGrid::forEachInRange(const Vec3 &_p, const float &_radius, F _f) const
+{
+  // The cells overlapped by the box around the query, 27 at most for the search radius
+  const Vec3i low = getHashCell(Vec3(_p.m_x - _radius, _p.m_y - _radius, _p.m_z - _radius));
+  const Vec3i high = getHashCell(Vec3(_p.m_x + _radius, _p.m_y + _radius, _p.m_z + _radius));
+  const float r2 = _radius * _radius;
+  for(int z = low.m_z; z <= high.m_z; ++z)
+    for(int y = low.m_y; y <= high.m_y; ++y)
+      for(int x = low.m_x; x <= high.m_x; ++x)
+      {
+        const Vec3i cell(x, y, z);
+        const unsigned int bucket = getBucket(x, y, z);
+        for(unsigned int s = m_bucketStart[bucket]; s < m_bucketStart[bucket + 1]; ++s)
+        {
+          if(m_sortedCells[s] == cell && (m_sortedPositions[s] - _p).lengthSquared() < r2)
+            _f(m_sortedParticles[s]);
+        }
+      }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void HashGrid::findNeighbors(const std::vector<Particle *> &_particles, const unsigned int &_pid)
+{
+  unsigned int *neighbors = &m_neighbors[(std::size_t)_pid * m_maxNeighbors];
+  unsigned int &count = m_numNeighbors[_pid];
+  count = 0;
+  forEachInRange(_particles[_pid]->m_pos, m_fixedRadius, [&](const unsigned int &_p)
+  {
+    if(_p != _pid && count < m_maxNeighbors)
+      neighbors[count++] = _p;
+  });
+  finishNeighbors(_pid);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void HashGrid::rangeQuery(const std::vector<Particle *> &, const Vec3 &_p, const float &_radius, std::vector<unsigned int> &o_indices) const
+{
+  o_indices.clear();
+  forEachInRange(_p, _radius, [&](const unsigned int &_i) { o_indices.push_back(_i); });
+}
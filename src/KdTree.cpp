@@ -0,0 +1,209 @@
+#include <algorithm>
+#include "KdTree.h"
+#include "Profiler.h"
+
+namespace
+{
+  // Nodes with at most this many particles are leaves
+  const unsigned int c_leafSize = 12;
+
+  // Subtrees with more particles than this are built and refitted as tasks
+  const unsigned int c_taskSize = 8192;
+
+  // Steps the planes are refitted for before the tree is built again
+  const unsigned int c_maxRefits = 8;
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief coordinate Component of a vector along an axis
+  /// @param[in] _v     Vector
+  /// @param[in] _axis  0, 1 or 2
+  /// @return           Component
+  //----------------------------------------------------------------------------------------------------------------------
+  inline float coordinate(const Vec3 &_v, const unsigned int &_axis)
+  {
+    return _axis == 0 ? _v.m_x : (_axis == 1 ? _v.m_y : _v.m_z);
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void KdTree::buildGrid(const std::vector<Particle *> &_particles)
+{
+  PBF_PROFILE_SCOPE("grid");
+  m_refits = 0;
+  m_sortedParticles.resize(m_particleCount);
+  m_sortedPositions.resize(m_particleCount);
+  for(unsigned int i = 0; i < m_particleCount; ++i)
+    m_sortedParticles[i] = i;
+
+  // The halves differ by one particle at most, so the depth and the amount of nodes follow from the particle count
+  unsigned int depth = 0;
+  for(unsigned int size = m_particleCount; size > c_leafSize; size = (size + 1) / 2)
+    ++depth;
+  m_lowerMax.resize((2u << depth) - 1);
+  m_upperMin.resize(m_lowerMax.size());
+  m_axes.resize(m_lowerMax.size());
+
+#pragma omp parallel
+  {
+#pragma omp single
+    buildNode(_particles, 0, 0, m_particleCount);
+  }
+
+#pragma omp parallel for schedule(static)
+  for(unsigned int s = 0; s < m_particleCount; ++s)
+    m_sortedPositions[s] = _particles[m_sortedParticles[s]]->m_pos;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void KdTree::buildNode(const std::vector<Particle *> &_particles, const unsigned int &_node, const unsigned int &_begin, const unsigned int &_end)
+{
+  if(_end - _begin <= c_leafSize)
+    return;
+
+  // Split the longest side of the bounds of the particles at their median
+  Vec3 low = _particles[m_sortedParticles[_begin]]->m_pos, high = low;
+  for(unsigned int s = _begin + 1; s < _end; ++s)
+  {
+    const Vec3 &p = _particles[m_sortedParticles[s]]->m_pos;
+    low.set(std::min(low.m_x, p.m_x), std::min(low.m_y, p.m_y), std::min(low.m_z, p.m_z));
+    high.set(std::max(high.m_x, p.m_x), std::max(high.m_y, p.m_y), std::max(high.m_z, p.m_z));
+  }
+  const Vec3 extent = high - low;
+  const unsigned int axis = extent.m_x >= extent.m_y && extent.m_x >= extent.m_z ? 0 : (extent.m_y >= extent.m_z ? 1 : 2);
+  const unsigned int mid = (_begin + _end) / 2;
+  std::nth_element(m_sortedParticles.begin() + _begin, m_sortedParticles.begin() + mid, m_sortedParticles.begin() + _end,
+                   [&](const unsigned int &_a, const unsigned int &_b)
+  {
+    return coordinate(_particles[_a]->m_pos, axis) < coordinate(_particles[_b]->m_pos, axis);
+  });
+  m_lowerMax[_node] = m_upperMin[_node] = coordinate(_particles[m_sortedParticles[mid]]->m_pos, axis);
+  m_axes[_node] = axis;
+
+  // The halves don't overlap so they can be built at the same time, the particles are shared as a task would
+  // otherwise take a copy of the vector
+#pragma omp task shared(_particles) if(_end - _begin > c_taskSize)
+  buildNode(_particles, 2 * _node + 1, _begin, mid);
+  buildNode(_particles, 2 * _node + 2, mid, _end);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void KdTree::update(const std::vector<Particle *> &_particles)
+{
+  if(m_particleCount == 0 || m_sortedPositions.size() != m_particleCount || m_refits == c_maxRefits)
+  {
+    buildGrid(_particles);
+    return;
+  }
+
+  PBF_PROFILE_SCOPE("grid");
+  ++m_refits;
+#pragma omp parallel for schedule(static)
+  for(unsigned int s = 0; s < m_particleCount; ++s)
+    m_sortedPositions[s] = _particles[m_sortedParticles[s]]->m_pos;
+
+  Vec3 low, high;
+#pragma omp parallel
+  {
+#pragma omp single
+    refitNode(0, 0, m_particleCount, low, high);
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void KdTree::refitNode(const unsigned int &_node, const unsigned int &_begin, const unsigned int &_end, Vec3 &o_low, Vec3 &o_high)
+{
+  if(_end - _begin <= c_leafSize)
+  {
+    o_low = o_high = m_sortedPositions[_begin];
+    for(unsigned int s = _begin + 1; s < _end; ++s)
+    {
+      const Vec3 &p = m_sortedPositions[s];
+      o_low.set(std::min(o_low.m_x, p.m_x), std::min(o_low.m_y, p.m_y), std::min(o_low.m_z, p.m_z));
+      o_high.set(std::max(o_high.m_x, p.m_x), std::max(o_high.m_y, p.m_y), std::max(o_high.m_z, p.m_z));
+    }
+    return;
+  }
+
+  // The bounds of the halves are needed for the planes of this node, so unlike the build it waits for the task
+  const unsigned int mid = (_begin + _end) / 2;
+  Vec3 lowerLow, lowerHigh, upperLow, upperHigh;
+#pragma omp task shared(lowerLow, lowerHigh) if(_end - _begin > c_taskSize)
+  refitNode(2 * _node + 1, _begin, mid, lowerLow, lowerHigh);
+  refitNode(2 * _node + 2, mid, _end, upperLow, upperHigh);
+#pragma omp taskwait
+
+  const unsigned int axis = m_axes[_node];
+  m_lowerMax[_node] = coordinate(lowerHigh, axis);
+  m_upperMin[_node] = coordinate(upperLow, axis);
+  o_low.set(std::min(lowerLow.m_x, upperLow.m_x), std::min(lowerLow.m_y, upperLow.m_y), std::min(lowerLow.m_z, upperLow.m_z));
+  o_high.set(std::max(lowerHigh.m_x, upperHigh.m_x), std::max(lowerHigh.m_y, upperHigh.m_y), std::max(lowerHigh.m_z, upperHigh.m_z));
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+template <typename F>
+void KdTree::forEachInRange(const Vec3 &_p, const float &_radius, F _f) const
+{
+  if(!m_particleCount)
+    return;
+
+  // Depth first with the lower half on top so the particles come in leaf order, a node adds at most one more entry
+  // to the stack than it takes off
+  const float r2 = _radius * _radius;
+  unsigned int stack[3 * 64];
+  unsigned int top = 0;
+  stack[top++] = 0;
+  stack[top++] = 0;
+  stack[top++] = m_particleCount;
+  while(top)
+  {
+    const unsigned int end = stack[--top];
+    const unsigned int begin = stack[--top];
+    const unsigned int node = stack[--top];
+    if(end - begin <= c_leafSize)
+    {
+      for(unsigned int s = begin; s < end; ++s)
+      {
+        if((m_sortedPositions[s] - _p).lengthSquared() < r2)
+          _f(m_sortedParticles[s]);
+      }
+      continue;
+    }
+
+    // The lower half is at most at its plane and the upper half at least at its own
+    const float p = coordinate(_p, m_axes[node]);
+    const unsigned int mid = (begin + end) / 2;
+    if(m_upperMin[node] - p < _radius)
+    {
+      stack[top++] = 2 * node + 2;
+      stack[top++] = mid;
+      stack[top++] = end;
+    }
+    if(p - m_lowerMax[node] < _radius)
+    {
+      stack[top++] = 2 * node + 1;
+      stack[top++] = begin;
+      stack[top++] = mid;
+    }
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void KdTree::findNeighbors(const std::vector<Particle *> &_particles, const unsigned int &_pid)
+{
+  unsigned int *neighbors = &m_neighbors[(std::size_t)_pid * m_maxNeighbors];
+  unsigned int &count = m_numNeighbors[_pid];
+  count = 0;
+  forEachInRange(_particles[_pid]->m_pos, m_fixedRadius, [&](const unsigned int &_p)
+  {
+    if(_p != _pid && count < m_maxNeighbors)
+      neighbors[count++] = _p;
+  });
+  finishNeighbors(_pid);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void KdTree::rangeQuery(const std::vector<Particle *> &, const Vec3 &_p, const float &_radius, std::vector<unsigned int> &o_indices) const
+{
+  o_indices.clear();
+  forEachInRange(_p, _radius, [&](const unsigned int &_i) { o_indices.push_back(_i); });
+}
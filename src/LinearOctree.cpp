@@ -0,0 +1,236 @@
+#include <algorithm>
+#include "LinearOctree.h"
+#include "Profiler.h"
+
+namespace
+{
+  // Quantisation steps per axis as a power of two, three bits per level fit a 32-bit code
+  const unsigned int c_levels = 10;
+
+  // Octants with at most this many particles aren't split any further
+  const unsigned int c_leafSize = 16;
+
+  // Steps the octants are refitted for before the tree is built again
+  const unsigned int c_maxRefits = 8;
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief spreadBits Moves the lowest 10 bits of a value two bits apart
+  /// @param[in] _v     Value
+  /// @return           Spread bits
+  //----------------------------------------------------------------------------------------------------------------------
+  inline uint32_t spreadBits(uint32_t _v)
+  {
+    _v = (_v | (_v << 16)) & 0x030000ff;
+    _v = (_v | (_v << 8)) & 0x0300f00f;
+    _v = (_v | (_v << 4)) & 0x030c30c3;
+    _v = (_v | (_v << 2)) & 0x09249249;
+    return _v;
+  }
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief axisDistance Distance from a coordinate to an interval
+  /// @param[in] _p       Coordinate
+  /// @param[in] _min     Start of the interval
+  /// @param[in] _max     End of the interval
+  /// @return             Distance, 0 inside the interval
+  //----------------------------------------------------------------------------------------------------------------------
+  inline float axisDistance(const float &_p, const float &_min, const float &_max)
+  {
+    return _p < _min ? _min - _p : (_p > _max ? _p - _max : 0.f);
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void LinearOctree::buildGrid(const std::vector<Particle *> &_particles)
+{
+  PBF_PROFILE_SCOPE("grid");
+  m_refits = 0;
+  m_nodes.clear();
+  m_keys.resize(m_particleCount);
+  m_sortedParticles.resize(m_particleCount);
+  m_sortedPositions.resize(m_particleCount);
+  if(!m_particleCount)
+    return;
+
+  // The root is the cube around the particles, slightly enlarged so the furthest particles stay inside
+  Vec3 low = _particles[0]->m_pos, high = low;
+  for(unsigned int i = 1; i < m_particleCount; ++i)
+  {
+    const Vec3 &p = _particles[i]->m_pos;
+    low.set(std::min(low.m_x, p.m_x), std::min(low.m_y, p.m_y), std::min(low.m_z, p.m_z));
+    high.set(std::max(high.m_x, p.m_x), std::max(high.m_y, p.m_y), std::max(high.m_z, p.m_z));
+  }
+  float size = std::max(high.m_x - low.m_x, std::max(high.m_y - low.m_y, high.m_z - low.m_z)) * 1.0001f;
+  if(size <= 0.f)
+    size = 1.f;
+
+  // The codes are sorted together with the indices so equal codes keep the particle order
+  const unsigned int steps = 1 << c_levels;
+  const float scale = steps / size;
+#pragma omp parallel for schedule(static)
+  for(unsigned int i = 0; i < m_particleCount; ++i)
+  {
+    const Vec3 q = (_particles[i]->m_pos - low) * scale;
+    const uint32_t x = std::min((uint32_t)q.m_x, steps - 1);
+    const uint32_t y = std::min((uint32_t)q.m_y, steps - 1);
+    const uint32_t z = std::min((uint32_t)q.m_z, steps - 1);
+    m_keys[i] = std::make_pair(spreadBits(x) | spreadBits(y) << 1 | spreadBits(z) << 2, i);
+  }
+  std::sort(m_keys.begin(), m_keys.end());
+
+#pragma omp parallel for schedule(static)
+  for(unsigned int s = 0; s < m_particleCount; ++s)
+  {
+    m_sortedParticles[s] = m_keys[s].second;
+    m_sortedPositions[s] = _particles[m_keys[s].second]->m_pos;
+  }
+
+  OctreeNode root = {low, low + Vec3(size, size, size), 0, 0, m_particleCount, -1, 0};
+  m_nodes.push_back(root);
+  buildNode(0, 0);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void LinearOctree::update(const std::vector<Particle *> &_particles)
+{
+  if(m_nodes.empty() || m_sortedPositions.size() != m_particleCount || m_refits == c_maxRefits)
+  {
+    buildGrid(_particles);
+    return;
+  }
+
+  PBF_PROFILE_SCOPE("grid");
+  ++m_refits;
+#pragma omp parallel for schedule(static)
+  for(unsigned int s = 0; s < m_particleCount; ++s)
+    m_sortedPositions[s] = _particles[m_sortedParticles[s]]->m_pos;
+
+  // The leaves are bound by their particles and the other octants by their children, the children come after
+  // their parent so walking the octants backwards reaches them first
+  const int nodeCount = m_nodes.size();
+#pragma omp parallel for schedule(static)
+  for(int n = 0; n < nodeCount; ++n)
+  {
+    OctreeNode &node = m_nodes[n];
+    if(node.firstChild >= 0)
+      continue;
+    Vec3 low = m_sortedPositions[node.begin], high = low;
+    for(unsigned int s = node.begin + 1; s < node.end; ++s)
+    {
+      const Vec3 &p = m_sortedPositions[s];
+      low.set(std::min(low.m_x, p.m_x), std::min(low.m_y, p.m_y), std::min(low.m_z, p.m_z));
+      high.set(std::max(high.m_x, p.m_x), std::max(high.m_y, p.m_y), std::max(high.m_z, p.m_z));
+    }
+    node.min = low;
+    node.max = high;
+  }
+  for(int n = nodeCount; n-- > 0; )
+  {
+    OctreeNode &node = m_nodes[n];
+    if(node.firstChild < 0)
+      continue;
+    Vec3 low = m_nodes[node.firstChild].min, high = m_nodes[node.firstChild].max;
+    for(unsigned int c = 1; c < node.childCount; ++c)
+    {
+      const OctreeNode &child = m_nodes[node.firstChild + c];
+      low.set(std::min(low.m_x, child.min.m_x), std::min(low.m_y, child.min.m_y), std::min(low.m_z, child.min.m_z));
+      high.set(std::max(high.m_x, child.max.m_x), std::max(high.m_y, child.max.m_y), std::max(high.m_z, child.max.m_z));
+    }
+    node.min = low;
+    node.max = high;
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void LinearOctree::buildNode(const unsigned int &_node, const unsigned int &_level)
+{
+  // Copied as adding the children moves the nodes
+  const OctreeNode parent = m_nodes[_node];
+  if(parent.end - parent.begin <= c_leafSize || _level == c_levels)
+    return;
+
+  // The children split the code range of the octant in eight, the first code past a child ends it
+  const unsigned int shift = 3 * (c_levels - _level - 1);
+  const float half = 0.5f * (parent.max.m_x - parent.min.m_x);
+  m_nodes[_node].firstChild = m_nodes.size();
+  unsigned int first = parent.begin;
+  for(uint32_t c = 0; c < 8; ++c)
+  {
+    const uint32_t code = parent.code | c << shift;
+    unsigned int last = parent.end;
+    if(c < 7)
+      last = std::lower_bound(m_keys.begin() + first, m_keys.begin() + parent.end, std::make_pair(code + (1u << shift), 0u)) - m_keys.begin();
+    if(last > first)
+    {
+      const Vec3 min = parent.min + half * Vec3(c & 1, (c >> 1) & 1, (c >> 2) & 1);
+      OctreeNode child = {min, min + Vec3(half, half, half), code, first, last, -1, 0};
+      m_nodes.push_back(child);
+      ++m_nodes[_node].childCount;
+    }
+    first = last;
+  }
+
+  const unsigned int firstChild = m_nodes[_node].firstChild;
+  const unsigned int childCount = m_nodes[_node].childCount;
+  for(unsigned int c = 0; c < childCount; ++c)
+    buildNode(firstChild + c, _level + 1);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+template <typename F>
+void LinearOctree::forEachInRange(const Vec3 &_p, const float &_radius, F _f) const
+{
+  if(m_nodes.empty())
+    return;
+
+  // Depth first with the children pushed in reverse so the particles come in Morton order, a level adds at most
+  // seven octants to the stack
+  const float r2 = _radius * _radius;
+  unsigned int stack[8 * (c_levels + 1)];
+  unsigned int top = 0;
+  stack[top++] = 0;
+  while(top)
+  {
+    const OctreeNode &node = m_nodes[stack[--top]];
+    const float dx = axisDistance(_p.m_x, node.min.m_x, node.max.m_x);
+    const float dy = axisDistance(_p.m_y, node.min.m_y, node.max.m_y);
+    const float dz = axisDistance(_p.m_z, node.min.m_z, node.max.m_z);
+    if(dx*dx + dy*dy + dz*dz >= r2)
+      continue;
+
+    if(node.firstChild < 0)
+    {
+      for(unsigned int s = node.begin; s < node.end; ++s)
+      {
+        if((m_sortedPositions[s] - _p).lengthSquared() < r2)
+          _f(m_sortedParticles[s]);
+      }
+    }
+    else
+    {
+      for(unsigned int c = node.childCount; c-- > 0; )
+        stack[top++] = node.firstChild + c;
+    }
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void LinearOctree::findNeighbors(const std::vector<Particle *> &_particles, const unsigned int &_pid)
+{
+  unsigned int *neighbors = &m_neighbors[(std::size_t)_pid * m_maxNeighbors];
+  unsigned int &count = m_numNeighbors[_pid];
+  count = 0;
+  forEachInRange(_particles[_pid]->m_pos, m_fixedRadius, [&](const unsigned int &_p)
+  {
+    if(_p != _pid && count < m_maxNeighbors)
+      neighbors[count++] = _p;
+  });
+  finishNeighbors(_pid);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void LinearOctree::rangeQuery(const std::vector<Particle *> &, const Vec3 &_p, const float &_radius, std::vector<unsigned int> &o_indices) const
+{
+  o_indices.clear();
+  forEachInRange(_p, _radius, [&](const unsigned int &_i) { o_indices.push_back(_i); });
+}
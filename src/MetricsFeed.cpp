@@ -0,0 +1,247 @@
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#if defined(__linux__) || defined(__APPLE__)
+#include <dirent.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define PBF_SHARED_MEMORY
+#endif
+#include "MetricsFeed.h"
+
+namespace
+{
+  // Identifies the segment and its layout, bumped whenever MetricsSample changes
+  const uint32_t c_magic = 0x70626631;
+  const uint32_t c_version = 1;
+}
+
+// The readers of other processes only see the sequence as a plain 64-bit word
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "The sequence of the metrics feed has to be lock-free");
+
+//----------------------------------------------------------------------------------------------------------------------
+MetricsFeed::MetricsFeed() :
+  m_segment(nullptr),
+  m_statm(-1)
+{
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+MetricsFeed::~MetricsFeed()
+{
+  close();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool MetricsFeed::open(const std::string &_name)
+{
+  close();
+#ifdef PBF_SHARED_MEMORY
+  // Unlink first so that a reader of a crashed run doesn't keep watching the old segment
+  m_name = segmentName(_name);
+  shm_unlink(m_name.c_str());
+  const int fd = shm_open(m_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+  if(fd < 0)
+    return false;
+  void *memory = MAP_FAILED;
+  if(ftruncate(fd, sizeof(MetricsSegment)) == 0)
+    memory = mmap(nullptr, sizeof(MetricsSegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if(memory == MAP_FAILED)
+  {
+    shm_unlink(m_name.c_str());
+    return false;
+  }
+
+  // The new segment is zero filled, the header is written last so readers never see a half initialised feed
+  m_segment = new (memory) MetricsSegment;
+  m_segment->pid = getpid();
+  m_segment->closed = 0;
+  m_segment->version = c_version;
+  m_segment->sequence.store(0, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  m_segment->magic = c_magic;
+#ifdef __linux__
+  m_statm = ::open("/proc/self/statm", O_RDONLY);
+#endif
+  return true;
+#else
+  (void)_name;
+  return false;
+#endif
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void MetricsFeed::close()
+{
+#ifdef PBF_SHARED_MEMORY
+  if(!m_segment)
+    return;
+  // Readers that still have the segment mapped see the flag, new readers can't find it anymore
+  m_segment->closed = 1;
+  munmap(m_segment, sizeof(MetricsSegment));
+  shm_unlink(m_name.c_str());
+  m_segment = nullptr;
+  if(m_statm >= 0)
+    ::close(m_statm);
+  m_statm = -1;
+#endif
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void MetricsFeed::publish(const MetricsSample &_sample)
+{
+  if(!m_segment)
+    return;
+
+  // Seqlock write, the sequence is odd while the sample is being copied
+  const uint64_t sequence = m_segment->sequence.load(std::memory_order_relaxed);
+  m_segment->sequence.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  std::memcpy(&m_segment->sample, &_sample, sizeof(MetricsSample));
+  m_segment->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+std::vector<std::string> MetricsFeed::list()
+{
+  std::vector<std::string> names;
+#ifdef __linux__
+  // Linux keeps the POSIX shared memory segments as files in /dev/shm
+  DIR *directory = opendir("/dev/shm");
+  if(!directory)
+    return names;
+  while(dirent *entry = readdir(directory))
+  {
+    if(std::strncmp(entry->d_name, "pbf.", 4) == 0)
+      names.push_back(entry->d_name + 4);
+  }
+  closedir(directory);
+#endif
+  return names;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+uint64_t MetricsFeed::residentBytes() const
+{
+#ifdef __linux__
+  // The kernel writes statm out again on every read from the start, the second field is the resident set in pages
+  if(m_statm < 0)
+    return 0;
+  char buffer[128];
+  const ssize_t length = pread(m_statm, buffer, sizeof(buffer) - 1, 0);
+  if(length <= 0)
+    return 0;
+  buffer[length] = '\0';
+  char *field = nullptr;
+  std::strtoul(buffer, &field, 10);
+  const unsigned long resident = std::strtoul(field, nullptr, 10);
+  return (uint64_t)resident * sysconf(_SC_PAGESIZE);
+#else
+  return 0;
+#endif
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+MetricsReader::MetricsReader() :
+  m_segment(nullptr),
+  m_lastSequence(0)
+{
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+MetricsReader::~MetricsReader()
+{
+  detach();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool MetricsReader::attach(const std::string &_name)
+{
+  detach();
+#ifdef PBF_SHARED_MEMORY
+  const int fd = shm_open(MetricsFeed::segmentName(_name).c_str(), O_RDONLY, 0);
+  if(fd < 0)
+    return false;
+  // A segment that is still being created may not have its size yet, reading past the end would fault
+  struct stat status;
+  void *memory = MAP_FAILED;
+  if(fstat(fd, &status) == 0 && (std::size_t)status.st_size >= sizeof(MetricsSegment))
+    memory = mmap(nullptr, sizeof(MetricsSegment), PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if(memory == MAP_FAILED)
+    return false;
+
+  m_segment = static_cast<const MetricsSegment *>(memory);
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if(m_segment->magic != c_magic || m_segment->version != c_version)
+  {
+    detach();
+    return false;
+  }
+  m_lastSequence = 0;
+  return true;
+#else
+  (void)_name;
+  return false;
+#endif
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void MetricsReader::detach()
+{
+#ifdef PBF_SHARED_MEMORY
+  if(m_segment)
+    munmap(const_cast<MetricsSegment *>(m_segment), sizeof(MetricsSegment));
+#endif
+  m_segment = nullptr;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool MetricsReader::read(MetricsSample &o_sample)
+{
+  if(!m_segment)
+    return false;
+
+  // Seqlock read, retry while the writer is in the middle of a copy or has moved on during ours. A writer that
+  // was killed in the middle of a copy leaves the sequence odd, give up after a while.
+  for(int attempt = 0; attempt < 100000; ++attempt)
+  {
+    const uint64_t before = m_segment->sequence.load(std::memory_order_acquire);
+    if(before & 1)
+      continue;
+    if(before == m_lastSequence)
+      return false;
+    std::memcpy(&o_sample, &m_segment->sample, sizeof(MetricsSample));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if(m_segment->sequence.load(std::memory_order_relaxed) == before)
+    {
+      m_lastSequence = before;
+      return true;
+    }
+  }
+  return false;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool MetricsReader::isAlive() const
+{
+  if(!m_segment || m_segment->closed)
+    return false;
+#ifdef PBF_SHARED_MEMORY
+  // A run that was killed never closes its feed
+  return kill(m_segment->pid, 0) == 0 || errno == EPERM;
+#else
+  return true;
+#endif
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+int MetricsReader::getPid() const
+{
+  return m_segment ? m_segment->pid : 0;
+}
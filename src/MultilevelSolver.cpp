@@ -0,0 +1,218 @@
+#include <algorithm>
+#include <cmath>
+#include "MultilevelSolver.h"
+#include "Profiler.h"
+
+namespace
+{
+  // The smoothing length of a level spans 1.5 of its blocks like it spans 1.5 cells of the fine grid
+  const int c_searchRange = 2;
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief spikyGradient  Spiky kernel gradient of a coarse level
+  /// @param[in] _v         Vector from the neighbor to the proxy
+  /// @param[in] _r2        Squared length of the vector
+  /// @param[in] _h         Smoothing length of the level
+  /// @param[in] _constant  Spiky kernel constant of the level
+  /// @return               Gradient vector
+  //----------------------------------------------------------------------------------------------------------------------
+  Vec3 spikyGradient(const Vec3 &_v, const float &_r2, const float &_h, const float &_constant)
+  {
+    if(_r2 == 0.f)
+      return Vec3(0.f, 0.f, 0.f);
+    const float r = std::sqrt(_r2);
+    const float tmp = _h - r;
+    return (_constant * tmp*tmp / r) * _v;
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+MultilevelSolver::MultilevelSolver() :
+  m_levels(0),
+  m_iterations(2)
+{
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void MultilevelSolver::configure(const unsigned int &_levels, const unsigned int &_iterations)
+{
+  m_levels = _levels;
+  m_iterations = std::max(_iterations, 1u);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void MultilevelSolver::project(std::vector<Particle *> &io_particles, const unsigned int &_count, NNS &_nns, FluidSolver &_solver, const BoundingBox &_bb)
+{
+  if(!isEnabled() || !_count)
+    return;
+
+  // Coarsest first, every level is clustered from the particles the previous levels already moved
+  const SolverParameters parameters = _solver.getParameters();
+  const float h = parameters.smoothingLength;
+  const float mass = io_particles[0]->m_mass;
+  const float selfDensity = mass * parameters.polyKernelConstant * h*h*h*h*h*h;
+  for(unsigned int level = m_levels; level > 0; --level)
+  {
+    PBF_PROFILE_SCOPE_INDEX("level", level);
+    buildLevel(io_particles, _count, _nns, level);
+    if(m_positions.size() < 2)
+      continue;
+    projectLevel(h * (1 << level), mass, selfDensity, _solver);
+
+    // Prolongate the corrections, each particle moves with its proxy
+#pragma omp parallel for schedule(static)
+    for(unsigned int i = 0; i < _count; ++i)
+    {
+      io_particles[i]->m_predPos += m_displacements[m_blockProxies[m_particleBlocks[i]]];
+      _solver.handleEnvCollisions(io_particles[i], _bb);
+    }
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void MultilevelSolver::buildLevel(const std::vector<Particle *> &_particles, const unsigned int &_count, NNS &_nns, const unsigned int &_level)
+{
+  // Blocks of the cells the neighbor lists were built from, the particles outside of the grid join the border blocks
+  const Vec3i &cells = _nns.getGridSize();
+  const int size = 1 << _level;
+  const int blocks[3] = {(cells.m_x + size - 1) / size, (cells.m_y + size - 1) / size, (cells.m_z + size - 1) / size};
+  m_particleBlocks.resize(_count);
+#pragma omp parallel for schedule(static)
+  for(unsigned int i = 0; i < _count; ++i)
+  {
+    int x, y, z;
+    _nns.getCellCoords(_particles[i]->m_pos, x, y, z);
+    x = std::min(std::max(x, 0), cells.m_x - 1) >> _level;
+    y = std::min(std::max(y, 0), cells.m_y - 1) >> _level;
+    z = std::min(std::max(z, 0), cells.m_z - 1) >> _level;
+    m_particleBlocks[i] = x + (y + z * blocks[1]) * blocks[0];
+  }
+
+  // A proxy per non-empty block in block order, the sums run in particle order so the proxies don't depend on
+  // the thread count
+  m_blockProxies.assign(blocks[0] * blocks[1] * blocks[2], -1);
+  for(unsigned int i = 0; i < _count; ++i)
+    m_blockProxies[m_particleBlocks[i]] = 0;
+  m_proxyBlocks.clear();
+  m_proxyBlocks.reserve(m_blockProxies.size());
+  for(unsigned int b = 0; b < m_blockProxies.size(); ++b)
+  {
+    if(m_blockProxies[b] == 0)
+    {
+      m_blockProxies[b] = m_proxyBlocks.size();
+      m_proxyBlocks.push_back(b);
+    }
+  }
+
+  // There are never more proxies than blocks or particles, the buffers are reserved for that many with a full
+  // search window each so that the levels stop allocating once the largest one has been built
+  const std::size_t maxProxies = std::min<std::size_t>(m_blockProxies.size(), _count);
+  const std::size_t window = (2 * c_searchRange + 1) * (2 * c_searchRange + 1) * (2 * c_searchRange + 1) - 1;
+  m_positions.reserve(maxProxies);
+  m_masses.reserve(maxProxies);
+  m_lambdas.reserve(maxProxies);
+  m_updates.reserve(maxProxies);
+  m_displacements.reserve(maxProxies);
+  m_neighborOffsets.reserve(maxProxies + 1);
+  m_neighbors.reserve(maxProxies * window);
+
+  const unsigned int proxies = m_proxyBlocks.size();
+  m_positions.assign(proxies, Vec3());
+  m_masses.assign(proxies, 0.f);
+  for(unsigned int i = 0; i < _count; ++i)
+  {
+    const int proxy = m_blockProxies[m_particleBlocks[i]];
+    m_positions[proxy].addScaled(_particles[i]->m_predPos, _particles[i]->m_mass);
+    m_masses[proxy] += _particles[i]->m_mass;
+  }
+  for(unsigned int p = 0; p < proxies; ++p)
+    m_positions[p] *= 1.f / m_masses[p];
+
+  // Candidates from the surrounding blocks, the proxies move less than a block during the level
+  m_neighborOffsets.resize(proxies + 1);
+  m_neighbors.clear();
+  for(unsigned int p = 0; p < proxies; ++p)
+  {
+    m_neighborOffsets[p] = m_neighbors.size();
+    const int bx = m_proxyBlocks[p] % blocks[0];
+    const int by = m_proxyBlocks[p] / blocks[0] % blocks[1];
+    const int bz = m_proxyBlocks[p] / (blocks[0] * blocks[1]);
+    for(int z = std::max(bz - c_searchRange, 0); z <= std::min(bz + c_searchRange, blocks[2] - 1); ++z)
+      for(int y = std::max(by - c_searchRange, 0); y <= std::min(by + c_searchRange, blocks[1] - 1); ++y)
+        for(int x = std::max(bx - c_searchRange, 0); x <= std::min(bx + c_searchRange, blocks[0] - 1); ++x)
+        {
+          const int neighbor = m_blockProxies[x + (y + z * blocks[1]) * blocks[0]];
+          if(neighbor >= 0 && neighbor != (int)p)
+            m_neighbors.push_back(neighbor);
+        }
+  }
+  m_neighborOffsets[proxies] = m_neighbors.size();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void MultilevelSolver::projectLevel(const float &_h, const float &_mass, const float &_selfDensity, const FluidSolver &_solver)
+{
+  const SolverParameters parameters = _solver.getParameters();
+  const float h2 = _h * _h;
+  const float poly6 = 315.f / (64.f * m_pi * std::pow(_h, 9.f));
+  const float spiky = -45.f / (m_pi * std::pow(_h, 6.f));
+  const float inverseRestDensity = parameters.inverseRestDensity;
+  const float updateScale = _solver.getRelaxation() * inverseRestDensity;
+  const unsigned int proxies = m_positions.size();
+  m_lambdas.assign(proxies, 0.f);
+  m_updates.resize(proxies);
+  m_displacements.assign(proxies, Vec3());
+
+  // The constraint of FluidSolver with the proxy masses. A proxy moves by its inverse mass relative to a fine
+  // particle, so a proxy of one particle gets the same lambda and update as the fine solver would give it.
+  for(unsigned int iteration = 0; iteration < m_iterations; ++iteration)
+  {
+#pragma omp parallel
+    {
+#pragma omp for schedule(static)
+      for(unsigned int p = 0; p < proxies; ++p)
+      {
+        float density = m_masses[p] * poly6 * h2*h2*h2 - _selfDensity, sumGradientLengthSquared = 0.f;
+        Vec3 gradient;
+        for(unsigned int n = m_neighborOffsets[p]; n < m_neighborOffsets[p + 1]; ++n)
+        {
+          const unsigned int j = m_neighbors[n];
+          const Vec3 v = m_positions[p] - m_positions[j];
+          const float r2 = v.lengthSquared();
+          if(r2 > h2)
+            continue;
+          const float tmp = h2 - r2;
+          density += m_masses[j] * poly6 * tmp*tmp*tmp;
+          const Vec3 g = (m_masses[j] * inverseRestDensity) * spikyGradient(v, r2, _h, spiky);
+          sumGradientLengthSquared += _mass / m_masses[j] * g.dot(g);
+          gradient += g;
+        }
+        const float c = density * inverseRestDensity - 1.f;
+        m_lambdas[p] = c > 0.f ? -c / (sumGradientLengthSquared + _mass / m_masses[p] * gradient.dot(gradient) + parameters.epsilon) : 0.f;
+      }
+
+#pragma omp for schedule(static)
+      for(unsigned int p = 0; p < proxies; ++p)
+      {
+        Vec3 update;
+        for(unsigned int n = m_neighborOffsets[p]; n < m_neighborOffsets[p + 1]; ++n)
+        {
+          const unsigned int j = m_neighbors[n];
+          const Vec3 v = m_positions[p] - m_positions[j];
+          const float r2 = v.lengthSquared();
+          if(r2 > h2)
+            continue;
+          update.addScaled(spikyGradient(v, r2, _h, spiky), m_lambdas[p] * m_masses[j] / m_masses[p] + m_lambdas[j]);
+        }
+        m_updates[p] = updateScale * update;
+      }
+
+#pragma omp for schedule(static) nowait
+      for(unsigned int p = 0; p < proxies; ++p)
+      {
+        m_positions[p] += m_updates[p];
+        m_displacements[p] += m_updates[p];
+      }
+    }
+  }
+}
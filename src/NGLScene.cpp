@@ -4,11 +4,40 @@
 #include <ngl/NGLInit.h>
 #include <ngl/ShaderLib.h>
 #include <ngl/VAOPrimitives.h>
+#include <algorithm>
+#include <cstddef>
 #include <iostream>
 //#include <omp.h>
 
 #include "NGLScene.h"
 #include "FluidSystem.h"
+#include "Profiler.h"
+
+namespace
+{
+//----------------------------------------------------------------------------------------------------------------------
+inline ngl::Vec3 toNgl(const Vec3 &_v)
+{
+  // The simulation core has its own vector types, they're converted only when handed to NGL
+  return ngl::Vec3(_v.m_x, _v.m_y, _v.m_z);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief ColourRamp Transfer function of a colour channel, the value is mapped linearly from the low to the high
+/// colour over the range and clamped outside of it
+//----------------------------------------------------------------------------------------------------------------------
+struct ColourRamp
+{
+  float min, max;
+  ngl::Vec3 low, high;
+};
+
+// Flat water, the ramp the solver used to write over the relative density and white foam on the fast particles,
+// in the order of NGLScene::ColourChannel
+const ColourRamp c_colourRamps[] = {{0.f, 1.f, ngl::Vec3(0.f, 0.62745f, 0.690196f), ngl::Vec3(0.f, 0.62745f, 0.690196f)},
+                                    {0.f, 1.f, ngl::Vec3(0.75f, 1.f, 1.f), ngl::Vec3(-0.25f, 0.62745f, 0.690196f)},
+                                    {0.f, 6.f, ngl::Vec3(0.f, 0.62745f, 0.690196f), ngl::Vec3(0.9f, 0.95f, 1.f)}};
+}
 
 NGLScene::NGLScene()
 {
@@ -17,6 +46,15 @@ NGLScene::NGLScene()
   m_rotate = false;
   m_cam.setDefaultCamera();
   m_cam.set(ngl::Vec3(2.f, 8.5f, 16.f), ngl::Vec3(0.f, 0.f, 0.f), ngl::Vec3(0.f, 1.f, 0.f));
+  m_impostors = true;
+  m_lodDistance = 15.f;
+  m_spriteVAO = 0;
+  m_spriteVBO = 0;
+  m_surfaceVAO = 0;
+  m_boxVAO = 0;
+  m_drawSurface = false;
+  m_viewerFrame = FrameHeader();
+  m_colourChannel = DENSITY;
 
 //  std::cout << "Setting number of threads to " << omp_get_max_threads() << "\n";
 //  omp_set_num_threads(omp_get_max_threads());
@@ -25,6 +63,16 @@ NGLScene::NGLScene()
 NGLScene::~NGLScene()
 {
   std::cout << "Shutting down NGL, removing VAO's and Shaders\n";
+  if(m_spriteVAO)
+  {
+    makeCurrent();
+    glDeleteBuffers(1, &m_spriteVBO);
+    glDeleteVertexArrays(1, &m_spriteVAO);
+    glDeleteBuffers(3, m_surfaceBuffers);
+    glDeleteVertexArrays(1, &m_surfaceVAO);
+    glDeleteBuffers(2, m_boxBuffers);
+    glDeleteVertexArrays(1, &m_boxVAO);
+  }
 //  m_vao->removeVOA();
 }
 
@@ -64,43 +112,79 @@ void NGLScene::initializeGL()
   // Creating a VAOPrimitive sphere for particle drawing
   particle->createSphere("particle", 1.f, 32);
 
-  // Create a simple colour shader and set the initial uniforms
-  shader->createShaderProgram("SimpleShader");
-  shader->attachShader("SimpleVertex", ngl::ShaderType::VERTEX);
-  shader->attachShader("SimpleFragment", ngl::ShaderType::FRAGMENT);
-
-  shader->loadShaderSource("SimpleVertex", "shaders/simple.vert");
-  shader->loadShaderSource("SimpleFragment", "shaders/simple.frag");
+  // Create a simple colour shader for the meshes and a sprite shader ray casting the particle
+  // spheres, both share the lights and the material
+  createShader("SimpleShader", "shaders/simple.vert", "shaders/simple.frag");
+  createShader("SpriteShader", "shaders/sprite.vert", "shaders/sprite.frag");
 
-  shader->compileShader("SimpleVertex");
-  shader->compileShader("SimpleFragment");
-
-  shader->attachShaderToProgram("SimpleShader", "SimpleVertex");
-  shader->attachShaderToProgram("SimpleShader", "SimpleFragment");
-
-  shader->linkProgramObject("SimpleShader");
-  shader->use("SimpleShader");
-
-  shader->autoRegisterUniforms("SimpleShader");
-  shader->printProperties();
-
-  shader->setRegisteredUniform("u_Light.Position", ngl::Vec4(1.f, 5.5f, 0.5f, 1.f));
-  shader->setRegisteredUniform("u_Light.La", ngl::Vec3(0.f, 0.f, 0.f));
-  shader->setRegisteredUniform("u_Light.Ld", ngl::Vec3(1.f, 1.f, 1.f));
-  shader->setRegisteredUniform("u_Light.Ls", ngl::Vec3(0.1f, 0.1f, 0.1f));
-
-  shader->setRegisteredUniform("u_BackLight.Position", ngl::Vec4(3.f, -1.5f, -25.f, 1.f));
-  shader->setRegisteredUniform("u_BackLight.La", ngl::Vec3(0.f, 0.f, 0.f));
-  shader->setRegisteredUniform("u_BackLight.Ld", ngl::Vec3(1.f, 1.f, 1.f));
-  shader->setRegisteredUniform("u_BackLight.Ls", ngl::Vec3(0.1f, 0.1f, 0.1f));
+  const char *programs[] = {"SpriteShader", "SimpleShader"};
+  for(const char *program : programs)
+  {
+    shader->use(program);
+
+    shader->setRegisteredUniform("u_Light.Position", ngl::Vec4(1.f, 5.5f, 0.5f, 1.f));
+    shader->setRegisteredUniform("u_Light.La", ngl::Vec3(0.f, 0.f, 0.f));
+    shader->setRegisteredUniform("u_Light.Ld", ngl::Vec3(1.f, 1.f, 1.f));
+    shader->setRegisteredUniform("u_Light.Ls", ngl::Vec3(0.1f, 0.1f, 0.1f));
+
+    shader->setRegisteredUniform("u_BackLight.Position", ngl::Vec4(3.f, -1.5f, -25.f, 1.f));
+    shader->setRegisteredUniform("u_BackLight.La", ngl::Vec3(0.f, 0.f, 0.f));
+    shader->setRegisteredUniform("u_BackLight.Ld", ngl::Vec3(1.f, 1.f, 1.f));
+    shader->setRegisteredUniform("u_BackLight.Ls", ngl::Vec3(0.1f, 0.1f, 0.1f));
+
+    shader->setRegisteredUniform("u_Material.Ka", ngl::Vec3(0.2f, 0.2f, 0.2f));
+    shader->setRegisteredUniform("u_Material.Kd", ngl::Vec3(1.f, 1.f, 1.f));
+    shader->setRegisteredUniform("u_Material.Ks", ngl::Vec3(1.f, 1.f, 1.f));
+    shader->setRegisteredUniform("u_Material.Shininess", 2.f);
+  }
 
-  shader->setRegisteredUniform("u_Material.Ka", ngl::Vec3(0.2f, 0.2f, 0.2f));
-  shader->setRegisteredUniform("u_Material.Kd", ngl::Vec3(1.f, 1.f, 1.f));
-  shader->setRegisteredUniform("u_Material.Ks", ngl::Vec3(1.f, 1.f, 1.f));
-  shader->setRegisteredUniform("u_Material.Shininess", 2.f);
+  // Vertex array for the sprites, each point is the centre and radius followed by the colour channels, the
+  // channel drawn is pointed to when drawing
+  glGenVertexArrays(1, &m_spriteVAO);
+  glGenBuffers(1, &m_spriteVBO);
+  glBindVertexArray(m_spriteVAO);
+  glBindBuffer(GL_ARRAY_BUFFER, m_spriteVBO);
+  glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(FrameVertex), 0);
+  glEnableVertexAttribArray(0);
+  glEnableVertexAttribArray(1);
+  glBindVertexArray(0);
+  // The vertex shader sets the size of the sprites
+  glEnable(GL_PROGRAM_POINT_SIZE);
+
+  // Vertex array for the surface mesh, positions and normals in their own buffers and the triangle indices
+  glGenVertexArrays(1, &m_surfaceVAO);
+  glGenBuffers(3, m_surfaceBuffers);
+  glBindVertexArray(m_surfaceVAO);
+  glBindBuffer(GL_ARRAY_BUFFER, m_surfaceBuffers[0]);
+  // The mesh is uploaded as it is, the stride skips the padding lane of the vectors
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vec3), 0);
+  glBindBuffer(GL_ARRAY_BUFFER, m_surfaceBuffers[1]);
+  glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(Vec3), 0);
+  glEnableVertexAttribArray(0);
+  glEnableVertexAttribArray(2);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_surfaceBuffers[2]);
+  glBindVertexArray(0);
+
+  // Initialise the fluid system, a viewer only draws the particles of another process. The window closes
+  // with an error if there's nothing to simulate.
+  if(!m_viewer && !m_pbf.init())
+    QGuiApplication::exit(EXIT_FAILURE);
+
+  // Vertex array for the outlines of the bounding box, the corners are uploaded once here and
+  // rewritten in place whenever the box moves
+  const static GLubyte indices[] = {0, 1, 5, 4, 0, 2, 3, 1, 3, 7, 5, 7, 6, 4, 6, 2};
+  m_pbf.getBoundingBox().corners(m_boxCorners);
+  glGenVertexArrays(1, &m_boxVAO);
+  glGenBuffers(2, m_boxBuffers);
+  glBindVertexArray(m_boxVAO);
+  glBindBuffer(GL_ARRAY_BUFFER, m_boxBuffers[0]);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(m_boxCorners), m_boxCorners, GL_DYNAMIC_DRAW);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vec3), 0);
+  glEnableVertexAttribArray(0);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_boxBuffers[1]);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+  glBindVertexArray(0);
 
-  // Initialise the fluid system
-  m_pbf.init();
   m_text.reset(new ngl::Text(QFont("Arial",14)));
   m_text->setScreenSize(width(),height());
 
@@ -121,16 +205,18 @@ void NGLScene::paintGL()
   // Get the frame time and set the frame start clock again
   std::chrono::duration<float> elapsed_time = m_end - m_start;
   m_start = std::chrono::system_clock::now();
-  std::cout << "Frame time: " << elapsed_time.count() << "s\n";
 
   // Render out the fps and particle count
   m_text->setColour(1,1,0);
   QString text = QString("%1 fps").arg(1/elapsed_time.count());
   m_text->renderText(10,20,text);
-  text=QString("Num particles = %1").arg(m_pbf.getParticles().size());
+  if(m_viewer)
+    text = QString("Viewing %1: step %2, %3 particles").arg(m_viewerName.c_str()).arg(m_viewerFrame.step).arg(m_viewerFrame.count);
+  else
+    text=QString("Num particles = %1").arg(m_pbf.getParticles().size());
   m_text->renderText(10,40,text);
+  drawProfile();
 
-  ngl::VAOPrimitives *particle = ngl::VAOPrimitives::instance();
   ngl::ShaderLib *shader = ngl::ShaderLib::instance();
 
   shader->use("SimpleShader");
@@ -155,24 +241,272 @@ void NGLScene::paintGL()
   shader->setRegisteredUniform("u_Light.Position", mouseGlobalTX * (m_cam.getEye() + ngl::Vec3(0.0f, 2.0f, 0.f)));
   shader->setRegisteredUniform("u_BackLight.Position", mouseGlobalTX * (m_cam.getEye() * ngl::Vec3(1.f, 1.f, -1.f) + ngl::Vec3(0.0f, 2.0f, 0.f)));
 
-  // Execute the fluid system and simulation if simulation is enabled
+  // A viewer draws what the simulating process published
+  if(m_viewer)
+  {
+    drawFrame(mouseGlobalTX);
+    m_end = std::chrono::system_clock::now();
+    return;
+  }
+
+  // Draw the bounding box and execute the fluid system and simulation if simulation is enabled
+  drawBoundingBox(m_pbf.getBoundingBox());
   m_pbf.execute();
 
+  // Draw the surface instead of the particles once it has been extracted
+  const std::vector<Particle *> &particles = m_pbf.getParticles();
+  if(m_drawSurface && !m_pbf.getSurface().m_indices.empty())
+    drawSurface(m_pbf.getSurface(), mouseGlobalTX);
+  else if(m_impostors)
+    drawSprites(particles, mouseGlobalTX);
+  else
+    drawSpheres(particles, mouseGlobalTX);
+
+  // Record the frame end time
+  m_end = std::chrono::system_clock::now();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void NGLScene::createShader(const std::string &_name, const std::string &_vertex, const std::string &_fragment)
+{
+  ngl::ShaderLib *shader = ngl::ShaderLib::instance();
+  const std::string vertex = _name + "Vertex";
+  const std::string fragment = _name + "Fragment";
+
+  shader->createShaderProgram(_name);
+  shader->attachShader(vertex, ngl::ShaderType::VERTEX);
+  shader->attachShader(fragment, ngl::ShaderType::FRAGMENT);
+
+  shader->loadShaderSource(vertex, _vertex);
+  shader->loadShaderSource(fragment, _fragment);
+
+  shader->compileShader(vertex);
+  shader->compileShader(fragment);
+
+  shader->attachShaderToProgram(_name, vertex);
+  shader->attachShaderToProgram(_name, fragment);
+
+  shader->linkProgramObject(_name);
+  shader->use(_name);
+
+  shader->autoRegisterUniforms(_name);
+  shader->printProperties();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void NGLScene::drawSpheres(const std::vector<Particle *> &_particles, const ngl::Mat4 &_mouseGlobalTX)
+{
+  ngl::VAOPrimitives *particle = ngl::VAOPrimitives::instance();
+  ngl::ShaderLib *shader = ngl::ShaderLib::instance();
+  ngl::Mat4 modelMatrix;
+
   // Loop through the particles and modify the model matrix to translate and scale the particles
   // to their respective locations and scales. Using a ngl::VAOPrimitive sphere to draw the particles
-  std::vector<Particle *> particles = m_pbf.getParticles();
-  for(unsigned int i = 0; i < particles.size(); ++i)
+  for(unsigned int i = 0; i < _particles.size(); ++i)
   {
     modelMatrix.identity();
-    modelMatrix.scale(particles[i]->m_radius, particles[i]->m_radius, particles[i]->m_radius);
-    modelMatrix.translate(particles[i]->m_pos.m_x, particles[i]->m_pos.m_y, particles[i]->m_pos.m_z);
-    shader->setRegisteredUniform4f("u_Color", particles[i]->m_colour.m_x,  particles[i]->m_colour.m_y,  particles[i]->m_colour.m_z,  particles[i]->m_colour.m_w);
-    shader->setRegisteredUniform("u_MV", modelMatrix * mouseGlobalTX * m_cam.getViewMatrix());
+    modelMatrix.scale(_particles[i]->m_radius, _particles[i]->m_radius, _particles[i]->m_radius);
+    modelMatrix.translate(_particles[i]->m_pos.m_x, _particles[i]->m_pos.m_y, _particles[i]->m_pos.m_z);
+    shader->setRegisteredUniform("u_Color", mapColour(*_particles[i]));
+    shader->setRegisteredUniform("u_MV", modelMatrix * _mouseGlobalTX * m_cam.getViewMatrix());
     particle->draw("particle");
   }
+}
 
-  // Record the frame end time
-  m_end = std::chrono::system_clock::now();
+//----------------------------------------------------------------------------------------------------------------------
+void NGLScene::drawSprites(const std::vector<Particle *> &_particles, const ngl::Mat4 &_mouseGlobalTX)
+{
+  // Pack the centre, radius and colour channels of each particle, only for the frames drawn, the staging vector
+  // keeps its capacity between the frames
+  const float inverseRestDensity = m_pbf.getSolverParameters().inverseRestDensity;
+  m_spriteData.resize(_particles.size());
+  for(unsigned int i = 0; i < _particles.size(); ++i)
+  {
+    const Particle *p = _particles[i];
+    FrameVertex &v = m_spriteData[i];
+    v.x = p->m_pos.m_x; v.y = p->m_pos.m_y; v.z = p->m_pos.m_z; v.radius = p->m_radius;
+    v.density = p->m_density * inverseRestDensity;
+    v.speed = p->m_vel.length();
+  }
+
+  // Orphan the buffer before uploading so the driver doesn't wait for the previous frame's draw
+  glBindBuffer(GL_ARRAY_BUFFER, m_spriteVBO);
+  glBufferData(GL_ARRAY_BUFFER, m_spriteData.size() * sizeof(FrameVertex), nullptr, GL_STREAM_DRAW);
+  glBufferSubData(GL_ARRAY_BUFFER, 0, m_spriteData.size() * sizeof(FrameVertex), m_spriteData.data());
+  drawSpriteBuffer(_particles.size(), _mouseGlobalTX);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void NGLScene::drawSpriteBuffer(const unsigned int &_count, const ngl::Mat4 &_mouseGlobalTX)
+{
+  ngl::ShaderLib *shader = ngl::ShaderLib::instance();
+  shader->use("SpriteShader");
+  shader->setRegisteredUniform("u_Projection", m_cam.getProjectionMatrix());
+  shader->setRegisteredUniform("u_MV", _mouseGlobalTX * m_cam.getViewMatrix());
+  shader->setRegisteredUniform("u_Light.Position", _mouseGlobalTX * (m_cam.getEye() + ngl::Vec3(0.0f, 2.0f, 0.f)));
+  shader->setRegisteredUniform("u_BackLight.Position", _mouseGlobalTX * (m_cam.getEye() * ngl::Vec3(1.f, 1.f, -1.f) + ngl::Vec3(0.0f, 2.0f, 0.f)));
+  shader->setRegisteredUniform("u_ViewportHeight", static_cast<float>(m_height));
+  shader->setRegisteredUniform2f("u_Viewport", m_width, m_height);
+  shader->setRegisteredUniform("u_LodDistance", m_lodDistance);
+  const ColourRamp &ramp = c_colourRamps[m_colourChannel];
+  shader->setRegisteredUniform2f("u_ColourRange", ramp.min, ramp.max);
+  shader->setRegisteredUniform("u_ColourLow", ramp.low);
+  shader->setRegisteredUniform("u_ColourHigh", ramp.high);
+
+  // The flat colour ignores the value, point it to the density like any other channel
+  const std::size_t channel = m_colourChannel == SPEED ? offsetof(FrameVertex, speed) : offsetof(FrameVertex, density);
+  glBindVertexArray(m_spriteVAO);
+  glBindBuffer(GL_ARRAY_BUFFER, m_spriteVBO);
+  glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, sizeof(FrameVertex), reinterpret_cast<GLvoid *>(channel));
+  glEnableVertexAttribArray(1);
+  glDrawArrays(GL_POINTS, 0, _count);
+  glBindVertexArray(0);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+ngl::Vec4 NGLScene::mapColour(const Particle &_particle) const
+{
+  const ColourRamp &ramp = c_colourRamps[m_colourChannel];
+  const float value = m_colourChannel == SPEED ? _particle.m_vel.length() : _particle.m_density * m_pbf.getSolverParameters().inverseRestDensity;
+  const float t = std::min(std::max((value - ramp.min) / (ramp.max - ramp.min), 0.f), 1.f);
+  const ngl::Vec3 colour = ramp.low + (ramp.high - ramp.low) * t;
+  return ngl::Vec4(colour.m_x, colour.m_y, colour.m_z, 1.f);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void NGLScene::drawFrame(const ngl::Mat4 &_mouseGlobalTX)
+{
+  // The feed may not exist yet or may have been replaced by a bigger one
+  if(!m_viewer->isAlive() && m_viewer->attach(m_viewerName))
+    m_viewerFrame = FrameHeader();
+
+  // The frame goes from the segment to the sprite buffer as it is, a frame the simulation started overwriting
+  // during the upload isn't drawn
+  FrameHeader header;
+  if(const FrameVertex *vertices = m_viewer->acquire(header))
+  {
+    glBindBuffer(GL_ARRAY_BUFFER, m_spriteVBO);
+    glBufferData(GL_ARRAY_BUFFER, header.count * sizeof(FrameVertex), vertices, GL_STREAM_DRAW);
+    if(m_viewer->release())
+      m_viewerFrame = header;
+    else
+      m_viewerFrame.count = 0;
+  }
+
+  if(m_viewerFrame.count)
+  {
+    drawBoundingBox(BoundingBox(m_viewerFrame.boxMin[0], m_viewerFrame.boxMax[0], m_viewerFrame.boxMin[1],
+                                m_viewerFrame.boxMax[1], m_viewerFrame.boxMin[2], m_viewerFrame.boxMax[2]));
+  }
+  drawSpriteBuffer(m_viewerFrame.count, _mouseGlobalTX);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void NGLScene::drawSurface(const SurfaceMesh &_surface, const ngl::Mat4 &_mouseGlobalTX)
+{
+  ngl::ShaderLib *shader = ngl::ShaderLib::instance();
+  shader->use("SimpleShader");
+  shader->setRegisteredUniform4f("u_Color", 0.f, 0.62745f, 0.690196f, 1.f);
+  shader->setRegisteredUniform("u_MV", _mouseGlobalTX * m_cam.getViewMatrix());
+
+  // The mesh changes size every step, orphan the buffers before uploading
+  glBindVertexArray(m_surfaceVAO);
+  glBindBuffer(GL_ARRAY_BUFFER, m_surfaceBuffers[0]);
+  glBufferData(GL_ARRAY_BUFFER, _surface.m_vertices.size() * sizeof(Vec3), _surface.m_vertices.data(), GL_STREAM_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, m_surfaceBuffers[1]);
+  glBufferData(GL_ARRAY_BUFFER, _surface.m_normals.size() * sizeof(Vec3), _surface.m_normals.data(), GL_STREAM_DRAW);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, _surface.m_indices.size() * sizeof(GLuint), _surface.m_indices.data(), GL_STREAM_DRAW);
+  glDrawElements(GL_TRIANGLES, _surface.m_indices.size(), GL_UNSIGNED_INT, 0);
+  glBindVertexArray(0);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void NGLScene::drawBoundingBox(const BoundingBox &_bb)
+{
+  Vec3 corners[8];
+  _bb.corners(corners);
+  bool changed = false;
+  for(int i = 0; i < 8; ++i)
+    changed |= corners[i] != m_boxCorners[i];
+
+  glBindVertexArray(m_boxVAO);
+  if(changed)
+  {
+    // Only the corners change, rewrite them in the existing buffer
+    std::copy(corners, corners + 8, m_boxCorners);
+    glBindBuffer(GL_ARRAY_BUFFER, m_boxBuffers[0]);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(m_boxCorners), m_boxCorners);
+  }
+  glDrawElements(GL_LINE_LOOP, 16, GL_UNSIGNED_BYTE, 0);
+  glBindVertexArray(0);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void NGLScene::drawProfile()
+{
+#ifdef PBF_PROFILE
+  // Mean and 95th percentile of the stage wall times over the last frames,
+  // followed by the busy time of each thread
+  Profiler *profiler = Profiler::instance();
+  const std::vector<ProfileStage> &stages = profiler->getStages();
+  int y = 70;
+  m_text->setColour(1,1,1);
+  for(unsigned int s = 0; s < stages.size(); ++s, y += 18)
+  {
+    QString name = stages[s].name;
+    if(stages[s].index >= 0)
+      name += QString(" %1").arg(stages[s].index);
+    QString text = QString("%1  %2 ms  p95 %3 ms").arg(name, -14)
+                                                  .arg(stages[s].wallTime.mean(), 0, 'f', 3)
+                                                  .arg(stages[s].wallTime.percentile(0.95f), 0, 'f', 3);
+#ifdef PBF_PERF_COUNTERS
+    // Instructions per cycle and the misses per thousand instructions tell whether a stage
+    // is compute bound or waiting on memory
+    if(profiler->hasCounters())
+    {
+      const RollingHistogram *counters = stages[s].counters;
+      const float cycles = counters[PerfCounters::CYCLES].mean();
+      const float kiloInstructions = counters[PerfCounters::INSTRUCTIONS].mean() * 1e-3f;
+      if(cycles > 0.f && kiloInstructions > 0.f)
+      {
+        text += QString("  ipc %1  l1 %2  llc %3  br %4 /ki").arg(kiloInstructions * 1e3f / cycles, 0, 'f', 2)
+                                                            .arg(counters[PerfCounters::L1_MISSES].mean() / kiloInstructions, 0, 'f', 1)
+                                                            .arg(counters[PerfCounters::LLC_MISSES].mean() / kiloInstructions, 0, 'f', 2)
+                                                            .arg(counters[PerfCounters::BRANCH_MISSES].mean() / kiloInstructions, 0, 'f', 2);
+      }
+    }
+#endif
+    m_text->renderText(10, y, text);
+  }
+#ifdef PBF_PERF_COUNTERS
+  if(!profiler->hasCounters())
+  {
+    m_text->renderText(10, y, "hardware counters unavailable");
+    y += 18;
+  }
+#endif
+
+  const std::vector<RollingHistogram> &threads = profiler->getThreadTimes();
+  y += 10;
+  for(unsigned int t = 0; t < threads.size(); ++t, y += 18)
+  {
+    QString text = QString("thread %1  busy %2 ms").arg(t).arg(threads[t].mean(), 0, 'f', 3);
+#ifdef PBF_PERF_COUNTERS
+    const std::vector<std::vector<RollingHistogram>> &counters = profiler->getThreadCounters();
+    if(t < counters.size() && counters[t][PerfCounters::CYCLES].mean() > 0.f)
+    {
+      text += QString("  ipc %1").arg(counters[t][PerfCounters::INSTRUCTIONS].mean() / counters[t][PerfCounters::CYCLES].mean(), 0, 'f', 2);
+    }
+#endif
+    m_text->renderText(10, y, text);
+  }
+
+  if(profiler->isCapturing())
+  {
+    m_text->setColour(1,0,0);
+    m_text->renderText(10, y + 10, "Capturing trace");
+  }
+#endif
 }
 
 //----------------------------------------------------------------------------------------------------------------------
@@ -236,6 +570,20 @@ void NGLScene::keyPressEvent(QKeyEvent *_event)
     case Qt::Key_1 : m_pbf.toggleSimulation(); break;
     // 2 to toggle wave machine on/off
     case Qt::Key_2 : m_pbf.toggleWaves(); break;
+#ifdef PBF_PROFILE
+    // 3 to capture a trace of the next 120 steps
+    case Qt::Key_3 : Profiler::instance()->captureTrace(120, "pbf_trace.json"); break;
+#endif
+    // 4 to switch between the sprite impostors and the sphere meshes
+    case Qt::Key_4 : m_impostors = !m_impostors; break;
+    // 5 to switch between the particles and the extracted surface
+    case Qt::Key_5 :
+      m_drawSurface = !m_drawSurface;
+      if(m_drawSurface && !m_pbf.isExtractingSurface())
+        m_pbf.setSurfaceExtraction(true, true);
+      break;
+    // 6 to cycle the colour channel of the particles
+    case Qt::Key_6 : m_colourChannel = static_cast<ColourChannel>((m_colourChannel + 1) % 3); break;
     default : break;
   }
   // finally update the GLWindow and re-draw
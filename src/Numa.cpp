@@ -0,0 +1,83 @@
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#ifdef __linux__
+#include <sched.h>
+#include <sys/mman.h>
+#endif
+#include "AllocationCounter.h"
+#include "Numa.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+void Numa::pinThreads()
+{
+#if defined(_OPENMP) && defined(__linux__)
+  // Collect the cpus the process may run on so pinning respects taskset/cgroup limits
+  cpu_set_t allowed;
+  if(sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+    return;
+  std::vector<int> cpus;
+  for(int c = 0; c < CPU_SETSIZE; ++c)
+    if(CPU_ISSET(c, &allowed))
+      cpus.push_back(c);
+  if(cpus.empty())
+    return;
+
+  // The OpenMP runtime keeps the same threads between parallel regions, so pinning
+  // them once keeps thread n on the same core for all of the solver loops
+#pragma omp parallel
+  {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpus[omp_get_thread_num() % cpus.size()], &set);
+    sched_setaffinity(0, sizeof(set), &set);
+  }
+#endif
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void *Numa::allocate(const std::size_t &_count, const std::size_t &_elementSize)
+{
+  // Align big buffers to the huge page size so that they can be backed by transparent huge pages
+  const std::size_t bytes = _count * _elementSize;
+  const std::size_t hugePageSize = 2 * 1024 * 1024;
+  const std::size_t alignment = bytes >= hugePageSize ? hugePageSize : 64;
+
+  void *ptr = nullptr;
+  if(bytes == 0 || posix_memalign(&ptr, alignment, bytes) != 0)
+  {
+    if(bytes == 0)
+      return nullptr;
+    throw std::bad_alloc();
+  }
+  AllocationCounter::record(bytes);
+
+#ifdef __linux__
+  if(hugePages() && bytes >= hugePageSize)
+    madvise(ptr, bytes, MADV_HUGEPAGE);
+#endif
+
+  // First touch each element from the thread that owns it in a static schedule. A buffer within a page can only
+  // live on one node, so small scratch buffers skip the parallel region and are left to the container.
+  const std::size_t pageSize = 4096;
+  if(bytes <= pageSize)
+    return ptr;
+  char *data = static_cast<char *>(ptr);
+  const long count = (long)_count;
+#pragma omp parallel for schedule(static)
+  for(long i = 0; i < count; ++i)
+  {
+    std::memset(data + i * _elementSize, 0, _elementSize);
+  }
+
+  return ptr;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void Numa::release(void *_ptr)
+{
+  std::free(_ptr);
+}
@@ -0,0 +1,438 @@
+#ifdef PBF_USE_OPENCL
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include "OpenCLBackend.h"
+#include "Profiler.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+OpenCLBackend::OpenCLBackend(const FluidSolver &_solver, const NNS &_nns) :
+  m_parameters(_solver.getParameters()),
+  m_solver(_solver),
+  m_nns(_nns),
+  m_ok(false),
+  m_context(nullptr),
+  m_device(nullptr),
+  m_queue(nullptr),
+  m_program(nullptr),
+  m_count(0),
+  m_capacity(0),
+  m_paddedCount(0),
+  m_cellCount(0),
+  m_frame(nullptr)
+{
+  for(int k = 0; k < KERNEL_COUNT; ++k)
+    m_kernels[k] = nullptr;
+  for(int b = 0; b < BUFFER_COUNT; ++b)
+    m_buffers[b] = nullptr;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+OpenCLBackend::~OpenCLBackend()
+{
+  for(int b = 0; b < BUFFER_COUNT; ++b)
+  {
+    if(m_buffers[b])
+      clReleaseMemObject(m_buffers[b]);
+  }
+  for(int k = 0; k < KERNEL_COUNT; ++k)
+  {
+    if(m_kernels[k])
+      clReleaseKernel(m_kernels[k]);
+  }
+  if(m_program)
+    clReleaseProgram(m_program);
+  if(m_queue)
+    clReleaseCommandQueue(m_queue);
+  if(m_context)
+    clReleaseContext(m_context);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool OpenCLBackend::init(const std::string &_kernelFile)
+{
+  // Take the first device of the first platform that has one, on machines without a gpu
+  // this is a cpu runtime such as POCL
+  m_ok = false;
+  cl_uint platformCount = 0;
+  if(clGetPlatformIDs(0, nullptr, &platformCount) != CL_SUCCESS || platformCount == 0)
+  {
+    std::cerr << "OpenCL: no platforms found\n";
+    return false;
+  }
+  std::vector<cl_platform_id> platforms(platformCount);
+  clGetPlatformIDs(platformCount, &platforms[0], nullptr);
+  for(cl_uint p = 0; p < platformCount && !m_device; ++p)
+  {
+    if(clGetDeviceIDs(platforms[p], CL_DEVICE_TYPE_ALL, 1, &m_device, nullptr) != CL_SUCCESS)
+      m_device = nullptr;
+  }
+  if(!m_device)
+  {
+    std::cerr << "OpenCL: no devices found\n";
+    return false;
+  }
+
+  char name[256] = {0};
+  clGetDeviceInfo(m_device, CL_DEVICE_NAME, sizeof(name) - 1, name, nullptr);
+  m_deviceName = name;
+
+  // Failing calls report themselves and clear m_ok from here on
+  m_ok = true;
+  cl_int error;
+  m_context = clCreateContext(nullptr, 1, &m_device, nullptr, nullptr, &error);
+  if(!check(error, "clCreateContext"))
+    return false;
+  m_queue = clCreateCommandQueue(m_context, m_device, 0, &error);
+  if(!check(error, "clCreateCommandQueue"))
+    return false;
+
+  // Load the kernels and give them the solver constants as defines
+  std::ifstream file(_kernelFile.c_str());
+  if(!file)
+  {
+    std::cerr << "OpenCL: could not open " << _kernelFile << "\n";
+    m_ok = false;
+    return false;
+  }
+  std::stringstream source;
+  source << file.rdbuf();
+  const std::string sourceString = source.str();
+  const char *sourcePointer = sourceString.c_str();
+  m_program = clCreateProgramWithSource(m_context, 1, &sourcePointer, nullptr, &error);
+  if(!check(error, "clCreateProgramWithSource"))
+    return false;
+
+  const float h = m_parameters.smoothingLength;
+  const float fixedRadius = m_nns.getFixedRadius();
+  std::ostringstream options;
+  options << std::setprecision(9) << std::scientific
+          << "-DH=" << h << "f -DH2=" << h*h << "f -DPOLY6=" << m_parameters.polyKernelConstant
+          << "f -DSPIKY=" << m_parameters.spikyKernelConstant << "f -DINV_REST_DENSITY=" << m_parameters.inverseRestDensity
+          << "f -DINV_FIXED_WEIGHT=" << m_parameters.inverseFixedRadiusWeight << "f -DK=" << m_parameters.k
+          << "f -DN=" << m_parameters.n << " -DEPSILON=" << m_parameters.epsilon << "f -DXSPH_C=" << m_parameters.xsph_c
+          << "f -DVORTICITY_SCALE=" << m_parameters.vorticityScale << "f -DFIXED_RADIUS2=" << fixedRadius*fixedRadius
+          << "f -DMAX_NEIGHBORS=" << m_nns.getMaxNeighbors() << "u";
+  if(clBuildProgram(m_program, 1, &m_device, options.str().c_str(), nullptr, nullptr) != CL_SUCCESS)
+  {
+    size_t logSize = 0;
+    clGetProgramBuildInfo(m_program, m_device, CL_PROGRAM_BUILD_LOG, 0, nullptr, &logSize);
+    std::string log(logSize, '\0');
+    if(logSize)
+      clGetProgramBuildInfo(m_program, m_device, CL_PROGRAM_BUILD_LOG, logSize, &log[0], nullptr);
+    std::cerr << "OpenCL: building " << _kernelFile << " failed\n" << log << "\n";
+    m_ok = false;
+    return false;
+  }
+
+  const char *names[KERNEL_COUNT] = {"predict", "computeCellKeys", "bitonicSort", "clearCellRanges", "findCellRanges",
+                                     "findNeighbors", "computeLambda", "computePositionUpdate", "applyPositionUpdate",
+                                     "computeVorticity", "finalize"};
+  for(int k = 0; k < KERNEL_COUNT && m_ok; ++k)
+  {
+    m_kernels[k] = clCreateKernel(m_program, names[k], &error);
+    check(error, names[k]);
+  }
+  if(m_ok)
+    std::cout << "OpenCL backend running on " << m_deviceName << "\n";
+  return m_ok;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool OpenCLBackend::check(const cl_int &_error, const char *_what)
+{
+  if(_error == CL_SUCCESS)
+    return true;
+  if(m_ok)
+    std::cerr << "OpenCL: " << _what << " failed with error " << _error << "\n";
+  m_ok = false;
+  return false;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool OpenCLBackend::allocate(const unsigned int &_count, const unsigned int &_cells)
+{
+  for(int b = 0; b < BUFFER_COUNT; ++b)
+  {
+    if(m_buffers[b])
+      clReleaseMemObject(m_buffers[b]);
+    m_buffers[b] = nullptr;
+  }
+
+  // The bitonic sort needs a power of two
+  m_paddedCount = 1;
+  while(m_paddedCount < _count)
+    m_paddedCount <<= 1;
+
+  const size_t sizes[BUFFER_COUNT] =
+  {
+    _count * sizeof(cl_float4), _count * sizeof(cl_float4), _count * sizeof(cl_float4), _count * sizeof(cl_float4),
+    _count * sizeof(cl_float4), _count * sizeof(cl_float), _count * sizeof(cl_float), _count * sizeof(cl_float),
+    _count * sizeof(cl_float), m_paddedCount * sizeof(cl_ulong), _cells * sizeof(cl_uint), _cells * sizeof(cl_uint),
+    (size_t)_count * m_nns.getMaxNeighbors() * sizeof(cl_uint), _count * sizeof(cl_uint), 12 * sizeof(cl_float4)
+  };
+  cl_int error;
+  for(int b = 0; b < BUFFER_COUNT; ++b)
+  {
+    m_buffers[b] = clCreateBuffer(m_context, CL_MEM_READ_WRITE, sizes[b], nullptr, &error);
+    if(!check(error, "clCreateBuffer"))
+      return false;
+  }
+
+  m_capacity = _count;
+  m_cellCount = _cells;
+  m_hostPos.resize(_count);
+  m_hostVel.resize(_count);
+  m_hostExtForces.resize(_count);
+  m_hostMass.resize(_count);
+  m_hostRadius.resize(_count);
+  m_hostDensity.resize(_count);
+  m_hostLambda.resize(_count);
+  return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void OpenCLBackend::run(const Kernel &_kernel, const size_t &_workItems)
+{
+  if(m_ok && _workItems)
+    check(clEnqueueNDRangeKernel(m_queue, m_kernels[_kernel], 1, nullptr, &_workItems, nullptr, 0, nullptr, nullptr), "clEnqueueNDRangeKernel");
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void OpenCLBackend::sync()
+{
+#ifdef PBF_PROFILE
+  if(m_ok)
+    clFinish(m_queue);
+#endif
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void OpenCLBackend::beginStep(std::vector<Particle *> &io_particles, const unsigned int &_count, const BoundingBox &_bb)
+{
+  PBF_PROFILE_SCOPE("upload");
+  // The stages are skipped once a call has failed, isValid() tells the caller to run the step elsewhere
+  if(!m_ok)
+    return;
+
+  // Grid layout of the cpu neighbor search, with an extra cell for the particles outside of it
+  const BoundingBox &gridBB = m_nns.getBounds();
+  const Vec3i &cells = m_nns.getGridSize();
+  const Vec3 &cellSize = m_nns.getCellSize();
+  m_cells[0] = cells.m_x;
+  m_cells[1] = cells.m_y;
+  m_cells[2] = cells.m_z;
+  const cl_uint cellCount = m_cells[0] * m_cells[1] * m_cells[2] + 1;
+  m_gridMin.s[0] = gridBB.m_minx;
+  m_gridMin.s[1] = gridBB.m_miny;
+  m_gridMin.s[2] = gridBB.m_minz;
+  m_gridMin.s[3] = 0.f;
+  m_cellSize.s[0] = cellSize.m_x;
+  m_cellSize.s[1] = cellSize.m_y;
+  m_cellSize.s[2] = cellSize.m_z;
+  m_cellSize.s[3] = 1.f;
+
+  m_count = 0;
+  if(!_count || ((_count != m_capacity || cellCount != m_cellCount) && !allocate(_count, cellCount)))
+    return;
+  m_count = _count;
+
+  // Pack the particles to the structure of arrays staging buffers
+  for(unsigned int i = 0; i < m_count; ++i)
+  {
+    const Particle *p = io_particles[i];
+    const cl_float4 pos = {{p->m_pos.m_x, p->m_pos.m_y, p->m_pos.m_z, 0.f}};
+    const cl_float4 vel = {{p->m_vel.m_x, p->m_vel.m_y, p->m_vel.m_z, 0.f}};
+    const cl_float4 extForces = {{p->m_extForces.m_x, p->m_extForces.m_y, p->m_extForces.m_z, 0.f}};
+    m_hostPos[i] = pos;
+    m_hostVel[i] = vel;
+    m_hostExtForces[i] = extForces;
+    m_hostMass[i] = p->m_mass;
+    m_hostRadius[i] = p->m_radius;
+    m_hostLambda[i] = p->m_lambda;
+  }
+
+  // Walls as the plane normal and distance term followed by the wall velocity, they move with the wave machine
+  cl_float4 walls[12];
+  for(int w = 0; w < 6; ++w)
+  {
+    walls[2*w].s[0] = _bb.m_walls[w].normal.m_x;
+    walls[2*w].s[1] = _bb.m_walls[w].normal.m_y;
+    walls[2*w].s[2] = _bb.m_walls[w].normal.m_z;
+    walls[2*w].s[3] = _bb.m_walls[w].d;
+    walls[2*w + 1].s[0] = _bb.m_walls[w].velocity.m_x;
+    walls[2*w + 1].s[1] = _bb.m_walls[w].velocity.m_y;
+    walls[2*w + 1].s[2] = _bb.m_walls[w].velocity.m_z;
+    walls[2*w + 1].s[3] = 0.f;
+  }
+
+  check(clEnqueueWriteBuffer(m_queue, m_buffers[POS], CL_FALSE, 0, m_count * sizeof(cl_float4), &m_hostPos[0], 0, nullptr, nullptr), "write positions");
+  check(clEnqueueWriteBuffer(m_queue, m_buffers[VEL], CL_FALSE, 0, m_count * sizeof(cl_float4), &m_hostVel[0], 0, nullptr, nullptr), "write velocities");
+  check(clEnqueueWriteBuffer(m_queue, m_buffers[EXT_FORCES], CL_FALSE, 0, m_count * sizeof(cl_float4), &m_hostExtForces[0], 0, nullptr, nullptr), "write forces");
+  check(clEnqueueWriteBuffer(m_queue, m_buffers[MASS], CL_FALSE, 0, m_count * sizeof(cl_float), &m_hostMass[0], 0, nullptr, nullptr), "write masses");
+  check(clEnqueueWriteBuffer(m_queue, m_buffers[RADIUS], CL_FALSE, 0, m_count * sizeof(cl_float), &m_hostRadius[0], 0, nullptr, nullptr), "write radii");
+  // The walls are a local array so this write has to block
+  check(clEnqueueWriteBuffer(m_queue, m_buffers[WALLS], CL_TRUE, 0, sizeof(walls), walls, 0, nullptr, nullptr), "write walls");
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void OpenCLBackend::predict(const float &_timeStep)
+{
+  PBF_PROFILE_SCOPE("predict");
+  const cl_float4 gravity = {{m_parameters.gravity.m_x, m_parameters.gravity.m_y, m_parameters.gravity.m_z, 0.f}};
+  const cl_float timeStep = _timeStep;
+  setArgs(PREDICT, 0, m_buffers[POS], m_buffers[PRED_POS], m_buffers[VEL], m_buffers[EXT_FORCES], m_buffers[POS_UPDATE],
+          gravity, timeStep, m_count);
+  run(PREDICT, m_count);
+  sync();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void OpenCLBackend::buildGrid(const bool &)
+{
+  PBF_PROFILE_SCOPE("grid");
+  // The keys are sorted again every step, a counting grid has nothing to refit
+  // Sort the (cell, particle) keys and find where each cell starts and ends in them
+  setArgs(CELL_KEYS, 0, m_buffers[POS], m_buffers[KEYS], m_gridMin, m_cellSize, m_cells[0], m_cells[1], m_cells[2],
+          m_count, m_paddedCount);
+  run(CELL_KEYS, m_paddedCount);
+
+  for(cl_uint k = 2; k <= m_paddedCount; k <<= 1)
+  {
+    for(cl_uint j = k >> 1; j > 0; j >>= 1)
+    {
+      setArgs(BITONIC_SORT, 0, m_buffers[KEYS], j, k);
+      run(BITONIC_SORT, m_paddedCount);
+    }
+  }
+
+  setArgs(CLEAR_CELLS, 0, m_buffers[CELL_START], m_buffers[CELL_END], m_cellCount);
+  run(CLEAR_CELLS, m_cellCount);
+  setArgs(CELL_RANGES, 0, m_buffers[KEYS], m_buffers[CELL_START], m_buffers[CELL_END], m_count);
+  run(CELL_RANGES, m_count);
+  sync();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void OpenCLBackend::buildNeighbors()
+{
+  PBF_PROFILE_SCOPE("neighbors");
+  setArgs(NEIGHBORS, 0, m_buffers[POS], m_buffers[KEYS], m_buffers[CELL_START], m_buffers[CELL_END],
+          m_buffers[NEIGHBOR_LIST], m_buffers[NUM_NEIGHBORS], m_gridMin, m_cellSize, m_cells[0], m_cells[1], m_cells[2],
+          m_count);
+  run(NEIGHBORS, m_count);
+  sync();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void OpenCLBackend::computeLambda(const unsigned int &_iteration)
+{
+  PBF_PROFILE_SCOPE_INDEX("lambda", _iteration);
+  setArgs(LAMBDA, 0, m_buffers[PRED_POS], m_buffers[MASS], m_buffers[NEIGHBOR_LIST], m_buffers[NUM_NEIGHBORS],
+          m_buffers[DENSITY], m_buffers[LAMBDA_VALUES], m_count);
+  run(LAMBDA, m_count);
+  sync();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void OpenCLBackend::warmStart()
+{
+  PBF_PROFILE_SCOPE("warm-start");
+  if(!m_ok || !m_count)
+    return;
+
+  // The lambdas of the previous step were staged with the particles, the update is applied without the velocity
+  check(clEnqueueWriteBuffer(m_queue, m_buffers[LAMBDA_VALUES], CL_FALSE, 0, m_count * sizeof(cl_float), &m_hostLambda[0], 0, nullptr, nullptr), "write lambdas");
+  const cl_float relaxation = m_solver.getRelaxation();
+  setArgs(POSITION_UPDATE, 0, m_buffers[PRED_POS], m_buffers[LAMBDA_VALUES], m_buffers[NEIGHBOR_LIST],
+          m_buffers[NUM_NEIGHBORS], m_buffers[POS_UPDATE], relaxation, m_count);
+  run(POSITION_UPDATE, m_count);
+  const cl_int lastIteration = 0;
+  const cl_float invTimeStep = 0.f;
+  setArgs(APPLY_UPDATE, 0, m_buffers[POS], m_buffers[PRED_POS], m_buffers[POS_UPDATE], m_buffers[VEL], m_buffers[RADIUS],
+          m_buffers[WALLS], lastIteration, invTimeStep, m_count);
+  run(APPLY_UPDATE, m_count);
+  sync();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void OpenCLBackend::computePositionUpdate(const unsigned int &_iteration)
+{
+  PBF_PROFILE_SCOPE_INDEX("update", _iteration);
+  const cl_float relaxation = m_solver.getRelaxation();
+  setArgs(POSITION_UPDATE, 0, m_buffers[PRED_POS], m_buffers[LAMBDA_VALUES], m_buffers[NEIGHBOR_LIST],
+          m_buffers[NUM_NEIGHBORS], m_buffers[POS_UPDATE], relaxation, m_count);
+  run(POSITION_UPDATE, m_count);
+  sync();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void OpenCLBackend::applyPositionUpdate(const unsigned int &_iteration, const bool &_lastIteration, const float &_timeStep)
+{
+  PBF_PROFILE_SCOPE_INDEX("collisions", _iteration);
+  const cl_int lastIteration = _lastIteration ? 1 : 0;
+  const cl_float invTimeStep = 1.f/_timeStep;
+  setArgs(APPLY_UPDATE, 0, m_buffers[POS], m_buffers[PRED_POS], m_buffers[POS_UPDATE], m_buffers[VEL], m_buffers[RADIUS],
+          m_buffers[WALLS], lastIteration, invTimeStep, m_count);
+  run(APPLY_UPDATE, m_count);
+  sync();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void OpenCLBackend::computeVorticity(const float &)
+{
+  PBF_PROFILE_SCOPE("vorticity");
+  setArgs(VORTICITY, 0, m_buffers[PRED_POS], m_buffers[VEL], m_buffers[DENSITY], m_buffers[NEIGHBOR_LIST],
+          m_buffers[NUM_NEIGHBORS], m_buffers[EXT_FORCES], m_buffers[POS_UPDATE], m_count);
+  run(VORTICITY, m_count);
+  sync();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void OpenCLBackend::finalize(FrameVertex *o_frame)
+{
+  PBF_PROFILE_SCOPE("finalize");
+  // The device layout differs from the frame, the vertices are written as the particles are read back
+  m_frame = o_frame;
+  setArgs(FINALIZE, 0, m_buffers[POS], m_buffers[PRED_POS], m_buffers[VEL], m_buffers[POS_UPDATE], m_count);
+  run(FINALIZE, m_count);
+  sync();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void OpenCLBackend::endStep(std::vector<Particle *> &io_particles)
+{
+  PBF_PROFILE_SCOPE("download");
+  FrameVertex *frame = m_frame;
+  m_frame = nullptr;
+  if(!m_ok || !m_count)
+    return;
+
+  // Read the state back, the last read blocks until the whole queue has finished
+  check(clEnqueueReadBuffer(m_queue, m_buffers[POS], CL_FALSE, 0, m_count * sizeof(cl_float4), &m_hostPos[0], 0, nullptr, nullptr), "read positions");
+  check(clEnqueueReadBuffer(m_queue, m_buffers[VEL], CL_FALSE, 0, m_count * sizeof(cl_float4), &m_hostVel[0], 0, nullptr, nullptr), "read velocities");
+  check(clEnqueueReadBuffer(m_queue, m_buffers[EXT_FORCES], CL_FALSE, 0, m_count * sizeof(cl_float4), &m_hostExtForces[0], 0, nullptr, nullptr), "read forces");
+  check(clEnqueueReadBuffer(m_queue, m_buffers[DENSITY], CL_FALSE, 0, m_count * sizeof(cl_float), &m_hostDensity[0], 0, nullptr, nullptr), "read densities");
+  check(clEnqueueReadBuffer(m_queue, m_buffers[LAMBDA_VALUES], CL_TRUE, 0, m_count * sizeof(cl_float), &m_hostLambda[0], 0, nullptr, nullptr), "read lambdas");
+
+  // Nothing is written back if any call of the step has failed, the caller runs the step again on the cpu
+  if(!m_ok)
+    return;
+
+  for(unsigned int i = 0; i < m_count; ++i)
+  {
+    Particle *p = io_particles[i];
+    p->m_pos.set(m_hostPos[i].s[0], m_hostPos[i].s[1], m_hostPos[i].s[2]);
+    p->m_predPos = p->m_pos;
+    p->m_vel.set(m_hostVel[i].s[0], m_hostVel[i].s[1], m_hostVel[i].s[2]);
+    p->m_extForces.set(m_hostExtForces[i].s[0], m_hostExtForces[i].s[1], m_hostExtForces[i].s[2]);
+    p->m_density = m_hostDensity[i];
+    p->m_lambda = m_hostLambda[i];
+    if(frame)
+      writeFrameVertex(*p, m_parameters.inverseRestDensity, frame[i]);
+  }
+}
+
+#endif // PBF_USE_OPENCL
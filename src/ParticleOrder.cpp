@@ -0,0 +1,195 @@
+#include <algorithm>
+#include "ParticleOrder.h"
+#include "Profiler.h"
+
+namespace
+{
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief spreadBits Moves bit b of the lowest 21 bits of a value to bit 3b
+  /// @param[in] _v     Value
+  /// @return           Spread value
+  //----------------------------------------------------------------------------------------------------------------------
+  uint64_t spreadBits(uint64_t _v)
+  {
+    _v &= 0x1fffffull;
+    _v = (_v | _v << 32) & 0x1f00000000ffffull;
+    _v = (_v | _v << 16) & 0x1f0000ff0000ffull;
+    _v = (_v | _v << 8) & 0x100f00f00f00f00full;
+    _v = (_v | _v << 4) & 0x10c30c30c30c30c3ull;
+    _v = (_v | _v << 2) & 0x1249249249249249ull;
+    return _v;
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+ParticleOrder::ParticleOrder() :
+  m_curve(HILBERT),
+  m_interval(0),
+  m_threshold(0.f),
+  m_disorder(0.f),
+  m_keyBits(0)
+{
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void ParticleOrder::configure(const Curve &_curve, const unsigned int &_interval, const float &_threshold)
+{
+  m_curve = _curve;
+  m_interval = _interval;
+  m_threshold = _threshold;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool ParticleOrder::update(ParticleBuffer &io_storage, const unsigned int &_count, const NNS &_nns, const unsigned int &_step)
+{
+  if(!isEnabled() || _count < 2)
+    return false;
+
+  // The keys are needed for the disorder anyway so they're computed every step when the threshold is used
+  const bool periodic = m_interval != 0 && _step % m_interval == 0;
+  if(!periodic && m_threshold <= 0.f)
+    return false;
+
+  PBF_PROFILE_SCOPE("reorder");
+  computeKeys(io_storage, _count, _nns);
+  if(!periodic && m_disorder < m_threshold)
+    return false;
+  sortKeys(_count);
+  gather(io_storage, _count);
+  return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void ParticleOrder::reorder(ParticleBuffer &io_storage, const unsigned int &_count, const NNS &_nns)
+{
+  PBF_PROFILE_SCOPE("reorder");
+  computeKeys(io_storage, _count, _nns);
+  sortKeys(_count);
+  gather(io_storage, _count);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void ParticleOrder::computeKeys(const ParticleBuffer &_storage, const unsigned int &_count, const NNS &_nns)
+{
+  // Enough bits for the longest axis of the grid, the particles outside of it are clamped to the border cells
+  const BoundingBox &bb = _nns.getBounds();
+  const Vec3 &cellSize = _nns.getCellSize();
+  const Vec3i &cells = _nns.getGridSize();
+  const int maxCells = std::max(cells.m_x, std::max(cells.m_y, cells.m_z));
+  int bits = 1;
+  while(bits < 21 && (1 << bits) < maxCells)
+    ++bits;
+  m_keyBits = 3 * bits;
+
+  m_keys.resize(_count);
+  const Vec3 minCorner(bb.m_minx, bb.m_miny, bb.m_minz);
+  const Vec3 invCellSize(1.f / cellSize.m_x, 1.f / cellSize.m_y, 1.f / cellSize.m_z);
+  const int last[3] = {cells.m_x - 1, cells.m_y - 1, cells.m_z - 1};
+  const bool hilbert = m_curve == HILBERT;
+#pragma omp parallel for schedule(static)
+  for(int i = 0; i < (int)_count; ++i)
+  {
+    const Vec3 c = (_storage[i].m_pos - minCorner) * invCellSize;
+    const float coords[3] = {c.m_x, c.m_y, c.m_z};
+    uint32_t cell[3];
+    for(int a = 0; a < 3; ++a)
+      cell[a] = (uint32_t)std::min(std::max((int)coords[a], 0), last[a]);
+    m_keys[i] = hilbert ? hilbertKey(cell[0], cell[1], cell[2], bits) : mortonKey(cell[0], cell[1], cell[2]);
+  }
+
+  // Count the places where the keys go backwards, each one is a jump in memory the sort would remove
+  unsigned int descents = 0;
+#pragma omp parallel for schedule(static) reduction(+:descents)
+  for(int i = 1; i < (int)_count; ++i)
+    descents += m_keys[i] < m_keys[i - 1] ? 1 : 0;
+  m_disorder = (float)descents / _count;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void ParticleOrder::sortKeys(const unsigned int &_count)
+{
+  // Least significant digit radix sort over the significant bits of the keys, stable so the particles of a cell
+  // keep their relative order
+  m_order.resize(_count);
+  m_sortScratch.resize(_count);
+  m_keyScratch.resize(_count);
+  for(unsigned int i = 0; i < _count; ++i)
+    m_order[i] = i;
+
+  for(int shift = 0; shift < m_keyBits; shift += 8)
+  {
+    unsigned int offsets[257] = {0};
+    for(unsigned int i = 0; i < _count; ++i)
+      ++offsets[((m_keys[i] >> shift) & 0xff) + 1];
+    for(int d = 0; d < 256; ++d)
+      offsets[d + 1] += offsets[d];
+    for(unsigned int i = 0; i < _count; ++i)
+    {
+      const unsigned int d = (m_keys[i] >> shift) & 0xff;
+      m_keyScratch[offsets[d]] = m_keys[i];
+      m_sortScratch[offsets[d]++] = m_order[i];
+    }
+    m_keys.swap(m_keyScratch);
+    m_order.swap(m_sortScratch);
+  }
+  m_disorder = 0.f;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void ParticleOrder::gather(ParticleBuffer &io_storage, const unsigned int &_count)
+{
+  // Gather in the same static partition as the solver loops so each thread first touches the pages it will use,
+  // then swap the buffers. The old storage is kept as the scratch of the next reorder.
+  const int size = io_storage.size();
+  m_scratch.resize(size);
+#pragma omp parallel for schedule(static)
+  for(int i = 0; i < size; ++i)
+    m_scratch[i] = io_storage[i < (int)_count ? m_order[i] : i];
+  io_storage.swap(m_scratch);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+uint64_t ParticleOrder::mortonKey(const uint32_t &_x, const uint32_t &_y, const uint32_t &_z)
+{
+  return spreadBits(_x) << 2 | spreadBits(_y) << 1 | spreadBits(_z);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+uint64_t ParticleOrder::hilbertKey(const uint32_t &_x, const uint32_t &_y, const uint32_t &_z, const int &_bits)
+{
+  // Skilling's transform of the coordinates to the transposed Hilbert index, interleaving the transposed
+  // coordinates gives the index itself
+  uint32_t x[3] = {_x, _y, _z};
+  const uint32_t top = 1u << (_bits - 1);
+  for(uint32_t q = top; q > 1; q >>= 1)
+  {
+    const uint32_t p = q - 1;
+    for(int i = 0; i < 3; ++i)
+    {
+      if(x[i] & q)
+      {
+        x[0] ^= p;
+      }
+      else
+      {
+        const uint32_t t = (x[0] ^ x[i]) & p;
+        x[0] ^= t;
+        x[i] ^= t;
+      }
+    }
+  }
+
+  // Gray encode
+  x[1] ^= x[0];
+  x[2] ^= x[1];
+  uint32_t t = 0;
+  for(uint32_t q = top; q > 1; q >>= 1)
+  {
+    if(x[2] & q)
+      t ^= q - 1;
+  }
+  for(int i = 0; i < 3; ++i)
+    x[i] ^= t;
+
+  return mortonKey(x[0], x[1], x[2]);
+}
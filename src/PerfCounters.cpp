@@ -0,0 +1,125 @@
+#include <algorithm>
+#include <cstring>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#include "PerfCounters.h"
+
+#ifdef __linux__
+namespace
+{
+//----------------------------------------------------------------------------------------------------------------------
+int openCounter(const unsigned int &_type, const unsigned long long &_config, const int &_group)
+{
+  // Count the calling thread on any cpu, user space only so it works with perf_event_paranoid 2
+  perf_event_attr attr;
+  std::memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = _type;
+  attr.config = _config;
+  attr.disabled = _group == -1 ? 1 : 0;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_ID;
+  return (int)syscall(__NR_perf_event_open, &attr, 0, -1, _group, 0);
+}
+}
+#endif
+
+//----------------------------------------------------------------------------------------------------------------------
+PerfCounters::PerfCounters() :
+  m_leader(-1)
+{
+  for(int c = 0; c < COUNT; ++c)
+  {
+    m_fds[c] = -1;
+    m_ids[c] = 0;
+  }
+
+#ifdef __linux__
+  const unsigned int types[COUNT] = {PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE,
+                                     PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE};
+  const unsigned long long configs[COUNT] =
+  {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+    PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_MISSES
+  };
+
+  // The first counter that opens leads the group so all of them are scheduled and read together,
+  // the ones the cpu doesn't support are skipped
+  for(int c = 0; c < COUNT; ++c)
+  {
+    m_fds[c] = openCounter(types[c], configs[c], m_leader);
+    if(m_fds[c] == -1)
+      continue;
+    if(m_leader == -1)
+      m_leader = m_fds[c];
+    ioctl(m_fds[c], PERF_EVENT_IOC_ID, &m_ids[c]);
+  }
+
+  if(m_leader != -1)
+  {
+    ioctl(m_leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(m_leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+  }
+#endif
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+PerfCounters::~PerfCounters()
+{
+#ifdef __linux__
+  for(int c = 0; c < COUNT; ++c)
+  {
+    if(m_fds[c] != -1)
+      close(m_fds[c]);
+  }
+#endif
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void PerfCounters::read(long long o_values[COUNT]) const
+{
+  for(int c = 0; c < COUNT; ++c)
+    o_values[c] = 0;
+
+#ifdef __linux__
+  if(m_leader == -1)
+    return;
+
+  // Group read layout: the amount of counters followed by a value and id pair for each
+  unsigned long long data[1 + 2 * COUNT];
+  if(::read(m_leader, data, sizeof(data)) <= 0)
+    return;
+
+  const unsigned long long count = std::min<unsigned long long>(data[0], COUNT);
+  for(unsigned long long n = 0; n < count; ++n)
+  {
+    for(int c = 0; c < COUNT; ++c)
+    {
+      if(m_fds[c] != -1 && m_ids[c] == data[2 + 2 * n])
+        o_values[c] = (long long)data[1 + 2 * n];
+    }
+  }
+#endif
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+const char *PerfCounters::getName(const Counter &_counter)
+{
+  switch(_counter)
+  {
+    case CYCLES : return "cycles";
+    case INSTRUCTIONS : return "instructions";
+    case L1_MISSES : return "l1d misses";
+    case LLC_MISSES : return "llc misses";
+    case BRANCH_MISSES : return "branch misses";
+    default : return "";
+  }
+}
@@ -0,0 +1,346 @@
+#ifdef PBF_PROFILE
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include "Profiler.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+RollingHistogram::RollingHistogram(const unsigned int &_capacity) :
+  m_samples(std::max(_capacity, 1u), 0.f),
+  m_next(0),
+  m_count(0),
+  m_sorted(m_samples.size())
+{
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void RollingHistogram::add(const float &_value)
+{
+  m_samples[m_next] = _value;
+  m_next = (m_next + 1) % m_samples.size();
+  m_count = std::min(m_count + 1, (unsigned int)m_samples.size());
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+float RollingHistogram::mean() const
+{
+  if(m_count == 0)
+    return 0.f;
+  float sum = 0.f;
+  for(unsigned int i = 0; i < m_count; ++i)
+    sum += m_samples[i];
+  return sum / m_count;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+float RollingHistogram::percentile(const float &_p) const
+{
+  if(m_count == 0)
+    return 0.f;
+  std::copy(m_samples.begin(), m_samples.begin() + m_count, m_sorted.begin());
+  const unsigned int rank = std::min((unsigned int)(_p * m_count), m_count - 1);
+  std::nth_element(m_sorted.begin(), m_sorted.begin() + rank, m_sorted.begin() + m_count);
+  return m_sorted[rank];
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+float RollingHistogram::histogram(const unsigned int &_bins, std::vector<unsigned int> &o_counts) const
+{
+  o_counts.assign(_bins, 0);
+  if(m_count == 0 || _bins == 0)
+    return 0.f;
+
+  const float max = *std::max_element(m_samples.begin(), m_samples.begin() + m_count);
+  const float binSize = max > 0.f ? max / _bins : 1.f;
+  for(unsigned int i = 0; i < m_count; ++i)
+    o_counts[std::min((unsigned int)(m_samples[i] / binSize), _bins - 1)]++;
+  return binSize;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+Profiler *Profiler::instance()
+{
+  static Profiler profiler;
+  return &profiler;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+Profiler::Profiler() :
+  m_epoch(std::chrono::steady_clock::now()),
+  m_eventCapacity(256),
+  m_captureFrames(0)
+{
+#ifdef PBF_PERF_COUNTERS
+  m_hasCounters = false;
+#endif
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+long long Profiler::now() const
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_epoch).count();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+long long Profiler::begin()
+{
+  ThreadBuffer *buffer = threadBuffer();
+  if(buffer->enabled)
+    buffer->depth++;
+  return now();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void Profiler::end(const char *_name, const int &_index, const long long &_start)
+{
+  const long long end = now();
+  ThreadBuffer *buffer = threadBuffer();
+  if(!buffer->enabled)
+    return;
+  Event event;
+  event.name = _name;
+  event.index = _index;
+  event.depth = --buffer->depth;
+  event.start = _start;
+  event.end = end;
+#ifdef PBF_PERF_COUNTERS
+  for(int c = 0; c < PerfCounters::COUNT; ++c)
+    event.counters[c] = 0;
+#endif
+  buffer->events.push_back(event);
+}
+
+#ifdef PBF_PERF_COUNTERS
+//----------------------------------------------------------------------------------------------------------------------
+void Profiler::readCounters(long long o_values[PerfCounters::COUNT])
+{
+  threadBuffer()->counters->read(o_values);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void Profiler::end(const char *_name, const int &_index, const long long &_start, const long long _counters[PerfCounters::COUNT])
+{
+  ThreadBuffer *buffer = threadBuffer();
+  if(!buffer->enabled)
+    return;
+  long long counters[PerfCounters::COUNT];
+  buffer->counters->read(counters);
+  end(_name, _index, _start);
+
+  Event &event = buffer->events.back();
+  for(int c = 0; c < PerfCounters::COUNT; ++c)
+    event.counters[c] = counters[c] - _counters[c];
+}
+#endif
+
+//----------------------------------------------------------------------------------------------------------------------
+Profiler::ThreadBuffer *Profiler::threadBuffer()
+{
+  // The buffers live as long as the program as the profiler may still read them after the thread has exited
+  static thread_local ThreadBuffer *buffer = nullptr;
+  if(!buffer)
+  {
+    buffer = new ThreadBuffer();
+    buffer->depth = 0;
+    buffer->enabled = true;
+#ifdef PBF_PERF_COUNTERS
+    // The counters measure the thread that opens them
+    buffer->counters = new PerfCounters();
+#endif
+    std::lock_guard<std::mutex> guard(m_lock);
+#ifdef PBF_PERF_COUNTERS
+    if(buffer->counters->isAvailable())
+      m_hasCounters = true;
+    else if(m_buffers.empty())
+      std::cerr << "Hardware counters unavailable, check /proc/sys/kernel/perf_event_paranoid\n";
+#endif
+    buffer->id = m_buffers.size();
+    buffer->events.reserve(m_eventCapacity);
+    m_buffers.push_back(buffer);
+  }
+  return buffer;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+unsigned int Profiler::findStage(const char *_name, const int &_index)
+{
+  for(unsigned int s = 0; s < m_stages.size(); ++s)
+  {
+    // The same literal may have a different address in another translation unit
+    if(m_stages[s].index == _index && (m_stages[s].name == _name || std::strcmp(m_stages[s].name, _name) == 0))
+      return s;
+  }
+
+  ProfileStage stage;
+  stage.name = _name;
+  stage.index = _index;
+  m_stages.push_back(stage);
+  m_stageStart.push_back(0);
+  m_stageEnd.push_back(-1);
+  return m_stages.size() - 1;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void Profiler::endFrame()
+{
+  if(!threadBuffer()->enabled)
+    return;
+  std::lock_guard<std::mutex> guard(m_lock);
+
+  // The wall time of a stage is the span from its earliest start to its latest end over all the
+  // threads, the busy time of a thread only counts its outermost scopes
+  if(m_threadTimes.size() < m_buffers.size())
+    m_threadTimes.resize(m_buffers.size());
+#ifdef PBF_PERF_COUNTERS
+  if(m_threadCounters.size() < m_buffers.size())
+    m_threadCounters.resize(m_buffers.size(), std::vector<RollingHistogram>(PerfCounters::COUNT));
+  m_stageCounters.assign(m_stages.size() * PerfCounters::COUNT, 0);
+#endif
+
+  // Frames with more scopes than reserveEvents() made room for give each buffer room for twice the largest frame so
+  // far, any thread may record all of them. Growing the buffers here keeps the scopes of the step from allocating.
+  std::size_t eventCount = 0;
+  for(unsigned int b = 0; b < m_buffers.size(); ++b)
+    eventCount += m_buffers[b]->events.size();
+  if(eventCount > m_eventCapacity)
+    m_eventCapacity = 2 * eventCount;
+
+  for(unsigned int b = 0; b < m_buffers.size(); ++b)
+  {
+    ThreadBuffer *buffer = m_buffers[b];
+    long long busy = 0;
+#ifdef PBF_PERF_COUNTERS
+    long long threadCounters[PerfCounters::COUNT] = {0};
+#endif
+    for(unsigned int e = 0; e < buffer->events.size(); ++e)
+    {
+      const Event &event = buffer->events[e];
+      const unsigned int s = findStage(event.name, event.index);
+      if(m_stageEnd[s] < m_stageStart[s])
+      {
+        m_stageStart[s] = event.start;
+        m_stageEnd[s] = event.end;
+      }
+      else
+      {
+        m_stageStart[s] = std::min(m_stageStart[s], event.start);
+        m_stageEnd[s] = std::max(m_stageEnd[s], event.end);
+      }
+      if(event.depth == 0)
+        busy += event.end - event.start;
+#ifdef PBF_PERF_COUNTERS
+      if(m_stageCounters.size() < m_stages.size() * PerfCounters::COUNT)
+        m_stageCounters.resize(m_stages.size() * PerfCounters::COUNT, 0);
+      for(int c = 0; c < PerfCounters::COUNT; ++c)
+      {
+        m_stageCounters[s * PerfCounters::COUNT + c] += event.counters[c];
+        if(event.depth == 0)
+          threadCounters[c] += event.counters[c];
+      }
+#endif
+      if(m_captureFrames > 0)
+        m_trace.push_back(std::make_pair(buffer->id, event));
+    }
+    if(!buffer->events.empty())
+    {
+      m_threadTimes[b].add(busy * 1e-6f);
+#ifdef PBF_PERF_COUNTERS
+      for(int c = 0; c < PerfCounters::COUNT; ++c)
+        m_threadCounters[b][c].add((float)threadCounters[c]);
+#endif
+    }
+    buffer->events.clear();
+    buffer->events.reserve(m_eventCapacity);
+  }
+
+  for(unsigned int s = 0; s < m_stages.size(); ++s)
+  {
+    if(m_stageEnd[s] >= m_stageStart[s])
+    {
+      m_stages[s].wallTime.add((m_stageEnd[s] - m_stageStart[s]) * 1e-6f);
+#ifdef PBF_PERF_COUNTERS
+      for(int c = 0; c < PerfCounters::COUNT; ++c)
+        m_stages[s].counters[c].add((float)m_stageCounters[s * PerfCounters::COUNT + c]);
+#endif
+    }
+    m_stageStart[s] = 0;
+    m_stageEnd[s] = -1;
+  }
+
+  if(m_captureFrames > 0 && --m_captureFrames == 0)
+    writeTrace();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void Profiler::reserveEvents(const std::size_t &_events)
+{
+  if(!threadBuffer()->enabled)
+    return;
+  std::lock_guard<std::mutex> guard(m_lock);
+  if(_events <= m_eventCapacity)
+    return;
+  m_eventCapacity = _events;
+  for(unsigned int b = 0; b < m_buffers.size(); ++b)
+    m_buffers[b]->events.reserve(m_eventCapacity);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void Profiler::captureTrace(const unsigned int &_frames, const std::string &_fileName)
+{
+  std::lock_guard<std::mutex> guard(m_lock);
+  m_trace.clear();
+  m_traceFile = _fileName;
+  m_captureFrames = _frames;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void Profiler::writeTrace()
+{
+  std::ofstream file(m_traceFile.c_str());
+  if(!file)
+  {
+    std::cerr << "Could not write the trace to " << m_traceFile << "\n";
+    return;
+  }
+
+  // Thread names first, then complete events ("X") with the timestamps in microseconds. The first
+  // thread to record a scope is the one running the step.
+  const char *separator = "";
+  file << "{\"traceEvents\":[";
+  for(unsigned int b = 0; b < m_buffers.size(); ++b)
+  {
+    file << separator << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << b
+         << ",\"args\":{\"name\":\"thread " << b << "\"}}";
+    separator = ",";
+  }
+  file.precision(3);
+  file << std::fixed;
+  for(unsigned int e = 0; e < m_trace.size(); ++e)
+  {
+    const Event &event = m_trace[e].second;
+    file << separator << "\n{\"name\":\"" << event.name;
+    if(event.index >= 0)
+      file << " " << event.index;
+    file << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << m_trace[e].first
+         << ",\"ts\":" << event.start * 1e-3 << ",\"dur\":" << (event.end - event.start) * 1e-3;
+#ifdef PBF_PERF_COUNTERS
+    if(m_hasCounters)
+    {
+      file << ",\"args\":{";
+      for(int c = 0; c < PerfCounters::COUNT; ++c)
+        file << (c ? ",\"" : "\"") << PerfCounters::getName((PerfCounters::Counter)c) << "\":" << event.counters[c];
+      file << "}";
+    }
+#endif
+    file << "}";
+    separator = ",";
+  }
+  file << "\n]}\n";
+
+  std::cout << "Wrote " << m_trace.size() << " trace events to " << m_traceFile << "\n";
+  m_trace.clear();
+}
+
+#endif // PBF_PROFILE
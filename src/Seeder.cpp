@@ -0,0 +1,459 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include "Seeder.h"
+
+namespace
+{
+//----------------------------------------------------------------------------------------------------------------------
+inline unsigned int hash(unsigned int _x)
+{
+  // Integer finalizer, every input bit affects every output bit
+  _x ^= _x >> 16;
+  _x *= 0x7feb352du;
+  _x ^= _x >> 15;
+  _x *= 0x846ca68bu;
+  _x ^= _x >> 16;
+  return _x;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+inline float jitter(const int &_x, const int &_y, const int &_z, const unsigned int &_seed, const unsigned int &_axis)
+{
+  // Uniform in [-1, 1) from the lattice index, the same point gets the same offset on every thread and rank
+  unsigned int h = hash(_seed * 3u + _axis);
+  h = hash(h ^ (unsigned int)_x);
+  h = hash(h ^ (unsigned int)_y);
+  h = hash(h ^ (unsigned int)_z);
+  return (h >> 8) * (2.f / 16777216.f) - 1.f;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+inline float edge(const Vec3 &_p, const Vec3 &_q, const float &_x, const float &_y)
+{
+  // Side of the point from the edge in the xy-plane. The edge is always evaluated from its lexicographically smaller
+  // end so the two triangles sharing it get exactly opposite values.
+  const bool swap = _q.m_x < _p.m_x || (_q.m_x == _p.m_x && _q.m_y < _p.m_y);
+  const Vec3 &a = swap ? _q : _p;
+  const Vec3 &b = swap ? _p : _q;
+  const float w = (b.m_x - a.m_x) * (_y - a.m_y) - (b.m_y - a.m_y) * (_x - a.m_x);
+  return swap ? -w : w;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+inline bool crossing(const Vec3 &_a, const Vec3 &_b, const Vec3 &_c, const float &_x, const float &_y, float *o_weights)
+{
+  // Whether a ray along z through (x, y) crosses the triangle, with the barycentric weights of the crossing. A ray
+  // through a shared edge or vertex is given to exactly one of the triangles with the top-left rule of rasterizers,
+  // so the parity of the crossings stays right for rays through the edges of a regular mesh.
+  const float area = (_b.m_x - _a.m_x) * (_c.m_y - _a.m_y) - (_c.m_x - _a.m_x) * (_b.m_y - _a.m_y);
+  if(area == 0.f)
+    return false;
+  // Walk the edges counter clockwise in the xy-plane, the weight of a vertex is the edge function of its opposite edge
+  const Vec3 *v[3] = {&_a, area > 0.f ? &_b : &_c, area > 0.f ? &_c : &_b};
+  for(int i = 0; i < 3; ++i)
+  {
+    const Vec3 &p = *v[(i + 1) % 3], &q = *v[(i + 2) % 3];
+    const float w = edge(p, q, _x, _y);
+    const float dx = q.m_x - p.m_x, dy = q.m_y - p.m_y;
+    if(w < 0.f || (w == 0.f && !(dy < 0.f || (dy == 0.f && dx > 0.f))))
+      return false;
+    o_weights[i] = w;
+  }
+  if(area < 0.f)
+    std::swap(o_weights[1], o_weights[2]);
+  return o_weights[0] + o_weights[1] + o_weights[2] > 0.f;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+inline int objIndex(const std::string &_token, const std::size_t &_vertexCount)
+{
+  // OBJ indices start from 1, negative ones count back from the last vertex, texture and normal indices are ignored
+  const int index = std::atoi(_token.c_str());
+  return index < 0 ? (int)_vertexCount + index : index - 1;
+}
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+SeedMesh::SeedMesh(const std::vector<Vec3> &_vertices, const std::vector<unsigned int> &_indices, const unsigned int &_resolution) :
+  m_insideCount(0)
+{
+  m_voxels[0] = m_voxels[1] = m_voxels[2] = 0;
+  if(_vertices.empty() || _indices.size() < 3)
+    return;
+
+  m_min = m_max = _vertices[0];
+  for(const Vec3 &v : _vertices)
+  {
+    m_min.set(std::min(m_min.m_x, v.m_x), std::min(m_min.m_y, v.m_y), std::min(m_min.m_z, v.m_z));
+    m_max.set(std::max(m_max.m_x, v.m_x), std::max(m_max.m_y, v.m_y), std::max(m_max.m_z, v.m_z));
+  }
+
+  // Cubic voxels, the longest axis gets the requested resolution
+  const Vec3 size = m_max - m_min;
+  const float voxel = std::max(size.m_x, std::max(size.m_y, size.m_z)) / std::max(_resolution, 1u);
+  if(voxel <= 0.f)
+    return;
+  m_voxels[0] = std::max(1, (int)std::ceil(size.m_x / voxel));
+  m_voxels[1] = std::max(1, (int)std::ceil(size.m_y / voxel));
+  m_voxels[2] = std::max(1, (int)std::ceil(size.m_z / voxel));
+  m_voxelSize.set(size.m_x / m_voxels[0], size.m_y / m_voxels[1], size.m_z / m_voxels[2]);
+  m_inside.assign((std::size_t)m_voxels[0] * m_voxels[1] * m_voxels[2], 0);
+
+  // Bin the triangles to the columns their xy-bounds overlap, the rays only test the triangles of their column
+  const int columns = m_voxels[0] * m_voxels[1];
+  std::vector<unsigned int> columnStart(columns + 1, 0);
+  std::vector<unsigned int> binned;
+  const unsigned int triangles = _indices.size() / 3;
+  for(int pass = 0; pass < 2; ++pass)
+  {
+    for(unsigned int t = 0; t < triangles; ++t)
+    {
+      const Vec3 &a = _vertices[_indices[3*t]], &b = _vertices[_indices[3*t + 1]], &c = _vertices[_indices[3*t + 2]];
+      const float minX = std::min(a.m_x, std::min(b.m_x, c.m_x)), maxX = std::max(a.m_x, std::max(b.m_x, c.m_x));
+      const float minY = std::min(a.m_y, std::min(b.m_y, c.m_y)), maxY = std::max(a.m_y, std::max(b.m_y, c.m_y));
+      // Columns whose centre is within the bounds, the centres are at (i + 0.5) * voxel size
+      const int x0 = std::max(0, (int)std::ceil((minX - m_min.m_x) / m_voxelSize.m_x - 0.5f));
+      const int x1 = std::min(m_voxels[0] - 1, (int)std::floor((maxX - m_min.m_x) / m_voxelSize.m_x - 0.5f));
+      const int y0 = std::max(0, (int)std::ceil((minY - m_min.m_y) / m_voxelSize.m_y - 0.5f));
+      const int y1 = std::min(m_voxels[1] - 1, (int)std::floor((maxY - m_min.m_y) / m_voxelSize.m_y - 0.5f));
+      for(int y = y0; y <= y1; ++y)
+        for(int x = x0; x <= x1; ++x)
+        {
+          const int column = x + y * m_voxels[0];
+          if(pass == 0)
+            ++columnStart[column + 1];
+          else
+            binned[columnStart[column]++] = t;
+        }
+    }
+    if(pass == 0)
+    {
+      for(int i = 0; i < columns; ++i)
+        columnStart[i + 1] += columnStart[i];
+      binned.resize(columnStart[columns]);
+    }
+    else
+    {
+      // The second pass advanced each start to the end of its column
+      for(int i = columns; i > 0; --i)
+        columnStart[i] = columnStart[i - 1];
+      columnStart[0] = 0;
+    }
+  }
+
+  // Cast a ray along z through the centre of each column and fill the voxels between the entry and exit crossings
+  unsigned int insideCount = 0;
+#pragma omp parallel for schedule(dynamic, 16) reduction(+:insideCount)
+  for(int column = 0; column < columns; ++column)
+  {
+    const int cx = column % m_voxels[0], cy = column / m_voxels[0];
+    const float px = m_min.m_x + (cx + 0.5f) * m_voxelSize.m_x;
+    const float py = m_min.m_y + (cy + 0.5f) * m_voxelSize.m_y;
+    std::vector<float> hits;
+    for(unsigned int i = columnStart[column]; i < columnStart[column + 1]; ++i)
+    {
+      const unsigned int t = binned[i];
+      float w[3];
+      if(crossing(_vertices[_indices[3*t]], _vertices[_indices[3*t + 1]], _vertices[_indices[3*t + 2]], px, py, w))
+      {
+        const Vec3 &a = _vertices[_indices[3*t]], &b = _vertices[_indices[3*t + 1]], &c = _vertices[_indices[3*t + 2]];
+        hits.push_back((w[0] * a.m_z + w[1] * b.m_z + w[2] * c.m_z) / (w[0] + w[1] + w[2]));
+      }
+    }
+    std::sort(hits.begin(), hits.end());
+
+    unsigned char *voxels = &m_inside[(std::size_t)column];
+    const std::size_t stride = (std::size_t)columns;
+    for(std::size_t h = 0; h + 1 < hits.size(); h += 2)
+    {
+      const int z0 = std::max(0, (int)std::ceil((hits[h] - m_min.m_z) / m_voxelSize.m_z - 0.5f));
+      const int z1 = std::min(m_voxels[2] - 1, (int)std::floor((hits[h + 1] - m_min.m_z) / m_voxelSize.m_z - 0.5f));
+      for(int z = z0; z <= z1; ++z)
+      {
+        voxels[z * stride] = 1;
+        ++insideCount;
+      }
+    }
+  }
+  m_insideCount = insideCount;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool SeedMesh::readOBJ(const std::string &_fileName, std::vector<Vec3> &o_vertices, std::vector<unsigned int> &o_indices)
+{
+  std::ifstream file(_fileName.c_str());
+  if(!file)
+    return false;
+
+  o_vertices.clear();
+  o_indices.clear();
+  std::string line, type, token;
+  std::vector<int> face;
+  while(std::getline(file, line))
+  {
+    std::istringstream stream(line);
+    if(!(stream >> type))
+      continue;
+    if(type == "v")
+    {
+      Vec3 v;
+      stream >> v.m_x >> v.m_y >> v.m_z;
+      o_vertices.push_back(v);
+    }
+    else if(type == "f")
+    {
+      // Fan the polygon into triangles
+      face.clear();
+      while(stream >> token)
+        face.push_back(objIndex(token, o_vertices.size()));
+      for(std::size_t i = 1; i + 1 < face.size(); ++i)
+      {
+        const int triangle[3] = {face[0], face[i], face[i + 1]};
+        for(int k = 0; k < 3; ++k)
+        {
+          if(triangle[k] < 0 || triangle[k] >= (int)o_vertices.size())
+            return false;
+          o_indices.push_back(triangle[k]);
+        }
+      }
+    }
+  }
+  return !o_indices.empty();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool SeedMesh::isClosed(const std::vector<unsigned int> &_indices)
+{
+  // Each edge as the pair of its vertices, lower index first, sorted so that the copies of an edge are adjacent
+  std::vector<uint64_t> edges;
+  edges.reserve(_indices.size());
+  for(std::size_t t = 0; t + 2 < _indices.size(); t += 3)
+  {
+    for(int k = 0; k < 3; ++k)
+    {
+      const uint64_t a = _indices[t + k], b = _indices[t + (k + 1) % 3];
+      edges.push_back(std::min(a, b) << 32 | std::max(a, b));
+    }
+  }
+  std::sort(edges.begin(), edges.end());
+  for(std::size_t e = 0; e < edges.size(); e += 2)
+  {
+    if(e + 1 == edges.size() || edges[e] != edges[e + 1] || (e + 2 < edges.size() && edges[e + 2] == edges[e]))
+      return false;
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool SeedMesh::contains(const Vec3 &_p) const
+{
+  if(m_inside.empty())
+    return false;
+  const Vec3 p = _p - m_min;
+  if(p.m_x < 0.f || p.m_y < 0.f || p.m_z < 0.f)
+    return false;
+  const int x = (int)(p.m_x / m_voxelSize.m_x);
+  const int y = (int)(p.m_y / m_voxelSize.m_y);
+  const int z = (int)(p.m_z / m_voxelSize.m_z);
+  if(x >= m_voxels[0] || y >= m_voxels[1] || z >= m_voxels[2])
+    return false;
+  return m_inside[x + (std::size_t)m_voxels[0] * (y + (std::size_t)m_voxels[1] * z)] != 0;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+Seeder::Seeder() :
+  m_spacing(0.24f),
+  m_targetCount(0),
+  m_hasOrigin(false),
+  m_sampling(LATTICE),
+  m_jitter(0.25f),
+  m_seed(1)
+{
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool Seeder::addMesh(const std::string &_fileName, const unsigned int &_resolution)
+{
+  std::vector<Vec3> vertices;
+  std::vector<unsigned int> indices;
+  if(!SeedMesh::readOBJ(_fileName, vertices, indices) || !SeedMesh::isClosed(indices))
+    return false;
+  m_volumes.push_back(std::make_shared<SeedMesh>(vertices, indices, _resolution));
+  return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void Seeder::setSampling(const Sampling &_sampling, const float &_jitter, const unsigned int &_seed)
+{
+  m_sampling = _sampling;
+  m_jitter = _jitter;
+  m_seed = _seed;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool Seeder::samplePoint(const Lattice &_lattice, const int &_x, const int &_y, const int &_z, Vec3 &o_p) const
+{
+  o_p = _lattice.origin + _lattice.spacing * Vec3(_x, _y, _z);
+  if(m_sampling == JITTERED)
+  {
+    const float amount = m_jitter * _lattice.spacing;
+    o_p += amount * Vec3(jitter(_x, _y, _z, m_seed, 0), jitter(_x, _y, _z, m_seed, 1), jitter(_x, _y, _z, m_seed, 2));
+  }
+
+  if(o_p.m_x < m_clipMin.m_x || o_p.m_y < m_clipMin.m_y || o_p.m_z < m_clipMin.m_z ||
+     o_p.m_x > m_clipMax.m_x || o_p.m_y > m_clipMax.m_y || o_p.m_z > m_clipMax.m_z)
+    return false;
+
+  for(const std::shared_ptr<const SeedVolume> &volume : m_volumes)
+    if(volume->contains(o_p))
+      return true;
+  return false;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void Seeder::getBounds(Vec3 &o_min, Vec3 &o_max) const
+{
+  // Union of the volume bounds, limited to the region the particles may be in
+  m_volumes[0]->getBounds(o_min, o_max);
+  for(std::size_t i = 1; i < m_volumes.size(); ++i)
+  {
+    Vec3 vmin, vmax;
+    m_volumes[i]->getBounds(vmin, vmax);
+    o_min.set(std::min(o_min.m_x, vmin.m_x), std::min(o_min.m_y, vmin.m_y), std::min(o_min.m_z, vmin.m_z));
+    o_max.set(std::max(o_max.m_x, vmax.m_x), std::max(o_max.m_y, vmax.m_y), std::max(o_max.m_z, vmax.m_z));
+  }
+  o_min.set(std::max(o_min.m_x, m_clipMin.m_x), std::max(o_min.m_y, m_clipMin.m_y), std::max(o_min.m_z, m_clipMin.m_z));
+  o_max.set(std::min(o_max.m_x, m_clipMax.m_x), std::min(o_max.m_y, m_clipMax.m_y), std::min(o_max.m_z, m_clipMax.m_z));
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void Seeder::buildLattice(const float &_spacing, Lattice &o_lattice) const
+{
+  Vec3 bmin, bmax;
+  getBounds(bmin, bmax);
+
+  o_lattice.spacing = _spacing;
+  o_lattice.origin = m_hasOrigin ? m_origin : bmin + Vec3(0.5f * _spacing, 0.5f * _spacing, 0.5f * _spacing);
+
+  // Jittered points may move up to the jitter from their lattice point
+  const float margin = m_sampling == JITTERED ? m_jitter * _spacing : 0.f;
+  const float lo[3] = {bmin.m_x - margin - o_lattice.origin.m_x, bmin.m_y - margin - o_lattice.origin.m_y, bmin.m_z - margin - o_lattice.origin.m_z};
+  const float hi[3] = {bmax.m_x + margin - o_lattice.origin.m_x, bmax.m_y + margin - o_lattice.origin.m_y, bmax.m_z + margin - o_lattice.origin.m_z};
+  for(int a = 0; a < 3; ++a)
+  {
+    o_lattice.begin[a] = (int)std::ceil(lo[a] / _spacing);
+    o_lattice.end[a] = std::max(o_lattice.begin[a], (int)std::floor(hi[a] / _spacing) + 1);
+  }
+
+  // Count the points of each x-slab in parallel and turn the counts into the first index of each slab
+  const int slabs = o_lattice.end[0] - o_lattice.begin[0];
+  o_lattice.slabStart.assign(slabs + 1, 0);
+#pragma omp parallel for schedule(dynamic, 1)
+  for(int s = 0; s < slabs; ++s)
+  {
+    const int x = o_lattice.begin[0] + s;
+    unsigned int count = 0;
+    Vec3 p;
+    for(int z = o_lattice.begin[2]; z < o_lattice.end[2]; ++z)
+      for(int y = o_lattice.begin[1]; y < o_lattice.end[1]; ++y)
+        count += samplePoint(o_lattice, x, y, z, p);
+    o_lattice.slabStart[s + 1] = count;
+  }
+  for(int s = 0; s < slabs; ++s)
+    o_lattice.slabStart[s + 1] += o_lattice.slabStart[s];
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+unsigned int Seeder::seed(ParticleBuffer &o_storage, const BoundingBox &_bb, const unsigned int &_first, const unsigned int &_stride)
+{
+  o_storage.clear();
+  if(m_volumes.empty())
+    return 0;
+
+  Particle tmp;
+  m_clipMin.set(_bb.m_minx + tmp.m_radius, _bb.m_miny + tmp.m_radius, _bb.m_minz + tmp.m_radius);
+  m_clipMax.set(_bb.m_maxx - tmp.m_radius, _bb.m_maxy - tmp.m_radius, _bb.m_maxz - tmp.m_radius);
+
+  Lattice lattice;
+  if(m_targetCount == 0)
+  {
+    buildLattice(m_spacing, lattice);
+  }
+  else
+  {
+    // Start from the spacing that would fill the bounds of the volumes and correct it with the ratio of the
+    // counts, the lattice count scales with the inverse cube of the spacing. Keep the densest lattice that
+    // still has enough points, the surplus is thinned out.
+    Vec3 bmin, bmax;
+    getBounds(bmin, bmax);
+    const Vec3 size = bmax - bmin;
+    float spacing = std::cbrt(std::max(size.m_x * size.m_y * size.m_z, 1e-9f) / m_targetCount);
+    float best = 0.f;
+    unsigned int bestCount = 0;
+    for(int iteration = 0; iteration < 16; ++iteration)
+    {
+      buildLattice(spacing, lattice);
+      const unsigned int count = lattice.slabStart.back();
+      if(count >= m_targetCount && (best == 0.f || count < bestCount))
+      {
+        best = spacing;
+        bestCount = count;
+      }
+      // A surplus of a percent thins out few enough points to leave the lattice regular
+      if(count >= m_targetCount && count - m_targetCount <= m_targetCount / 100)
+        break;
+      // Overshoot slightly towards the denser side so the search ends up with enough points
+      const float ratio = count == 0 ? 0.125f : std::cbrt((float)count / m_targetCount);
+      spacing *= std::max(0.5f, std::min(2.f, ratio)) * (count > m_targetCount ? 1.f : 0.999f);
+    }
+    for(int iteration = 0; best == 0.f && iteration < 200; ++iteration)
+    {
+      spacing *= 0.99f;
+      buildLattice(spacing, lattice);
+      if(lattice.slabStart.back() >= m_targetCount)
+        best = spacing;
+    }
+    if(best == 0.f)
+      return 0;
+    if(lattice.spacing != best)
+      buildLattice(best, lattice);
+  }
+  m_spacing = lattice.spacing;
+
+  // Keep lattice point g as particle (g + 1) * target / count - 1 when it advances that index, which spreads the
+  // dropped points evenly over the lattice
+  const unsigned long long count = lattice.slabStart.back();
+  const unsigned long long total = m_targetCount ? std::min<unsigned long long>(m_targetCount, count) : count;
+  const unsigned int local = total > _first ? (unsigned int)((total - _first + _stride - 1) / _stride) : 0;
+  o_storage.resize(local);
+
+  const int slabs = lattice.end[0] - lattice.begin[0];
+#pragma omp parallel for schedule(dynamic, 1)
+  for(int s = 0; s < slabs; ++s)
+  {
+    const int x = lattice.begin[0] + s;
+    unsigned long long g = lattice.slabStart[s];
+    if(g == lattice.slabStart[s + 1])
+      continue;
+    Vec3 p;
+    for(int z = lattice.begin[2]; z < lattice.end[2]; ++z)
+      for(int y = lattice.begin[1]; y < lattice.end[1]; ++y)
+      {
+        if(!samplePoint(lattice, x, y, z, p))
+          continue;
+        const unsigned long long next = (g + 1) * total / count;
+        const bool kept = next > g * total / count;
+        ++g;
+        if(!kept || (next - 1) % _stride != _first)
+          continue;
+        Particle &particle = o_storage[(next - 1 - _first) / _stride];
+        particle.m_pos = p;
+        particle.m_id = (unsigned int)(next - 1);
+      }
+  }
+  return (unsigned int)total;
+}
@@ -0,0 +1,697 @@
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include "SurfaceMesher.h"
+
+namespace
+{
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief MarchingCubesTable Triangles of each of the 256 corner configurations of a voxel. The corner bits are the
+  ///                           x, y and z offsets of the corner, edge e runs along axis e/4 from the (e%4)th corner
+  ///                           with a zero bit on that axis. Each face of the voxel joins its surface crossing edges
+  ///                           so that the inside corners are separated, as both voxels sharing a face make the same
+  ///                           choice the surface has no cracks. The segments are chained into loops and fanned.
+  //----------------------------------------------------------------------------------------------------------------------
+  struct MarchingCubesTable
+  {
+    enum { MAX_INDICES = 37 };
+    signed char triangles[256][MAX_INDICES];
+
+    MarchingCubesTable()
+    {
+      for(int config = 0; config < 256; ++config)
+      {
+        int next[12];
+        std::fill(next, next + 12, -1);
+        for(int axis = 0; axis < 3; ++axis)
+        {
+          for(int side = 0; side < 2; ++side)
+          {
+            // Corners of the face counter clockwise seen from outside the voxel
+            const int u = (axis + 1) % 3, v = (axis + 2) % 3;
+            int face[4] = {0, 1 << u, (1 << u) | (1 << v), 1 << v};
+            for(int k = 0; k < 4; ++k)
+              face[k] |= side << axis;
+            if(side == 0)
+              std::swap(face[1], face[3]);
+
+            // Join each edge entering the inside corners to the next edge leaving them
+            for(int k = 0; k < 4; ++k)
+            {
+              if(inside(config, face[k]) || !inside(config, face[(k + 1) % 4]))
+                continue;
+              for(int m = 1; m < 4; ++m)
+              {
+                const int c0 = face[(k + m) % 4], c1 = face[(k + m + 1) % 4];
+                if(inside(config, c0) && !inside(config, c1))
+                {
+                  next[edge(c0, c1)] = edge(face[k], face[(k + 1) % 4]);
+                  break;
+                }
+              }
+            }
+          }
+        }
+
+        // Every crossing edge is entered from one face and left from the other, so the segments form closed loops
+        int count = 0;
+        bool visited[12] = {false};
+        for(int e = 0; e < 12; ++e)
+        {
+          if(next[e] == -1 || visited[e])
+            continue;
+          int loop[12], length = 0;
+          for(int l = e; !visited[l]; l = next[l])
+          {
+            visited[l] = true;
+            loop[length++] = l;
+          }
+          for(int t = 1; t + 1 < length; ++t)
+          {
+            triangles[config][count++] = loop[0];
+            triangles[config][count++] = loop[t + 1];
+            triangles[config][count++] = loop[t];
+          }
+        }
+        triangles[config][count] = -1;
+      }
+    }
+
+    static bool inside(const int &_config, const int &_corner) { return (_config >> _corner) & 1; }
+
+    static int edge(const int &_c0, const int &_c1)
+    {
+      // The other two corner bits in order give the index of the edge along its axis
+      const int axis = (_c0 ^ _c1) == 1 ? 0 : (_c0 ^ _c1) == 2 ? 1 : 2;
+      const int origin = std::min(_c0, _c1);
+      const int low = origin & ((1 << axis) - 1);
+      const int high = origin >> (axis + 1);
+      return axis * 4 + (low | (high << axis));
+    }
+  };
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief edgeOrigin Corner of a voxel an edge starts from
+  /// @param[in] _edge  Edge index
+  /// @return           Corner bits
+  //----------------------------------------------------------------------------------------------------------------------
+  int edgeOrigin(const int &_edge)
+  {
+    const int axis = _edge / 4;
+    const int index = _edge % 4;
+    const int low = index & ((1 << axis) - 1);
+    const int high = index >> axis;
+    return low | (high << (axis + 1));
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool SurfaceMesh::writeOBJ(const std::string &_fileName) const
+{
+  std::ofstream file(_fileName.c_str());
+  if(!file)
+    return false;
+
+  for(unsigned int i = 0; i < m_vertices.size(); ++i)
+    file << "v " << m_vertices[i].m_x << " " << m_vertices[i].m_y << " " << m_vertices[i].m_z << "\n";
+  for(unsigned int i = 0; i < m_normals.size(); ++i)
+    file << "vn " << m_normals[i].m_x << " " << m_normals[i].m_y << " " << m_normals[i].m_z << "\n";
+  for(unsigned int i = 0; i + 2 < m_indices.size(); i += 3)
+  {
+    file << "f " << m_indices[i] + 1 << "//" << m_indices[i] + 1 << " "
+                 << m_indices[i + 1] + 1 << "//" << m_indices[i + 1] + 1 << " "
+                 << m_indices[i + 2] + 1 << "//" << m_indices[i + 2] + 1 << "\n";
+  }
+  return (bool)file;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+SurfaceMesher::SurfaceMesher() :
+  m_tileSize(4),
+  m_subdivisions(2),
+  m_range(0),
+  m_h2(0.f),
+  m_weight(0.f),
+  m_iso(0.5f),
+  m_busy(false),
+  m_ready(false),
+  m_quit(false)
+{
+  for(int a = 0; a < 3; ++a)
+    m_cells[a] = m_points[a] = m_tiles[a] = 0;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+SurfaceMesher::~SurfaceMesher()
+{
+  if(m_thread.joinable())
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_lock);
+      m_quit = true;
+    }
+    m_wake.notify_all();
+    m_thread.join();
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void SurfaceMesher::init(const NNS &_nns, const SolverParameters &_parameters, const unsigned int &_subdivisions)
+{
+  // The lattice is shared with the background thread
+  wait();
+
+  const BoundingBox &bb = _nns.getBounds();
+  const Vec3i &cells = _nns.getGridSize();
+  m_min.set(bb.m_minx, bb.m_miny, bb.m_minz);
+  m_cellSize = _nns.getCellSize();
+  m_subdivisions = std::max(_subdivisions, 1u);
+  m_spacing = m_cellSize / (float)m_subdivisions;
+  m_cells[0] = cells.m_x;
+  m_cells[1] = cells.m_y;
+  m_cells[2] = cells.m_z;
+  for(int a = 0; a < 3; ++a)
+  {
+    m_points[a] = m_cells[a] * m_subdivisions + 1;
+    m_tiles[a] = (m_cells[a] + m_tileSize - 1) / m_tileSize;
+  }
+
+  // The field is the density over the rest density, the poly6 kernel reaches a smoothing length away
+  const float h = _parameters.smoothingLength;
+  const float minCell = std::min(m_cellSize.m_x, std::min(m_cellSize.m_y, m_cellSize.m_z));
+  m_range = (int)std::ceil(h / minCell);
+  m_h2 = h*h;
+  m_weight = _parameters.polyKernelConstant * _parameters.inverseRestDensity;
+
+  const std::size_t cellCount = (std::size_t)m_cells[0] * m_cells[1] * m_cells[2];
+  m_cellStart.assign(cellCount + 1, 0);
+  m_active.assign(cellCount, 0);
+  m_scratch.assign(cellCount, 0);
+  m_field.assign((std::size_t)m_points[0] * m_points[1] * m_points[2], 0.f);
+  m_fieldTiles.clear();
+
+  // Every tile gets room up front as the surface keeps reaching new tiles while the fluid spreads, reserving on first
+  // use would allocate in the middle of a run. A plane crosses at most one edge per point and axis, a thin sheet of a
+  // splash has two sides and a vertex of a closed surface is shared by about six triangles. The vectors only grow
+  // when the surface folds more often than that inside a tile.
+  const std::size_t tileCount = (std::size_t)m_tiles[0] * m_tiles[1] * m_tiles[2];
+  const std::size_t sheetEdges = 2 * 3 * (std::size_t)(m_tileSize * m_subdivisions) * (m_tileSize * m_subdivisions);
+  m_tileData.resize(tileCount);
+  for(Tile &tile : m_tileData)
+  {
+    tile.edges.reserve(sheetEdges);
+    tile.vertices.reserve(sheetEdges);
+    tile.normals.reserve(sheetEdges);
+    tile.indices.reserve(6 * sheetEdges);
+  }
+  m_activeTiles.reserve(tileCount);
+  m_fieldTiles.reserve(tileCount);
+  m_tileActive.reserve(tileCount);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void SurfaceMesher::extract(const std::vector<Particle *> &_particles, const unsigned int &_count, SurfaceMesh &o_mesh)
+{
+  wait();
+  m_positions.resize(_count);
+  m_masses.resize(_count);
+  for(unsigned int i = 0; i < _count; ++i)
+  {
+    m_positions[i] = _particles[i]->m_pos;
+    m_masses[i] = _particles[i]->m_mass;
+  }
+  run(o_mesh);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool SurfaceMesher::submit(const std::vector<Particle *> &_particles, const unsigned int &_count)
+{
+  {
+    std::lock_guard<std::mutex> lock(m_lock);
+    if(m_busy)
+      return false;
+  }
+
+  // The background thread is idle so the copies can be written without locking
+  m_positions.resize(_count);
+  m_masses.resize(_count);
+  for(unsigned int i = 0; i < _count; ++i)
+  {
+    m_positions[i] = _particles[i]->m_pos;
+    m_masses[i] = _particles[i]->m_mass;
+  }
+
+  if(!m_thread.joinable())
+    m_thread = std::thread(&SurfaceMesher::workerLoop, this);
+  {
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_busy = true;
+  }
+  m_wake.notify_all();
+  return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool SurfaceMesher::fetch(SurfaceMesh &o_mesh)
+{
+  std::lock_guard<std::mutex> lock(m_lock);
+  if(!m_ready)
+    return false;
+  std::swap(o_mesh, m_result);
+  m_ready = false;
+  return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void SurfaceMesher::wait()
+{
+  std::unique_lock<std::mutex> lock(m_lock);
+  m_wake.wait(lock, [this]() { return !m_busy; });
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void SurfaceMesher::workerLoop()
+{
+  std::unique_lock<std::mutex> lock(m_lock);
+  for(;;)
+  {
+    m_wake.wait(lock, [this]() { return m_busy || m_quit; });
+    if(m_quit)
+      return;
+
+    lock.unlock();
+    run(m_working);
+    lock.lock();
+
+    // Publish the mesh, an unfetched older mesh is replaced
+    std::swap(m_working, m_result);
+    m_ready = true;
+    m_busy = false;
+    m_wake.notify_all();
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void SurfaceMesher::run(SurfaceMesh &o_mesh)
+{
+  binParticles();
+
+  // Points written by the previous extraction that aren't rewritten have to read as zero
+  const int tileCount = m_fieldTiles.size();
+#pragma omp parallel for schedule(dynamic)
+  for(int t = 0; t < tileCount; ++t)
+  {
+    const int tile = m_fieldTiles[t];
+    int begin[3], end[3];
+    tileRange(tile % m_tiles[0], 0, begin[0], end[0]);
+    tileRange((tile / m_tiles[0]) % m_tiles[1], 1, begin[1], end[1]);
+    tileRange(tile / (m_tiles[0] * m_tiles[1]), 2, begin[2], end[2]);
+    for(int z = begin[2]; z < end[2]; ++z)
+      for(int y = begin[1]; y < end[1]; ++y)
+        std::fill(&m_field[pointIndex(begin[0], y, z)], &m_field[pointIndex(begin[0], y, z)] + (end[0] - begin[0]), 0.f);
+  }
+  m_fieldTiles = m_activeTiles;
+
+  // Each pass reads the results of the neighboring tiles from the previous pass
+  const int activeCount = m_activeTiles.size();
+#pragma omp parallel for schedule(dynamic)
+  for(int t = 0; t < activeCount; ++t)
+    splatTile(m_activeTiles[t]);
+
+#pragma omp parallel for schedule(dynamic)
+  for(int t = 0; t < activeCount; ++t)
+    createVertices(m_activeTiles[t]);
+
+  unsigned int vertexCount = 0;
+  for(int t = 0; t < activeCount; ++t)
+  {
+    Tile &tile = m_tileData[m_activeTiles[t]];
+    tile.vertexOffset = vertexCount;
+    vertexCount += tile.vertices.size();
+  }
+
+#pragma omp parallel for schedule(dynamic)
+  for(int t = 0; t < activeCount; ++t)
+    triangulate(m_activeTiles[t]);
+
+  unsigned int indexCount = 0;
+  for(int t = 0; t < activeCount; ++t)
+  {
+    Tile &tile = m_tileData[m_activeTiles[t]];
+    tile.indexOffset = indexCount;
+    indexCount += tile.indices.size();
+  }
+
+  // Gather the tiles to the mesh
+  o_mesh.m_vertices.resize(vertexCount);
+  o_mesh.m_normals.resize(vertexCount);
+  o_mesh.m_indices.resize(indexCount);
+#pragma omp parallel for schedule(dynamic)
+  for(int t = 0; t < activeCount; ++t)
+  {
+    const Tile &tile = m_tileData[m_activeTiles[t]];
+    std::copy(tile.vertices.begin(), tile.vertices.end(), o_mesh.m_vertices.begin() + tile.vertexOffset);
+    std::copy(tile.normals.begin(), tile.normals.end(), o_mesh.m_normals.begin() + tile.vertexOffset);
+    std::copy(tile.indices.begin(), tile.indices.end(), o_mesh.m_indices.begin() + tile.indexOffset);
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void SurfaceMesher::binParticles()
+{
+  const unsigned int count = m_positions.size();
+  const int cellCount = m_active.size();
+  m_particleCells.resize(count);
+  m_cellParticles.resize(count);
+
+  // Cell of each particle with the same rounding as the neighbor search
+#pragma omp parallel for schedule(static)
+  for(unsigned int i = 0; i < count; ++i)
+  {
+    const Vec3 p = m_positions[i] - m_min;
+    const int x = (int)(p.m_x / m_cellSize.m_x);
+    const int y = (int)(p.m_y / m_cellSize.m_y);
+    const int z = (int)(p.m_z / m_cellSize.m_z);
+    if(p.m_x < 0.f || p.m_y < 0.f || p.m_z < 0.f || x >= m_cells[0] || y >= m_cells[1] || z >= m_cells[2])
+      m_particleCells[i] = -1;
+    else
+      m_particleCells[i] = x + m_cells[0] * (y + m_cells[1] * z);
+  }
+
+  // Counting sort of the particles by cell, the particles are placed from the end of each cell backwards
+  // which leaves the start of cell c in m_cellStart[c + 1]
+  std::fill(m_cellStart.begin(), m_cellStart.end(), 0);
+  for(unsigned int i = 0; i < count; ++i)
+    if(m_particleCells[i] != -1)
+      ++m_cellStart[m_particleCells[i] + 1];
+  for(int c = 0; c < cellCount; ++c)
+    m_cellStart[c + 1] += m_cellStart[c];
+  const unsigned int binned = m_cellStart[cellCount];
+  for(unsigned int i = count; i-- > 0; )
+  {
+    const int c = m_particleCells[i];
+    if(c != -1)
+      m_cellParticles[--m_cellStart[c + 1]] = i;
+  }
+  std::copy(m_cellStart.begin() + 1, m_cellStart.end(), m_cellStart.begin());
+  m_cellStart[cellCount] = binned;
+
+  // The field can only be non-zero within the kernel radius of an occupied cell, dilate the occupied
+  // cells by the radius one axis at a time keeping a count of the occupied cells in a sliding window
+  for(int c = 0; c < cellCount; ++c)
+    m_active[c] = m_cellStart[c + 1] > m_cellStart[c];
+  const int stride[3] = {1, m_cells[0], m_cells[0] * m_cells[1]};
+  for(int axis = 0; axis < 3; ++axis)
+  {
+    const int u = axis == 0 ? 1 : 0, v = axis == 2 ? 1 : 2;
+    const int length = m_cells[axis];
+    const int lines = m_cells[u] * m_cells[v];
+#pragma omp parallel for schedule(static)
+    for(int l = 0; l < lines; ++l)
+    {
+      const int start = (l % m_cells[u]) * stride[u] + (l / m_cells[u]) * stride[v];
+      const unsigned char *source = &m_active[start];
+      unsigned char *target = &m_scratch[start];
+      const int step = stride[axis];
+      int window = 0;
+      for(int d = 0; d < std::min(m_range, length); ++d)
+        window += source[d * step];
+      for(int d = 0; d < length; ++d)
+      {
+        if(d + m_range < length)
+          window += source[(d + m_range) * step];
+        if(d - m_range - 1 >= 0)
+          window -= source[(d - m_range - 1) * step];
+        target[d * step] = window > 0;
+      }
+    }
+    std::swap(m_active, m_scratch);
+  }
+
+  // A tile is needed if any of its points touches an active cell, the points of cell x run from
+  // x * subdivisions to (x + 1) * subdivisions so the last one may belong to the next tile
+  m_tileActive.assign(m_tileData.size(), 0);
+  for(int z = 0; z < m_cells[2]; ++z)
+  {
+    for(int y = 0; y < m_cells[1]; ++y)
+    {
+      for(int x = 0; x < m_cells[0]; ++x)
+      {
+        if(!m_active[x + m_cells[0] * (y + m_cells[1] * z)])
+          continue;
+        const int c[3] = {x, y, z};
+        int begin[3], end[3];
+        for(int a = 0; a < 3; ++a)
+        {
+          begin[a] = c[a] / m_tileSize;
+          end[a] = std::min((c[a] + 1) / m_tileSize, m_tiles[a] - 1);
+        }
+        for(int tz = begin[2]; tz <= end[2]; ++tz)
+          for(int ty = begin[1]; ty <= end[1]; ++ty)
+            for(int tx = begin[0]; tx <= end[0]; ++tx)
+              m_tileActive[tx + m_tiles[0] * (ty + m_tiles[1] * tz)] = 1;
+      }
+    }
+  }
+  m_activeTiles.clear();
+  for(unsigned int t = 0; t < m_tileActive.size(); ++t)
+    if(m_tileActive[t])
+      m_activeTiles.push_back(t);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void SurfaceMesher::splatTile(const unsigned int &_tile)
+{
+  const int t[3] = {(int)_tile % m_tiles[0], ((int)_tile / m_tiles[0]) % m_tiles[1], (int)_tile / (m_tiles[0] * m_tiles[1])};
+  int begin[3], end[3], cellBegin[3], cellEnd[3];
+  for(int a = 0; a < 3; ++a)
+  {
+    tileRange(t[a], a, begin[a], end[a]);
+    cellBegin[a] = std::max(begin[a] / m_subdivisions - m_range - 1, 0);
+    cellEnd[a] = std::min((end[a] - 1) / m_subdivisions + m_range + 1, m_cells[a]);
+  }
+
+  for(int z = begin[2]; z < end[2]; ++z)
+    for(int y = begin[1]; y < end[1]; ++y)
+      std::fill(&m_field[pointIndex(begin[0], y, z)], &m_field[pointIndex(begin[0], y, z)] + (end[0] - begin[0]), 0.f);
+
+  // Add the kernel of each particle around the tile to the points of the tile within its reach, the outermost
+  // points of the lattice are left at zero so the surface is closed where the fluid touches the walls
+  const float h = std::sqrt(m_h2);
+  int inner[6];
+  for(int a = 0; a < 3; ++a)
+  {
+    inner[a] = std::max(begin[a], 1);
+    inner[a + 3] = std::min(end[a], m_points[a] - 1);
+  }
+  for(int cz = cellBegin[2]; cz < cellEnd[2]; ++cz)
+  {
+    for(int cy = cellBegin[1]; cy < cellEnd[1]; ++cy)
+    {
+      for(int cx = cellBegin[0]; cx < cellEnd[0]; ++cx)
+      {
+        const int cell = cx + m_cells[0] * (cy + m_cells[1] * cz);
+        for(unsigned int n = m_cellStart[cell]; n < m_cellStart[cell + 1]; ++n)
+        {
+          const unsigned int i = m_cellParticles[n];
+          const Vec3 p = m_positions[i] - m_min;
+          const float weight = m_masses[i] * m_weight;
+          const int x0 = std::max((int)std::ceil((p.m_x - h) / m_spacing.m_x), inner[0]);
+          const int x1 = std::min((int)std::floor((p.m_x + h) / m_spacing.m_x) + 1, inner[3]);
+          const int y0 = std::max((int)std::ceil((p.m_y - h) / m_spacing.m_y), inner[1]);
+          const int y1 = std::min((int)std::floor((p.m_y + h) / m_spacing.m_y) + 1, inner[4]);
+          const int z0 = std::max((int)std::ceil((p.m_z - h) / m_spacing.m_z), inner[2]);
+          const int z1 = std::min((int)std::floor((p.m_z + h) / m_spacing.m_z) + 1, inner[5]);
+          for(int z = z0; z < z1; ++z)
+          {
+            const float dz = z * m_spacing.m_z - p.m_z;
+            for(int y = y0; y < y1; ++y)
+            {
+              const float dy = y * m_spacing.m_y - p.m_y;
+              float *field = &m_field[pointIndex(0, y, z)];
+              for(int x = x0; x < x1; ++x)
+              {
+                const float dx = x * m_spacing.m_x - p.m_x;
+                const float tmp = m_h2 - (dx*dx + dy*dy + dz*dz);
+                if(tmp > 0.f)
+                  field[x] += weight * tmp*tmp*tmp;
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void SurfaceMesher::createVertices(const unsigned int &_tile)
+{
+  const int t[3] = {(int)_tile % m_tiles[0], ((int)_tile / m_tiles[0]) % m_tiles[1], (int)_tile / (m_tiles[0] * m_tiles[1])};
+  int begin[3], end[3];
+  for(int a = 0; a < 3; ++a)
+    tileRange(t[a], a, begin[a], end[a]);
+
+  Tile &tile = m_tileData[_tile];
+  tile.edges.clear();
+  tile.vertices.clear();
+  tile.normals.clear();
+
+  // The points are visited in the order of their index so the edge keys come out sorted
+  const int s = m_subdivisions;
+  const std::size_t pointStride[3] = {1, (std::size_t)m_points[0], (std::size_t)m_points[0] * m_points[1]};
+  for(int z = begin[2]; z < end[2]; ++z)
+  {
+    for(int y = begin[1]; y < end[1]; ++y)
+    {
+      for(int x = begin[0]; x < end[0]; ++x)
+      {
+        const int p[3] = {x, y, z};
+        const std::size_t index = pointIndex(x, y, z);
+        const bool in = m_field[index] > m_iso;
+        for(int axis = 0; axis < 3; ++axis)
+        {
+          if(p[axis] + 1 >= m_points[axis])
+            continue;
+          int q[3] = {x, y, z};
+          ++q[axis];
+          const std::size_t other = index + pointStride[axis];
+          if((m_field[other] > m_iso) == in)
+            continue;
+
+          // Only the edges of the voxels in the active cells are triangulated, the edge lies in the cell
+          // ahead of it along its axis and in the one or two cells around it along the other axes
+          int c0[3], c1[3];
+          for(int a = 0; a < 3; ++a)
+          {
+            c1[a] = p[a] / s;
+            c0[a] = a != axis && p[a] % s == 0 ? c1[a] - 1 : c1[a];
+          }
+          bool active = false;
+          for(int cz = c0[2]; cz <= c1[2] && !active; ++cz)
+            for(int cy = c0[1]; cy <= c1[1] && !active; ++cy)
+              for(int cx = c0[0]; cx <= c1[0] && !active; ++cx)
+                active = isCellActive(cx, cy, cz);
+          if(!active)
+            continue;
+
+          // Interpolate the crossing and the field gradient of the end points
+          const float f0 = m_field[index], f1 = m_field[other];
+          const float w = (m_iso - f0) / (f1 - f0);
+          Vec3 position(x * m_spacing.m_x, y * m_spacing.m_y, z * m_spacing.m_z);
+          position.m_x += axis == 0 ? w * m_spacing.m_x : 0.f;
+          position.m_y += axis == 1 ? w * m_spacing.m_y : 0.f;
+          position.m_z += axis == 2 ? w * m_spacing.m_z : 0.f;
+
+          Vec3 gradient;
+          for(int e = 0; e < 2; ++e)
+          {
+            const int *c = e == 0 ? p : q;
+            const float weight = e == 0 ? 1.f - w : w;
+            float g[3];
+            for(int a = 0; a < 3; ++a)
+            {
+              int lo[3] = {c[0], c[1], c[2]}, hi[3] = {c[0], c[1], c[2]};
+              lo[a] = std::max(c[a] - 1, 0);
+              hi[a] = std::min(c[a] + 1, m_points[a] - 1);
+              g[a] = (m_field[pointIndex(hi[0], hi[1], hi[2])] - m_field[pointIndex(lo[0], lo[1], lo[2])]) / (hi[a] - lo[a]);
+            }
+            gradient += weight * Vec3(g[0] / m_spacing.m_x, g[1] / m_spacing.m_y, g[2] / m_spacing.m_z);
+          }
+          // The density falls towards the outside
+          const float length = gradient.length();
+          Vec3 normal = length > 0.f ? gradient / -length : Vec3(0.f, 1.f, 0.f);
+
+          tile.edges.push_back(index * 3 + axis);
+          tile.vertices.push_back(position + m_min);
+          tile.normals.push_back(normal);
+        }
+      }
+    }
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void SurfaceMesher::triangulate(const unsigned int &_tile)
+{
+  static const MarchingCubesTable table;
+  const int t[3] = {(int)_tile % m_tiles[0], ((int)_tile / m_tiles[0]) % m_tiles[1], (int)_tile / (m_tiles[0] * m_tiles[1])};
+  int begin[3], end[3];
+  for(int a = 0; a < 3; ++a)
+  {
+    begin[a] = t[a] * m_tileSize;
+    end[a] = std::min(begin[a] + m_tileSize, m_cells[a]);
+  }
+
+  Tile &tile = m_tileData[_tile];
+  tile.indices.clear();
+
+  const int s = m_subdivisions;
+  std::size_t corners[8];
+  for(int c = 0; c < 8; ++c)
+    corners[c] = pointIndex(c & 1, (c >> 1) & 1, (c >> 2) & 1);
+  for(int cz = begin[2]; cz < end[2]; ++cz)
+  {
+    for(int cy = begin[1]; cy < end[1]; ++cy)
+    {
+      for(int cx = begin[0]; cx < end[0]; ++cx)
+      {
+        if(!isCellActive(cx, cy, cz))
+          continue;
+
+        // Voxels of the cell
+        for(int z = cz * s; z < (cz + 1) * s; ++z)
+        {
+          for(int y = cy * s; y < (cy + 1) * s; ++y)
+          {
+            for(int x = cx * s; x < (cx + 1) * s; ++x)
+            {
+              const float *field = &m_field[pointIndex(x, y, z)];
+              int config = 0;
+              for(int c = 0; c < 8; ++c)
+                config |= (field[corners[c]] > m_iso) << c;
+              if(config == 0 || config == 255)
+                continue;
+
+              for(const signed char *e = table.triangles[config]; *e != -1; ++e)
+              {
+                const int origin = edgeOrigin(*e);
+                tile.indices.push_back(findVertex(x + (origin & 1), y + ((origin >> 1) & 1), z + ((origin >> 2) & 1), *e / 4));
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+unsigned int SurfaceMesher::findVertex(const int &_x, const int &_y, const int &_z, const int &_axis) const
+{
+  // The tile owning the point the edge starts from has the vertex
+  const int pointsPerTile = m_tileSize * m_subdivisions;
+  const int tx = std::min(_x / pointsPerTile, m_tiles[0] - 1);
+  const int ty = std::min(_y / pointsPerTile, m_tiles[1] - 1);
+  const int tz = std::min(_z / pointsPerTile, m_tiles[2] - 1);
+  const Tile &tile = m_tileData[tx + m_tiles[0] * (ty + m_tiles[1] * tz)];
+  const uint64_t key = pointIndex(_x, _y, _z) * 3 + _axis;
+  const std::vector<uint64_t>::const_iterator it = std::lower_bound(tile.edges.begin(), tile.edges.end(), key);
+  return tile.vertexOffset + (it - tile.edges.begin());
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool SurfaceMesher::isCellActive(const int &_x, const int &_y, const int &_z) const
+{
+  if(_x < 0 || _x >= m_cells[0] || _y < 0 || _y >= m_cells[1] || _z < 0 || _z >= m_cells[2])
+    return false;
+  return m_active[_x + m_cells[0] * (_y + m_cells[1] * _z)];
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void SurfaceMesher::tileRange(const int &_t, const int &_axis, int &o_begin, int &o_end) const
+{
+  const int pointsPerTile = m_tileSize * m_subdivisions;
+  o_begin = _t * pointsPerTile;
+  o_end = _t + 1 == m_tiles[_axis] ? m_points[_axis] : o_begin + pointsPerTile;
+}
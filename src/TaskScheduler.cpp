@@ -0,0 +1,234 @@
+#include <algorithm>
+#include "TaskScheduler.h"
+
+namespace
+{
+  // Id of the worker the calling thread is processing a graph as
+  thread_local unsigned int t_worker = 0;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+unsigned int TaskGraph::addTask(const std::function<void()> &_task)
+{
+  // Reuse the slots of earlier graphs so a graph of the same shape doesn't allocate
+  if(m_size == m_tasks.size())
+  {
+    m_tasks.push_back(_task);
+    m_predecessorCount.push_back(0);
+  }
+  else
+  {
+    m_tasks[m_size] = _task;
+    m_predecessorCount[m_size] = 0;
+  }
+  return m_size++;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void TaskGraph::addDependency(const unsigned int &_before, const unsigned int &_after)
+{
+  m_dependencies.push_back(std::make_pair(_before, _after));
+  m_predecessorCount[_after]++;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void TaskGraph::reserve(const unsigned int &_tasks, const unsigned int &_dependencies)
+{
+  m_tasks.reserve(_tasks);
+  m_predecessorCount.reserve(_tasks);
+  m_successorStart.reserve(_tasks + 1);
+  m_dependencies.reserve(_dependencies);
+  m_successors.reserve(_dependencies);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void TaskGraph::buildSuccessors()
+{
+  // Counting sort by the task that has to finish first, the successors of a task stay in the order they were added
+  m_successorStart.assign(m_size + 1, 0);
+  m_successors.resize(m_dependencies.size());
+  for(const std::pair<unsigned int, unsigned int> &dependency : m_dependencies)
+    ++m_successorStart[dependency.first + 1];
+  for(unsigned int t = 0; t < m_size; ++t)
+    m_successorStart[t + 1] += m_successorStart[t];
+  for(const std::pair<unsigned int, unsigned int> &dependency : m_dependencies)
+    m_successors[m_successorStart[dependency.first]++] = dependency.second;
+  for(unsigned int t = m_size; t > 0; --t)
+    m_successorStart[t] = m_successorStart[t - 1];
+  m_successorStart[0] = 0;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+TaskScheduler::TaskScheduler(const unsigned int &_threads) :
+  m_graph(nullptr),
+  m_pendingCapacity(0),
+  m_remaining(0),
+  m_active(0),
+  m_generation(0),
+  m_quit(false)
+{
+  unsigned int threads = _threads;
+  if(threads == 0)
+    threads = std::max(1u, std::thread::hardware_concurrency());
+
+  for(unsigned int i = 0; i < threads; ++i)
+  {
+    m_workers.emplace_back(new Worker());
+    m_workers.back()->first = 0;
+    m_workers.back()->count = 0;
+  }
+
+  // The calling thread is worker 0, so only start the rest
+  for(unsigned int i = 1; i < threads; ++i)
+    m_threads.emplace_back(&TaskScheduler::workerLoop, this, i);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+TaskScheduler::~TaskScheduler()
+{
+  {
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_quit = true;
+  }
+  m_wake.notify_all();
+  for(unsigned int i = 0; i < m_threads.size(); ++i)
+    m_threads[i].join();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void TaskScheduler::run(TaskGraph &_graph)
+{
+  if(_graph.size() == 0)
+    return;
+
+  // The counters and the deques only grow, so running graphs of the same size doesn't allocate
+  if(_graph.size() > m_pendingCapacity)
+  {
+    m_pendingCapacity = std::max(_graph.size(), _graph.capacity());
+    m_pending.reset(new std::atomic<unsigned int>[m_pendingCapacity]);
+    for(std::unique_ptr<Worker> &worker : m_workers)
+    {
+      worker->tasks.resize(m_pendingCapacity);
+      worker->first = 0;
+    }
+  }
+  _graph.buildSuccessors();
+
+  // Reset the dependency counters and hand out the tasks without dependencies round robin,
+  // the remaining count is set last so no worker starts before the counters are ready
+  m_graph = &_graph;
+  unsigned int worker = 0;
+  for(unsigned int i = 0; i < _graph.size(); ++i)
+  {
+    m_pending[i] = _graph.m_predecessorCount[i];
+    if(_graph.m_predecessorCount[i] == 0)
+    {
+      push(worker, i);
+      worker = (worker + 1) % m_workers.size();
+    }
+  }
+  m_remaining = _graph.size();
+
+  {
+    std::lock_guard<std::mutex> guard(m_lock);
+    ++m_generation;
+  }
+  m_wake.notify_all();
+
+  process(0);
+
+  // Wait for the other workers to leave the graph before it's modified again
+  while(m_active > 0)
+    std::this_thread::yield();
+  m_graph = nullptr;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+unsigned int TaskScheduler::getCurrentWorker()
+{
+  return t_worker;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void TaskScheduler::workerLoop(const unsigned int _id)
+{
+  unsigned long generation = 0;
+  while(true)
+  {
+    {
+      std::unique_lock<std::mutex> guard(m_lock);
+      m_wake.wait(guard, [&]() { return m_quit || m_generation != generation; });
+      if(m_quit)
+        return;
+      generation = m_generation;
+      ++m_active;
+    }
+    process(_id);
+    --m_active;
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void TaskScheduler::process(const unsigned int &_id)
+{
+  t_worker = _id;
+  unsigned int task;
+  while(m_remaining > 0)
+  {
+    if(!pop(_id, task) && !steal(_id, task))
+    {
+      std::this_thread::yield();
+      continue;
+    }
+
+    m_graph->m_tasks[task]();
+
+    // Release the successors, the ones that became ready go to our own deque so
+    // they're likely to run next on this core
+    const unsigned int *successors = m_graph->m_successors.data();
+    for(unsigned int i = m_graph->m_successorStart[task]; i < m_graph->m_successorStart[task + 1]; ++i)
+    {
+      if(m_pending[successors[i]].fetch_sub(1) == 1)
+        push(_id, successors[i]);
+    }
+    --m_remaining;
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool TaskScheduler::pop(const unsigned int &_id, unsigned int &o_task)
+{
+  Worker &worker = *m_workers[_id];
+  std::lock_guard<std::mutex> guard(worker.lock);
+  if(worker.count == 0)
+    return false;
+  --worker.count;
+  o_task = worker.tasks[(worker.first + worker.count) % worker.tasks.size()];
+  return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool TaskScheduler::steal(const unsigned int &_id, unsigned int &o_task)
+{
+  for(unsigned int i = 1; i < m_workers.size(); ++i)
+  {
+    Worker &victim = *m_workers[(_id + i) % m_workers.size()];
+    std::lock_guard<std::mutex> guard(victim.lock);
+    if(victim.count != 0)
+    {
+      o_task = victim.tasks[victim.first];
+      victim.first = (victim.first + 1) % victim.tasks.size();
+      --victim.count;
+      return true;
+    }
+  }
+  return false;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void TaskScheduler::push(const unsigned int &_id, const unsigned int &_task)
+{
+  Worker &worker = *m_workers[_id];
+  std::lock_guard<std::mutex> guard(worker.lock);
+  worker.tasks[(worker.first + worker.count++) % worker.tasks.size()] = _task;
+}
@@ -0,0 +1,150 @@
+#include <algorithm>
+#include <cmath>
+#include "Profiler.h"
+#include "UniformGrid.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+UniformGrid::~UniformGrid()
+{
+  // Clean up the grid
+  // As the member variables are vectors, we don't have to worry about the cleanup of the neighbor tables
+  m_grid.clear();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void UniformGrid::initStructure()
+{
+  // Get the cell count, estimate maximum particles per cell and resize the vectors
+  Particle tmp;
+  m_grid.clear();
+  unsigned int cellCount = m_cells.m_x * m_cells.m_y * m_cells.m_z;
+  m_maxParticlesPerCell = (int)std::ceil((m_cellSize.m_x*m_cellSize.m_y*m_cellSize.m_z) / (tmp.m_radius*tmp.m_radius*tmp.m_radius)) * 2;
+  m_gridCellNumParticles.resize(cellCount);
+
+  // Initialise the grid particle counts to 0 and make sure
+  // that the grid cell vectors have enough space and are set to -1 for no particles
+  for(unsigned int i = 0; i < cellCount; ++i)
+  {
+    m_gridCellNumParticles[i] = 0;
+    m_grid[i].assign(m_maxParticlesPerCell, -1);
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void UniformGrid::buildGrid(const std::vector<Particle *> &_particles)
+{
+  PBF_PROFILE_SCOPE("grid");
+  // Iterate over the particles and insert them in their respective cells,
+  // ignores the particles if the cell id's invalid or the maximum amount of particles
+  // per cell has been reached (in theory this should never be the case)
+  for(unsigned int i = 0; i < m_particleCount; ++i)
+  {
+    const unsigned int x = getCellX(_particles[i]->m_pos.m_x);
+    const unsigned int y = getCellY(_particles[i]->m_pos.m_y);
+    const unsigned int z = getCellZ(_particles[i]->m_pos.m_z);
+    const int cell = getCell(x, y, z);
+    if(cell != -1)
+    {
+      if(m_gridCellNumParticles[cell] < m_maxParticlesPerCell)
+      {
+        m_grid[cell][m_gridCellNumParticles[cell]++] = i;
+      }
+    }
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void UniformGrid::cleanTable()
+{
+  unsigned int cellCount = m_cells.m_x * m_cells.m_y * m_cells.m_z;
+
+  // Set the grid cell values to -1 and reset the grid cell particle counts to 0
+  // Note that we're not cleaning up the neighbor tables as the m_numNeighbors
+  // table makes sure that the particle's will never receive "old"/excess data
+  // even if the table's not fully cleaned up
+  for(unsigned int i = 0; i < cellCount; ++i)
+  {
+    for(unsigned int j = 0; j < m_gridCellNumParticles[i]; ++j)
+      m_grid[i][j] = -1;
+    m_gridCellNumParticles[i] = 0;
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void UniformGrid::findNeighbors(const std::vector<Particle *> &_particles, const unsigned int &_pid)
+{
+  // Get neighboring cells up to 2 cells away (each direction)
+  const int coords[5] = {0, 1, -1, 2, -2};
+  const unsigned int a = _pid;
+
+  // Get the current cell coordinates and initialise the amount of neighbors to 0
+  const int x = getCellX(_particles[a]->m_pos.m_x);
+  const int y = getCellY(_particles[a]->m_pos.m_y);
+  const int z = getCellZ(_particles[a]->m_pos.m_z);
+  unsigned int *neighbors = &m_neighbors[(std::size_t)a * m_maxNeighbors];
+  m_numNeighbors[a] = 0;
+
+  // Loop through the current and neighboring cells
+  for(int i = 0; i < 5; ++i)
+  {
+    for(int j = 0; j < 5; ++j)
+    {
+      for(int k = 0; k < 5; ++k)
+      {
+        // Get the 1D cell id and make sure it's valid
+        const int cell = getCell(x + coords[i], y + coords[j], z + coords[k]);
+        if(cell != -1)
+        {
+          // Get the particle indices in the cell and iterate over them, the cell is only read so
+          // it's looked up without operator[] which could insert into the map from several threads
+          const std::vector<int> &cellData = m_grid.find(cell)->second;
+          for(unsigned int n = 0; n < m_gridCellNumParticles[cell]; ++n)
+          {
+            // Get the particle index, p should never be -1 due to us keeping track of the amount
+            // of particles per cell but just to be sure we check if this is the case and break out
+            // Also don't add the current particle to the table
+            int p = cellData[n];
+            if(p == -1)
+              break;
+            if(p == (int)a)
+              continue;
+            // Check that the maximum amount of neighbors hasn't been reached
+            if(m_numNeighbors[a] < m_maxNeighbors)
+            {
+              // Check if the particle is within a fixed radius of the current particle and add it to the list if so
+              if((_particles[a]->m_pos - _particles[p]->m_pos).lengthSquared() < m_fixedRadius*m_fixedRadius)
+              {
+                neighbors[m_numNeighbors[a]++] = p;
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+
+  finishNeighbors(a);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void UniformGrid::rangeQuery(const std::vector<Particle *> &_particles, const Vec3 &_p, const float &_radius, std::vector<unsigned int> &o_indices) const
+{
+  // Cells overlapped by the box around the query, clamped to the grid
+  o_indices.clear();
+  const int x0 = std::max(getCellX(_p.m_x - _radius), 0), x1 = std::min(getCellX(_p.m_x + _radius), m_cells.m_x - 1);
+  const int y0 = std::max(getCellY(_p.m_y - _radius), 0), y1 = std::min(getCellY(_p.m_y + _radius), m_cells.m_y - 1);
+  const int z0 = std::max(getCellZ(_p.m_z - _radius), 0), z1 = std::min(getCellZ(_p.m_z + _radius), m_cells.m_z - 1);
+  const float r2 = _radius * _radius;
+  for(int z = z0; z <= z1; ++z)
+    for(int y = y0; y <= y1; ++y)
+      for(int x = x0; x <= x1; ++x)
+      {
+        const int cell = getCell(x, y, z);
+        const std::vector<int> &cellData = m_grid.at(cell);
+        for(unsigned int n = 0; n < m_gridCellNumParticles[cell]; ++n)
+        {
+          if((_particles[cellData[n]]->m_pos - _p).lengthSquared() < r2)
+            o_indices.push_back(cellData[n]);
+        }
+      }
+}
@@ -0,0 +1,211 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include "Workload.h"
+#include "NNS.h"
+
+namespace
+{
+  // Bits of the flags in the header
+  const unsigned int c_wavesFlag = 1u;
+  const unsigned int c_neighborsFlag = 2u;
+
+  // Words of the header before the scene name: magic, version, flags, particle count and step
+  const unsigned int c_headerSize = 5;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+Workload::Workload() :
+  m_step(0),
+  m_bb(0.f, 0.f, 0.f, 0.f, 0.f, 0.f),
+  m_waves(false)
+{
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void Workload::capture(const std::string &_scene, const unsigned int &_step, const BoundingBox &_bb, const bool &_waves,
+                       const std::vector<Particle *> &_particles, const unsigned int &_count)
+{
+  m_scene = _scene.substr(0, m_nameSize - 1);
+  m_step = _step;
+  m_bb = _bb;
+  m_waves = _waves;
+  m_particles.resize(std::min<std::size_t>(_count, _particles.size()));
+  for(unsigned int i = 0; i < m_particles.size(); ++i)
+    m_particles[i] = *_particles[i];
+  m_neighborOffsets.clear();
+  m_neighbors.clear();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool Workload::computeNeighbors(const std::string &_nns, const unsigned int &_maxNeighbors)
+{
+  std::unique_ptr<NNS> nns = NNS::create(_nns);
+  if(!nns)
+    return false;
+
+  std::vector<Particle *> particles(m_particles.size());
+  for(unsigned int i = 0; i < m_particles.size(); ++i)
+    particles[i] = &m_particles[i];
+  nns->setSortedNeighbors(true);
+  nns->init(m_bb, particles.size(), _maxNeighbors);
+  nns->buildGrid(particles);
+  nns->buildNeighborTable(particles);
+
+  m_neighborOffsets.assign(1, 0);
+  m_neighbors.clear();
+  for(unsigned int i = 0; i < particles.size(); ++i)
+  {
+    const std::pair<unsigned int *, unsigned int> neighbors = nns->getNeighbors(i);
+    m_neighbors.insert(m_neighbors.end(), neighbors.first, neighbors.first + neighbors.second);
+    m_neighborOffsets.push_back(m_neighbors.size());
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool Workload::write(const std::string &_fileName) const
+{
+  std::ofstream file(_fileName.c_str(), std::ios::binary);
+  if(!file)
+    return false;
+
+  const unsigned int flags = (m_waves ? c_wavesFlag : 0u) | (hasNeighbors() ? c_neighborsFlag : 0u);
+  const unsigned int header[c_headerSize] = {0x57464250u /* "PBFW" */, m_version, flags, (unsigned int)m_particles.size(), m_step};
+  file.write(reinterpret_cast<const char *>(header), sizeof(header));
+  char name[m_nameSize] = {};
+  std::strncpy(name, m_scene.c_str(), m_nameSize - 1);
+  file.write(name, sizeof(name));
+  const float bounds[6] = {m_bb.m_minx, m_bb.m_maxx, m_bb.m_miny, m_bb.m_maxy, m_bb.m_minz, m_bb.m_maxz};
+  file.write(reinterpret_cast<const char *>(bounds), sizeof(bounds));
+
+  for(const Particle &p : m_particles)
+  {
+    const float values[m_recordSize] = {p.m_pos.m_x, p.m_pos.m_y, p.m_pos.m_z,
+                                        p.m_vel.m_x, p.m_vel.m_y, p.m_vel.m_z,
+                                        p.m_extForces.m_x, p.m_extForces.m_y, p.m_extForces.m_z,
+                                        p.m_mass, p.m_radius, p.m_density, p.m_lambda};
+    file.write(reinterpret_cast<const char *>(&p.m_id), sizeof(p.m_id));
+    file.write(reinterpret_cast<const char *>(values), sizeof(values));
+  }
+
+  if(hasNeighbors())
+  {
+    for(unsigned int i = 0; i < m_particles.size(); ++i)
+    {
+      const unsigned int count = m_neighborOffsets[i + 1] - m_neighborOffsets[i];
+      file.write(reinterpret_cast<const char *>(&count), sizeof(count));
+    }
+    file.write(reinterpret_cast<const char *>(m_neighbors.data()), m_neighbors.size() * sizeof(unsigned int));
+  }
+  return (bool)file;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+bool Workload::read(const std::string &_fileName, std::ostream &o_report)
+{
+  *this = Workload();
+  std::ifstream file(_fileName.c_str(), std::ios::binary);
+  if(!file)
+  {
+    o_report << _fileName << ": could not open the workload file\n";
+    return false;
+  }
+
+  // The size of the file bounds the particle count before anything is allocated for them
+  file.seekg(0, std::ios::end);
+  const unsigned long long fileSize = file.tellg();
+  file.seekg(0, std::ios::beg);
+
+  unsigned int header[c_headerSize];
+  char name[m_nameSize];
+  float bounds[6];
+  file.read(reinterpret_cast<char *>(header), sizeof(header));
+  file.read(name, sizeof(name));
+  file.read(reinterpret_cast<char *>(bounds), sizeof(bounds));
+  if(!file || header[0] != 0x57464250u || header[1] != m_version)
+  {
+    o_report << _fileName << ": not a workload file of version " << m_version << "\n";
+    return false;
+  }
+  const unsigned long long recordBytes = sizeof(unsigned int) + m_recordSize * sizeof(float);
+  const unsigned long long particleBytes = sizeof(header) + sizeof(name) + sizeof(bounds) + header[3] * recordBytes;
+  const bool neighbors = (header[2] & c_neighborsFlag) != 0;
+  if(particleBytes + (neighbors ? header[3] * sizeof(unsigned int) : 0) > fileSize)
+  {
+    o_report << _fileName << ": workload file is truncated\n";
+    return false;
+  }
+
+  name[m_nameSize - 1] = '\0';
+  m_scene = name;
+  m_step = header[4];
+  m_waves = (header[2] & c_wavesFlag) != 0;
+  m_bb = BoundingBox(bounds[0], bounds[1], bounds[2], bounds[3], bounds[4], bounds[5]);
+  m_particles.resize(header[3]);
+  for(Particle &p : m_particles)
+  {
+    float values[m_recordSize];
+    file.read(reinterpret_cast<char *>(&p.m_id), sizeof(p.m_id));
+    file.read(reinterpret_cast<char *>(values), sizeof(values));
+    p.m_pos.set(values[0], values[1], values[2]);
+    p.m_vel.set(values[3], values[4], values[5]);
+    p.m_extForces.set(values[6], values[7], values[8]);
+    p.m_mass = values[9];
+    p.m_radius = values[10];
+    p.m_density = values[11];
+    p.m_lambda = values[12];
+    p.m_predPos = p.m_pos;
+    p.m_posUpdate.set(0.f, 0.f, 0.f);
+  }
+
+  if(neighbors)
+  {
+    m_neighborOffsets.resize(header[3] + 1);
+    m_neighborOffsets[0] = 0;
+    unsigned long long total = 0;
+    for(unsigned int i = 0; i < header[3]; ++i)
+    {
+      unsigned int count = 0;
+      file.read(reinterpret_cast<char *>(&count), sizeof(count));
+      total += count;
+      m_neighborOffsets[i + 1] = total;
+    }
+    if(!file || particleBytes + (header[3] + total) * sizeof(unsigned int) > fileSize)
+    {
+      o_report << _fileName << ": workload file is truncated\n";
+      *this = Workload();
+      return false;
+    }
+    m_neighbors.resize(total);
+    file.read(reinterpret_cast<char *>(m_neighbors.data()), total * sizeof(unsigned int));
+    if(std::any_of(m_neighbors.begin(), m_neighbors.end(), [&](const unsigned int &_n) { return _n >= header[3]; }))
+    {
+      o_report << _fileName << ": workload file has neighbors that aren't particles\n";
+      *this = Workload();
+      return false;
+    }
+  }
+
+  if(!file)
+  {
+    o_report << _fileName << ": workload file is truncated\n";
+    *this = Workload();
+    return false;
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+unsigned int Workload::restore(ParticleBuffer &o_storage, const unsigned int &_first, const unsigned int &_stride) const
+{
+  // Every rank takes its share in the order of the capture, the storage is first touched by the threads
+  const unsigned int total = m_particles.size();
+  const unsigned int local = total > _first ? (total - _first + _stride - 1) / _stride : 0;
+  o_storage.clear();
+  o_storage.resize(local);
+#pragma omp parallel for schedule(static)
+  for(int i = 0; i < (int)local; ++i)
+    o_storage[i] = m_particles[_first + i * _stride];
+  return total;
+}
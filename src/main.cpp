@@ -2,12 +2,1042 @@
 basic OpenGL demo modified from http://qt-project.org/doc/qt-5.0/qtgui/openglwindow.html
 ****************************************************************************/
 #include <QtGui/QGuiApplication>
+#include <algorithm>
 #include <iostream>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
 #include "NGLScene.h"
+#include "AllocationCounter.h"
+#include "Domain.h"
+#include "Ensemble.h"
+#include "GoldenState.h"
+#include "Workload.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief ReorderOptions Space filling curve reordering of the particles given on the command line
+//----------------------------------------------------------------------------------------------------------------------
+struct ReorderOptions
+{
+  ParticleOrder::Curve curve;
+  unsigned int interval;
+  float threshold;
+  void apply(FluidSystem &io_pbf) const { io_pbf.setReordering(curve, interval, threshold); }
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief MetricsOptions Live metrics feed given on the command line, no feed without a name
+//----------------------------------------------------------------------------------------------------------------------
+struct MetricsOptions
+{
+  std::string name;
+  unsigned int interval;
+  void apply(FluidSystem &io_pbf, const std::string &_suffix = "") const
+  {
+    if(!name.empty() && !io_pbf.setMetricsFeed(name + _suffix, interval))
+      std::cerr << "Could not create the metrics feed " << name + _suffix << "\n";
+  }
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief FrameOptions Frame feed for a viewer process given on the command line, no feed without a name
+//----------------------------------------------------------------------------------------------------------------------
+struct FrameOptions
+{
+  std::string name;
+  unsigned int interval;
+  void apply(FluidSystem &io_pbf, const std::string &_suffix = "") const
+  {
+    if(!name.empty() && !io_pbf.setFrameFeed(name + _suffix, interval))
+      std::cerr << "Could not create the frame feed " << name + _suffix << "\n";
+  }
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief SolverOptions Iteration of the constraints given on the command line
+//----------------------------------------------------------------------------------------------------------------------
+struct SolverOptions
+{
+  FluidSystem::SolverMode mode;
+  bool warmStart;
+  float relaxation;
+  unsigned int levels;
+  unsigned int levelIterations;
+  void apply(FluidSystem &io_pbf) const
+  {
+    io_pbf.setSolverMode(mode);
+    io_pbf.setWarmStart(warmStart);
+    io_pbf.setRelaxation(relaxation);
+    io_pbf.setMultilevel(levels, levelIterations);
+  }
+};
+
+#ifdef PBF_USE_MPI
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief runDistributed Runs a headless simulation split over the MPI ranks, e.g. mpirun -np 4 ./pbf --distributed 500
+/// @param[in] _frames    Amount of frames to simulate
+/// @param[in] _pinThreads Pin the worker threads of each rank
+/// @param[in] _hugePages Use transparent huge pages for the particle and neighbor buffers
+/// @param[in] _seeder    Initial particles, the dam break if it has no volumes
+/// @param[in] _solver    Iteration of the constraints, the ranks always iterate Jacobi
+/// @param[in] _reorder   Reordering of the particles of each rank
+/// @param[in] _metrics   Metrics feed of each rank, the rank is appended to the name
+/// @param[in] _frameFeed Frame feed of each rank, the rank is appended to the name
+/// @param[in] _nns       Neighbor search of each rank
+/// @return               Exit code
+//----------------------------------------------------------------------------------------------------------------------
+int runDistributed(const unsigned int &_frames, const bool &_pinThreads, const bool &_hugePages, const Seeder &_seeder,
+                   const SolverOptions &_solver, const ReorderOptions &_reorder, const MetricsOptions &_metrics,
+                   const FrameOptions &_frameFeed, const std::string &_nns)
+{
+  // The domain frees its datatypes when it goes out of scope, so it has to before MPI_Finalize()
+  int status = EXIT_SUCCESS;
+  MPI_Init(nullptr, nullptr);
+  {
+    Domain domain;
+    FluidSystem pbf;
+    pbf.setDomain(&domain);
+    pbf.setNumaMode(_pinThreads, _hugePages);
+    pbf.setNeighborSearch(_nns);
+    pbf.getSeeder() = _seeder;
+    _solver.apply(pbf);
+    _reorder.apply(pbf);
+    if(!pbf.init())
+    {
+      status = EXIT_FAILURE;
+    }
+    else
+    {
+      pbf.toggleSimulation();
+      _metrics.apply(pbf, ".rank" + std::to_string(domain.getRank()));
+      _frameFeed.apply(pbf, ".rank" + std::to_string(domain.getRank()));
+
+      unsigned long initialCount = domain.globalCount(pbf.getOwnedCount());
+      std::chrono::time_point<std::chrono::system_clock> start = std::chrono::system_clock::now();
+      for(unsigned int i = 0; i < _frames; ++i)
+        pbf.execute();
+      std::chrono::duration<float> elapsed = std::chrono::system_clock::now() - start;
+
+      // Report the particle counts of each rank in order and check that no particles were lost on the way
+      unsigned long finalCount = domain.globalCount(pbf.getOwnedCount());
+      for(int r = 0; r < domain.getSize(); ++r)
+      {
+        if(r == domain.getRank())
+          std::cout << "Rank " << r << ": " << pbf.getOwnedCount() << " particles, " << pbf.getParticles().size() - pbf.getOwnedCount() << " ghosts\n" << std::flush;
+        MPI_Barrier(MPI_COMM_WORLD);
+      }
+      if(domain.getRank() == 0)
+      {
+        std::cout << _frames << " frames in " << elapsed.count() << "s (" << elapsed.count() / _frames << "s per frame)\n";
+        std::cout << "Particle count " << initialCount << " -> " << finalCount << "\n";
+      }
+    }
+  }
+  MPI_Finalize();
+  return status;
+}
+#endif
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief runGolden        Runs the reference scenes headless and records or checks their golden state files,
+///                         e.g. ./pbf --golden-check golden --tolerance 1e-3 0.05 1e-3 --bulk-tolerance 0.05 --tasks
+/// @param[in] _directory   Directory of the golden files
+/// @param[in] _record      Write the golden files instead of comparing against them
+/// @param[in] _tolerance   Allowed differences when comparing
+/// @param[in] _tasks       Run the task graph mode
+/// @param[in] _deterministic Run the deterministic mode
+/// @param[in] _kernelTable Size of the kernel lookup tables, 0 evaluates the kernels
+/// @param[in] _backend     Compute backend of the step
+/// @param[in] _reorder     Reordering of the particles, the states are compared by particle id
+/// @param[in] _nns         Neighbor search
+/// @return                 Exit code, failure if any of the scenes is outside the tolerances
+//----------------------------------------------------------------------------------------------------------------------
+int runGolden(const std::string &_directory, const bool &_record, const GoldenTolerance &_tolerance, const bool &_tasks, const bool &_deterministic,
+              const unsigned int &_kernelTable, const std::string &_backend, const ReorderOptions &_reorder, const std::string &_nns)
+{
+  // Reference scenes: the default dam break and the same with the wave machine running. The short
+  // scene is compared before the particles have had time to diverge with a different summation order.
+  struct Scene { const char *name; bool waves; unsigned int steps; };
+  const Scene scenes[] = {{"dam-short", false, 20}, {"dam", false, 300}, {"waves", true, 300}};
+
+  bool passed = true;
+  for(const Scene &scene : scenes)
+  {
+    FluidSystem pbf;
+    pbf.setDeterministic(_deterministic);
+    pbf.setKernelTable(_kernelTable);
+    pbf.setBackend(_backend);
+    pbf.setNeighborSearch(_nns);
+    _reorder.apply(pbf);
+    if(_tasks)
+      pbf.setTaskScheduling(0);
+    if(!pbf.init())
+      return EXIT_FAILURE;
+    pbf.toggleSimulation();
+    if(scene.waves)
+      pbf.toggleWaves();
+    for(unsigned int i = 0; i < scene.steps; ++i)
+      pbf.execute();
+
+    const std::string fileName = _directory + "/" + scene.name + ".golden";
+    if(_record)
+    {
+      if(!GoldenState::write(fileName, pbf.getParticles(), scene.steps))
+      {
+        std::cerr << "Could not write " << fileName << "\n";
+        passed = false;
+      }
+      else
+      {
+        std::cout << "Recorded " << fileName << "\n";
+      }
+    }
+    else
+    {
+      passed = GoldenState::compare(fileName, pbf.getParticles(), scene.steps, _tolerance, std::cout) && passed;
+    }
+  }
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief runSurfaceExport Simulates the dam break headless and writes the surface of every frame as an OBJ file,
+///                         e.g. ./pbf --surface-export meshes 200
+/// @param[in] _directory   Directory of the OBJ files
+/// @param[in] _frames      Amount of frames to simulate
+/// @param[in] _tasks       Run the task graph mode
+/// @param[in] _backend     Compute backend of the step
+/// @param[in] _solver      Iteration of the constraints
+/// @param[in] _seeder      Initial particles, the dam break if it has no volumes
+/// @param[in] _reorder     Reordering of the particles
+/// @param[in] _metrics     Metrics feed of the run
+/// @param[in] _frameFeed   Frame feed of the run
+/// @param[in] _nns         Neighbor search
+/// @return                 Exit code, failure if a file couldn't be written
+//----------------------------------------------------------------------------------------------------------------------
+int runSurfaceExport(const std::string &_directory, const unsigned int &_frames, const bool &_tasks, const std::string &_backend,
+                     const SolverOptions &_solver, const Seeder &_seeder, const ReorderOptions &_reorder, const MetricsOptions &_metrics,
+                     const FrameOptions &_frameFeed, const std::string &_nns)
+{
+  FluidSystem pbf;
+  pbf.setBackend(_backend);
+  pbf.setNeighborSearch(_nns);
+  _solver.apply(pbf);
+  pbf.getSeeder() = _seeder;
+  _reorder.apply(pbf);
+  if(_tasks)
+    pbf.setTaskScheduling(0);
+  pbf.setSurfaceExtraction(true, false);
+  if(!pbf.init())
+    return EXIT_FAILURE;
+  pbf.toggleSimulation();
+  _metrics.apply(pbf);
+  _frameFeed.apply(pbf);
+
+  std::chrono::time_point<std::chrono::system_clock> start = std::chrono::system_clock::now();
+  for(unsigned int i = 0; i < _frames; ++i)
+  {
+    pbf.execute();
+    char fileName[32];
+    std::snprintf(fileName, sizeof(fileName), "/surface_%04u.obj", i + 1);
+    if(!pbf.getSurface().writeOBJ(_directory + fileName))
+    {
+      std::cerr << "Could not write " << _directory + fileName << "\n";
+      return EXIT_FAILURE;
+    }
+  }
+  std::chrono::duration<float> elapsed = std::chrono::system_clock::now() - start;
+  std::cout << _frames << " surfaces written to " << _directory << " in " << elapsed.count() << "s\n";
+  return EXIT_SUCCESS;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief runEnsemble      Runs a parameter sweep as an ensemble of independent scenes and writes their metrics,
+///                         e.g. ./pbf --ensemble sweep.csv 300 k=0.05,0.1,0.2 epsilon=0.0005,0.005 iterations=2,3,4
+///                         runs every combination of the values
+/// @param[in] _fileName    CSV file of the metrics
+/// @param[in] _steps       Amount of steps per scene
+/// @param[in] _sweeps      Swept parameters as name=value,value,... with the names k, n, epsilon, xsph, vorticity,
+///                         iterations, relaxation, warmstart, levels and waves
+/// @param[in] _seeder      Initial particles of every scene, the dam break if it has no volumes
+/// @return                 Exit code, failure on a bad sweep or if the file couldn't be written
+//----------------------------------------------------------------------------------------------------------------------
+int runEnsemble(const std::string &_fileName, const unsigned int &_steps, const std::vector<std::string> &_sweeps, const Seeder &_seeder)
+{
+  // Values of each swept parameter
+  const char *names[] = {"k", "n", "epsilon", "xsph", "vorticity", "iterations", "relaxation", "warmstart", "levels", "waves"};
+  std::vector<std::pair<int, std::vector<float>>> axes;
+  for(const std::string &sweep : _sweeps)
+  {
+    const std::string::size_type split = sweep.find('=');
+    const std::string name = sweep.substr(0, split);
+    int parameter = -1;
+    for(int n = 0; n < 10; ++n)
+    {
+      if(name == names[n])
+        parameter = n;
+    }
+    if(split == std::string::npos || parameter == -1)
+    {
+      std::cerr << "Unknown sweep " << sweep << ", expected name=value,value,...\n";
+      return EXIT_FAILURE;
+    }
+    std::vector<float> values;
+    for(std::string::size_type start = split + 1; start <= sweep.size();)
+    {
+      std::string::size_type end = sweep.find(',', start);
+      if(end == std::string::npos)
+        end = sweep.size();
+      values.push_back(std::atof(sweep.substr(start, end - start).c_str()));
+      start = end + 1;
+    }
+    axes.push_back(std::make_pair(parameter, values));
+  }
+
+  // One scene per combination, the first axis changes fastest
+  Ensemble ensemble;
+  unsigned int combinations = 1;
+  for(unsigned int a = 0; a < axes.size(); ++a)
+    combinations *= axes[a].second.size();
+  for(unsigned int c = 0; c < combinations; ++c)
+  {
+    EnsembleScene scene = Ensemble::defaultScene(_steps);
+    scene.name = "scene" + std::to_string(c);
+    scene.seeder = _seeder;
+    unsigned int index = c;
+    for(unsigned int a = 0; a < axes.size(); ++a)
+    {
+      const float value = axes[a].second[index % axes[a].second.size()];
+      index /= axes[a].second.size();
+      switch(axes[a].first)
+      {
+        case 0: scene.parameters.k = value; break;
+        case 1: scene.parameters.n = (int)value; break;
+        case 2: scene.parameters.epsilon = value; break;
+        case 3: scene.parameters.xsph_c = value; break;
+        case 4: scene.parameters.vorticityScale = value; break;
+        case 5: scene.iterations = (unsigned int)value; break;
+        case 6: scene.relaxation = value; break;
+        case 7: scene.warmStart = value != 0.f; break;
+        case 8: scene.levels = (unsigned int)value; break;
+        default: scene.waves = value != 0.f; break;
+      }
+    }
+    ensemble.addScene(scene);
+  }
+
+  std::chrono::time_point<std::chrono::system_clock> start = std::chrono::system_clock::now();
+  ensemble.run();
+  std::chrono::duration<float> elapsed = std::chrono::system_clock::now() - start;
+
+  unsigned int unstable = 0;
+  for(const SceneMetrics &metrics : ensemble.getMetrics())
+    unstable += metrics.stable ? 0 : 1;
+  std::cout << combinations << " scenes on " << ensemble.getThreadCount() << " workers in " << elapsed.count() << "s ("
+            << combinations / elapsed.count() << " scenes/s), " << unstable << " unstable\n";
+
+  std::ofstream file(_fileName.c_str());
+  ensemble.writeCSV(file);
+  if(!file)
+  {
+    std::cerr << "Could not write " << _fileName << "\n";
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief printSample      Prints a metrics sample as a line of text or of comma separated values
+/// @param[in] _sample      Sample to print
+/// @param[in] _csv         Print comma separated values, the stage times are last
+/// @param[in] _header      Print the header row of the values first
+//----------------------------------------------------------------------------------------------------------------------
+void printSample(const MetricsSample &_sample, const bool &_csv, const bool &_header)
+{
+  if(_csv)
+  {
+    if(_header)
+    {
+      std::cout << "step,elapsed,steps_per_s,particle_steps_per_s,step_ms,max_step_ms,particles,ghosts,iterations,"
+                   "mean_density_error,max_density_error,moving,resting,min_neighbors,mean_neighbors,max_neighbors,"
+                   "particle_bytes,neighbor_bytes,resident_bytes";
+      for(unsigned int s = 0; s < _sample.stageCount; ++s)
+        std::cout << "," << _sample.stages[s].name << (_sample.stages[s].index >= 0 ? std::to_string(_sample.stages[s].index) : "") << "_ms";
+      std::cout << "\n";
+    }
+    std::cout << _sample.step << "," << _sample.elapsed << "," << _sample.stepRate << "," << _sample.particleStepRate << ","
+              << _sample.stepTime << "," << _sample.maxStepTime << "," << _sample.particles << "," << _sample.ghosts << ","
+              << _sample.iterations << "," << _sample.meanDensityError << "," << _sample.maxDensityError << ","
+              << _sample.movingParticles << "," << _sample.restingParticles << "," << _sample.minNeighbors << ","
+              << _sample.meanNeighbors << "," << _sample.maxNeighbors << "," << _sample.particleBytes << ","
+              << _sample.neighborBytes << "," << _sample.residentBytes;
+    for(unsigned int s = 0; s < _sample.stageCount; ++s)
+      std::cout << "," << _sample.stages[s].meanTime;
+    std::cout << std::endl;
+    return;
+  }
+
+  char line[256];
+  std::snprintf(line, sizeof(line), "step %lu  %.1fs  %.1f steps/s  %.3g particle-steps/s  step %.2f ms (max %.2f)  %u particles",
+                (unsigned long)_sample.step, _sample.elapsed, _sample.stepRate, _sample.particleStepRate, _sample.stepTime,
+                _sample.maxStepTime, _sample.particles);
+  std::cout << line;
+  if(_sample.ghosts)
+    std::cout << " + " << _sample.ghosts << " ghosts";
+  std::snprintf(line, sizeof(line), "\n  %u iterations, density error %.4f (max %.4f)  resting %u  neighbors %u/%.1f/%u  rss %.1f MB",
+                _sample.iterations, _sample.meanDensityError, _sample.maxDensityError, _sample.restingParticles,
+                _sample.minNeighbors, _sample.meanNeighbors, _sample.maxNeighbors, _sample.residentBytes / 1048576.0);
+  std::cout << line << "\n";
+  for(unsigned int s = 0; s < _sample.stageCount; ++s)
+  {
+    std::snprintf(line, sizeof(line), "  %-14s %8.3f ms  p95 %8.3f ms\n", (std::string(_sample.stages[s].name) +
+                  (_sample.stages[s].index >= 0 ? " " + std::to_string(_sample.stages[s].index) : "")).c_str(),
+                  _sample.stages[s].meanTime, _sample.stages[s].p95Time);
+    std::cout << line;
+  }
+  std::cout << std::flush;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief runMonitor       Attaches to the metrics feed of a run on this node and prints its samples until the run
+///                         ends, e.g. ./pbf --monitor dam 500 --csv >> dam.csv. Lists the feeds without a name.
+/// @param[in] _name        Name of the feed, empty to list the feeds
+/// @param[in] _period      Milliseconds between the reads
+/// @param[in] _csv         Print comma separated values instead of text
+/// @return                 Exit code, failure if the feed couldn't be attached to
+//----------------------------------------------------------------------------------------------------------------------
+int runMonitor(const std::string &_name, const unsigned int &_period, const bool &_csv)
+{
+  MetricsReader reader;
+  MetricsSample sample;
+  if(_name.empty())
+  {
+    for(const std::string &name : MetricsFeed::list())
+    {
+      if(!reader.attach(name))
+        continue;
+      const bool published = reader.read(sample);
+      std::cout << name << "  pid " << reader.getPid() << (reader.isAlive() ? "" : " (ended)");
+      if(published)
+        std::cout << "  step " << sample.step << "  " << sample.stepRate << " steps/s  " << sample.particles << " particles";
+      std::cout << "\n";
+    }
+    return EXIT_SUCCESS;
+  }
+
+  if(!reader.attach(_name))
+  {
+    std::cerr << "No metrics feed " << _name << "\n";
+    return EXIT_FAILURE;
+  }
+  bool header = true;
+  while(reader.isAlive())
+  {
+    if(reader.read(sample))
+    {
+      printSample(sample, _csv, header);
+      header = false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(_period));
+  }
+  if(!_csv)
+    std::cout << "The run has ended\n";
+  return EXIT_SUCCESS;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief runCapture     Runs the reference scenes headless and captures their particles at the given steps as workload
+///                       files for the benchmarks, e.g. ./pbf --capture workloads 0,100,300
+/// @param[in] _directory Directory of the workload files, named <scene>-<step>.workload
+/// @param[in] _steps     Steps to capture at, ascending
+/// @param[in] _neighbors Record the neighbor lists of the grid as well
+/// @param[in] _seeder    Initial particles, the dam break if it has no volumes
+/// @param[in] _nns       Neighbor search of the simulation
+/// @return               Exit code, failure if a file couldn't be written
+//----------------------------------------------------------------------------------------------------------------------
+int runCapture(const std::string &_directory, const std::vector<unsigned int> &_steps, const bool &_neighbors, const Seeder &_seeder,
+               const std::string &_nns)
+{
+  // The scenes of the golden harness, the dam break and the same with the wave machine running
+  struct Scene { const char *name; bool waves; };
+  const Scene scenes[] = {{"dam", false}, {"waves", true}};
+
+  bool written = true;
+  for(const Scene &scene : scenes)
+  {
+    FluidSystem pbf;
+    pbf.setVerbose(false);
+    pbf.setNeighborSearch(_nns);
+    pbf.getSeeder() = _seeder;
+    if(!pbf.init())
+      return EXIT_FAILURE;
+    pbf.toggleSimulation();
+    if(scene.waves)
+      pbf.toggleWaves();
+    unsigned int step = 0;
+    for(const unsigned int &target : _steps)
+    {
+      for(; step < target; ++step)
+        pbf.execute();
+
+      Workload workload;
+      workload.capture(scene.name, step, pbf.getBoundingBox(), scene.waves, pbf.getParticles(), pbf.getOwnedCount());
+      if(_neighbors)
+        workload.computeNeighbors();
+      const std::string fileName = _directory + "/" + scene.name + "-" + std::to_string(step) + ".workload";
+      if(!workload.write(fileName))
+      {
+        std::cerr << "Could not write " << fileName << "\n";
+        written = false;
+      }
+      else
+      {
+        std::cout << "Captured " << fileName << ", " << workload.getParticles().size() << " particles\n";
+      }
+    }
+  }
+  return written ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief runNeighborBench Times the neighbor searches side by side on the same particles and checks that they find the
+///                         same neighbors as the uniform grid, e.g. ./pbf --nns-bench 200. The scenes are the seeded
+///                         tank, the splash after the given amount of steps and the splash spread over eight times
+///                         the volume, or the given workload files. The neighbors recorded in a workload are the
+///                         reference instead of the grid. The range queries look twice the neighbor radius around
+///                         every particle. The lists are compared after refitting each search from the particles of
+///                         the previous scene.
+/// @param[in] _steps       Steps of the dam break before the splash is taken
+/// @param[in] _seeder      Initial particles, the dam break if it has no volumes
+/// @param[in] _workloads   Workload files to use as the scenes, the seeded scenes if empty
+/// @return                 Exit code, failure if a search disagrees with the reference, allocates when
+///                         rebuilding or a workload can't be read
+//----------------------------------------------------------------------------------------------------------------------
+int runNeighborBench(const unsigned int &_steps, const Seeder &_seeder, const std::vector<std::string> &_workloads)
+{
+  struct Scene { std::string name; BoundingBox bb; std::vector<Particle> particles; const Workload *recorded; };
+  std::vector<Scene> scenes;
+  std::vector<Workload> workloads(_workloads.size());
+  for(unsigned int w = 0; w < _workloads.size(); ++w)
+  {
+    if(!workloads[w].read(_workloads[w], std::cerr))
+      return EXIT_FAILURE;
+    const Workload &workload = workloads[w];
+    scenes.push_back({workload.getScene() + "-" + std::to_string(workload.getStep()), workload.getBounds(), workload.getParticles(),
+                      workload.hasNeighbors() ? &workload : nullptr});
+  }
+  if(scenes.empty())
+  {
+    FluidSystem pbf;
+    pbf.setVerbose(false);
+    pbf.getSeeder() = _seeder;
+    if(!pbf.init())
+      return EXIT_FAILURE;
+    const BoundingBox &bb = pbf.getBoundingBox();
+    scenes.push_back({"tank", bb, {}, nullptr});
+    for(Particle *p : pbf.getParticles())
+      scenes.back().particles.push_back(*p);
+    pbf.toggleSimulation();
+    for(unsigned int i = 0; i < _steps; ++i)
+      pbf.execute();
+    scenes.push_back({"splash", bb, {}, nullptr});
+    for(Particle *p : pbf.getParticles())
+      scenes.back().particles.push_back(*p);
+
+    // Twice the distances from the centre of the box, the particles are sparse and the box eight times the volume
+    const Vec3 centre(0.5f * (bb.m_minx + bb.m_maxx), 0.5f * (bb.m_miny + bb.m_maxy), 0.5f * (bb.m_minz + bb.m_maxz));
+    scenes.push_back({"open", BoundingBox(2.f * bb.m_minx - centre.m_x, 2.f * bb.m_maxx - centre.m_x,
+                                          2.f * bb.m_miny - centre.m_y, 2.f * bb.m_maxy - centre.m_y,
+                                          2.f * bb.m_minz - centre.m_z, 2.f * bb.m_maxz - centre.m_z), scenes.back().particles, nullptr});
+    for(Particle &p : scenes.back().particles)
+      p.m_pos = centre + 2.f * (p.m_pos - centre);
+  }
+
+  const char *names[] = {"grid", "hash", "octree", "kdtree"};
+  const unsigned int repeats = 10;
+  typedef std::chrono::duration<float, std::milli> Milliseconds;
+  bool agree = true;
+  std::printf("%-12s %-8s %10s %10s %10s %10s %10s %12s %10s %8s\n", "scene", "search", "init ms", "build ms", "table ms", "update ms",
+              "range ms", "range hits", "mismatch", "allocs");
+  std::vector<Particle *> previous;
+  for(Scene &scene : scenes)
+  {
+    std::vector<Particle *> particles;
+    for(Particle &p : scene.particles)
+      particles.push_back(&p);
+    const unsigned int count = particles.size();
+    std::vector<unsigned int> reference, indices;
+    if(scene.recorded)
+    {
+      for(unsigned int i = 0; i < count; ++i)
+      {
+        const std::pair<const unsigned int *, unsigned int> neighbors = scene.recorded->getNeighbors(i);
+        reference.push_back(neighbors.second);
+        reference.insert(reference.end(), neighbors.first, neighbors.first + neighbors.second);
+      }
+    }
+    std::size_t referenceHits = 0;
+    bool haveHits = false;
+    for(const char *name : names)
+    {
+      std::unique_ptr<NNS> nns = NNS::create(name);
+      std::chrono::time_point<std::chrono::steady_clock> start = std::chrono::steady_clock::now();
+      nns->init(scene.bb, count, 150);
+      const float initTime = Milliseconds(std::chrono::steady_clock::now() - start).count();
+
+      // The first repeat sizes the structures, the later ones have to rebuild them without allocating
+      float buildTime = 0.f, tableTime = 0.f;
+      AllocationScope allocations;
+      for(unsigned int r = 0; r < repeats; ++r)
+      {
+        if(r == 1)
+          allocations.reset();
+        nns->cleanTable();
+        start = std::chrono::steady_clock::now();
+        nns->buildGrid(particles);
+        std::chrono::time_point<std::chrono::steady_clock> built = std::chrono::steady_clock::now();
+        nns->buildNeighborTable(particles);
+        buildTime += Milliseconds(built - start).count();
+        tableTime += Milliseconds(std::chrono::steady_clock::now() - built).count();
+      }
+      const unsigned long long allocationCount = allocations.getAllocations();
+
+      start = std::chrono::steady_clock::now();
+      std::size_t hits = 0;
+      for(unsigned int i = 0; i < count; ++i)
+      {
+        nns->rangeQuery(particles, particles[i]->m_pos, 2.f * nns->getFixedRadius(), indices);
+        hits += indices.size();
+      }
+      const float rangeTime = Milliseconds(std::chrono::steady_clock::now() - start).count();
+
+      // The structure is refitted to these particles from those of the previous scene where it has as many, so the
+      // lists below check that a refit finds the same neighbors as a build
+      float updateTime = 0.f;
+      if(previous.size() == count)
+      {
+        nns->cleanTable();
+        nns->buildGrid(previous);
+        nns->cleanTable();
+        start = std::chrono::steady_clock::now();
+        nns->update(particles);
+        updateTime = Milliseconds(std::chrono::steady_clock::now() - start).count();
+      }
+
+      // Sorted lists of every particle compared to the recorded ones or the ones of the uniform grid
+      nns->setSortedNeighbors(true);
+      nns->buildNeighborTable(particles);
+      std::vector<unsigned int> lists;
+      for(unsigned int i = 0; i < count; ++i)
+      {
+        const std::pair<unsigned int *, unsigned int> neighbors = nns->getNeighbors(i);
+        lists.push_back(neighbors.second);
+        lists.insert(lists.end(), neighbors.first, neighbors.first + neighbors.second);
+      }
+      unsigned int mismatch = 0;
+      if(reference.empty())
+      {
+        reference.swap(lists);
+      }
+      else
+      {
+        for(std::size_t a = 0, b = 0; a < reference.size() && b < lists.size(); a += reference[a] + 1, b += lists[b] + 1)
+          mismatch += reference[a] != lists[b] || !std::equal(&reference[a + 1], &reference[a + 1] + reference[a], &lists[b + 1]);
+      }
+      if(haveHits)
+        mismatch += hits != referenceHits;
+      referenceHits = hits;
+      haveHits = true;
+      agree = agree && mismatch == 0 && allocationCount == 0;
+      std::printf("%-12s %-8s %10.2f %10.3f %10.3f %10.3f %10.2f %12zu %10u %8llu\n", scene.name.c_str(), name, initTime,
+                  buildTime / repeats, tableTime / repeats, updateTime, rangeTime, hits, mismatch, allocationCount);
+    }
+    previous.swap(particles);
+  }
+  return agree ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief runSolverBench   Times the simulation step starting from workload files, e.g.
+///                         ./pbf --solver-bench 50 workloads/dam-300.workload. Every run starts from the same
+///                         particles so the timings and checksums of different builds and options can be compared.
+/// @param[in] _steps       Steps to time from each workload
+/// @param[in] _workloads   Workload files
+/// @param[in] _tasks       Run the task graph mode
+/// @param[in] _deterministic Run the deterministic mode
+/// @param[in] _kernelTable Size of the kernel lookup tables, 0 evaluates the kernels
+/// @param[in] _backend     Compute backend of the step
+/// @param[in] _solver      Iteration of the constraints
+/// @param[in] _reorder     Reordering of the particles
+/// @param[in] _nns         Neighbor search
+/// @return                 Exit code, failure if a workload can't be read or a step after the first ten allocates with
+///                         the surface extraction and the feeds on
+//----------------------------------------------------------------------------------------------------------------------
+int runSolverBench(const unsigned int &_steps, const std::vector<std::string> &_workloads, const bool &_tasks, const bool &_deterministic,
+                   const unsigned int &_kernelTable, const std::string &_backend, const SolverOptions &_solver, const ReorderOptions &_reorder,
+                   const std::string &_nns)
+{
+  typedef std::chrono::duration<float, std::milli> Milliseconds;
+  std::printf("%-12s %10s %10s %12s %14s %16s %8s\n", "workload", "particles", "init ms", "step ms", "mean density", "checksum", "allocs");
+  bool steady = true;
+  for(const std::string &fileName : _workloads)
+  {
+    Workload workload;
+    if(!workload.read(fileName, std::cerr))
+      return EXIT_FAILURE;
+
+    const auto configure = [&](FluidSystem &io_pbf)
+    {
+      io_pbf.setVerbose(false);
+      io_pbf.setDeterministic(_deterministic);
+      io_pbf.setKernelTable(_kernelTable);
+      io_pbf.setBackend(_backend);
+      io_pbf.setNeighborSearch(_nns);
+      _solver.apply(io_pbf);
+      _reorder.apply(io_pbf);
+      if(_tasks)
+        io_pbf.setTaskScheduling(0);
+      io_pbf.setWorkload(&workload);
+    };
+
+    FluidSystem pbf;
+    configure(pbf);
+    std::chrono::time_point<std::chrono::steady_clock> start = std::chrono::steady_clock::now();
+    if(!pbf.init())
+      return EXIT_FAILURE;
+    const float initTime = Milliseconds(std::chrono::steady_clock::now() - start).count();
+    pbf.toggleSimulation();
+    if(workload.getWaves())
+      pbf.toggleWaves();
+    start = std::chrono::steady_clock::now();
+    for(unsigned int i = 0; i < _steps; ++i)
+      pbf.execute();
+    const float stepTime = Milliseconds(std::chrono::steady_clock::now() - start).count() / std::max(_steps, 1u);
+
+    // The allocations are counted on the same steps again with the surface extraction, a metrics sample and a frame
+    // every step, they're left out of the timed run so its step times stay comparable. The first steps size the
+    // buffers, the steps after them have to run without allocating. Where there's no shared memory the check runs
+    // without the feeds.
+    unsigned long long allocationCount = 0;
+    {
+      FluidSystem checked;
+      configure(checked);
+      checked.setSurfaceExtraction(true, false);
+      checked.setMetricsFeed("solver-bench", 1);
+      checked.setFrameFeed("solver-bench", 1);
+      if(!checked.init())
+        return EXIT_FAILURE;
+      checked.toggleSimulation();
+      if(workload.getWaves())
+        checked.toggleWaves();
+      const unsigned int warmUp = std::min(10u, _steps / 2);
+      AllocationScope allocations;
+      for(unsigned int i = 0; i < _steps; ++i)
+      {
+        if(i == warmUp)
+          allocations.reset();
+        checked.execute();
+      }
+      allocationCount = allocations.getAllocations();
+    }
+    steady = steady && allocationCount == 0;
+
+    // Mean density relative to the rest density and a position checksum to compare runs by
+    const float inverseRestDensity = pbf.getSolverParameters().inverseRestDensity;
+    double density = 0.0, checksum = 0.0;
+    const std::vector<Particle *> &particles = pbf.getParticles();
+    for(const Particle *p : particles)
+    {
+      density += p->m_density * inverseRestDensity;
+      checksum += p->m_pos.m_x + 2.0 * p->m_pos.m_y + 3.0 * p->m_pos.m_z;
+    }
+    std::printf("%-12s %10zu %10.2f %12.3f %14.6f %16.6f %8llu\n", (workload.getScene() + "-" + std::to_string(workload.getStep())).c_str(),
+                particles.size(), initTime, stepTime, particles.empty() ? 0.0 : density / particles.size(), checksum, allocationCount);
+  }
+  return steady ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief printUsage   Lists the modes and the options, for --help and unknown arguments
+/// @param[out] o_stream Stream to write to
+//----------------------------------------------------------------------------------------------------------------------
+void printUsage(std::ostream &o_stream)
+{
+  o_stream <<
+    "Usage: pbf [mode] [options]\n"
+    "Without a mode the simulation runs in a window, the dam break unless volumes are seeded.\n"
+    "\n"
+    "Modes, given first:\n"
+    "  --golden-record dir             Run the reference scenes headless and store their states in dir\n"
+    "  --golden-check dir              Run the reference scenes and compare them to the states in dir\n"
+    "  --surface-export dir frames     Write the surface of every frame to dir as OBJ files\n"
+    "  --ensemble file steps name=a,b  Run every combination of the swept parameters, write the metrics as CSV\n"
+    "  --monitor [name [ms]]           Print the metrics feed of another run, lists the feeds without a name\n"
+    "  --nns-bench [steps] [files]     Compare the neighbor searches on the seeded scenes or on workload files\n"
+    "  --capture dir step,step,...     Write workload files of the reference scenes at the given steps\n"
+    "  --solver-bench steps files      Time the step from workload files\n"
+#ifdef PBF_USE_MPI
+    "  --distributed frames            Run headless split over the MPI ranks\n"
+#endif
+    "\n"
+    "Simulation:\n"
+    "  --numa                          Pin the worker threads to the cores\n"
+    "  --hugepages                     Back the particle and neighbor buffers with transparent huge pages\n"
+    "  --tasks                         Run the step as a task graph over spatial tiles\n"
+    "  --deterministic                 Give bit-identical results on any thread count\n"
+    "  --kernel-table n                Interpolate the kernels from tables of n intervals\n"
+    "  --backend cpu|opencl            Device the step runs on\n"
+    "  --nns grid|hash|octree|kdtree   Neighbor search\n"
+    "  --gauss-seidel                  Iterate the constraints colour by colour instead of all at once\n"
+    "  --warm-start                    Start each step from the lambdas of the previous one\n"
+    "  --relaxation f                  Scale the position updates, backed off when the density error jumps\n"
+    "  --multilevel n                  Project n coarse levels before the fine iterations\n"
+    "  --multilevel-iterations n       Jacobi iterations per coarse level\n"
+    "  --reorder n                     Sort the particles along a space filling curve every n steps\n"
+    "  --reorder-threshold f           Sort them when the fraction f is out of order\n"
+    "  --reorder-curve hilbert|morton  Curve to sort along\n"
+    "  --workload file                 Start from a workload file\n"
+    "\n"
+    "Seeding:\n"
+    "  --seed-box x0 y0 z0 x1 y1 z1    Fill a box with particles\n"
+    "  --seed-sphere x y z r           Fill a sphere with particles\n"
+    "  --seed-mesh file                Fill a closed OBJ mesh with particles\n"
+    "  --seed-spacing f                Distance between the seeded particles\n"
+    "  --seed-count n                  Pick the spacing that seeds about n particles\n"
+    "  --seed-jitter f                 Offset the particles from the lattice by up to f of the spacing\n"
+    "\n"
+    "Output:\n"
+    "  --metrics name                  Publish live metrics to a shared memory feed\n"
+    "  --metrics-interval n            Steps between the metrics samples\n"
+    "  --frames name                   Publish the particles to a shared memory feed\n"
+    "  --frames-interval n             Steps between the published frames\n"
+    "  --csv                           Print the monitored metrics as CSV\n"
+    "  --capture-neighbors             Store the neighbor lists in the captured workloads\n"
+    "  --tolerance pos vel density     Allowed differences of --golden-check\n"
+    "  --bulk-tolerance f              Allowed difference of the bulk statistics of --golden-check\n"
+    "\n"
+    "Drawing:\n"
+    "  --spheres                       Draw the particles as meshes instead of sprites\n"
+    "  --lod-distance f                Distance the sprites turn into discs at\n"
+    "  --surface                       Draw the surface extracted on a background thread\n"
+    "  --colour density|speed|flat     Colour of the particles\n"
+    "  --viewer name                   Draw the frame feed of another run\n"
+    "  --help                          Print this\n";
+}
 
 //----------------------------------------------------------------------------------------------------------------------
 int main(int argc, char **argv)
 {
+  bool pinThreads = false, hugePages = false, tasks = false, deterministic = false, impostors = true, surface = false;
+  float lodDistance = 15.f;
+  unsigned int kernelTable = 0;
+  std::string backend = "cpu";
+  std::string nns = "grid";
+  SolverOptions solver = {FluidSystem::JACOBI, false, 1.f, 0, 2};
+  GoldenTolerance tolerance = {0.f, 0.f, 0.f, 0.f};
+  Seeder seeder;
+  ReorderOptions reorder = {ParticleOrder::HILBERT, 0, 0.f};
+  MetricsOptions metrics = {"", 10};
+  FrameOptions frameFeed = {"", 1};
+  std::string viewer;
+  NGLScene::ColourChannel colour = NGLScene::DENSITY;
+  bool csv = false;
+  bool captureNeighbors = false;
+  Workload workload;
+  // The positional arguments of a mode are read by the mode itself below
+  const char *modes[] = {"--golden-record", "--golden-check", "--surface-export", "--ensemble", "--monitor", "--nns-bench",
+                         "--capture", "--solver-bench",
+#ifdef PBF_USE_MPI
+                         "--distributed"
+#endif
+                        };
+  for(int i = 1; i < argc; ++i)
+  {
+    if(i == 1 && std::find_if(std::begin(modes), std::end(modes), [&](const char *_mode) { return std::strcmp(argv[1], _mode) == 0; }) != std::end(modes))
+    {
+      while(i + 1 < argc && std::strncmp(argv[i + 1], "--", 2) != 0)
+        ++i;
+    }
+    else if(std::strcmp(argv[i], "--help") == 0)
+    {
+      printUsage(std::cout);
+      return EXIT_SUCCESS;
+    }
+    else if(std::strcmp(argv[i], "--numa") == 0)
+      pinThreads = true;
+    else if(std::strcmp(argv[i], "--hugepages") == 0)
+      hugePages = true;
+    else if(std::strcmp(argv[i], "--tasks") == 0)
+      tasks = true;
+    else if(std::strcmp(argv[i], "--deterministic") == 0)
+      deterministic = true;
+    else if(std::strcmp(argv[i], "--tolerance") == 0 && i + 3 < argc)
+    {
+      tolerance.position = std::atof(argv[++i]);
+      tolerance.velocity = std::atof(argv[++i]);
+      tolerance.density = std::atof(argv[++i]);
+    }
+    else if(std::strcmp(argv[i], "--bulk-tolerance") == 0 && i + 1 < argc)
+      tolerance.bulk = std::atof(argv[++i]);
+    else if(std::strcmp(argv[i], "--kernel-table") == 0 && i + 1 < argc)
+      kernelTable = std::atoi(argv[++i]);
+    else if(std::strcmp(argv[i], "--backend") == 0 && i + 1 < argc)
+      backend = argv[++i];
+    else if(std::strcmp(argv[i], "--nns") == 0 && i + 1 < argc)
+      nns = argv[++i];
+    else if(std::strcmp(argv[i], "--gauss-seidel") == 0)
+      solver.mode = FluidSystem::GAUSS_SEIDEL;
+    else if(std::strcmp(argv[i], "--warm-start") == 0)
+      solver.warmStart = true;
+    else if(std::strcmp(argv[i], "--relaxation") == 0 && i + 1 < argc)
+      solver.relaxation = std::atof(argv[++i]);
+    else if(std::strcmp(argv[i], "--multilevel") == 0 && i + 1 < argc)
+      solver.levels = std::atoi(argv[++i]);
+    else if(std::strcmp(argv[i], "--multilevel-iterations") == 0 && i + 1 < argc)
+      solver.levelIterations = std::atoi(argv[++i]);
+    else if(std::strcmp(argv[i], "--spheres") == 0)
+      impostors = false;
+    else if(std::strcmp(argv[i], "--lod-distance") == 0 && i + 1 < argc)
+      lodDistance = std::atof(argv[++i]);
+    else if(std::strcmp(argv[i], "--surface") == 0)
+      surface = true;
+    else if(std::strcmp(argv[i], "--seed-box") == 0 && i + 6 < argc)
+    {
+      const Vec3 min(std::atof(argv[i + 1]), std::atof(argv[i + 2]), std::atof(argv[i + 3]));
+      const Vec3 max(std::atof(argv[i + 4]), std::atof(argv[i + 5]), std::atof(argv[i + 6]));
+      seeder.addBox(min, max);
+      i += 6;
+    }
+    else if(std::strcmp(argv[i], "--seed-sphere") == 0 && i + 4 < argc)
+    {
+      seeder.addSphere(Vec3(std::atof(argv[i + 1]), std::atof(argv[i + 2]), std::atof(argv[i + 3])), std::atof(argv[i + 4]));
+      i += 4;
+    }
+    else if(std::strcmp(argv[i], "--seed-mesh") == 0 && i + 1 < argc)
+    {
+      if(!seeder.addMesh(argv[++i]))
+      {
+        std::cerr << "Could not read a closed mesh from " << argv[i] << "\n";
+        return EXIT_FAILURE;
+      }
+    }
+    else if(std::strcmp(argv[i], "--seed-spacing") == 0 && i + 1 < argc)
+      seeder.setSpacing(std::atof(argv[++i]));
+    else if(std::strcmp(argv[i], "--seed-count") == 0 && i + 1 < argc)
+      seeder.setTargetCount(std::atoi(argv[++i]));
+    else if(std::strcmp(argv[i], "--seed-jitter") == 0 && i + 1 < argc)
+      seeder.setSampling(Seeder::JITTERED, std::atof(argv[++i]));
+    else if(std::strcmp(argv[i], "--reorder") == 0 && i + 1 < argc)
+      reorder.interval = std::atoi(argv[++i]);
+    else if(std::strcmp(argv[i], "--reorder-threshold") == 0 && i + 1 < argc)
+      reorder.threshold = std::atof(argv[++i]);
+    else if(std::strcmp(argv[i], "--reorder-curve") == 0 && i + 1 < argc)
+      reorder.curve = std::strcmp(argv[++i], "morton") == 0 ? ParticleOrder::MORTON : ParticleOrder::HILBERT;
+    else if(std::strcmp(argv[i], "--metrics") == 0 && i + 1 < argc)
+      metrics.name = argv[++i];
+    else if(std::strcmp(argv[i], "--metrics-interval") == 0 && i + 1 < argc)
+      metrics.interval = std::atoi(argv[++i]);
+    else if(std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+      frameFeed.name = argv[++i];
+    else if(std::strcmp(argv[i], "--frames-interval") == 0 && i + 1 < argc)
+      frameFeed.interval = std::atoi(argv[++i]);
+    else if(std::strcmp(argv[i], "--viewer") == 0 && i + 1 < argc)
+      viewer = argv[++i];
+    else if(std::strcmp(argv[i], "--colour") == 0 && i + 1 < argc)
+    {
+      ++i;
+      colour = std::strcmp(argv[i], "speed") == 0 ? NGLScene::SPEED : std::strcmp(argv[i], "flat") == 0 ? NGLScene::FLAT : NGLScene::DENSITY;
+    }
+    else if(std::strcmp(argv[i], "--csv") == 0)
+      csv = true;
+    else if(std::strcmp(argv[i], "--capture-neighbors") == 0)
+      captureNeighbors = true;
+    else if(std::strcmp(argv[i], "--workload") == 0 && i + 1 < argc)
+    {
+      if(!workload.read(argv[++i], std::cerr))
+        return EXIT_FAILURE;
+    }
+    else if(std::strncmp(argv[i], "--", 2) == 0)
+    {
+      // Single dash arguments are left to Qt
+      std::cerr << "Unknown argument or missing values: " << argv[i] << "\n\n";
+      printUsage(std::cerr);
+      return EXIT_FAILURE;
+    }
+  }
+
+  // Golden state harness, records or checks the reference scenes without opening a window
+  if(argc > 2 && (std::strcmp(argv[1], "--golden-record") == 0 || std::strcmp(argv[1], "--golden-check") == 0))
+    return runGolden(argv[2], std::strcmp(argv[1], "--golden-record") == 0, tolerance, tasks, deterministic, kernelTable, backend, reorder, nns);
+
+  // Monitor of the metrics feed of another run, doesn't simulate anything itself
+  if(argc > 1 && std::strcmp(argv[1], "--monitor") == 0)
+  {
+    const bool named = argc > 2 && std::strncmp(argv[2], "--", 2) != 0;
+    const bool period = named && argc > 3 && std::strncmp(argv[3], "--", 2) != 0;
+    return runMonitor(named ? argv[2] : "", period ? std::atoi(argv[3]) : 1000, csv);
+  }
+
+  // Neighbor search comparison on the particles of the seeded scene or of the workload files given after it
+  if(argc > 1 && std::strcmp(argv[1], "--nns-bench") == 0)
+  {
+    unsigned int steps = 200;
+    std::vector<std::string> workloads;
+    for(int i = 2; i < argc && std::strncmp(argv[i], "--", 2) != 0; ++i)
+    {
+      if(std::strstr(argv[i], ".workload") != nullptr)
+        workloads.push_back(argv[i]);
+      else
+        steps = std::atoi(argv[i]);
+    }
+    return runNeighborBench(steps, seeder, workloads);
+  }
+
+  // Workload capture, the steps are a comma separated list
+  if(argc > 3 && std::strcmp(argv[1], "--capture") == 0)
+  {
+    std::vector<unsigned int> steps;
+    std::stringstream list(argv[3]);
+    for(std::string step; std::getline(list, step, ','); )
+      steps.push_back(std::atoi(step.c_str()));
+    std::sort(steps.begin(), steps.end());
+    return runCapture(argv[2], steps, captureNeighbors, seeder, nns);
+  }
+
+  // Solver timing from the workload files given after the step count
+  if(argc > 3 && std::strcmp(argv[1], "--solver-bench") == 0)
+  {
+    std::vector<std::string> workloads;
+    for(int i = 3; i < argc && std::strncmp(argv[i], "--", 2) != 0; ++i)
+      workloads.push_back(argv[i]);
+    return runSolverBench(std::atoi(argv[2]), workloads, tasks, deterministic, kernelTable, backend, solver, reorder, nns);
+  }
+
+  // Parameter sweep, the name=value arguments after the step count are the swept parameters
+  if(argc > 3 && std::strcmp(argv[1], "--ensemble") == 0)
+  {
+    std::vector<std::string> sweeps;
+    for(int i = 4; i < argc && std::strchr(argv[i], '=') != nullptr; ++i)
+      sweeps.push_back(argv[i]);
+    return runEnsemble(argv[2], std::atoi(argv[3]), sweeps, seeder);
+  }
+
+  // Surface export, writes the surface of every frame without opening a window
+  if(argc > 3 && std::strcmp(argv[1], "--surface-export") == 0)
+    return runSurfaceExport(argv[2], std::atoi(argv[3]), tasks, backend, solver, seeder, reorder, metrics, frameFeed, nns);
+
+#ifdef PBF_USE_MPI
+  if(argc > 2 && std::strcmp(argv[1], "--distributed") == 0)
+    return runDistributed(std::atoi(argv[2]), pinThreads, hugePages, seeder, solver, reorder, metrics, frameFeed, nns);
+#endif
+
   QGuiApplication app(argc, argv);
   // create an OpenGL format specifier
   QSurfaceFormat format;
@@ -30,6 +1060,26 @@ int main(int argc, char **argv)
   format.setDepthBufferSize(24);
   // now we are going to create our scene window
   NGLScene window;
+  window.getFluidSystem().setNumaMode(pinThreads, hugePages);
+  window.getFluidSystem().setDeterministic(deterministic);
+  window.getFluidSystem().setKernelTable(kernelTable);
+  window.getFluidSystem().setBackend(backend);
+  window.getFluidSystem().setNeighborSearch(nns);
+  solver.apply(window.getFluidSystem());
+  window.getFluidSystem().getSeeder() = seeder;
+  if(!workload.getParticles().empty())
+    window.getFluidSystem().setWorkload(&workload);
+  reorder.apply(window.getFluidSystem());
+  metrics.apply(window.getFluidSystem());
+  frameFeed.apply(window.getFluidSystem());
+  if(!viewer.empty())
+    window.setViewer(viewer);
+  window.setImpostors(impostors, lodDistance);
+  window.setColourChannel(colour);
+  window.getFluidSystem().setSurfaceExtraction(surface, true);
+  window.setDrawSurface(surface);
+  if(tasks)
+    window.getFluidSystem().setTaskScheduling(0);
   // and set the OpenGL format
   window.setFormat(format);
   // we can now query the version to see if it worked